@@ -2118,14 +2118,14 @@ struct ABookNode *CreateABookGroup(struct ABook *abook, const char *name)
 
 ///
 /// FindPersonInABook
-struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Person *pe)
+struct ABookNode *FindPersonInABook(const struct ABook *abook, const char *address)
 {
   struct ABookNode *result = NULL;
   struct ABookNode *abn;
 
   ENTER();
 
-  if(SearchABook(abook, pe->Address, ASM_ADDRESS|ASM_USER|ASM_COMPLETE, &abn) == 1)
+  if(SearchABook(abook, address, ASM_ADDRESS|ASM_USER|ASM_COMPLETE, &abn) == 1)
   {
     result = abn;
   }
@@ -34,9 +34,6 @@
 #include "YAM_stringsizes.h"
 #include "YAM_write.h"
 
-// forward declarations
-struct Person;
-
 enum ABookNodeType
 {
   ABNT_USER = 0,
@@ -123,7 +120,7 @@ BOOL ImportXMLABook(const char *filename, struct ABook *abook, BOOL append);
 ULONG SearchABook(const struct ABook *abook, const char *text, ULONG mode, struct ABookNode **abn);
 ULONG PatternSearchABook(const struct ABook *abook, const char *pattern, ULONG mode, char **aliases);
 struct ABookNode *CreateABookGroup(struct ABook *abook, const char *name);
-struct ABookNode *FindPersonInABook(const struct ABook *abook, const struct Person *pe);
+struct ABookNode *FindPersonInABook(const struct ABook *abook, const char *address);
 void CheckABookBirthdays(const struct ABook *abook, BOOL check);
 void FixAlias(const struct ABook *abook, struct ABookNode *abn, const struct ABookNode *excludeThis);
 void SetDefaultAlias(struct ABookNode *abn);
@@ -0,0 +1,352 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "AhoCorasickSearch.h"
+
+#include "Debug.h"
+
+// The automaton works on lower case characters only. Patterns which must
+// be matched case sensitively are verified against the original string
+// for every occurence found by the automaton.
+
+// a node of the automaton. The children of a node are kept in a simple
+// list, which is sufficient for the small alphabet of typical patterns.
+// Node number 0 is the root and is never the child of another node, hence
+// 0 is used as "none" for all links.
+struct AhoCorasickNode
+{
+  ULONG firstChild;     // the first child node
+  ULONG nextSibling;    // the next node with the same parent
+  ULONG fail;           // the node of the longest proper suffix in the trie
+  ULONG output;         // the next node along the fail links which ends a pattern
+  LONG pattern;         // the first pattern ending at this node or -1
+  UBYTE c;              // the character leading to this node
+};
+
+struct AhoCorasickPattern
+{
+  char *string;         // the original pattern
+  ULONG length;         // the length of the pattern
+  ULONG number;         // the number given by the caller
+  LONG nextPattern;     // the next pattern ending at the same node or -1
+  BOOL caseSensitive;   // must the original pattern match exactly?
+};
+
+/// FindChild
+// find the child of a node for a given character
+static ULONG FindChild(const struct AhoCorasickNode *nodes, ULONG node, UBYTE c)
+{
+  ULONG child;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  for(child = nodes[node].firstChild; child != 0; child = nodes[child].nextSibling)
+  {
+    if(nodes[child].c == c)
+      break;
+  }
+
+  return child;
+}
+
+///
+/// AllocNode
+// append a new node to the automaton, returns 0 on failure
+static ULONG AllocNode(struct AhoCorasickContext *acc, UBYTE c)
+{
+  ULONG node = 0;
+
+  ENTER();
+
+  if(acc->numNodes == acc->maxNodes)
+  {
+    ULONG newMax = (acc->maxNodes == 0) ? 64 : acc->maxNodes * 2;
+    struct AhoCorasickNode *newNodes;
+
+    if((newNodes = realloc(acc->nodes, newMax * sizeof(*newNodes))) != NULL)
+    {
+      acc->nodes = newNodes;
+      acc->maxNodes = newMax;
+    }
+  }
+
+  if(acc->numNodes < acc->maxNodes)
+  {
+    struct AhoCorasickNode *n;
+
+    node = acc->numNodes++;
+    n = &acc->nodes[node];
+    memset(n, 0, sizeof(*n));
+    n->pattern = -1;
+    n->c = c;
+  }
+
+  RETURN(node);
+  return node;
+}
+
+///
+/// AhoCorasickInit
+// create an empty automaton
+struct AhoCorasickContext *AhoCorasickInit(void)
+{
+  struct AhoCorasickContext *acc;
+
+  ENTER();
+
+  if((acc = calloc(1, sizeof(*acc))) != NULL)
+  {
+    // create the root node, its number is always 0
+    AllocNode(acc, '\0');
+
+    if(acc->numNodes == 0)
+    {
+      free(acc);
+      acc = NULL;
+    }
+  }
+
+  RETURN(acc);
+  return acc;
+}
+
+///
+/// AhoCorasickAddPattern
+// add a pattern to the automaton, this is possible until the automaton is compiled
+BOOL AhoCorasickAddPattern(struct AhoCorasickContext *acc, const char *pattern, const BOOL caseSensitive, const ULONG number)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(acc != NULL && acc->compiled == FALSE && pattern != NULL && pattern[0] != '\0')
+  {
+    if(acc->numPatterns == acc->maxPatterns)
+    {
+      ULONG newMax = (acc->maxPatterns == 0) ? 16 : acc->maxPatterns * 2;
+      struct AhoCorasickPattern *newPatterns;
+
+      if((newPatterns = realloc(acc->patterns, newMax * sizeof(*newPatterns))) != NULL)
+      {
+        acc->patterns = newPatterns;
+        acc->maxPatterns = newMax;
+      }
+    }
+
+    if(acc->numPatterns < acc->maxPatterns)
+    {
+      struct AhoCorasickPattern *p = &acc->patterns[acc->numPatterns];
+
+      if((p->string = strdup(pattern)) != NULL)
+      {
+        const unsigned char *s;
+        ULONG node = 0;
+
+        p->length = strlen(pattern);
+        p->number = number;
+        p->caseSensitive = caseSensitive;
+
+        success = TRUE;
+
+        // walk down the trie and add the missing nodes
+        for(s = (const unsigned char *)pattern; *s != '\0'; s++)
+        {
+          UBYTE c = tolower(*s);
+          ULONG child;
+
+          if((child = FindChild(acc->nodes, node, c)) == 0)
+          {
+            if((child = AllocNode(acc, c)) != 0)
+            {
+              acc->nodes[child].nextSibling = acc->nodes[node].firstChild;
+              acc->nodes[node].firstChild = child;
+            }
+            else
+            {
+              success = FALSE;
+              break;
+            }
+          }
+
+          node = child;
+        }
+
+        if(success == TRUE)
+        {
+          // chain the pattern to the node where it ends
+          p->nextPattern = acc->nodes[node].pattern;
+          acc->nodes[node].pattern = acc->numPatterns;
+          acc->numPatterns++;
+        }
+        else
+          free(p->string);
+      }
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// AhoCorasickCompile
+// calculate the fail and output links of all nodes
+BOOL AhoCorasickCompile(struct AhoCorasickContext *acc)
+{
+  BOOL success = FALSE;
+  ULONG *queue;
+
+  ENTER();
+
+  if(acc != NULL && (queue = malloc(acc->numNodes * sizeof(*queue))) != NULL)
+  {
+    struct AhoCorasickNode *nodes = acc->nodes;
+    ULONG head = 0;
+    ULONG tail = 0;
+    ULONG child;
+
+    // the children of the root fail back to the root
+    for(child = nodes[0].firstChild; child != 0; child = nodes[child].nextSibling)
+    {
+      nodes[child].fail = 0;
+      nodes[child].output = 0;
+      queue[tail++] = child;
+    }
+
+    // all other nodes are handled in breadth first order, so that the
+    // fail links of all shorter prefixes are known already
+    while(head < tail)
+    {
+      ULONG node = queue[head++];
+
+      for(child = nodes[node].firstChild; child != 0; child = nodes[child].nextSibling)
+      {
+        UBYTE c = nodes[child].c;
+        ULONG fail = nodes[node].fail;
+        ULONG target;
+
+        while((target = FindChild(nodes, fail, c)) == 0 && fail != 0)
+          fail = nodes[fail].fail;
+
+        nodes[child].fail = target;
+        nodes[child].output = (nodes[target].pattern != -1) ? target : nodes[target].output;
+
+        queue[tail++] = child;
+      }
+    }
+
+    free(queue);
+
+    acc->compiled = TRUE;
+    success = TRUE;
+
+    D(DBF_FILTER, "compiled Aho/Corasick automaton with %ld patterns and %ld nodes", acc->numPatterns, acc->numNodes);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// AhoCorasickCleanup
+// free an automaton
+void AhoCorasickCleanup(struct AhoCorasickContext *acc)
+{
+  ENTER();
+
+  if(acc != NULL)
+  {
+    ULONG i;
+
+    for(i = 0; i < acc->numPatterns; i++)
+      free(acc->patterns[i].string);
+
+    free(acc->patterns);
+    free(acc->nodes);
+    free(acc);
+  }
+
+  LEAVE();
+}
+
+///
+/// AhoCorasickSearch
+// search all patterns in a string in a single pass and set the bits of the
+// patterns found. The bits of the patterns not found are left untouched.
+// Returns TRUE if at least one pattern was found.
+BOOL AhoCorasickSearch(const struct AhoCorasickContext *acc, const char *string, UBYTE *found)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(acc != NULL && acc->compiled == TRUE && string != NULL)
+  {
+    const struct AhoCorasickNode *nodes = acc->nodes;
+    const unsigned char *s;
+    ULONG node = 0;
+
+    for(s = (const unsigned char *)string; *s != '\0'; s++)
+    {
+      UBYTE c = tolower(*s);
+      ULONG next;
+      ULONG out;
+
+      while((next = FindChild(nodes, node, c)) == 0 && node != 0)
+        node = nodes[node].fail;
+
+      node = next;
+
+      // check all patterns ending at this position
+      for(out = (nodes[node].pattern != -1) ? node : nodes[node].output; out != 0; out = nodes[out].output)
+      {
+        LONG p;
+
+        for(p = nodes[out].pattern; p != -1; p = acc->patterns[p].nextPattern)
+        {
+          const struct AhoCorasickPattern *pattern = &acc->patterns[p];
+
+          if(pattern->caseSensitive == FALSE ||
+             strncmp((const char *)s - pattern->length + 1, pattern->string, pattern->length) == 0)
+          {
+            AC_SETBIT(found, pattern->number);
+            result = TRUE;
+          }
+        }
+      }
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
@@ -0,0 +1,72 @@
+#ifndef AHOCORASICKSEARCH_H
+#define AHOCORASICKSEARCH_H 1
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+/*
+ An implementation of the Aho/Corasick multi pattern string search
+ algorithm. All patterns are added to a context structure created by
+ AhoCorasickInit() using AhoCorasickAddPattern(). Then the automaton
+ must be built by AhoCorasickCompile(). Afterwards a single pass of
+ AhoCorasickSearch() over a string finds all occurences of all patterns.
+ Finally the context must be freed using AhoCorasickCleanup().
+
+ Every pattern is given a number by the caller, for each found pattern
+ the corresponding bit in the caller's bit array will be set.
+
+ Details about the Aho/Corasick string search algorithm can be found here:
+   http://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_string_matching_algorithm
+*/
+
+struct AhoCorasickNode;
+struct AhoCorasickPattern;
+
+struct AhoCorasickContext
+{
+  struct AhoCorasickNode *nodes;        // the nodes of the automaton, node 0 is the root
+  ULONG numNodes;                       // number of used nodes
+  ULONG maxNodes;                       // number of allocated nodes
+  struct AhoCorasickPattern *patterns;  // all added patterns
+  ULONG numPatterns;                    // number of used patterns
+  ULONG maxPatterns;                    // number of allocated patterns
+  BOOL compiled;                        // is the automaton ready for searching?
+};
+
+// set/check a bit in an array of bits as used by AhoCorasickSearch()
+#define AC_SETBIT(bits, n)    ((bits)[(n) >> 3] |= (1 << ((n) & 7)))
+#define AC_ISBITSET(bits, n)  (((bits)[(n) >> 3] & (1 << ((n) & 7))) != 0)
+
+struct AhoCorasickContext *AhoCorasickInit(void);
+BOOL AhoCorasickAddPattern(struct AhoCorasickContext *acc, const char *pattern, const BOOL caseSensitive, const ULONG number);
+BOOL AhoCorasickCompile(struct AhoCorasickContext *acc);
+void AhoCorasickCleanup(struct AhoCorasickContext *acc);
+BOOL AhoCorasickSearch(const struct AhoCorasickContext *acc, const char *string, UBYTE *found);
+
+#endif /* AHOCORASICKSEARCH_H */
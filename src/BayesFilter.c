@@ -193,6 +193,48 @@ static struct Token *tokenizerGet(struct Tokenizer *t,
   return (struct Token *)entry;
 }
 
+///
+/// tokenizerGetCounts
+// look up the words of an array of tokens all at once and return their counts
+static void tokenizerGetCounts(struct Tokenizer *t,
+                               const struct Token *tokens,
+                               const ULONG numTokens,
+                               ULONG *counts)
+{
+  const void **words;
+  ULONG i;
+
+  ENTER();
+
+  // the array holds the words first and will receive the found entries afterwards
+  if((words = malloc(numTokens * 2 * sizeof(*words))) != NULL)
+  {
+    struct HashEntryHeader **entries = (struct HashEntryHeader **)&words[numTokens];
+
+    for(i = 0; i < numTokens; i++)
+      words[i] = tokens[i].word;
+
+    HashTableOperateBatch(&t->tokenTable, words, numTokens, htoLookup, entries);
+
+    for(i = 0; i < numTokens; i++)
+      counts[i] = (entries[i] != NULL) ? ((struct Token *)entries[i])->count : 0;
+
+    free(words);
+  }
+  else
+  {
+    // look up the words one by one
+    for(i = 0; i < numTokens; i++)
+    {
+      struct Token *token = tokenizerGet(t, tokens[i].word);
+
+      counts[i] = (token != NULL) ? token->count : 0;
+    }
+  }
+
+  LEAVE();
+}
+
 ///
 /// tokenizerAdd
 // add a word to the token table with an arbitrary prefix (maybe NULL) and count
@@ -203,6 +245,7 @@ static struct Token *tokenizerAdd(struct Tokenizer *t,
 {
   struct Token *token = NULL;
   ULONG len;
+  char buffer[SIZE_DEFAULT];
   char *tmpWord;
 
   ENTER();
@@ -211,7 +254,14 @@ static struct Token *tokenizerAdd(struct Tokenizer *t,
   if(prefix != NULL)
     len += strlen(prefix) + 1;
 
-  if((tmpWord = (STRPTR)malloc(len)) != NULL)
+  // most words are already known, so build the word on the stack if
+  // possible and allocate a copy for new tokens only
+  if(len <= sizeof(buffer))
+    tmpWord = buffer;
+  else
+    tmpWord = (STRPTR)malloc(len);
+
+  if(tmpWord != NULL)
   {
     if(prefix != NULL)
       snprintf(tmpWord, len, "%s:%s", prefix, word);
@@ -222,18 +272,31 @@ static struct Token *tokenizerAdd(struct Tokenizer *t,
     {
       if(token->word == NULL)
       {
-        token->word = tmpWord;
-        token->length = len-1;
-        token->count = count;
-        token->probability = 0.0;
-        // make sure this one isn't free()'d
-        tmpWord = NULL;
+        if(tmpWord == buffer)
+          token->word = memdup(buffer, len);
+        else
+          token->word = tmpWord;
+
+        if(token->word != NULL)
+        {
+          token->length = len-1;
+          token->count = count;
+          token->probability = 0.0;
+          // make sure this one isn't free()'d
+          tmpWord = NULL;
+        }
+        else
+        {
+          HashTableRawRemove(&t->tokenTable, (struct HashEntryHeader *)token);
+          token = NULL;
+        }
       }
       else
         token->count += count;
     }
 
-    free(tmpWord);
+    if(tmpWord != buffer)
+      free(tmpWord);
   }
 
   RETURN(token);
@@ -1374,7 +1437,7 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
   if(C->SpamAddressBookIsWhiteList == TRUE)
   {
     // try to find the sender's address in the address book
-    isInWhiteList = (FindPersonInABook(&G->abook, &mail->From) != NULL);
+    isInWhiteList = (FindPersonInABook(&G->abook, mail->From.Address) != NULL);
   }
   else
   {
@@ -1405,6 +1468,7 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
           ULONG i;
           ULONG goodClues = 0;
           ULONG count = t->tokenTable.entryCount;
+          ULONG *tokenCounts;
           ULONG first;
           ULONG last;
           ULONG Hexp;
@@ -1413,11 +1477,17 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
           double H;
           double S;
 
+          // look up the ham and spam counts of all tokens at once
+          if((tokenCounts = malloc(count * 2 * sizeof(*tokenCounts))) != NULL)
+          {
+            tokenizerGetCounts(&G->spamFilter.goodTokens, tokens, count, tokenCounts);
+            tokenizerGetCounts(&G->spamFilter.badTokens, tokens, count, &tokenCounts[count]);
+          }
+
           for(i = 0; i < count; i++)
           {
             struct Token *token = &tokens[i];
             const char *word = token->word;
-            struct Token *_t;
             double hamCount;
             double spamCount;
             double denom;
@@ -1425,10 +1495,20 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
             double n;
             double distance;
 
-            _t = tokenizerGet(&G->spamFilter.goodTokens, word);
-            hamCount = (_t != NULL) ? _t->count : 0;
-            _t = tokenizerGet(&G->spamFilter.badTokens, word);
-            spamCount = (_t != NULL) ? _t->count : 0;
+            if(tokenCounts != NULL)
+            {
+              hamCount = tokenCounts[i];
+              spamCount = tokenCounts[count + i];
+            }
+            else
+            {
+              struct Token *_t;
+
+              _t = tokenizerGet(&G->spamFilter.goodTokens, word);
+              hamCount = (_t != NULL) ? _t->count : 0;
+              _t = tokenizerGet(&G->spamFilter.badTokens, word);
+              spamCount = (_t != NULL) ? _t->count : 0;
+            }
 
             denom = hamCount * nBad + spamCount * nGood;
             // avoid division by zero error
@@ -1454,6 +1534,8 @@ static BOOL tokenAnalyzerClassifyMessage(const struct Tokenizer *t,
             }
           }
 
+          free(tokenCounts);
+
           D(DBF_SPAM, "found %ld good clues in the first scan", goodClues);
 
           // sort array of token distances
@@ -29,11 +29,64 @@
 #include <string.h>
 #include <ctype.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_SEARCH 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_SEARCH 1
+#endif
+
 #include "BoyerMooreSearch.h"
 #include "YAM_utilities.h"
 
 #include "Debug.h"
 
+// the number of characters checked at once by the SIMD search
+#define SIMD_BLOCKSIZE 16
+
+#if defined(SIMD_SEARCH)
+/// FindAnchors
+// collect all characters which match a lower case pattern character in a
+// case insensitive search. Returns FALSE if there are more than two.
+static BOOL FindAnchors(const unsigned char c, const BOOL caseSensitive, UBYTE anchors[2])
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  if(caseSensitive == TRUE)
+  {
+    anchors[0] = c;
+    anchors[1] = c;
+  }
+  else
+  {
+    int num = 0;
+    int i;
+
+    for(i = 0; i < 256; i++)
+    {
+      if(tolower(i) == c)
+      {
+        if(num < 2)
+          anchors[num] = i;
+        num++;
+      }
+    }
+
+    if(num == 1)
+      anchors[1] = anchors[0];
+    else if(num != 2)
+      success = FALSE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+#endif // SIMD_SEARCH
 /// BoyerMooreInit
 // initialize the skip table for a Boyer-Moore string search
 struct BoyerMooreContext *BoyerMooreInit(const char *pattern, const BOOL caseSensitive)
@@ -50,6 +103,7 @@ struct BoyerMooreContext *BoyerMooreInit(const char *pattern, const BOOL caseSen
     bmc->pattern = strdup(pattern);
     bmc->patternLength = plen;
     bmc->caseSensitive = caseSensitive;
+    bmc->useAnchors = FALSE;
 
     // calculate the skip table
     for(i = 0; i < ARRAY_SIZE(bmc->skip); i++)
@@ -58,10 +112,24 @@ struct BoyerMooreContext *BoyerMooreInit(const char *pattern, const BOOL caseSen
     // convert the complete pattern to lower case if we are not
     // interested in a case sensitive search
     if(caseSensitive == FALSE)
-      ToLowerCase(bmc->pattern);
+    {
+      for(i = 0; i < plen; i++)
+        bmc->pattern[i] = tolower((unsigned char)bmc->pattern[i]);
+    }
 
     for(i = 0; i < plen; i++)
       bmc->skip[(unsigned char)bmc->pattern[i]] = plen - i - 1;
+
+    #if defined(SIMD_SEARCH)
+    // the SIMD search needs to know all characters matching the first and
+    // the last pattern character
+    if(plen > 0 &&
+       FindAnchors((unsigned char)bmc->pattern[0], caseSensitive, bmc->firstAnchor) == TRUE &&
+       FindAnchors((unsigned char)bmc->pattern[plen-1], caseSensitive, bmc->lastAnchor) == TRUE)
+    {
+      bmc->useAnchors = TRUE;
+    }
+    #endif
   }
 
   RETURN(bmc);
@@ -85,6 +153,129 @@ void BoyerMooreCleanup(struct BoyerMooreContext *bmc)
 }
 
 ///
+#if defined(SIMD_SEARCH)
+/// MatchAt
+// check if the pattern matches at the given position
+static BOOL MatchAt(const struct BoyerMooreContext *bmc, const char *string)
+{
+  BOOL match = TRUE;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(bmc->caseSensitive == TRUE)
+  {
+    match = (memcmp(string, bmc->pattern, bmc->patternLength) == 0);
+  }
+  else
+  {
+    const unsigned char *s = (const unsigned char *)string;
+    const unsigned char *p = (const unsigned char *)bmc->pattern;
+    int i;
+
+    for(i = 0; i < bmc->patternLength; i++)
+    {
+      if(tolower(s[i]) != p[i])
+      {
+        match = FALSE;
+        break;
+      }
+    }
+  }
+
+  return match;
+}
+
+///
+/// CandidateMask
+// get a bit mask of all positions within a block of the string where the
+// first and the last character of the pattern match
+static ULONG CandidateMask(const struct BoyerMooreContext *bmc, const char *block)
+{
+  ULONG mask;
+  #if defined(__SSE2__)
+  __m128i first = _mm_loadu_si128((const __m128i *)block);
+  __m128i last = _mm_loadu_si128((const __m128i *)&block[bmc->patternLength-1]);
+  __m128i f;
+  __m128i l;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  f = _mm_or_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8(bmc->firstAnchor[0])),
+                   _mm_cmpeq_epi8(first, _mm_set1_epi8(bmc->firstAnchor[1])));
+  l = _mm_or_si128(_mm_cmpeq_epi8(last, _mm_set1_epi8(bmc->lastAnchor[0])),
+                   _mm_cmpeq_epi8(last, _mm_set1_epi8(bmc->lastAnchor[1])));
+
+  mask = _mm_movemask_epi8(_mm_and_si128(f, l));
+  #else
+  static const uint8_t bitWeights[SIMD_BLOCKSIZE] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  uint8x16_t first = vld1q_u8((const uint8_t *)block);
+  uint8x16_t last = vld1q_u8((const uint8_t *)&block[bmc->patternLength-1]);
+  uint8x16_t fl;
+  uint8x8_t sum;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  fl = vandq_u8(vorrq_u8(vceqq_u8(first, vdupq_n_u8(bmc->firstAnchor[0])),
+                         vceqq_u8(first, vdupq_n_u8(bmc->firstAnchor[1]))),
+                vorrq_u8(vceqq_u8(last, vdupq_n_u8(bmc->lastAnchor[0])),
+                         vceqq_u8(last, vdupq_n_u8(bmc->lastAnchor[1]))));
+
+  // NEON has no movemask instruction, hence we weight each lane with its
+  // bit and sum up the lanes of each half
+  fl = vandq_u8(fl, vld1q_u8(bitWeights));
+  sum = vpadd_u8(vget_low_u8(fl), vget_high_u8(fl));
+  sum = vpadd_u8(sum, sum);
+  sum = vpadd_u8(sum, sum);
+  mask = vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8);
+  #endif
+
+  return mask;
+}
+
+///
+/// SIMDSearch
+// search the pattern by checking blocks of possible start positions at once
+static const char *SIMDSearch(const struct BoyerMooreContext *bmc, const char *string, int slen)
+{
+  const char *result = NULL;
+  int patternLength = bmc->patternLength;
+  int i = 0;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  // never read beyond the end of the string
+  while(result == NULL && i + patternLength - 1 + SIMD_BLOCKSIZE <= slen)
+  {
+    ULONG mask = CandidateMask(bmc, &string[i]);
+
+    while(mask != 0)
+    {
+      int bit = __builtin_ctz(mask);
+
+      if(MatchAt(bmc, &string[i+bit]) == TRUE)
+      {
+        result = &string[i+bit];
+        break;
+      }
+
+      mask &= mask - 1;
+    }
+
+    i += SIMD_BLOCKSIZE;
+  }
+
+  // check the remaining positions one by one
+  for(; result == NULL && i + patternLength <= slen; i++)
+  {
+    if(MatchAt(bmc, &string[i]) == TRUE)
+      result = &string[i];
+  }
+
+  return result;
+}
+
+///
+#endif // SIMD_SEARCH
 /// BoyerMooreSearch
 // search a string in another string using the Boyer-Moore algorithm
 // the context structure must be initialized first using BoyerMooreInit()
@@ -100,39 +291,48 @@ const char *BoyerMooreSearch(const struct BoyerMooreContext *bmc, const char *st
 
     if(bmc->patternLength <= slen)
     {
-      const char *pattern = bmc->pattern;
-      int patternLength = bmc->patternLength;
-      const int *skip = bmc->skip;
-      BOOL caseSensitive = bmc->caseSensitive;
-      int i, j;
-
-      i = patternLength-1;
-      j = patternLength-1;
-
-      // perform the string search
-      while(j >= 0 && i < slen)
+      #if defined(SIMD_SEARCH)
+      if(bmc->useAnchors == TRUE)
+      {
+        result = SIMDSearch(bmc, string, slen);
+      }
+      else
+      #endif
       {
-        char c;
+        const char *pattern = bmc->pattern;
+        int patternLength = bmc->patternLength;
+        const int *skip = bmc->skip;
+        BOOL caseSensitive = bmc->caseSensitive;
+        int i, j;
 
-        if(caseSensitive == TRUE)
-          c = string[i];
-        else
-          c = tolower(string[i]);
+        i = patternLength-1;
+        j = patternLength-1;
 
-        if(c == pattern[j])
+        // perform the string search
+        while(j >= 0 && i < slen)
         {
-          i--;
-          j--;
+          char c;
+
+          if(caseSensitive == TRUE)
+            c = string[i];
+          else
+            c = tolower((unsigned char)string[i]);
+
+          if(c == pattern[j])
+          {
+            i--;
+            j--;
+          }
+          else
+          {
+            i += MAX(patternLength-j, skip[(unsigned char)c]);
+            j = patternLength-1;
+          }
         }
-        else
-        {
-          i += MAX(patternLength-j, skip[(unsigned char)c]);
-          j = patternLength-1;
-        }
-      }
 
-      if(j == -1)
-        result = &string[i+1];
+        if(j == -1)
+          result = &string[i+1];
+      }
     }
   }
 
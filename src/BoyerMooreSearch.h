@@ -43,11 +43,21 @@
    http://en.wikipedia.org/wiki/Boyer%E2%80%93Moore_string_search_algorithm
 */
 
+/*
+ On CPUs with SIMD support (SSE2 on x86, NEON on ARM) the search first
+ looks for all positions where both the first and the last character of
+ the pattern match in blocks of 16 characters at once and verifies these
+ candidates only. All other CPUs fall back to the plain Boyer/Moore search.
+*/
+
 struct BoyerMooreContext
 {
   char *pattern;
   int patternLength;
   BOOL caseSensitive;
+  BOOL useAnchors;        // can the anchors below be used for a SIMD search?
+  UBYTE firstAnchor[2];   // the characters matching the first pattern character
+  UBYTE lastAnchor[2];    // the characters matching the last pattern character
   int skip[256];
 };
 
@@ -494,6 +494,9 @@ BOOL CompareConfigs(const struct Config *c1, const struct Config *c2)
      c1->SpamFlushTrainingDataInterval   == c2->SpamFlushTrainingDataInterval &&
      c1->SpamFlushTrainingDataThreshold  == c2->SpamFlushTrainingDataThreshold &&
      c1->SocketTimeout                   == c2->SocketTimeout &&
+     c1->MaxConnections                  == c2->MaxConnections &&
+     c1->MaxConnectionsPerHost           == c2->MaxConnectionsPerHost &&
+     c1->AttachmentCacheSize             == c2->AttachmentCacheSize &&
      c1->PrintMethod                     == c2->PrintMethod &&
      c1->LogfileMode                     == c2->LogfileMode &&
      c1->MDN_NoRecipient                 == c2->MDN_NoRecipient &&
@@ -975,6 +978,9 @@ void SetDefaultConfig(struct Config *co, enum ConfigPage page)
     co->SocketOptions.NoDelay     = FALSE;
     co->SocketOptions.LowDelay    = FALSE;
     co->SocketTimeout = 30; // 30s socket timeout per default
+    co->MaxConnections = 8; // at most 8 concurrent mail checks
+    co->MaxConnectionsPerHost = 2; // but at most 2 to the same host
+    co->AttachmentCacheSize = 4096; // keep up to 4MB of decoded attachments
     co->TRBufferSize = 8192; // 8K buffer per default
     co->EmbeddedMailDelay = 200; // 200ms delay per default
     co->KeepAliveInterval = 30;  // 30s interval per default
@@ -1270,6 +1276,7 @@ int LoadConfig(struct Config *co, const char *fname)
                 else if(stricmp(q, "Description") == 0)            strlcpy(msn->description, value, sizeof(msn->description));
                 else if(stricmp(q, "Server") == 0)                 strlcpy(msn->hostname, value, sizeof(msn->hostname));
                 else if(stricmp(q, "Port") == 0)                   msn->port = atoi(value);
+                else if(stricmp(q, "Protocol") == 0)               stricmp(value, "IMAP") == 0 ? setFlag(msn->flags, MSF_PROTO_IMAP) : clearFlag(msn->flags, MSF_PROTO_IMAP);
                 else if(stricmp(q, "Password") == 0)               strlcpy(msn->password, Decrypt(value), sizeof(msn->password));
                 else if(stricmp(q, "User") == 0)                   strlcpy(msn->username, value, sizeof(msn->username));
                 else if(stricmp(q, "Enabled") == 0)                Txt2Bool(value) == TRUE ? setFlag(msn->flags, MSF_ACTIVE) : clearFlag(msn->flags, MSF_ACTIVE);
@@ -1991,6 +1998,9 @@ int LoadConfig(struct Config *co, const char *fname)
             }
           }
           else if(stricmp(buf, "SocketTimeout") == 0)            co->SocketTimeout = atoi(value);
+          else if(stricmp(buf, "MaxConnections") == 0)           co->MaxConnections = atoi(value);
+          else if(stricmp(buf, "MaxConnectionsPerHost") == 0)    co->MaxConnectionsPerHost = atoi(value);
+          else if(stricmp(buf, "AttachmentCacheSize") == 0)      co->AttachmentCacheSize = atoi(value);
           else if(stricmp(buf, "TRBufferSize") == 0)             co->TRBufferSize = atoi(value);
           else if(stricmp(buf, "EmbeddedMailDelay") == 0)        co->EmbeddedMailDelay = atoi(value);
           else if(stricmp(buf, "KeepAliveInterval") == 0)        co->KeepAliveInterval = atoi(value);
@@ -2384,6 +2394,7 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
       fprintf(fh, "POP%02d.Description            = %s\n", i, msn->description);
       fprintf(fh, "POP%02d.Server                 = %s\n", i, msn->hostname);
       fprintf(fh, "POP%02d.Port                   = %d\n", i, msn->port);
+      fprintf(fh, "POP%02d.Protocol               = %s\n", i, hasServerIMAP(msn) ? "IMAP" : "POP3");
       fprintf(fh, "POP%02d.User                   = %s\n", i, savePrivateData == TRUE ? msn->username : "<intentionally removed>");
       fprintf(fh, "POP%02d.Password               = %s\n", i, savePrivateData == TRUE ? Encrypt(msn->password) : "<intentionally removed>");
       fprintf(fh, "POP%02d.SSLMode                = %d\n", i, MSF2POP3SecMethod(msn));
@@ -2754,6 +2765,9 @@ BOOL SaveConfig(struct Config *co, const char *fname, BOOL savePrivateData)
 
     fprintf(fh, "SocketOptions            =%s\n", buf);
     fprintf(fh, "SocketTimeout            = %d\n", co->SocketTimeout);
+    fprintf(fh, "MaxConnections           = %d\n", co->MaxConnections);
+    fprintf(fh, "MaxConnectionsPerHost    = %d\n", co->MaxConnectionsPerHost);
+    fprintf(fh, "AttachmentCacheSize      = %d\n", co->AttachmentCacheSize);
     fprintf(fh, "TRBufferSize             = %d\n", co->TRBufferSize);
     fprintf(fh, "EmbeddedMailDelay        = %d\n", co->EmbeddedMailDelay);
     fprintf(fh, "KeepAliveInterval        = %d\n", co->KeepAliveInterval);
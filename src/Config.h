@@ -141,6 +141,9 @@ struct Config
   int   SpamFlushTrainingDataInterval;
   int   SpamFlushTrainingDataThreshold;
   int   SocketTimeout;
+  int   MaxConnections;
+  int   MaxConnectionsPerHost;
+  int   AttachmentCacheSize;
 
   enum  PrintMethod        PrintMethod;
   enum  LFMode             LogfileMode;
@@ -33,7 +33,10 @@
 #include "extrasrc.h"
 
 #include "FolderList.h"
+#include "FullTextIndex.h"
 #include "MailList.h"
+#include "MsgIDHash.h"
+#include "ThreadTree.h"
 
 #include "Debug.h"
 
@@ -326,6 +329,9 @@ void FreeFolder(struct Folder *folder)
 {
   ENTER();
 
+  DeleteMsgIDHash(folder);
+  DeleteThreadTree(folder);
+  DeleteFullTextIndex(folder, TRUE);
   DeleteMailList(folder->messages);
   free(folder);
 
@@ -342,6 +348,17 @@ void MoveFolderContents(struct Folder *to, struct Folder *from)
   // move over all messages
   MoveMailList(to->messages, from->messages);
 
+  // the message ID lookup tables and thread trees are outdated now and will be rebuilt
+  // on demand
+  DeleteMsgIDHash(to);
+  DeleteMsgIDHash(from);
+  DeleteThreadTree(to);
+  DeleteThreadTree(from);
+
+  // the moved mails are not part of the destination's full text index and
+  // will be indexed again on demand
+  DeleteFullTextIndex(from, FALSE);
+
   // adjust the stats
   to->Size += from->Size;
   to->Total += from->Total;
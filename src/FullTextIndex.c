@@ -0,0 +1,1156 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libraries/iffparse.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include "extrasrc.h"
+
+#include "YAM_folderconfig.h"
+#include "YAM_mainFolder.h"
+#include "YAM_utilities.h"
+
+#include "FullTextIndex.h"
+#include "MailList.h"
+
+#include "Debug.h"
+
+// The index never stores the text itself, but only the tokens of it. A
+// token is a maximal run of ASCII letters and digits or non-ASCII bytes.
+// ASCII letters are lowered and all non-ASCII bytes are folded into a
+// single placeholder character. This keeps the index independent from
+// the search's case sensitivity and from the locale's character classes,
+// at the cost of some false candidates which the real search will drop.
+// Tokens exceeding FT_MAXTOKENLEN characters are not stored, instead the
+// whole document is flagged to be a candidate for every query.
+#define FT_MAXTOKENLEN    64
+#define FT_NONASCII       0x80
+
+// the header of a .ftindex file
+struct FTIndex
+{
+  ULONG ID;             // version of the index (must be FTINDEX_VER)
+  ULONG numDocs;        // number of document records following the header
+  ULONG numTerms;       // number of term records following the documents
+};
+
+// a document record, followed by the key string
+struct FTDocRecord
+{
+  ULONG docID;
+  LONG size;
+  UWORD keyLen;
+  UWORD flags;
+};
+
+// a term record, followed by the term string and the postings
+struct FTTermRecord
+{
+  ULONG postingsSize;
+  UWORD termLen;
+  UWORD pad;
+};
+
+#define FTINDEX_VER    (MAKE_ID('Y','F','T','1'))
+
+// a single indexed mail
+struct FullTextDoc
+{
+  struct HashEntryHeader hash;
+  char *key;            // the mail's file name without the status part
+  ULONG docID;          // the document number
+  LONG size;            // the size of the mail at the time it was indexed
+  UWORD flags;          // see below
+};
+
+#define FTDF_LONGTOKENS   (1<<0)  // the text contains tokens which were not indexed
+
+// a single token and the numbers of all documents containing it. The
+// numbers are stored as variable length deltas in increasing order.
+struct FullTextTerm
+{
+  struct HashEntryHeader hash;
+  char *key;            // the folded token
+  UBYTE *postings;      // the encoded document numbers
+  ULONG size;           // used bytes of postings
+  ULONG max;            // allocated bytes of postings
+  ULONG lastDocID;      // the last document number added
+};
+
+// how a word of a query must match a term
+enum TermMatch
+{
+  TM_EXACT=0,
+  TM_PREFIX,
+  TM_SUFFIX,
+  TM_INFIX
+};
+
+struct FullTextQuery
+{
+  struct Folder *folder;  // the folder the bitmap was built for
+  ULONG generation;       // the generation of the index the bitmap was built from
+  UBYTE *bitmap;          // one bit per document, set for possible matches
+  ULONG numBits;          // number of documents covered by the bitmap
+  ULONG numWords;         // number of words in the query
+  char *words;            // the folded words, separated by NUL bytes
+};
+
+// every index instance gets a new unique generation
+static ULONG lastGeneration;
+
+/*** Hash table operators ***/
+/// FullTextTermClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void FullTextTermClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct FullTextTerm *term = (struct FullTextTerm *)entry;
+
+  free(term->key);
+  free(term->postings);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// FullTextTermDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void FullTextTermDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  const struct FullTextTerm *term = (const struct FullTextTerm *)entry;
+
+  free(term->key);
+  free(term->postings);
+}
+
+///
+/// GetFullTextTermOps
+//
+static const struct HashTableOps *GetFullTextTermOps(void)
+{
+  static const struct HashTableOps fullTextTermOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    StringHashHashKey,
+    StringHashMatchEntry,
+    DefaultHashMoveEntry,
+    FullTextTermClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    FullTextTermDestroyEntry
+  };
+
+  ENTER();
+  RETURN(&fullTextTermOps);
+  return &fullTextTermOps;
+}
+
+///
+
+/*** Private functions ***/
+/// NextToken
+// fetch the next folded token from a text and advance the text pointer.
+// Returns the length of the token, 0 if there are no more tokens. Tokens
+// which don't fit into the buffer are skipped and reported via tooLong.
+static size_t NextToken(const char **text, char *token, BOOL *tooLong)
+{
+  const unsigned char *s = (const unsigned char *)*text;
+  size_t len = 0;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(len == 0 && *s != '\0')
+  {
+    size_t runLen = 0;
+
+    for(; *s != '\0'; s++)
+    {
+      unsigned char c = *s;
+
+      if(c >= 0x80)
+        c = FT_NONASCII;
+      else if(c >= 'A' && c <= 'Z')
+        c += 'a'-'A';
+      else if(!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')))
+        break;
+
+      if(runLen < FT_MAXTOKENLEN)
+        token[runLen] = c;
+      runLen++;
+    }
+
+    if(runLen > FT_MAXTOKENLEN)
+    {
+      if(tooLong != NULL)
+        *tooLong = TRUE;
+    }
+    else
+      len = runLen;
+
+    // skip the separator
+    if(*s != '\0' && len == 0)
+      s++;
+  }
+
+  token[len] = '\0';
+  *text = (const char *)s;
+
+  return len;
+}
+
+///
+/// GetMailKey
+// the part of a mail's file name in front of the status characters, this
+// part stays the same when the status of the mail changes
+static void GetMailKey(const struct Mail *mail, char *key, size_t keySize)
+{
+  char *p;
+
+  ENTER();
+
+  strlcpy(key, mail->MailFile, keySize);
+  if((p = strchr(key, ',')) != NULL)
+    *p = '\0';
+
+  LEAVE();
+}
+
+///
+/// IsIndexableFolder
+// the index contains parts of the mail texts in plain form, hence
+// protected folders are never indexed
+static BOOL IsIndexableFolder(const struct Folder *folder)
+{
+  BOOL result;
+
+  ENTER();
+
+  result = (folder != NULL && !isGroupFolder(folder) && !isProtectedFolder(folder));
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// AddPosting
+// append a document number to the postings of a term
+static BOOL AddPosting(struct FullTextTerm *term, ULONG docID)
+{
+  BOOL success = TRUE;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(term->lastDocID != docID)
+  {
+    ULONG delta = docID - term->lastDocID;
+
+    // a delta needs at most 5 bytes
+    if(term->size + 5 > term->max)
+    {
+      ULONG newMax = (term->max == 0) ? 8 : term->max * 2;
+      UBYTE *newPostings;
+
+      if((newPostings = realloc(term->postings, newMax)) != NULL)
+      {
+        term->postings = newPostings;
+        term->max = newMax;
+      }
+      else
+        success = FALSE;
+    }
+
+    if(success == TRUE)
+    {
+      while(delta >= 0x80)
+      {
+        term->postings[term->size++] = (delta & 0x7f) | 0x80;
+        delta >>= 7;
+      }
+      term->postings[term->size++] = delta;
+
+      term->lastDocID = docID;
+    }
+  }
+
+  return success;
+}
+
+///
+/// NextPosting
+// decode the next document number of a postings list, returns the new position
+static ULONG NextPosting(const UBYTE *postings, ULONG pos, ULONG *docID)
+{
+  ULONG delta = 0;
+  ULONG shift = 0;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(postings[pos] & 0x80)
+  {
+    delta |= (postings[pos] & 0x7f) << shift;
+    shift += 7;
+    pos++;
+  }
+  delta |= postings[pos] << shift;
+
+  *docID += delta;
+
+  return pos+1;
+}
+
+///
+/// CreateIndex
+// create a new empty index
+static struct FullTextIndex *CreateIndex(void)
+{
+  struct FullTextIndex *index;
+
+  ENTER();
+
+  if((index = calloc(1, sizeof(*index))) != NULL)
+  {
+    BOOL success = FALSE;
+
+    if((index->semaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
+    {
+      if(HashTableInit(&index->docs, HashTableGetDefaultStringOps(), NULL, sizeof(struct FullTextDoc), 512) == TRUE)
+      {
+        if(HashTableInit(&index->terms, GetFullTextTermOps(), NULL, sizeof(struct FullTextTerm), 4096) == TRUE)
+          success = TRUE;
+        else
+          HashTableCleanup(&index->docs);
+      }
+
+      if(success == FALSE)
+        FreeSysObject(ASOT_SEMAPHORE, index->semaphore);
+    }
+
+    if(success == TRUE)
+    {
+      index->nextDocID = 1;
+      index->generation = ++lastGeneration;
+    }
+    else
+    {
+      free(index);
+      index = NULL;
+    }
+  }
+
+  RETURN(index);
+  return index;
+}
+
+///
+/// FreeIndex
+// free an index
+static void FreeIndex(struct FullTextIndex *index)
+{
+  ENTER();
+
+  HashTableCleanup(&index->terms);
+  HashTableCleanup(&index->docs);
+  FreeSysObject(ASOT_SEMAPHORE, index->semaphore);
+  free(index);
+
+  LEAVE();
+}
+
+///
+/// LoadIndex
+// load the index of a folder from its .ftindex file
+static BOOL LoadIndex(struct Folder *folder, struct FullTextIndex *index)
+{
+  BOOL success = FALSE;
+  char indexFileName[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  AddPath(indexFileName, folder->Fullpath, ".ftindex", sizeof(indexFileName));
+
+  if((fh = fopen(indexFileName, "r")) != NULL)
+  {
+    struct FTIndex fti;
+
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    if(fread(&fti, sizeof(fti), 1, fh) == 1 && fti.ID == FTINDEX_VER)
+    {
+      char buf[SIZE_MFILE > FT_MAXTOKENLEN+1 ? SIZE_MFILE : FT_MAXTOKENLEN+1];
+      ULONG i;
+
+      success = TRUE;
+
+      for(i = 0; i < fti.numDocs && success == TRUE; i++)
+      {
+        struct FTDocRecord rec;
+        struct FullTextDoc *doc;
+
+        if(fread(&rec, sizeof(rec), 1, fh) == 1 && rec.keyLen < sizeof(buf) &&
+           fread(buf, rec.keyLen, 1, fh) == 1)
+        {
+          buf[rec.keyLen] = '\0';
+
+          if((doc = (struct FullTextDoc *)HashTableOperate(&index->docs, buf, htoAdd)) != NULL &&
+             (doc->key = strdup(buf)) != NULL)
+          {
+            doc->docID = rec.docID;
+            doc->size = rec.size;
+            doc->flags = rec.flags;
+
+            if(rec.docID >= index->nextDocID)
+              index->nextDocID = rec.docID+1;
+          }
+          else
+            success = FALSE;
+        }
+        else
+          success = FALSE;
+      }
+
+      for(i = 0; i < fti.numTerms && success == TRUE; i++)
+      {
+        struct FTTermRecord rec;
+        struct FullTextTerm *term;
+
+        if(fread(&rec, sizeof(rec), 1, fh) == 1 && rec.termLen < sizeof(buf) && rec.postingsSize > 0 &&
+           fread(buf, rec.termLen, 1, fh) == 1)
+        {
+          buf[rec.termLen] = '\0';
+
+          if((term = (struct FullTextTerm *)HashTableOperate(&index->terms, buf, htoAdd)) != NULL &&
+             (term->key = strdup(buf)) != NULL &&
+             (term->postings = malloc(rec.postingsSize)) != NULL &&
+             fread(term->postings, rec.postingsSize, 1, fh) == 1)
+          {
+            ULONG pos = 0;
+
+            term->size = rec.postingsSize;
+            term->max = rec.postingsSize;
+
+            // determine the last document number for further additions
+            while(pos < term->size)
+              pos = NextPosting(term->postings, pos, &term->lastDocID);
+          }
+          else
+            success = FALSE;
+        }
+        else
+          success = FALSE;
+      }
+    }
+
+    fclose(fh);
+
+    if(success == TRUE)
+      D(DBF_FOLDER, "loaded full text index of folder '%s' with %ld documents and %ld terms", folder->Name, index->docs.entryCount, index->terms.entryCount);
+    else
+      W(DBF_FOLDER, "outdated or corrupt full text index '%s' of folder '%s'", indexFileName, folder->Name);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// GetFullTextIndex
+// get the index of a folder, load or create it if necessary
+static struct FullTextIndex *GetFullTextIndex(struct Folder *folder)
+{
+  struct FullTextIndex *index = NULL;
+
+  ENTER();
+
+  if(IsIndexableFolder(folder) == TRUE)
+  {
+    if((index = folder->ftIndex) == NULL)
+    {
+      if((index = CreateIndex()) != NULL)
+      {
+        if(LoadIndex(folder, index) == FALSE)
+        {
+          // start over with an empty index
+          FreeIndex(index);
+          index = CreateIndex();
+        }
+
+        folder->ftIndex = index;
+      }
+    }
+  }
+
+  RETURN(index);
+  return index;
+}
+
+///
+/// FindDocument
+// find the document of a mail, the index must be locked by the caller
+static struct FullTextDoc *FindDocument(struct FullTextIndex *index, const struct Mail *mail)
+{
+  char key[SIZE_MFILE];
+  struct FullTextDoc *doc;
+
+  ENTER();
+
+  GetMailKey(mail, key, sizeof(key));
+
+  if((doc = (struct FullTextDoc *)HashTableOperate(&index->docs, key, htoLookup)) != NULL && !HASH_ENTRY_IS_LIVE(&doc->hash))
+    doc = NULL;
+
+  RETURN(doc);
+  return doc;
+}
+
+///
+
+/*** Query functions ***/
+struct MatchTermsData
+{
+  const char *word;       // the word to be matched
+  size_t wordLen;         // its length
+  enum TermMatch match;   // how to match it
+  UBYTE *bitmap;          // the bitmap to set the documents in
+  ULONG numBits;          // the size of the bitmap
+};
+
+/// SetPostingBits
+// set the bits of all documents of a term
+static void SetPostingBits(const struct FullTextTerm *term, UBYTE *bitmap, ULONG numBits)
+{
+  ULONG pos = 0;
+  ULONG docID = 0;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(pos < term->size)
+  {
+    pos = NextPosting(term->postings, pos, &docID);
+
+    if(docID < numBits)
+      bitmap[docID >> 3] |= 1 << (docID & 7);
+  }
+}
+
+///
+/// MatchTermsEnumerator
+// check a single term of the index against a word of a query
+static enum HashTableOperator MatchTermsEnumerator(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  const struct FullTextTerm *term = (const struct FullTextTerm *)entry;
+  struct MatchTermsData *mtd = (struct MatchTermsData *)arg;
+  size_t termLen = strlen(term->key);
+  BOOL matches = FALSE;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(termLen >= mtd->wordLen)
+  {
+    switch(mtd->match)
+    {
+      case TM_EXACT:
+        matches = (termLen == mtd->wordLen && memcmp(term->key, mtd->word, termLen) == 0);
+      break;
+
+      case TM_PREFIX:
+        matches = (memcmp(term->key, mtd->word, mtd->wordLen) == 0);
+      break;
+
+      case TM_SUFFIX:
+        matches = (memcmp(&term->key[termLen - mtd->wordLen], mtd->word, mtd->wordLen) == 0);
+      break;
+
+      case TM_INFIX:
+        matches = (strstr(term->key, mtd->word) != NULL);
+      break;
+    }
+  }
+
+  if(matches == TRUE)
+    SetPostingBits(term, mtd->bitmap, mtd->numBits);
+
+  return htoNext;
+}
+
+///
+/// LongTokensEnumerator
+// mark all documents with unindexed tokens as candidates
+static enum HashTableOperator LongTokensEnumerator(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  const struct FullTextDoc *doc = (const struct FullTextDoc *)entry;
+  struct MatchTermsData *mtd = (struct MatchTermsData *)arg;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(isFlagSet(doc->flags, FTDF_LONGTOKENS) && doc->docID < mtd->numBits)
+    mtd->bitmap[doc->docID >> 3] |= 1 << (doc->docID & 7);
+
+  return htoNext;
+}
+
+///
+/// BuildQueryBitmap
+// calculate the documents which may match all words of a query, the
+// index must be locked by the caller
+static BOOL BuildQueryBitmap(struct FullTextQuery *query, struct FullTextIndex *index)
+{
+  BOOL success = FALSE;
+  ULONG numBytes = (index->nextDocID + 7) / 8;
+  UBYTE *bitmap;
+  UBYTE *wordBitmap;
+
+  ENTER();
+
+  free(query->bitmap);
+  query->bitmap = NULL;
+  query->numBits = 0;
+
+  if((bitmap = calloc(1, numBytes)) != NULL)
+  {
+    if((wordBitmap = malloc(numBytes)) != NULL)
+    {
+      struct MatchTermsData mtd;
+      const char *word = query->words;
+      ULONG i;
+
+      mtd.numBits = index->nextDocID;
+
+      for(i = 0; i < query->numWords; i++)
+      {
+        ULONG j;
+
+        mtd.word = word;
+        mtd.wordLen = strlen(word);
+        mtd.bitmap = (i == 0) ? bitmap : wordBitmap;
+        memset(mtd.bitmap, 0, numBytes);
+
+        // a single word may appear anywhere within a token, otherwise the
+        // first word must end a token, the last one must start a token and
+        // all words inbetween must be complete tokens
+        if(query->numWords == 1)
+          mtd.match = TM_INFIX;
+        else if(i == 0)
+          mtd.match = TM_SUFFIX;
+        else if(i == query->numWords-1)
+          mtd.match = TM_PREFIX;
+        else
+          mtd.match = TM_EXACT;
+
+        if(mtd.match == TM_EXACT)
+        {
+          struct FullTextTerm *term;
+
+          if((term = (struct FullTextTerm *)HashTableOperate(&index->terms, word, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(&term->hash))
+            SetPostingBits(term, mtd.bitmap, mtd.numBits);
+        }
+        else
+          HashTableEnumerate(&index->terms, MatchTermsEnumerator, &mtd);
+
+        if(i > 0)
+        {
+          for(j = 0; j < numBytes; j++)
+            bitmap[j] &= wordBitmap[j];
+        }
+
+        word += mtd.wordLen+1;
+      }
+
+      // documents with unindexed tokens remain candidates
+      mtd.bitmap = bitmap;
+      HashTableEnumerate(&index->docs, LongTokensEnumerator, &mtd);
+
+      free(wordBitmap);
+
+      query->bitmap = bitmap;
+      query->numBits = index->nextDocID;
+      success = TRUE;
+    }
+    else
+      free(bitmap);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+
+/*** Public functions ***/
+/// CreateFullTextQuery
+// prepare a query for a substring search in the mail texts. Returns NULL
+// if the string does not contain any token, in this case the index
+// cannot be used to rule out any mail.
+struct FullTextQuery *CreateFullTextQuery(const char *match)
+{
+  struct FullTextQuery *query = NULL;
+
+  ENTER();
+
+  if(match != NULL && match[0] != '\0')
+  {
+    if((query = calloc(1, sizeof(*query))) != NULL)
+    {
+      // the folded words will never be longer than the string itself
+      if((query->words = malloc(strlen(match)+1)) != NULL)
+      {
+        char token[FT_MAXTOKENLEN+1];
+        char *w = query->words;
+        const char *s = match;
+        BOOL tooLong = FALSE;
+        size_t len;
+
+        while((len = NextToken(&s, token, &tooLong)) != 0)
+        {
+          memcpy(w, token, len+1);
+          w += len+1;
+          query->numWords++;
+        }
+
+        // words too long to be indexed cannot be looked up at all
+        if(tooLong == TRUE)
+          query->numWords = 0;
+      }
+
+      if(query->numWords == 0)
+      {
+        DeleteFullTextQuery(query);
+        query = NULL;
+      }
+    }
+  }
+
+  RETURN(query);
+  return query;
+}
+
+///
+/// DeleteFullTextQuery
+// free a query and save the index of the last searched folder
+void DeleteFullTextQuery(struct FullTextQuery *query)
+{
+  ENTER();
+
+  if(query != NULL)
+  {
+    if(query->folder != NULL)
+      SaveFullTextIndex(query->folder);
+
+    free(query->bitmap);
+    free(query->words);
+    free(query);
+  }
+
+  LEAVE();
+}
+
+///
+/// CheckFullTextQuery
+// check whether the text of a mail may match a query
+enum FullTextResult CheckFullTextQuery(struct FullTextQuery *query, const struct Mail *mail)
+{
+  enum FullTextResult result = FTR_UNKNOWN;
+  struct Folder *folder = mail->Folder;
+  struct FullTextIndex *index;
+
+  ENTER();
+
+  if(query != NULL && (index = GetFullTextIndex(folder)) != NULL)
+  {
+    struct FullTextDoc *doc;
+
+    // indices of other folders will most probably not be needed again
+    // very soon, so write them back as soon as we switch folders
+    if(query->folder != NULL && query->folder != folder)
+      SaveFullTextIndex(query->folder);
+
+    ObtainSemaphore(index->semaphore);
+
+    if(query->folder != folder || query->generation != index->generation)
+    {
+      query->folder = folder;
+      query->generation = index->generation;
+      BuildQueryBitmap(query, index);
+    }
+
+    if((doc = FindDocument(index, mail)) != NULL && doc->size == mail->Size)
+    {
+      // documents added after the bitmap was built must be checked
+      if(doc->docID >= query->numBits || (query->bitmap[doc->docID >> 3] & (1 << (doc->docID & 7))) != 0)
+        result = FTR_CANDIDATE;
+      else
+        result = FTR_NOMATCH;
+    }
+
+    ReleaseSemaphore(index->semaphore);
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// AddMailToFullTextIndex
+// add the decoded text of a mail to the index of its folder. Nothing is done
+// if the folder's index is not in use.
+void AddMailToFullTextIndex(const struct Mail *mail, const char *text)
+{
+  struct FullTextIndex *index;
+
+  ENTER();
+
+  if(mail->Folder != NULL && (index = mail->Folder->ftIndex) != NULL)
+  {
+    char key[SIZE_MFILE];
+    struct FullTextDoc *doc;
+
+    GetMailKey(mail, key, sizeof(key));
+
+    ObtainSemaphore(index->semaphore);
+
+    // an outdated document is simply replaced, its number becomes
+    // unused and is dropped from the postings when the index is saved
+    if((doc = (struct FullTextDoc *)HashTableOperate(&index->docs, key, htoAdd)) != NULL &&
+       (doc->key != NULL || (doc->key = strdup(key)) != NULL))
+    {
+      ULONG docID = index->nextDocID++;
+      char token[FT_MAXTOKENLEN+1];
+      BOOL tooLong = FALSE;
+      BOOL success = TRUE;
+
+      doc->docID = docID;
+      doc->size = mail->Size;
+      doc->flags = 0;
+
+      while(success == TRUE && NextToken(&text, token, &tooLong) != 0)
+      {
+        struct FullTextTerm *term;
+
+        if((term = (struct FullTextTerm *)HashTableOperate(&index->terms, token, htoAdd)) != NULL &&
+           (term->key != NULL || (term->key = strdup(token)) != NULL))
+        {
+          success = AddPosting(term, docID);
+        }
+        else
+          success = FALSE;
+      }
+
+      // an incompletely indexed document must be a candidate for every query
+      if(tooLong == TRUE || success == FALSE)
+        setFlag(doc->flags, FTDF_LONGTOKENS);
+
+      index->dirty = TRUE;
+    }
+
+    ReleaseSemaphore(index->semaphore);
+  }
+
+  LEAVE();
+}
+
+///
+/// RemoveMailFromFullTextIndex
+// remove a mail from the index of a folder
+void RemoveMailFromFullTextIndex(struct Folder *folder, const struct Mail *mail)
+{
+  struct FullTextIndex *index = folder->ftIndex;
+
+  ENTER();
+
+  if(index != NULL)
+  {
+    char key[SIZE_MFILE];
+
+    GetMailKey(mail, key, sizeof(key));
+
+    ObtainSemaphore(index->semaphore);
+
+    HashTableOperate(&index->docs, key, htoRemove);
+    index->dirty = TRUE;
+
+    ReleaseSemaphore(index->semaphore);
+  }
+
+  LEAVE();
+}
+
+///
+/// KeepDocsEnumerator
+// remember all documents to be saved
+static enum HashTableOperator KeepDocsEnumerator(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  const struct FullTextDoc *doc = (const struct FullTextDoc *)entry;
+  ULONG *remap = (ULONG *)arg;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  remap[doc->docID] = 1;
+
+  return htoNext;
+}
+
+///
+struct SaveIndexData
+{
+  FILE *fh;               // the file to write to
+  const ULONG *remap;     // old document number -> new document number
+  ULONG numRemap;         // number of entries in remap
+  UBYTE *postings;        // buffer for translated postings
+  ULONG postingsMax;      // size of the buffer
+  ULONG count;            // number of written records
+  BOOL success;           // did all writes succeed?
+};
+
+/// SaveDocsEnumerator
+// write a single document record
+static enum HashTableOperator SaveDocsEnumerator(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  const struct FullTextDoc *doc = (const struct FullTextDoc *)entry;
+  struct SaveIndexData *sid = (struct SaveIndexData *)arg;
+  enum HashTableOperator op = htoNext;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(sid->remap[doc->docID] != 0)
+  {
+    struct FTDocRecord rec;
+
+    rec.docID = sid->remap[doc->docID];
+    rec.size = doc->size;
+    rec.keyLen = strlen(doc->key);
+    rec.flags = doc->flags;
+
+    if(fwrite(&rec, sizeof(rec), 1, sid->fh) == 1 && fwrite(doc->key, rec.keyLen, 1, sid->fh) == 1)
+      sid->count++;
+    else
+    {
+      sid->success = FALSE;
+      op = htoStop;
+    }
+  }
+
+  return op;
+}
+
+///
+/// SaveTermsEnumerator
+// write a single term record with its postings translated to the new
+// document numbers, terms without any remaining document are dropped
+static enum HashTableOperator SaveTermsEnumerator(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  const struct FullTextTerm *term = (const struct FullTextTerm *)entry;
+  struct SaveIndexData *sid = (struct SaveIndexData *)arg;
+  struct FullTextTerm newTerm;
+  ULONG pos = 0;
+  ULONG docID = 0;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  memset(&newTerm, 0, sizeof(newTerm));
+  newTerm.postings = sid->postings;
+  newTerm.max = sid->postingsMax;
+
+  while(pos < term->size && sid->success == TRUE)
+  {
+    pos = NextPosting(term->postings, pos, &docID);
+
+    if(docID < sid->numRemap && sid->remap[docID] != 0)
+      sid->success = AddPosting(&newTerm, sid->remap[docID]);
+  }
+
+  // keep the possibly enlarged buffer for the next term
+  sid->postings = newTerm.postings;
+  sid->postingsMax = newTerm.max;
+
+  if(sid->success == TRUE && newTerm.size > 0)
+  {
+    struct FTTermRecord rec;
+
+    rec.postingsSize = newTerm.size;
+    rec.termLen = strlen(term->key);
+    rec.pad = 0;
+
+    if(fwrite(&rec, sizeof(rec), 1, sid->fh) == 1 &&
+       fwrite(term->key, rec.termLen, 1, sid->fh) == 1 &&
+       fwrite(newTerm.postings, newTerm.size, 1, sid->fh) == 1)
+    {
+      sid->count++;
+    }
+    else
+      sid->success = FALSE;
+  }
+
+  return (sid->success == TRUE) ? htoNext : htoStop;
+}
+
+///
+/// SaveFullTextIndex
+// save the index of a folder if it was modified. Documents of mails which
+// don't exist anymore are dropped and the remaining documents are
+// renumbered without gaps.
+BOOL SaveFullTextIndex(struct Folder *folder)
+{
+  BOOL success = TRUE;
+  struct FullTextIndex *index = folder->ftIndex;
+
+  ENTER();
+
+  if(index != NULL && index->dirty == TRUE)
+  {
+    BOOL useMailList = (folder->LoadedMode == LM_VALID);
+    ULONG *remap;
+
+    success = FALSE;
+
+    // the folder's mail list must be locked before the index
+    if(useMailList == TRUE)
+      LockMailListShared(folder->messages);
+
+    ObtainSemaphore(index->semaphore);
+
+    if((remap = calloc(index->nextDocID, sizeof(*remap))) != NULL)
+    {
+      char indexFileName[SIZE_PATHFILE];
+      FILE *fh;
+      ULONG newID;
+      ULONG i;
+
+      // keep the documents of all mails still existing, if the mail list
+      // is unknown all documents are kept
+      if(useMailList == TRUE)
+      {
+        struct MailNode *mnode;
+
+        ForEachMailNode(folder->messages, mnode)
+        {
+          struct FullTextDoc *doc;
+
+          if((doc = FindDocument(index, mnode->mail)) != NULL && doc->size == mnode->mail->Size)
+            remap[doc->docID] = 1;
+        }
+      }
+      else
+        HashTableEnumerate(&index->docs, KeepDocsEnumerator, remap);
+
+      // assign the new document numbers in the same order as before
+      for(i = 1, newID = 1; i < index->nextDocID; i++)
+      {
+        if(remap[i] != 0)
+          remap[i] = newID++;
+      }
+
+      AddPath(indexFileName, folder->Fullpath, ".ftindex", sizeof(indexFileName));
+
+      if((fh = fopen(indexFileName, "w")) != NULL)
+      {
+        struct FTIndex fti;
+        struct SaveIndexData sid;
+
+        setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+        // write an invalid header first, it is replaced when everything else was written
+        memset(&fti, 0, sizeof(fti));
+        memset(&sid, 0, sizeof(sid));
+        sid.fh = fh;
+        sid.remap = remap;
+        sid.numRemap = index->nextDocID;
+        sid.success = (fwrite(&fti, sizeof(fti), 1, fh) == 1);
+
+        if(sid.success == TRUE)
+        {
+          HashTableEnumerate(&index->docs, SaveDocsEnumerator, &sid);
+          fti.numDocs = sid.count;
+          sid.count = 0;
+        }
+
+        if(sid.success == TRUE)
+        {
+          HashTableEnumerate(&index->terms, SaveTermsEnumerator, &sid);
+          fti.numTerms = sid.count;
+        }
+
+        free(sid.postings);
+
+        if(sid.success == TRUE)
+        {
+          fti.ID = FTINDEX_VER;
+          success = (fseek(fh, 0, SEEK_SET) == 0 && fwrite(&fti, sizeof(fti), 1, fh) == 1);
+        }
+
+        fclose(fh);
+
+        if(success == TRUE)
+        {
+          D(DBF_FOLDER, "saved full text index of folder '%s' with %ld documents and %ld terms", folder->Name, fti.numDocs, fti.numTerms);
+          index->dirty = FALSE;
+        }
+        else
+        {
+          E(DBF_FOLDER, "error while writing full text index '%s'", indexFileName);
+          DeleteFile(indexFileName);
+        }
+      }
+
+      free(remap);
+    }
+
+    ReleaseSemaphore(index->semaphore);
+
+    if(useMailList == TRUE)
+      UnlockMailList(folder->messages);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// DeleteFullTextIndex
+// free the index of a folder, it will be reloaded on demand
+void DeleteFullTextIndex(struct Folder *folder, const BOOL save)
+{
+  ENTER();
+
+  if(folder->ftIndex != NULL)
+  {
+    if(save == TRUE)
+      SaveFullTextIndex(folder);
+
+    FreeIndex(folder->ftIndex);
+    folder->ftIndex = NULL;
+  }
+
+  LEAVE();
+}
+
+///
@@ -0,0 +1,68 @@
+#ifndef FULLTEXTINDEX_H
+#define FULLTEXTINDEX_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include "HashTable.h"
+
+// forward declarations
+struct Folder;
+struct Mail;
+struct SignalSemaphore;
+struct FullTextQuery;
+
+// the inverted index of the decoded body texts of a folder's mails.
+// Every indexed mail is a "document" with a number, every token of
+// the texts is a "term" with a list of the documents it appears in.
+struct FullTextIndex
+{
+  struct HashTable docs;              // mail file name -> document
+  struct HashTable terms;             // token -> postings
+  struct SignalSemaphore *semaphore;  // protects the tables
+  ULONG nextDocID;                    // the number of the next new document
+  ULONG generation;                   // unique number of this index instance
+  BOOL dirty;                         // must the index be saved?
+};
+
+// the result of checking a mail against the index
+enum FullTextResult
+{
+  FTR_NOMATCH=0,                      // the mail's text cannot match
+  FTR_CANDIDATE,                      // the mail's text may match
+  FTR_UNKNOWN                         // the mail is not indexed yet
+};
+
+struct FullTextQuery *CreateFullTextQuery(const char *match);
+void DeleteFullTextQuery(struct FullTextQuery *query);
+enum FullTextResult CheckFullTextQuery(struct FullTextQuery *query, const struct Mail *mail);
+void AddMailToFullTextIndex(const struct Mail *mail, const char *text);
+void RemoveMailFromFullTextIndex(struct Folder *folder, const struct Mail *mail);
+BOOL SaveFullTextIndex(struct Folder *folder);
+void DeleteFullTextIndex(struct Folder *folder, const BOOL save);
+
+#endif /* FULLTEXTINDEX_H */
@@ -28,6 +28,12 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include "YAM_utilities.h"
 
 #include "HashTable.h"
@@ -35,18 +41,28 @@
 #include "Debug.h"
 
 /*** Macro definitions ***/
-// double hashing needs the second hash code to be relatively prime to table size, so we
-// simply make hash2 odd.
+// The table is organized like Google's "Swiss tables". Besides the entries
+// themselves a separate array keeps one control byte per entry. Free and
+// removed entries have the high bit of their control byte set, live entries
+// store the 7 bits of their keyHash right below the bits which make up the
+// primary hash address. A lookup checks the control bytes of a whole group
+// of entries at once and only entries with matching control bytes and
+// matching keyHash values are compared by the matchEntry callback. The first
+// group of control bytes is mirrored behind the last entry, so that a group
+// can be checked without wrapping around.
+#define GROUP_WIDTH                         16
+#define CTRL_EMPTY                          ((UBYTE)0x80)
+#define CTRL_DELETED                        ((UBYTE)0xfe)
+
 #define HASH1(hash0, shift)                 ((hash0) >> (shift))
-#define HASH2(hash0, log2, shift)           ((((hash0) << (log2)) >> (shift)) | 1)
+#define HASH2(hash0, shift)                 ((UBYTE)(((hash0) >> ((shift) - 7)) & 0x7f))
 
-#define COLLISION_FLAG                      ((ULONG)1)
 #define MARK_ENTRY_FREE(entry)              ((entry)->keyHash = 0)
 #define MARK_ENTRY_REMOVED(entry)           ((entry)->keyHash = 1)
 #define ENTRY_IS_REMOVED(entry)             ((entry)->keyHash == 1)
 #define ENSURE_LIVE_KEYHASH(hash0)          if(hash0 < 2) hash0 -= 2; else (void)0;
-#define MATCH_ENTRY_KEYHASH(entry, hash0)   (((entry)->keyHash & ~COLLISION_FLAG) == (hash0))
 #define ADDRESS_ENTRY(table, index)         ((struct HashEntryHeader *)((table)->entryStore + (index) * (table)->entrySize))
+#define ENTRY_INDEX(table, entry)           ((ULONG)((char *)(entry) - (table)->entryStore) / (table)->entrySize)
 
 #define MAX_LOAD(table, size)               (((table)->maxAlphaFrac * (size)) >> 8)
 #define MIN_LOAD(table, size)               (((table)->minAlphaFrac * (size)) >> 8)
@@ -63,91 +79,298 @@ do { \
   if((j_) >>  1)    (_log2) +=  1; \
 } while(0)
 
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+#define PREFETCH(addr)                      __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)                      ((void)0)
+#endif
+
 /*** Static functions ***/
-/// SearchTable()
-//
-static struct HashEntryHeader *SearchTable(struct HashTable *table, const void *key, ULONG keyHash, enum HashTableOperator op)
+/// TrailingZeros()
+// get the number of the lowest bit set in a non-zero group mask
+static INLINE ULONG TrailingZeros(ULONG mask)
 {
-  ULONG hash1, hash2;
-  LONG hashShift, sizeLog2;
-  struct HashEntryHeader *entry, *firstRemoved;
-  BOOL (* matchEntry)(struct HashTable *, const struct HashEntryHeader *, const void *);
-  ULONG sizeMask;
+  ULONG n;
 
-  ENTER();
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  #if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+  n = __builtin_ctz(mask);
+  #else
+  for(n = 0; (mask & 1) == 0; n++)
+    mask >>= 1;
+  #endif
 
-  // compute the primary hash address
-  hashShift = table->shift;
-  hash1 = HASH1(keyHash, hashShift);
-  entry = ADDRESS_ENTRY(table, hash1);
+  return n;
+}
 
-  // miss: return space for a new entry
-  if(HASH_ENTRY_IS_FREE(entry))
+///
+/// LeadingZeros()
+// get the number of unset bits above the highest bit set in a group mask
+static ULONG LeadingZeros(ULONG mask)
+{
+  ULONG n;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  for(n = 0; n < GROUP_WIDTH && (mask & (1UL << (GROUP_WIDTH - 1 - n))) == 0; n++)
+    ;
+
+  return n;
+}
+
+///
+/// MatchGroup()
+// get a bit mask of all control bytes of a group which are equal to c
+static INLINE ULONG MatchGroup(const UBYTE *group, UBYTE c)
+{
+  ULONG mask;
+  #if defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  mask = _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  static const uint8_t bitWeights[GROUP_WIDTH] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  uint8x16_t eq = vceqq_u8(vld1q_u8(group), vdupq_n_u8(c));
+  uint8x8_t sum;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  // NEON has no movemask instruction, hence we weight each lane with its
+  // bit and sum up the lanes of each half
+  eq = vandq_u8(eq, vld1q_u8(bitWeights));
+  sum = vpadd_u8(vget_low_u8(eq), vget_high_u8(eq));
+  sum = vpadd_u8(sum, sum);
+  sum = vpadd_u8(sum, sum);
+  mask = vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8);
+  #else
+  ULONG i;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  mask = 0;
+  for(i = 0; i < GROUP_WIDTH; i++)
   {
-    //D(DBF_HASH, "search miss, creating new entry");
-    RETURN(entry);
-    return entry;
+    if(group[i] == c)
+      mask |= (1UL << i);
   }
+  #endif
 
-  // hit: return entry
-  matchEntry = table->ops->matchEntry;
-  if(MATCH_ENTRY_KEYHASH(entry, keyHash) && matchEntry(table, entry, key))
+  return mask;
+}
+
+///
+/// MatchGroupFree()
+// get a bit mask of all free or removed entries of a group
+static INLINE ULONG MatchGroupFree(const UBYTE *group)
+{
+  ULONG mask;
+  #if defined(__SSE2__)
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  // the high bit of the control bytes is set for free and removed entries only
+  mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+  #else
+  ULONG i;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  mask = 0;
+  for(i = 0; i < GROUP_WIDTH; i++)
   {
-    //D(DBF_HASH, "search hit, returning old entry");
-    RETURN(entry);
-    return entry;
+    if((group[i] & 0x80) != 0)
+      mask |= (1UL << i);
   }
+  #endif
+
+  return mask;
+}
+
+///
+/// SetCtrl()
+// set the control byte of an entry and its mirrored copy
+static INLINE void SetCtrl(struct HashTable *table, ULONG index, UBYTE c)
+{
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  table->ctrl[index] = c;
+  if(index < GROUP_WIDTH - 1)
+    table->ctrl[HASH_TABLE_SIZE(table) + index] = c;
+}
+
+///
+/// HashString()
+// the hash function of StringHashHashKey(), inlined for the string tables
+static INLINE ULONG HashString(const char *key)
+{
+  ULONG h = 0;
+  const unsigned char *s;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  for(s = (const unsigned char *)key; *s != '\0'; s++)
+    h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ *s;
+
+  return h;
+}
+
+///
+/// ComputeKeyHash()
+// compute the final keyHash value of a key, tables using the default string
+// operators get their hash values without calling the hashKey callback
+static INLINE ULONG ComputeKeyHash(struct HashTable *table, const void *key)
+{
+  ULONG keyHash;
 
-  // collision: hash again
-  //D(DBF_HASH, "search collision, hashing again");
-  sizeLog2 = HASH_BITS - table->shift;
-  hash2 = HASH2(keyHash, sizeLog2, hashShift);
-  sizeMask = (1UL << sizeLog2) - 1;
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
-  // save the first removed entry pointer so htoAdd can recycle it
-  if(ENTRY_IS_REMOVED(entry))
-    firstRemoved = entry;
+  if(table->ops->hashKey == StringHashHashKey && key != NULL)
+    keyHash = HashString(key);
   else
-  {
-    firstRemoved = NULL;
-    if(op == htoAdd)
-      entry->keyHash |= COLLISION_FLAG;
-  }
+    keyHash = table->ops->hashKey(table, key);
+
+  keyHash *= HASH_GOLDEN_RATIO;
 
-  for(;;)
+  // avoid 0 and 1 hash codes, they indicate free and removed entries
+  ENSURE_LIVE_KEYHASH(keyHash);
+
+  return keyHash;
+}
+
+///
+/// SearchTable()
+// return the index of the entry matching key. If there is no such entry the
+// index of the first free entry is returned, or the index of the first free
+// or removed entry which may be reused by htoAdd.
+static ULONG SearchTable(struct HashTable *table, const void *key, ULONG keyHash, enum HashTableOperator op)
+{
+  BOOL (* matchEntry)(struct HashTable *, const struct HashEntryHeader *, const void *);
+  BOOL stringKeys;
+  ULONG sizeMask;
+  ULONG index;
+  ULONG step = 0;
+  ULONG result = 0;
+  BOOL found = FALSE;
+  BOOL haveFree = FALSE;
+  UBYTE h2;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  matchEntry = table->ops->matchEntry;
+  stringKeys = (matchEntry == StringHashMatchEntry && key != NULL);
+  sizeMask = HASH_TABLE_SIZE(table) - 1;
+  index = HASH1(keyHash, table->shift);
+  h2 = HASH2(keyHash, table->shift);
+
+  do
   {
-    hash1 -= hash2;
-    hash1 &= sizeMask;
+    const UBYTE *group = &table->ctrl[index];
+    ULONG mask;
 
-    entry = ADDRESS_ENTRY(table, hash1);
-    if(HASH_ENTRY_IS_FREE(entry))
+    // check all entries with a matching control byte
+    for(mask = MatchGroup(group, h2); mask != 0; mask &= mask - 1)
     {
-      //D(DBF_HASH, "search miss, creating new entry");
-      if(firstRemoved != NULL && op == htoAdd)
-        entry = firstRemoved;
-      RETURN(entry);
-      return entry;
+      ULONG i = (index + TrailingZeros(mask)) & sizeMask;
+      struct HashEntryHeader *entry = ADDRESS_ENTRY(table, i);
+
+      if(entry->keyHash == keyHash)
+      {
+        // compare string keys without calling the matchEntry callback
+        const char *entryKey = ((struct HashEntry *)entry)->key;
+
+        if(stringKeys == TRUE ? (entryKey == key || (entryKey != NULL && strcmp(entryKey, key) == 0)) : matchEntry(table, entry, key))
+        {
+          result = i;
+          found = TRUE;
+          break;
+        }
+      }
     }
 
-    if(MATCH_ENTRY_KEYHASH(entry, keyHash) && matchEntry(table, entry, key))
+    if(found == FALSE)
     {
-      //D(DBF_HASH, "search hit, returning old entry");
-      RETURN(entry);
-      return entry;
+      // remember the first free or removed entry so htoAdd can recycle it
+      if(op == htoAdd && haveFree == FALSE && (mask = MatchGroupFree(group)) != 0)
+      {
+        result = (index + TrailingZeros(mask)) & sizeMask;
+        haveFree = TRUE;
+      }
+
+      // a free entry in this group terminates the search, the key cannot
+      // be located in one of the following groups
+      if((mask = MatchGroup(group, CTRL_EMPTY)) != 0)
+      {
+        if(haveFree == FALSE)
+          result = (index + TrailingZeros(mask)) & sizeMask;
+
+        found = TRUE;
+      }
+      else
+      {
+        // triangular probing visits every group exactly once
+        step += GROUP_WIDTH;
+        index = (index + step) & sizeMask;
+      }
     }
+  }
+  while(found == FALSE);
+
+  return result;
+}
+
+///
+/// FindFreeEntry()
+// return the index of the first free entry for a keyHash, used to move
+// entries into a new entry store which doesn't contain removed entries
+static ULONG FindFreeEntry(struct HashTable *table, ULONG keyHash)
+{
+  ULONG sizeMask;
+  ULONG index;
+  ULONG step = 0;
+  ULONG mask;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  sizeMask = HASH_TABLE_SIZE(table) - 1;
+  index = HASH1(keyHash, table->shift);
+
+  while((mask = MatchGroup(&table->ctrl[index], CTRL_EMPTY)) == 0)
+  {
+    step += GROUP_WIDTH;
+    index = (index + step) & sizeMask;
+  }
+
+  return (index + TrailingZeros(mask)) & sizeMask;
+}
+
+///
+/// ClaimEntry()
+// turn the free or removed entry found by SearchTable() into a live entry
+static struct HashEntryHeader *ClaimEntry(struct HashTable *table, ULONG index, const void *key, ULONG keyHash)
+{
+  struct HashEntryHeader *entry = ADDRESS_ENTRY(table, index);
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
+  if(table->ops->initEntry != NULL && table->ops->initEntry(table, entry, key) == FALSE)
+  {
+    // we haven't claimed entry yet; fail with NULL return.
+    memset(entry + 1, 0, table->entrySize - sizeof(*entry));
+    entry = NULL;
+  }
+  else
+  {
     if(ENTRY_IS_REMOVED(entry))
-    {
-      if(firstRemoved == NULL)
-        firstRemoved = entry;
-    }
-    else if(op == htoAdd)
-      entry->keyHash |= COLLISION_FLAG;
+      table->removedCount--;
+
+    entry->keyHash = keyHash;
+    SetCtrl(table, index, HASH2(keyHash, table->shift));
+    table->entryCount++;
   }
 
-  // this is never reached
-  RETURN(NULL);
-  return NULL;
+  return entry;
 }
 
 ///
@@ -158,9 +381,6 @@ static BOOL ChangeTable(struct HashTable *table, LONG deltaLog2)
   BOOL result = FALSE;
   LONG oldLog2, newLog2;
   ULONG oldCapacity, newCapacity;
-  char *oldEntryStore, *newEntryStore, *oldEntryAddr;
-  ULONG i;
-  struct HashEntryHeader *oldEntry, *newEntry;
 
   ENTER();
 
@@ -177,43 +397,69 @@ static BOOL ChangeTable(struct HashTable *table, LONG deltaLog2)
   if(newCapacity < HASH_SIZE_LIMIT)
   {
     ULONG entrySize;
+    char *newEntryStore;
+    UBYTE *newCtrl;
 
     entrySize = table->entrySize;
 
-    if((newEntryStore = table->ops->allocTable(table, newCapacity, entrySize)) != NULL)
+    newEntryStore = table->ops->allocTable(table, newCapacity, entrySize);
+    newCtrl = malloc(newCapacity + GROUP_WIDTH - 1);
+
+    if(newEntryStore != NULL && newCtrl != NULL)
     {
-      const void * (* getKey)(struct HashTable *, const struct HashEntryHeader *);
-      void         (* moveEntry)(struct HashTable *, const struct HashEntryHeader *, struct HashEntryHeader *);
+      void (* moveEntry)(struct HashTable *, const struct HashEntryHeader *, struct HashEntryHeader *);
+      char *oldEntryStore;
+      char *oldEntryAddr;
+      UBYTE *oldCtrl;
+      ULONG i;
 
-      getKey = table->ops->getKey;
       moveEntry = table->ops->moveEntry;
 
       oldEntryAddr = table->entryStore;
       oldEntryStore = table->entryStore;
+      oldCtrl = table->ctrl;
+
+      memset(newCtrl, CTRL_EMPTY, newCapacity + GROUP_WIDTH - 1);
 
       // assign the new entry store to the table
       table->shift = HASH_BITS - newLog2;
       table->removedCount = 0;
       table->generation++;
       table->entryStore = newEntryStore;
+      table->ctrl = newCtrl;
 
-      // copy all live nodes, leaving removed ones behind
+      // copy all live nodes, leaving removed ones behind. The keyHash values
+      // are kept in the entries, so there is no need to hash the keys again
       for(i = 0; i < oldCapacity; i++)
       {
-        oldEntry = (struct HashEntryHeader *)oldEntryAddr;
+        struct HashEntryHeader *oldEntry = (struct HashEntryHeader *)oldEntryAddr;
+
         if(HASH_ENTRY_IS_LIVE(oldEntry))
         {
-          oldEntry->keyHash &= ~COLLISION_FLAG;
-          newEntry = SearchTable(table, getKey(table, oldEntry), oldEntry->keyHash, htoAdd);
-          moveEntry(table, oldEntry, newEntry);
+          ULONG index = FindFreeEntry(table, oldEntry->keyHash);
+          struct HashEntryHeader *newEntry = ADDRESS_ENTRY(table, index);
+
+          if(moveEntry == DefaultHashMoveEntry)
+            memcpy(newEntry, oldEntry, entrySize);
+          else
+            moveEntry(table, oldEntry, newEntry);
+
           newEntry->keyHash = oldEntry->keyHash;
+          SetCtrl(table, index, HASH2(newEntry->keyHash, table->shift));
         }
         oldEntryAddr += entrySize;
       }
       table->ops->freeTable(table, oldEntryStore);
+      free(oldCtrl);
 
       result = TRUE;
     }
+    else
+    {
+      if(newEntryStore != NULL)
+        table->ops->freeTable(table, newEntryStore);
+      free(newCtrl);
+    }
   }
 
   RETURN(result);
@@ -336,15 +582,11 @@ void DefaultHashFinalize(UNUSED struct HashTable *table)
 ULONG StringHashHashKey(UNUSED struct HashTable *table, const void *key)
 {
   ULONG h = 0;
-  const unsigned char *s = (const unsigned char *)key;
 
   ENTER();
 
-  if(s != NULL)
-  {
-    for(s = key; *s != '\0'; s++)
-      h = (h >> (HASH_BITS - 4)) ^ (h << 4) ^ *s;
-  }
+  if(key != NULL)
+    h = HashString(key);
   else
     E(DBF_HASH, "StringHashHashKey called with <NULL> pointer");
 
@@ -461,7 +703,18 @@ BOOL HashTableInit(struct HashTable *table, const struct HashTableOps *ops, void
     table->generation = 0;
 
     if((table->entryStore = ops->allocTable(table, capacity, entrySize)) != NULL)
-      result = TRUE;
+    {
+      if((table->ctrl = malloc(capacity + GROUP_WIDTH - 1)) != NULL)
+      {
+        memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH - 1);
+        result = TRUE;
+      }
+      else
+      {
+        ops->freeTable(table, table->entryStore);
+        table->entryStore = NULL;
+      }
+    }
   }
 
   RETURN(result);
@@ -525,6 +778,9 @@ void HashTableCleanup(struct HashTable *table)
 
     table->ops->freeTable(table, table->entryStore);
     table->entryStore = NULL;
+
+    free(table->ctrl);
+    table->ctrl = NULL;
   }
 
   LEAVE();
@@ -540,18 +796,13 @@ struct HashEntryHeader *HashTableOperate(struct HashTable *table, const void *ke
 
   ENTER();
 
-  keyHash = table->ops->hashKey(table, key);
-  keyHash *= HASH_GOLDEN_RATIO;
-
-  // avoid 0 and 1 hash codes, they indicate free and removed entries
-  ENSURE_LIVE_KEYHASH(keyHash);
-  keyHash &= ~COLLISION_FLAG;
+  keyHash = ComputeKeyHash(table, key);
 
   switch(op)
   {
     case htoLookup:
     {
-      entry = SearchTable(table, key, keyHash, op);
+      entry = ADDRESS_ENTRY(table, SearchTable(table, key, keyHash, op));
     }
     break;
 
@@ -580,26 +831,13 @@ struct HashEntryHeader *HashTableOperate(struct HashTable *table, const void *ke
       {
         // look for entry after possibly growing, so we don't have to add it, then skip it
         // while growing the table and readd it after
-        entry = SearchTable(table, key, keyHash, op);
+        ULONG index = SearchTable(table, key, keyHash, op);
+
+        entry = ADDRESS_ENTRY(table, index);
         if(!HASH_ENTRY_IS_LIVE(entry))
         {
           // initialize the entry, indicating it is no longer free
-          if(ENTRY_IS_REMOVED(entry))
-          {
-            table->removedCount--;
-            keyHash |= COLLISION_FLAG;
-          }
-          if(table->ops->initEntry != NULL && table->ops->initEntry(table, entry, key) == FALSE)
-          {
-            // we haven't claimed entry yet; fail with NULL return.
-            memset(entry + 1, 0, table->entrySize - sizeof(*entry));
-            entry = NULL;
-          }
-          else
-          {
-            entry->keyHash = keyHash;
-            table->entryCount++;
-          }
+          entry = ClaimEntry(table, index, key, keyHash);
         }
       }
     }
@@ -607,7 +845,7 @@ struct HashEntryHeader *HashTableOperate(struct HashTable *table, const void *ke
 
     case htoRemove:
     {
-      entry = SearchTable(table, key, keyHash, op);
+      entry = ADDRESS_ENTRY(table, SearchTable(table, key, keyHash, op));
       if(HASH_ENTRY_IS_LIVE(entry))
       {
         ULONG size;
@@ -636,30 +874,110 @@ struct HashEntryHeader *HashTableOperate(struct HashTable *table, const void *ke
   return entry;
 }
 
+///
+/// HashTableOperateBatch()
+//
+ULONG HashTableOperateBatch(struct HashTable *table, const void *const *keys, ULONG count, enum HashTableOperator op, struct HashEntryHeader **entries)
+{
+  ULONG done = 0;
+
+  ENTER();
+
+  if(op == htoLookup || op == htoAdd)
+  {
+    ULONG size;
+    ULONG keyHash = 0;
+    ULONG i;
+
+    // grow the table once for all keys to be added, the entry pointers
+    // returned so far would become invalid if the table grows in between
+    size = HASH_TABLE_SIZE(table);
+    if(op == htoAdd && table->entryCount + table->removedCount + count >= MAX_LOAD(table, size))
+    {
+      LONG oldLog2 = HASH_BITS - table->shift;
+      LONG newLog2 = oldLog2;
+
+      while(table->entryCount + count >= MAX_LOAD(table, 1UL << newLog2) && (1UL << (newLog2 + 1)) < HASH_SIZE_LIMIT)
+        newLog2++;
+
+      // this will at least get rid of the removed entries
+      ChangeTable(table, newLog2 - oldLog2);
+      size = HASH_TABLE_SIZE(table);
+    }
+
+    if(count > 0)
+      keyHash = ComputeKeyHash(table, keys[0]);
+
+    for(i = 0; i < count; i++)
+    {
+      ULONG nextKeyHash = 0;
+      ULONG index;
+      struct HashEntryHeader *entry;
+
+      // hash the next key and fetch its control bytes while the current
+      // key is searched
+      if(i + 1 < count)
+      {
+        nextKeyHash = ComputeKeyHash(table, keys[i+1]);
+        PREFETCH(&table->ctrl[HASH1(nextKeyHash, table->shift)]);
+      }
+
+      index = SearchTable(table, keys[i], keyHash, op);
+      entry = ADDRESS_ENTRY(table, index);
+
+      if(!HASH_ENTRY_IS_LIVE(entry))
+      {
+        // keep at least one free entry if the table could not be grown
+        if(op == htoAdd && (ENTRY_IS_REMOVED(entry) || table->entryCount + table->removedCount < size - 1))
+          entry = ClaimEntry(table, index, keys[i], keyHash);
+        else
+          entry = NULL;
+      }
+
+      entries[i] = entry;
+      if(entry != NULL)
+        done++;
+
+      keyHash = nextKeyHash;
+    }
+  }
+
+  RETURN(done);
+  return done;
+}
+
 ///
 /// HashTableRawRemove()
 //
 void HashTableRawRemove(struct HashTable *table, struct HashEntryHeader *entry)
 {
-  ULONG keyHash;
+  ULONG index;
+  ULONG sizeMask;
+  ULONG emptyBefore;
+  ULONG emptyAfter;
 
-  // copy the hash value before we free/clear the entry
-  keyHash = entry->keyHash;
+  index = ENTRY_INDEX(table, entry);
+  sizeMask = HASH_TABLE_SIZE(table) - 1;
 
   table->ops->clearEntry(table, entry);
 
-  if(keyHash & COLLISION_FLAG)
+  // An entry can be marked as free again if every group containing it also
+  // contains a free entry. In this case no search ever continued behind this
+  // entry. Otherwise it must be marked as removed instead, HashTableOperate()
+  // knows how to handle this case.
+  emptyBefore = MatchGroup(&table->ctrl[(index - GROUP_WIDTH) & sizeMask], CTRL_EMPTY);
+  emptyAfter = MatchGroup(&table->ctrl[index], CTRL_EMPTY);
+
+  if(emptyBefore != 0 && emptyAfter != 0 && TrailingZeros(emptyAfter) + LeadingZeros(emptyBefore) < GROUP_WIDTH)
   {
-    // this entry collided with another entry, so it must not be marked
-    // as free, but as removed instead. HashTableOperate() knows how to
-    // handle this case.
-    MARK_ENTRY_REMOVED(entry);
-    table->removedCount++;
+    SetCtrl(table, index, CTRL_EMPTY);
+    MARK_ENTRY_FREE(entry);
   }
   else
   {
-    // this entry didn't cause a collision, so it can be marked as free
-    MARK_ENTRY_FREE(entry);
+    SetCtrl(table, index, CTRL_DELETED);
+    MARK_ENTRY_REMOVED(entry);
+    table->removedCount++;
   }
 
   table->entryCount--;
@@ -35,6 +35,10 @@
  The core functions of the ThunderBird 2.0.0.0 hash tables can be found here:
  http://mxr.mozilla.org/mozilla1.8/source/xpcom/glue/pldhash.c
  http://mxr.mozilla.org/mozilla1.8/source/xpcom/glue/pldhash.h
+
+ The double hashing of the original implementation has been replaced by
+ group wise probing of per entry control bytes as done by Google's "Swiss
+ tables", see https://abseil.io/about/design/swisstables for details.
 */
 
 #include <exec/types.h>
@@ -109,6 +113,7 @@ struct HashTable
   ULONG removedCount;               // removed entry sentinels in table
   ULONG generation;                 // entry storage generation number
   char *entryStore;                 // entry storage
+  UBYTE *ctrl;                      // control bytes of the entries
 };
 
 enum HashTableOperator
@@ -172,6 +177,22 @@ void HashTableCleanup(struct HashTable *table);
 // Perform an operation on the table.
 struct HashEntryHeader *HashTableOperate(struct HashTable *table, const void *key, enum HashTableOperator op);
 
+// Perform the same operation for several keys at once.  Only htoLookup and
+// htoAdd are supported.  entries[i] receives the live entry for keys[i], or
+// NULL if the key was not found or could not be added.  For htoAdd the table
+// is grown once in advance for all keys, hence all returned entry pointers
+// stay valid until the next call which may change the table.  Returns the
+// number of non-NULL entries.
+//
+// NB: the keys of an htoAdd batch must be distinct.  A new entry gets its key
+// from the caller only after the whole batch has been processed, hence a key
+// occurring twice is not found again within the same batch.  With the string
+// operators a second copy of a key ends up in a second entry, with other
+// operators matchEntry is even called for the still empty entry.  Remove
+// duplicate keys first or add them one by one via HashTableOperate().  Batches
+// of htoLookup operations may contain the same key several times.
+ULONG HashTableOperateBatch(struct HashTable *table, const void *const *keys, ULONG count, enum HashTableOperator op, struct HashEntryHeader **entries);
+
 // Remove an entry already accessed via LOOKUP or ADD.
 // NB: this is a "raw" or low-level routine, intended to be used only where
 // the inefficiency of a full HashTableOperate (which rehashes in order
@@ -229,10 +250,9 @@ ULONG HashTableEnumerate(struct HashTable *table, enum HashTableOperator (* etor
 void *DefaultHashAllocTable(UNUSED struct HashTable *table, ULONG capacity, ULONG entrySize);
 void DefaultHashFreeTable(UNUSED struct HashTable *table, void *ptr);
 
-// When a table grows or shrinks, each entry is queried for its key using this
-// callback.  NB: in that event, entry is not in table any longer; it's in the
-// old entryStore vector, which is due to be freed once all entries have been
-// moved via moveEntry callbacks.
+// Return the key of an entry.  The table itself doesn't need this callback
+// anymore, as the keyHash values stored in the entries are sufficient to move
+// the entries when the table grows or shrinks.
 const void *DefaultHashGetKey(UNUSED struct HashTable *table, const struct HashEntryHeader *entry);
 
 // Compute the hash code for a given key to be looked up, added, or removed
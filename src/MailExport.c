@@ -249,7 +249,7 @@ BOOL ExportMails(const char *fname, struct MailList *mlist, const ULONG flags)
                     }
 
                     // update the transfer status
-                    PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, curlen, tr(MSG_TR_Exporting));
+                    PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, curlen, tr(MSG_TR_Exporting), 0, 0);
                   }
 
                   // check why we exited the while() loop and if everything is fine
@@ -279,7 +279,7 @@ BOOL ExportMails(const char *fname, struct MailList *mlist, const ULONG flags)
                   free(buf);
 
                   // put the transferStat to 100%
-                  PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Exporting));
+                  PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Exporting), 0, 0);
                 }
                 else
                   success = FALSE;
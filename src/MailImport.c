@@ -969,7 +969,7 @@ static void ProcessImport(struct TransferContext *tc, const char *importFile, st
                 }
 
                 // update the transfer statistics
-                PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, lineLength+1, tr(MSG_TR_Importing));
+                PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, lineLength+1, tr(MSG_TR_Importing), 0, 0);
               }
 
               fclose(ofh);
@@ -1020,7 +1020,7 @@ static void ProcessImport(struct TransferContext *tc, const char *importFile, st
               MA_UpdateMailFile(mail);
 
               // put the transferStat to 100%
-              PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Importing));
+              PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Importing), 0, 0);
             }
 
             fclose(ifh);
@@ -1110,7 +1110,7 @@ static void ProcessImport(struct TransferContext *tc, const char *importFile, st
               MA_UpdateMailFile(mail);
 
               // put the transferStat to 100%
-              PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Importing));
+              PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Importing), 0, 0);
             }
 
             fclose(ifh);
@@ -37,6 +37,7 @@
 #include "YAM_mainFolder.h"
 
 #include "MailList.h"
+#include "StringPool.h"
 
 #include "Debug.h"
 
@@ -415,7 +416,8 @@ struct Mail *AllocMail(void)
 
   ENTER();
 
-  mail = ItemPoolAlloc(G->mailItemPool);
+  if((mail = ItemPoolAlloc(G->mailItemPool)) != NULL)
+    InitMailStrings(mail);
 
   RETURN(mail);
   return mail;
@@ -436,6 +438,16 @@ struct Mail *CloneMail(const struct Mail *mail)
 
     // start with a reference counter of zero
     clone->RefCounter = 0;
+
+    // the clone shares all pooled strings with the original mail
+    ReferenceString(G->stringPool, clone->From.Address);
+    ReferenceString(G->stringPool, clone->From.RealName);
+    ReferenceString(G->stringPool, clone->To.Address);
+    ReferenceString(G->stringPool, clone->To.RealName);
+    ReferenceString(G->stringPool, clone->ReplyTo.Address);
+    ReferenceString(G->stringPool, clone->ReplyTo.RealName);
+    ReferenceString(G->stringPool, clone->MailAccount);
+    ReferenceString(G->stringPool, clone->Subject);
   }
 
   RETURN(clone);
@@ -452,7 +464,10 @@ void FreeMail(struct Mail *mail)
   if(mail != NULL)
   {
     if(mail->RefCounter == 0)
+    {
+      FreeMailStrings(mail);
       ItemPoolFree(G->mailItemPool, mail);
+    }
     else
       W(DBF_MAIL, "FreeMail attempt on mail (%08lx) with RefCounter > 0 (%d)", mail, mail->RefCounter);
   }
@@ -460,6 +475,116 @@ void FreeMail(struct Mail *mail)
   LEAVE();
 }
 
+///
+/// InternMailString
+// return the pooled copy of a string which is cut to the given size
+// to keep the limits of the former fixed size fields of struct Mail
+static const char *InternMailString(const char *str, const size_t size)
+{
+  const char *result;
+
+  ENTER();
+
+  if(str != NULL && strlen(str) >= size)
+  {
+    char buffer[SIZE_SUBJECT];
+
+    strlcpy(buffer, str, MIN(size, sizeof(buffer)));
+    result = InternString(G->stringPool, buffer);
+  }
+  else
+    result = InternString(G->stringPool, str);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// InitMailStrings
+// let all string fields of a fresh mail structure point to valid empty
+// strings, no matter whether the structure was cleared before
+void InitMailStrings(struct Mail *mail)
+{
+  ENTER();
+
+  mail->From.Address = InternString(G->stringPool, NULL);
+  mail->From.RealName = mail->From.Address;
+  mail->To.Address = mail->From.Address;
+  mail->To.RealName = mail->From.Address;
+  mail->ReplyTo.Address = mail->From.Address;
+  mail->ReplyTo.RealName = mail->From.Address;
+  mail->MailAccount = mail->From.Address;
+  mail->Subject = mail->From.Address;
+
+  LEAVE();
+}
+
+///
+/// FreeMailStrings
+// release all pooled strings of a mail
+void FreeMailStrings(struct Mail *mail)
+{
+  ENTER();
+
+  SetMailPerson(&mail->From, NULL, NULL);
+  SetMailPerson(&mail->To, NULL, NULL);
+  SetMailPerson(&mail->ReplyTo, NULL, NULL);
+  SetMailAccount(mail, NULL);
+  SetMailSubject(mail, NULL);
+
+  LEAVE();
+}
+
+///
+/// SetMailSubject
+// set the subject of a mail, NULL is treated as an empty subject
+void SetMailSubject(struct Mail *mail, const char *subject)
+{
+  const char *old = mail->Subject;
+
+  ENTER();
+
+  // intern the new string before releasing the old one, as both may be
+  // the same pooled string
+  mail->Subject = InternMailString(subject, SIZE_SUBJECT);
+  ReleaseString(G->stringPool, old);
+
+  LEAVE();
+}
+
+///
+/// SetMailAccount
+// set the name of the account a mail was received/sent with
+void SetMailAccount(struct Mail *mail, const char *account)
+{
+  const char *old = mail->MailAccount;
+
+  ENTER();
+
+  mail->MailAccount = InternMailString(account, SIZE_DEFAULT);
+  ReleaseString(G->stringPool, old);
+
+  LEAVE();
+}
+
+///
+/// SetMailPerson
+// set the address and real name of one of the main persons of a mail
+void SetMailPerson(struct MailPerson *person, const char *address, const char *realName)
+{
+  const char *oldAddress = person->Address;
+  const char *oldRealName = person->RealName;
+
+  ENTER();
+
+  person->Address = InternMailString(address, SIZE_ADDRESS);
+  person->RealName = InternMailString(realName, SIZE_REALNAME);
+  ReleaseString(G->stringPool, oldAddress);
+  ReleaseString(G->stringPool, oldRealName);
+
+  LEAVE();
+}
+
 ///
 /// ReferenceMail
 // increase a mail's reference counter
@@ -38,6 +38,7 @@
 // forward declarations
 struct SignalSemaphore;
 struct Mail;
+struct MailPerson;
 
 struct MailList
 {
@@ -72,6 +73,11 @@ struct Mail *CloneMail(const struct Mail *mail);
 void ReferenceMail(struct Mail *mail);
 void DereferenceMail(struct Mail *mail);
 void FreeMail(struct Mail *mail);
+void InitMailStrings(struct Mail *mail);
+void FreeMailStrings(struct Mail *mail);
+void SetMailSubject(struct Mail *mail, const char *subject);
+void SetMailAccount(struct Mail *mail, const char *account);
+void SetMailPerson(struct MailPerson *person, const char *address, const char *realName);
 
 // public comparison functions
 int CompareMailsByDate(const struct MailNode *m1, const struct MailNode *m2);
@@ -63,6 +63,7 @@ enum MailServerType { MST_UNKNOWN=0, MST_SMTP, MST_POP3, MST_IMAP };
 #define MSF_DOWNLOAD_ON_STARTUP   (1<<16) // [POP3]      : check for new mail on startup
 #define MSF_DOWNLOAD_PERIODICALLY (1<<17) // [POP3]      : periodically check for new mails
 #define MSF_DOWNLOAD_LARGE_MAILS  (1<<18) // [POP3]      : download large mails in automatic mode
+#define MSF_PROTO_IMAP            (1<<19) // [POP3]      : receive the mails via IMAP4rev1 instead of POP3
 
 #define isServerActive(v)                (isFlagSet((v)->flags, MSF_ACTIVE))
 #define hasServerAPOP(v)                 (isFlagSet((v)->flags, MSF_APOP))
@@ -82,6 +83,7 @@ enum MailServerType { MST_UNKNOWN=0, MST_SMTP, MST_POP3, MST_IMAP };
 #define hasServerDownloadOnStartup(v)    (isFlagSet((v)->flags, MSF_DOWNLOAD_ON_STARTUP))
 #define hasServerDownloadPeriodically(v) (isFlagSet((v)->flags, MSF_DOWNLOAD_PERIODICALLY))
 #define hasServerDownloadLargeMails(v)   (isFlagSet((v)->flags, MSF_DOWNLOAD_LARGE_MAILS))
+#define hasServerIMAP(v)                 (isFlagSet((v)->flags, MSF_PROTO_IMAP))
 
 #define MSF2SMTPSecMethod(v)    (hasServerTLS(v) ? 1 : (hasServerSSL(v) ? 2 : 0))
 #define MSF2POP3SecMethod(v)    (hasServerSSL(v) ? 1 : (hasServerTLS(v) ? 2 : 0))
@@ -0,0 +1,405 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "YAM_folderconfig.h"
+#include "YAM_mainFolder.h"
+
+#include "MailList.h"
+#include "MsgIDHash.h"
+
+#include "Debug.h"
+
+/*** Hash table operators ***/
+/// MsgIDHashGetKey
+//
+static const void *MsgIDHashGetKey(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  const struct MsgIDHashEntry *mentry = (const struct MsgIDHashEntry *)entry;
+  const void *result;
+
+  ENTER();
+
+  result = (const void *)mentry->msgID;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// MsgIDHashHashKey
+// the compressed message IDs are CRC values already, hence they can be
+// used as hash values directly
+static ULONG MsgIDHashHashKey(UNUSED struct HashTable *table, const void *key)
+{
+  ULONG result;
+
+  ENTER();
+
+  result = (ULONG)key;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// MsgIDHashMatchEntry
+//
+static BOOL MsgIDHashMatchEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry, const void *key)
+{
+  const struct MsgIDHashEntry *mentry = (const struct MsgIDHashEntry *)entry;
+  BOOL result;
+
+  ENTER();
+
+  result = (mentry->msgID == (ULONG)key);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// MsgIDHashClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void MsgIDHashClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct MsgIDHashEntry *mentry = (struct MsgIDHashEntry *)entry;
+
+  free(mentry->moreMails);
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// MsgIDHashDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void MsgIDHashDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  const struct MsgIDHashEntry *mentry = (const struct MsgIDHashEntry *)entry;
+
+  free(mentry->moreMails);
+}
+
+///
+/// GetMsgIDHashOps
+//
+static const struct HashTableOps *GetMsgIDHashOps(void)
+{
+  static const struct HashTableOps msgIDHashOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    MsgIDHashGetKey,
+    MsgIDHashHashKey,
+    MsgIDHashMatchEntry,
+    DefaultHashMoveEntry,
+    MsgIDHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    MsgIDHashDestroyEntry
+  };
+
+  ENTER();
+  RETURN(&msgIDHashOps);
+  return &msgIDHashOps;
+}
+
+///
+
+/*** Private functions ***/
+/// AddMailToTable
+// add a mail to one of the two tables, mails without an ID are skipped
+static BOOL AddMailToTable(struct HashTable *table, const ULONG msgID, struct Mail *mail)
+{
+  BOOL success = TRUE;
+
+  ENTER();
+
+  if(msgID != 0)
+  {
+    struct MsgIDHashEntry *entry;
+
+    if((entry = (struct MsgIDHashEntry *)HashTableOperate(table, (const void *)msgID, htoAdd)) != NULL)
+    {
+      if(entry->mail == NULL)
+      {
+        // this is a new entry
+        entry->msgID = msgID;
+        entry->mail = mail;
+      }
+      else
+      {
+        // there are other mails with the same ID already, append this one
+        if(entry->numMoreMails == entry->maxMoreMails)
+        {
+          ULONG newMax = (entry->maxMoreMails == 0) ? 4 : entry->maxMoreMails * 2;
+          struct Mail **newMails;
+
+          if((newMails = realloc(entry->moreMails, newMax * sizeof(*newMails))) != NULL)
+          {
+            entry->moreMails = newMails;
+            entry->maxMoreMails = newMax;
+          }
+          else
+            success = FALSE;
+        }
+
+        if(success == TRUE)
+        {
+          entry->moreMails[entry->numMoreMails] = mail;
+          entry->numMoreMails++;
+        }
+      }
+    }
+    else
+      success = FALSE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// RemoveMailFromTable
+// remove a mail from one of the two tables
+static void RemoveMailFromTable(struct HashTable *table, const ULONG msgID, const struct Mail *mail)
+{
+  struct MsgIDHashEntry *entry;
+
+  ENTER();
+
+  if(msgID != 0 &&
+     (entry = (struct MsgIDHashEntry *)HashTableOperate(table, (const void *)msgID, htoLookup)) != NULL &&
+     HASH_ENTRY_IS_LIVE(&entry->hash))
+  {
+    if(entry->mail == mail)
+    {
+      if(entry->numMoreMails == 0)
+      {
+        // this was the last mail with this ID
+        HashTableOperate(table, (const void *)msgID, htoRemove);
+      }
+      else
+      {
+        // let the next mail move up, this keeps the original order
+        entry->mail = entry->moreMails[0];
+        entry->numMoreMails--;
+        memmove(&entry->moreMails[0], &entry->moreMails[1], entry->numMoreMails * sizeof(*entry->moreMails));
+      }
+    }
+    else
+    {
+      ULONG i;
+
+      for(i = 0; i < entry->numMoreMails; i++)
+      {
+        if(entry->moreMails[i] == mail)
+        {
+          entry->numMoreMails--;
+          memmove(&entry->moreMails[i], &entry->moreMails[i+1], (entry->numMoreMails - i) * sizeof(*entry->moreMails));
+          break;
+        }
+      }
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// BuildMsgIDHash
+// create the hash tables for all mails of a folder, the folder's mail
+// list must be locked by the caller
+static BOOL BuildMsgIDHash(struct Folder *folder)
+{
+  BOOL success = FALSE;
+  struct MsgIDHash *msgIDHash;
+
+  ENTER();
+
+  if((msgIDHash = calloc(1, sizeof(*msgIDHash))) != NULL)
+  {
+    ULONG capacity = (folder->Total > 0) ? folder->Total : 64;
+
+    if(HashTableInit(&msgIDHash->msgIDs, GetMsgIDHashOps(), NULL, sizeof(struct MsgIDHashEntry), capacity) == TRUE)
+    {
+      if(HashTableInit(&msgIDHash->irtMsgIDs, GetMsgIDHashOps(), NULL, sizeof(struct MsgIDHashEntry), capacity) == TRUE)
+      {
+        struct MailNode *mnode;
+
+        success = TRUE;
+
+        ForEachMailNode(folder->messages, mnode)
+        {
+          struct Mail *mail = mnode->mail;
+
+          if(AddMailToTable(&msgIDHash->msgIDs, mail->cMsgID, mail) == FALSE ||
+             AddMailToTable(&msgIDHash->irtMsgIDs, mail->cIRTMsgID, mail) == FALSE)
+          {
+            success = FALSE;
+            break;
+          }
+        }
+
+        if(success == TRUE)
+        {
+          D(DBF_FOLDER, "built message ID hash of folder '%s' with %ld/%ld IDs", folder->Name, msgIDHash->msgIDs.entryCount, msgIDHash->irtMsgIDs.entryCount);
+          folder->msgIDHash = msgIDHash;
+        }
+        else
+          HashTableCleanup(&msgIDHash->irtMsgIDs);
+      }
+
+      if(success == FALSE)
+        HashTableCleanup(&msgIDHash->msgIDs);
+    }
+
+    if(success == FALSE)
+    {
+      E(DBF_FOLDER, "could not build message ID hash of folder '%s'", folder->Name);
+      free(msgIDHash);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+
+/*** Public functions ***/
+/// AddMailToMsgIDHash
+// add a mail to the folder's hash tables, the folder's mail list must
+// be locked by the caller
+void AddMailToMsgIDHash(struct Folder *folder, struct Mail *mail)
+{
+  struct MsgIDHash *msgIDHash = folder->msgIDHash;
+
+  ENTER();
+
+  // nothing to do if the tables have not been built yet, they
+  // will include this mail once they are needed
+  if(msgIDHash != NULL)
+  {
+    if(AddMailToTable(&msgIDHash->msgIDs, mail->cMsgID, mail) == FALSE ||
+       AddMailToTable(&msgIDHash->irtMsgIDs, mail->cIRTMsgID, mail) == FALSE)
+    {
+      // drop the incomplete tables, they will be rebuilt on demand
+      DeleteMsgIDHash(folder);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// RemoveMailFromMsgIDHash
+// remove a mail from the folder's hash tables, the folder's mail list
+// must be locked by the caller
+void RemoveMailFromMsgIDHash(struct Folder *folder, const struct Mail *mail)
+{
+  struct MsgIDHash *msgIDHash = folder->msgIDHash;
+
+  ENTER();
+
+  if(msgIDHash != NULL)
+  {
+    RemoveMailFromTable(&msgIDHash->msgIDs, mail->cMsgID, mail);
+    RemoveMailFromTable(&msgIDHash->irtMsgIDs, mail->cIRTMsgID, mail);
+  }
+
+  LEAVE();
+}
+
+///
+/// DeleteMsgIDHash
+// free the folder's hash tables
+void DeleteMsgIDHash(struct Folder *folder)
+{
+  struct MsgIDHash *msgIDHash = folder->msgIDHash;
+
+  ENTER();
+
+  if(msgIDHash != NULL)
+  {
+    HashTableCleanup(&msgIDHash->msgIDs);
+    HashTableCleanup(&msgIDHash->irtMsgIDs);
+    free(msgIDHash);
+
+    folder->msgIDHash = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// FindMsgIDHashEntry
+// look up all mails of a folder which carry the given compressed ID,
+// the tables are built on first use. The folder's mail list must be
+// locked exclusively by the caller.
+const struct MsgIDHashEntry *FindMsgIDHashEntry(struct Folder *folder, const ULONG msgID, const enum MsgIDHashType type)
+{
+  const struct MsgIDHashEntry *result = NULL;
+
+  ENTER();
+
+  if(msgID != 0 && (folder->msgIDHash != NULL || BuildMsgIDHash(folder) == TRUE))
+  {
+    struct HashTable *table = (type == MHT_MSGID) ? &folder->msgIDHash->msgIDs : &folder->msgIDHash->irtMsgIDs;
+    struct HashEntryHeader *entry;
+
+    if((entry = HashTableOperate(table, (const void *)msgID, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
+      result = (const struct MsgIDHashEntry *)entry;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// GetMsgIDHashMail
+// return the n-th mail of a hash entry, or NULL if there are no more mails
+struct Mail *GetMsgIDHashMail(const struct MsgIDHashEntry *entry, const ULONG index)
+{
+  struct Mail *mail = NULL;
+
+  ENTER();
+
+  if(entry != NULL)
+  {
+    if(index == 0)
+      mail = entry->mail;
+    else if(index <= entry->numMoreMails)
+      mail = entry->moreMails[index-1];
+  }
+
+  RETURN(mail);
+  return mail;
+}
+
+///
@@ -0,0 +1,71 @@
+#ifndef MSGIDHASH_H
+#define MSGIDHASH_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include "HashTable.h"
+
+// forward declarations
+struct Folder;
+struct Mail;
+
+// the hash tables of a folder which map the compressed message IDs
+// and in-reply-to message IDs to the folder's mails
+struct MsgIDHash
+{
+  struct HashTable msgIDs;    // cMsgID -> mails
+  struct HashTable irtMsgIDs; // cIRTMsgID -> mails
+};
+
+// a single entry of the above hash tables. As several mails may share
+// the same (compressed) ID the first mail is kept directly within the
+// entry while all further mails go to a separately allocated array.
+struct MsgIDHashEntry
+{
+  struct HashEntryHeader hash; // a standard hash entry header
+  ULONG msgID;                 // the compressed ID, this is the key
+  struct Mail *mail;           // the first mail with this ID
+  struct Mail **moreMails;     // all further mails with this ID
+  ULONG numMoreMails;          // number of used slots in moreMails
+  ULONG maxMoreMails;          // number of allocated slots in moreMails
+};
+
+// which ID of a mail to look up
+enum MsgIDHashType
+{
+  MHT_MSGID=0,                 // the mail's own message ID
+  MHT_INREPLYTO                // the ID the mail is a reply to
+};
+
+void AddMailToMsgIDHash(struct Folder *folder, struct Mail *mail);
+void RemoveMailFromMsgIDHash(struct Folder *folder, const struct Mail *mail);
+void DeleteMsgIDHash(struct Folder *folder);
+const struct MsgIDHashEntry *FindMsgIDHashEntry(struct Folder *folder, const ULONG msgID, const enum MsgIDHashType type);
+struct Mail *GetMsgIDHashMail(const struct MsgIDHashEntry *entry, const ULONG index);
+
+#endif /* MSGIDHASH_H */
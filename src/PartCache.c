@@ -0,0 +1,442 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/utility.h>
+
+#include "YAM.h"
+#include "YAM_main.h"
+#include "YAM_mainFolder.h"
+#include "YAM_read.h"
+#include "YAM_stringsizes.h"
+#include "YAM_utilities.h"
+
+#include "Config.h"
+#include "FileInfo.h"
+#include "PartCache.h"
+
+#include "Debug.h"
+
+// The part cache keeps the decoded files of attachments which were opened,
+// saved or previewed by the user. The files stay in the temporary directory
+// after the read window was closed, so reading the same mail again doesn't
+// need to decode its attachments again. Unused files are removed in least
+// recently used order as soon as their total size exceeds the configured
+// limit. The nodes live within the hash table's entry store, which is moved
+// around when the table grows or shrinks. Hence the recency is tracked by a
+// use stamp instead of a linked list of nodes.
+
+/*** Static variables/functions ***/
+static long totalSize;  // total size of all cached files
+static ULONG useStamp;  // the stamp of the most recent use
+
+/// GetPartKey
+// build the cache key of a part, which is made up of the mail file, the
+// message ID and size of the mail and the part number
+static BOOL GetPartKey(const struct Part *rp, char *key, size_t keySize)
+{
+  BOOL result = FALSE;
+  struct Mail *mail = rp->rmData->mail;
+
+  ENTER();
+
+  // virtual mails don't have a permanent mail file
+  if(mail != NULL && isVirtualMail(mail) == FALSE && mail->Folder != NULL)
+  {
+    char mailFile[SIZE_PATHFILE];
+
+    GetMailFile(mailFile, sizeof(mailFile), mail->Folder, mail);
+    snprintf(key, keySize, "%s:%08lx:%ld:%d", mailFile, mail->cMsgID, mail->Size, rp->Nr);
+
+    result = TRUE;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// DeletePartCacheNode
+// delete the decoded file of a cache node
+static enum HashTableOperator DeletePartCacheNode(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, UNUSED void *arg)
+{
+  struct PartCacheNode *node = (struct PartCacheNode *)entry;
+
+  ENTER();
+
+  D(DBF_MIME, "removing cached part '%s' (%s)", node->id, node->filename);
+
+  #if defined(DEBUG)
+  if(node->openCount > 0)
+    W(DBF_MIME, "  openCount of part cache node still %ld!!!", node->openCount);
+  #endif
+
+  if(node->filename != NULL)
+  {
+    if(DeleteFile(node->filename) == 0)
+      AddZombieFile(node->filename);
+
+    free(node->filename);
+    node->filename = NULL;
+  }
+
+  totalSize -= node->size;
+
+  // node->id will be freed by the hash table functions
+  RETURN(htoNext);
+  return htoNext;
+}
+
+///
+/// FindOldestPart
+// find the least recently used part which is not in use anymore
+static enum HashTableOperator FindOldestPart(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  struct PartCacheNode *node = (struct PartCacheNode *)entry;
+  struct PartCacheNode **oldest = (struct PartCacheNode **)arg;
+
+  ENTER();
+
+  if(node->openCount == 0 && (*oldest == NULL || node->lastUse < (*oldest)->lastUse))
+    *oldest = node;
+
+  RETURN(htoNext);
+  return htoNext;
+}
+
+///
+/// EvictParts
+// remove unused parts from the cache until the cache fits into its limit
+static void EvictParts(void)
+{
+  long limit = C->AttachmentCacheSize * 1024L;
+
+  ENTER();
+
+  while(totalSize > limit)
+  {
+    struct PartCacheNode *oldest = NULL;
+
+    HashTableEnumerate(G->partCacheHashTable, FindOldestPart, &oldest);
+
+    // all remaining parts are still in use
+    if(oldest == NULL)
+      break;
+
+    DeletePartCacheNode(G->partCacheHashTable, &oldest->hash, 0, NULL);
+    // oldest->id will be freed by HashTableRawRemove()
+    HashTableRawRemove(G->partCacheHashTable, &oldest->hash);
+  }
+
+  D(DBF_MIME, "part cache holds %ld of %ld bytes", totalSize, limit);
+
+  LEAVE();
+}
+
+///
+
+/*** Part caching mechanisms ***/
+/// PartCacheSetup
+//
+BOOL PartCacheSetup(void)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  totalSize = 0;
+  useStamp = 0;
+
+  if((G->partCacheHashTable = HashTableNew(HashTableGetDefaultStringOps(), NULL, sizeof(struct PartCacheNode), 32)) != NULL)
+    result = TRUE;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// PartCacheCleanup
+// for cleaning up the part cache and deleting all cached files
+void PartCacheCleanup(void)
+{
+  ENTER();
+
+  if(G->partCacheHashTable != NULL)
+  {
+    HashTableEnumerate(G->partCacheHashTable, DeletePartCacheNode, NULL);
+    HashTableDestroy(G->partCacheHashTable);
+    G->partCacheHashTable = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// ObtainCachedPart
+// look up the decoded file of a part in the cache, on success the part
+// refers to the cached file until it is released again
+BOOL ObtainCachedPart(struct Part *rp)
+{
+  BOOL result = FALSE;
+  char key[SIZE_PATHFILE+SIZE_DEFAULT];
+
+  ENTER();
+
+  if(G->partCacheHashTable != NULL && C->AttachmentCacheSize > 0 && GetPartKey(rp, key, sizeof(key)) == TRUE)
+  {
+    struct HashEntryHeader *entry;
+
+    entry = HashTableOperate(G->partCacheHashTable, key, htoLookup);
+    if(HASH_ENTRY_IS_LIVE(entry))
+    {
+      struct PartCacheNode *node = (struct PartCacheNode *)entry;
+
+      if(FileExists(node->filename) == TRUE)
+      {
+        // remember the key, because the key of the part itself changes
+        // if the mail is moved or modified
+        if((rp->cacheKey = strdup(node->id)) != NULL)
+        {
+          D(DBF_MIME, "part '%s' found in cache (%s)", key, node->filename);
+
+          node->openCount++;
+          node->lastUse = ++useStamp;
+
+          strlcpy(rp->Filename, node->filename, sizeof(rp->Filename));
+          setFlag(rp->Flags, PFLAG_DECODED|PFLAG_CACHED);
+
+          result = TRUE;
+        }
+      }
+      else if(node->openCount == 0)
+      {
+        W(DBF_MIME, "cached file '%s' of part '%s' vanished", node->filename, key);
+
+        // forget about the vanished file
+        free(node->filename);
+        node->filename = NULL;
+        totalSize -= node->size;
+
+        // node->id will be freed by HashTableRawRemove()
+        HashTableRawRemove(G->partCacheHashTable, entry);
+      }
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// AddCachedPart
+// hand over the freshly decoded file of a part to the cache, the part keeps
+// referring to the file until it is released again
+void AddCachedPart(struct Part *rp)
+{
+  char key[SIZE_PATHFILE+SIZE_DEFAULT];
+
+  ENTER();
+
+  if(G->partCacheHashTable != NULL && C->AttachmentCacheSize > 0 && isDecoded(rp) == TRUE && isCached(rp) == FALSE &&
+     rp->Filename[0] != '\0' && rp->Size <= C->AttachmentCacheSize * 1024L &&
+     GetPartKey(rp, key, sizeof(key)) == TRUE)
+  {
+    struct HashEntryHeader *entry;
+
+    if((entry = HashTableOperate(G->partCacheHashTable, key, htoAdd)) != NULL)
+    {
+      struct PartCacheNode *node = (struct PartCacheNode *)entry;
+
+      // a part which is already cached will not be replaced
+      if(node->id == NULL)
+      {
+        char filepath[SIZE_PATHFILE];
+        char file[SIZE_FILE];
+        const char *ext = strchr(FilePart(rp->Filename), '.');
+
+        // the file gets a name of its own, because the name of a part's file
+        // is derived from the read mail data and the embedded read pane will
+        // reuse it for any other mail
+        snprintf(file, sizeof(file), "YAMc%08x%s", (unsigned int)GetUniqueID(), ext != NULL ? ext : "");
+        AddPath(filepath, C->TempDir, file, sizeof(filepath));
+
+        if((node->id = strdup(key)) != NULL && (node->filename = strdup(filepath)) != NULL &&
+           (rp->cacheKey = strdup(key)) != NULL && Rename(rp->Filename, filepath) != 0)
+        {
+          D(DBF_MIME, "adding part '%s' to cache (%s)", key, filepath);
+
+          node->size = rp->Size;
+          node->openCount = 1;
+          node->lastUse = ++useStamp;
+          totalSize += node->size;
+
+          strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
+          setFlag(rp->Flags, PFLAG_CACHED);
+
+          EvictParts();
+        }
+        else
+        {
+          E(DBF_MIME, "couldn't add part '%s' to cache", key);
+
+          free(rp->cacheKey);
+          rp->cacheKey = NULL;
+          free(node->filename);
+          node->filename = NULL;
+
+          // node->id will be freed by HashTableRawRemove()
+          HashTableRawRemove(G->partCacheHashTable, entry);
+        }
+      }
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// ReleaseCachedPart
+// release the cached file of a part, the file itself stays in the cache
+// until it is evicted
+void ReleaseCachedPart(struct Part *rp)
+{
+  ENTER();
+
+  if(G->partCacheHashTable != NULL && isCached(rp) == TRUE)
+  {
+    struct HashEntryHeader *entry = NULL;
+
+    // the node is looked up by the key it was obtained with, the part's
+    // current key might differ if the mail was moved or modified
+    if(rp->cacheKey != NULL)
+      entry = HashTableOperate(G->partCacheHashTable, rp->cacheKey, htoLookup);
+
+    if(entry != NULL && HASH_ENTRY_IS_LIVE(entry))
+    {
+      struct PartCacheNode *node = (struct PartCacheNode *)entry;
+
+      if(node->openCount > 0)
+      {
+        node->openCount--;
+        D(DBF_MIME, "reduced open count of cached part '%s' to %ld", node->id, node->openCount);
+      }
+      else
+        E(DBF_MIME, "couldn't reduce open count (%ld) of cached part '%s'", node->openCount, node->id);
+    }
+    else
+      E(DBF_MIME, "cached part '%s' (%s) not found in cache", SafeStr(rp->cacheKey), rp->Filename);
+
+    free(rp->cacheKey);
+    rp->cacheKey = NULL;
+
+    rp->Filename[0] = '\0';
+    clearFlag(rp->Flags, PFLAG_DECODED|PFLAG_CACHED);
+
+    EvictParts();
+  }
+
+  LEAVE();
+}
+
+///
+/// DetachCachedPart
+// replace the cached file of a part by a private copy, which the caller may
+// move or delete afterwards. The cached file itself is released.
+BOOL DetachCachedPart(struct Part *rp)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  if(isCached(rp) == TRUE)
+  {
+    char filepath[SIZE_PATHFILE];
+    char file[SIZE_FILE];
+    const char *ext = strchr(FilePart(rp->Filename), '.');
+
+    snprintf(file, sizeof(file), "YAMd%08x%s", (unsigned int)GetUniqueID(), ext != NULL ? ext : "");
+    AddPath(filepath, C->TempDir, file, sizeof(filepath));
+
+    if(CopyFile(filepath, NULL, rp->Filename, NULL) == TRUE)
+    {
+      D(DBF_MIME, "detached cached part '%s' (%s)", rp->cacheKey, filepath);
+
+      ReleaseCachedPart(rp);
+
+      strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
+      setFlag(rp->Flags, PFLAG_DECODED);
+    }
+    else
+    {
+      E(DBF_MIME, "couldn't copy cached file '%s' to '%s'", rp->Filename, filepath);
+
+      DeleteFile(filepath);
+      result = FALSE;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// DumpPartCache
+#if defined(DEBUG)
+static enum HashTableOperator DumpPartCacheNode(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, UNUSED void *arg)
+{
+  struct PartCacheNode *node = (struct PartCacheNode *)entry;
+
+  ENTER();
+
+  D(DBF_MIME, "  node %08lx", node);
+  D(DBF_MIME, "    hash key         %08lx", node->hash.keyHash);
+  D(DBF_MIME, "    id               '%s'", node->id);
+  D(DBF_MIME, "    file             '%s'", node->filename);
+  D(DBF_MIME, "    size             %ld", node->size);
+  D(DBF_MIME, "    lastUse          %ld", node->lastUse);
+  D(DBF_MIME, "    openCount        %ld", node->openCount);
+
+  RETURN(htoNext);
+  return htoNext;
+}
+
+void DumpPartCache(void)
+{
+  ENTER();
+
+  D(DBF_MIME, "current part cache contents, %ld bytes", totalSize);
+  HashTableEnumerate(G->partCacheHashTable, DumpPartCacheNode, NULL);
+
+  LEAVE();
+}
+#endif
+
+///
@@ -0,0 +1,62 @@
+#ifndef PARTCACHE_H
+#define PARTCACHE_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+#include "HashTable.h"
+
+// forward declarations
+struct Part;
+
+// definition of a partCacheNode which keeps the decoded
+// file of a mail part, keyed by the mail and the part number
+struct PartCacheNode
+{
+  struct HashEntryHeader hash; // standard hash table header
+  char *id;                    // pointer to the id
+  char *filename;              // pointer to the decoded file
+  long size;                   // size of the decoded file in bytes
+  ULONG lastUse;               // use stamp for the least recently used eviction
+  int openCount;               // counter how often the part is now opened/used
+};
+
+// the prototypes for our public available functions
+BOOL PartCacheSetup(void);
+void PartCacheCleanup(void);
+BOOL ObtainCachedPart(struct Part *rp);
+void AddCachedPart(struct Part *rp);
+void ReleaseCachedPart(struct Part *rp);
+BOOL DetachCachedPart(struct Part *rp);
+
+#if defined(DEBUG)
+void DumpPartCache(void);
+#endif
+
+#endif // PARTCACHE_H
@@ -0,0 +1,248 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <proto/exec.h>
+
+#include "StringPool.h"
+
+#include "Debug.h"
+
+// the memory layout of a pooled string, the reference counter is
+// placed directly in front of the string's characters
+struct PooledString
+{
+  ULONG refCount;
+  char string[1];
+};
+
+#define POOLEDSTRING(str)  ((struct PooledString *)((char *)(str) - offsetof(struct PooledString, string)))
+
+// empty strings are never pooled, all of them share this one
+static const char emptyString[] = "";
+
+/*** Hash table operators ***/
+/// StringPoolClearEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void StringPoolClearEntry(struct HashTable *table, struct HashEntryHeader *entry)
+{
+  struct HashEntry *stub = (struct HashEntry *)entry;
+
+  if(stub->key != NULL)
+    free(POOLEDSTRING(stub->key));
+
+  memset(entry, 0, table->entrySize);
+}
+
+///
+/// StringPoolDestroyEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void StringPoolDestroyEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  const struct HashEntry *stub = (const struct HashEntry *)entry;
+
+  if(stub->key != NULL)
+    free(POOLEDSTRING(stub->key));
+}
+
+///
+/// GetStringPoolOps
+//
+static const struct HashTableOps *GetStringPoolOps(void)
+{
+  static const struct HashTableOps stringPoolOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    StringHashHashKey,
+    StringHashMatchEntry,
+    DefaultHashMoveEntry,
+    StringPoolClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    StringPoolDestroyEntry
+  };
+
+  ENTER();
+  RETURN(&stringPoolOps);
+  return &stringPoolOps;
+}
+
+///
+
+/*** Public functions ***/
+/// CreateStringPool
+// create a new empty string pool
+struct StringPool *CreateStringPool(void)
+{
+  struct StringPool *pool;
+
+  ENTER();
+
+  if((pool = calloc(1, sizeof(*pool))) != NULL)
+  {
+    BOOL success = FALSE;
+
+    if((pool->semaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
+    {
+      if(HashTableInit(&pool->strings, GetStringPoolOps(), NULL, sizeof(struct HashEntry), 1024) == TRUE)
+        success = TRUE;
+      else
+        FreeSysObject(ASOT_SEMAPHORE, pool->semaphore);
+    }
+
+    if(success == FALSE)
+    {
+      free(pool);
+      pool = NULL;
+    }
+  }
+
+  RETURN(pool);
+  return pool;
+}
+
+///
+/// DeleteStringPool
+// free a string pool including all strings which are still referenced
+void DeleteStringPool(struct StringPool *pool)
+{
+  ENTER();
+
+  if(pool != NULL)
+  {
+    if(pool->strings.entryCount != 0)
+      W(DBF_UTIL, "string pool still contains %ld referenced strings", pool->strings.entryCount);
+
+    HashTableCleanup(&pool->strings);
+    FreeSysObject(ASOT_SEMAPHORE, pool->semaphore);
+    free(pool);
+  }
+
+  LEAVE();
+}
+
+///
+/// InternString
+// return the pooled copy of a string and add one reference to it. The
+// string is added to the pool if it is not yet part of it. The result
+// must be released via ReleaseString() once it is no longer needed.
+const char *InternString(struct StringPool *pool, const char *str)
+{
+  const char *result = emptyString;
+
+  ENTER();
+
+  if(str != NULL && str[0] != '\0')
+  {
+    struct HashEntry *entry;
+
+    ObtainSemaphore(pool->semaphore);
+
+    if((entry = (struct HashEntry *)HashTableOperate(&pool->strings, str, htoAdd)) != NULL)
+    {
+      if(entry->key != NULL)
+      {
+        // the string is known already
+        POOLEDSTRING(entry->key)->refCount++;
+        result = entry->key;
+      }
+      else
+      {
+        size_t len = strlen(str);
+        struct PooledString *ps;
+
+        if((ps = malloc(offsetof(struct PooledString, string) + len + 1)) != NULL)
+        {
+          ps->refCount = 1;
+          memcpy(ps->string, str, len + 1);
+
+          entry->key = ps->string;
+          result = ps->string;
+        }
+        else
+        {
+          // remove the empty entry again
+          HashTableRawRemove(&pool->strings, &entry->header);
+        }
+      }
+    }
+
+    ReleaseSemaphore(pool->semaphore);
+
+    if(result == emptyString)
+      E(DBF_UTIL, "could not add string '%s' to string pool", str);
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReferenceString
+// add another reference to a string which was obtained by InternString()
+const char *ReferenceString(struct StringPool *pool, const char *str)
+{
+  ENTER();
+
+  if(str != NULL && str != emptyString)
+  {
+    ObtainSemaphore(pool->semaphore);
+    POOLEDSTRING(str)->refCount++;
+    ReleaseSemaphore(pool->semaphore);
+  }
+
+  RETURN(str);
+  return str;
+}
+
+///
+/// ReleaseString
+// drop one reference to a pooled string, the string will be removed
+// from the pool as soon as the last reference has been dropped
+void ReleaseString(struct StringPool *pool, const char *str)
+{
+  ENTER();
+
+  if(str != NULL && str != emptyString)
+  {
+    ObtainSemaphore(pool->semaphore);
+
+    if(--POOLEDSTRING(str)->refCount == 0)
+      HashTableOperate(&pool->strings, str, htoRemove);
+
+    ReleaseSemaphore(pool->semaphore);
+  }
+
+  LEAVE();
+}
+
+///
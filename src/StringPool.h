@@ -0,0 +1,52 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+
+#include "HashTable.h"
+
+// forward declarations
+struct SignalSemaphore;
+
+// a pool of reference counted strings. Each distinct string is stored
+// only once no matter how many users are referencing it. The pool may
+// be accessed from different threads concurrently.
+struct StringPool
+{
+  struct HashTable strings;          // string -> pooled string
+  struct SignalSemaphore *semaphore; // arbitration for concurrent accesses
+};
+
+struct StringPool *CreateStringPool(void);
+void DeleteStringPool(struct StringPool *pool);
+const char *InternString(struct StringPool *pool, const char *str);
+const char *ReferenceString(struct StringPool *pool, const char *str);
+void ReleaseString(struct StringPool *pool, const char *str);
+
+#endif /* STRINGPOOL_H */
@@ -0,0 +1,600 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ The thread trees are built following the ideas of Jamie Zawinski's
+ threading algorithm (http://www.jwz.org/doc/threading.html). Each mail
+ is represented by a node, which is linked to the node of its parent as
+ given by the References: or In-Reply-To: headers. Referenced mails which
+ are not part of the folder are represented by empty placeholder nodes,
+ so mails are threaded correctly even if intermediate mails are missing.
+
+ The parent and the root of a mail's thread are stored in the folder
+ index as compressed message IDs, thus a tree can be built without
+ reading any mail file. As placeholders are filled as soon as the
+ referenced mail arrives, mails can be added and removed incrementally.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <clib/alib_protos.h>
+#include <proto/exec.h>
+
+#include "extrasrc.h"
+
+#include "YAM_folderconfig.h"
+#include "YAM_mainFolder.h"
+#include "YAM_utilities.h"
+
+#include "MailList.h"
+#include "ThreadTree.h"
+
+#include "Debug.h"
+
+// an entry of the two hash tables of a tree, the layout of the first
+// two members must match struct HashEntry to use the default operators
+struct ThreadHashEntry
+{
+  struct HashEntryHeader hash; // a standard hash entry header
+  const void *key;             // the compressed message ID or the mail
+  struct ThreadNode *node;     // the node belonging to the key
+};
+
+/*** Private functions ***/
+/// LookupNode
+// find the node for a key in one of the hash tables
+static struct ThreadNode *LookupNode(struct HashTable *table, const void *key)
+{
+  struct ThreadNode *node = NULL;
+  struct HashEntryHeader *entry;
+
+  ENTER();
+
+  if((entry = HashTableOperate(table, key, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
+    node = ((struct ThreadHashEntry *)entry)->node;
+
+  RETURN(node);
+  return node;
+}
+
+///
+/// AddNodeToTable
+// register a node for a key in one of the hash tables
+static BOOL AddNodeToTable(struct HashTable *table, const void *key, struct ThreadNode *node)
+{
+  BOOL success = FALSE;
+  struct ThreadHashEntry *entry;
+
+  ENTER();
+
+  if((entry = (struct ThreadHashEntry *)HashTableOperate(table, key, htoAdd)) != NULL)
+  {
+    entry->key = key;
+    entry->node = node;
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// LinkNode
+// append a node to the children of a parent node or to the thread roots
+static void LinkNode(struct ThreadTree *tree, struct ThreadNode *node, struct ThreadNode *parent)
+{
+  struct ThreadNode **first;
+  struct ThreadNode **last;
+
+  ENTER();
+
+  if(parent != NULL)
+  {
+    first = &parent->children;
+    last = &parent->lastChild;
+  }
+  else
+  {
+    first = &tree->roots;
+    last = &tree->lastRoot;
+  }
+
+  node->parent = parent;
+  node->next = NULL;
+  node->prev = *last;
+
+  if(*last != NULL)
+    (*last)->next = node;
+  else
+    *first = node;
+
+  *last = node;
+
+  LEAVE();
+}
+
+///
+/// UnlinkNode
+// remove a node from the children of its parent or from the thread roots
+static void UnlinkNode(struct ThreadTree *tree, struct ThreadNode *node)
+{
+  struct ThreadNode *parent = node->parent;
+
+  ENTER();
+
+  if(node->prev != NULL)
+    node->prev->next = node->next;
+  else if(parent != NULL)
+    parent->children = node->next;
+  else
+    tree->roots = node->next;
+
+  if(node->next != NULL)
+    node->next->prev = node->prev;
+  else if(parent != NULL)
+    parent->lastChild = node->prev;
+  else
+    tree->lastRoot = node->prev;
+
+  node->parent = NULL;
+  node->next = NULL;
+  node->prev = NULL;
+
+  LEAVE();
+}
+
+///
+/// IsDescendant
+// check whether a node is the given ancestor itself or one of its descendants
+static BOOL IsDescendant(const struct ThreadNode *node, const struct ThreadNode *ancestor)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  while(node != NULL)
+  {
+    if(node == ancestor)
+    {
+      result = TRUE;
+      break;
+    }
+
+    node = node->parent;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// CreateNode
+// create a new node as a thread root and register it for the given
+// message ID, if it is not taken by another node yet
+static struct ThreadNode *CreateNode(struct ThreadTree *tree, const ULONG msgID)
+{
+  struct ThreadNode *node;
+
+  ENTER();
+
+  if((node = calloc(1, sizeof(*node))) != NULL)
+  {
+    node->msgID = msgID;
+
+    if(msgID != 0 && LookupNode(&tree->ids, (const void *)msgID) == NULL)
+    {
+      if(AddNodeToTable(&tree->ids, (const void *)msgID, node) == TRUE)
+        node->hashed = TRUE;
+      else
+      {
+        free(node);
+        node = NULL;
+      }
+    }
+
+    if(node != NULL)
+    {
+      AddTail((struct List *)&tree->nodes, (struct Node *)&node->node);
+      LinkNode(tree, node, NULL);
+    }
+  }
+
+  RETURN(node);
+  return node;
+}
+
+///
+/// GetIDNode
+// find the node of a message ID, a placeholder is created if necessary
+static struct ThreadNode *GetIDNode(struct ThreadTree *tree, const ULONG msgID)
+{
+  struct ThreadNode *node;
+
+  ENTER();
+
+  if((node = LookupNode(&tree->ids, (const void *)msgID)) == NULL)
+    node = CreateNode(tree, msgID);
+
+  RETURN(node);
+  return node;
+}
+
+///
+/// FreeUnusedNodes
+// free a node and all its ancestors which are neither needed for a mail
+// nor to hold the thread together anymore
+static void FreeUnusedNodes(struct ThreadTree *tree, struct ThreadNode *node)
+{
+  ENTER();
+
+  while(node != NULL && node->mail == NULL && node->children == NULL)
+  {
+    struct ThreadNode *parent = node->parent;
+
+    UnlinkNode(tree, node);
+    Remove((struct Node *)&node->node);
+
+    if(node->hashed == TRUE)
+      HashTableOperate(&tree->ids, (const void *)node->msgID, htoRemove);
+
+    free(node);
+
+    node = parent;
+  }
+
+  LEAVE();
+}
+
+///
+/// InsertMail
+// insert a single mail into a tree
+static BOOL InsertMail(struct ThreadTree *tree, struct Mail *mail)
+{
+  BOOL success = FALSE;
+  struct ThreadNode *node = NULL;
+
+  ENTER();
+
+  // fill an existing placeholder for this mail, otherwise create a new node
+  if(mail->cMsgID != 0 && (node = LookupNode(&tree->ids, (const void *)mail->cMsgID)) != NULL && node->mail != NULL)
+  {
+    // a duplicate message ID, this mail gets a node on its own
+    node = NULL;
+  }
+
+  if(node != NULL || (node = CreateNode(tree, mail->cMsgID)) != NULL)
+  {
+    node->mail = mail;
+
+    if(AddNodeToTable(&tree->mails, mail, node) == TRUE)
+    {
+      // index files of older versions don't know the parent
+      ULONG parentID = (mail->cParentMsgID != 0) ? mail->cParentMsgID : mail->cIRTMsgID;
+
+      success = TRUE;
+
+      if(parentID != 0 && parentID != mail->cMsgID)
+      {
+        struct ThreadNode *parent;
+
+        if((parent = GetIDNode(tree, parentID)) != NULL)
+        {
+          // hook a still unlinked parent into the thread's root, the
+          // intermediate mails are unknown
+          if(mail->cRootMsgID != 0 && mail->cRootMsgID != parentID && mail->cRootMsgID != mail->cMsgID && parent->parent == NULL)
+          {
+            struct ThreadNode *root;
+
+            if((root = GetIDNode(tree, mail->cRootMsgID)) != NULL)
+            {
+              if(IsDescendant(root, parent) == FALSE)
+              {
+                UnlinkNode(tree, parent);
+                LinkNode(tree, parent, root);
+              }
+            }
+            else
+              success = FALSE;
+          }
+
+          // the mail's own references always have priority, but we must
+          // not create any loops
+          if(success == TRUE && parent != node->parent && IsDescendant(parent, node) == FALSE)
+          {
+            struct ThreadNode *oldParent = node->parent;
+
+            UnlinkNode(tree, node);
+            LinkNode(tree, node, parent);
+
+            // the previous parent might not be needed anymore
+            FreeUnusedNodes(tree, oldParent);
+          }
+        }
+        else
+          success = FALSE;
+      }
+    }
+    else
+    {
+      node->mail = NULL;
+      FreeUnusedNodes(tree, node);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// BuildThreadTree
+// create the thread tree of all mails of a folder, the folder's mail
+// list must be locked by the caller
+static BOOL BuildThreadTree(struct Folder *folder)
+{
+  BOOL success = FALSE;
+  struct ThreadTree *tree;
+
+  ENTER();
+
+  if((tree = calloc(1, sizeof(*tree))) != NULL)
+  {
+    ULONG capacity = (folder->Total > 0) ? folder->Total : 64;
+
+    NewMinList(&tree->nodes);
+
+    if(HashTableInit(&tree->ids, HashTableGetDefaultOps(), NULL, sizeof(struct ThreadHashEntry), capacity) == TRUE)
+    {
+      if(HashTableInit(&tree->mails, HashTableGetDefaultOps(), NULL, sizeof(struct ThreadHashEntry), capacity) == TRUE)
+      {
+        struct MailNode *mnode;
+
+        success = TRUE;
+
+        // the tree must be set first, because DeleteThreadTree()
+        // needs it in case of an error
+        folder->threadTree = tree;
+
+        ForEachMailNode(folder->messages, mnode)
+        {
+          if(InsertMail(tree, mnode->mail) == FALSE)
+          {
+            success = FALSE;
+            break;
+          }
+        }
+
+        if(success == TRUE)
+          D(DBF_FOLDER, "built thread tree of folder '%s' with %ld IDs", folder->Name, tree->ids.entryCount);
+        else
+          DeleteThreadTree(folder);
+      }
+      else
+      {
+        HashTableCleanup(&tree->ids);
+        free(tree);
+      }
+    }
+    else
+      free(tree);
+
+    if(success == FALSE)
+      E(DBF_FOLDER, "could not build thread tree of folder '%s'", folder->Name);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// FirstMailBelow
+// find the first mail in the subtree of a node in depth-first order
+static struct Mail *FirstMailBelow(const struct ThreadNode *top)
+{
+  struct Mail *mail = NULL;
+  const struct ThreadNode *node = top->children;
+
+  ENTER();
+
+  while(node != NULL)
+  {
+    if(node->mail != NULL)
+    {
+      mail = node->mail;
+      break;
+    }
+
+    if(node->children != NULL)
+    {
+      // descend into the placeholder's children
+      node = node->children;
+    }
+    else
+    {
+      // continue with the next sibling of the node or of one of its
+      // ancestors below the top node
+      while(node != top && node->next == NULL)
+        node = node->parent;
+
+      node = (node != top) ? node->next : NULL;
+    }
+  }
+
+  RETURN(mail);
+  return mail;
+}
+
+///
+
+/*** Public functions ***/
+/// AddMailToThreadTree
+// add a mail to the folder's thread tree, the folder's mail list must
+// be locked by the caller
+void AddMailToThreadTree(struct Folder *folder, struct Mail *mail)
+{
+  ENTER();
+
+  // nothing to do if the tree has not been built yet, it will
+  // include this mail once it is needed
+  if(folder->threadTree != NULL)
+  {
+    // drop an incomplete tree, it will be rebuilt on demand
+    if(InsertMail(folder->threadTree, mail) == FALSE)
+      DeleteThreadTree(folder);
+  }
+
+  LEAVE();
+}
+
+///
+/// RemoveMailFromThreadTree
+// remove a mail from the folder's thread tree, the folder's mail list
+// must be locked by the caller
+void RemoveMailFromThreadTree(struct Folder *folder, const struct Mail *mail)
+{
+  struct ThreadTree *tree = folder->threadTree;
+
+  ENTER();
+
+  if(tree != NULL)
+  {
+    struct ThreadNode *node;
+
+    if((node = LookupNode(&tree->mails, mail)) != NULL)
+    {
+      HashTableOperate(&tree->mails, mail, htoRemove);
+
+      // the node stays as a placeholder as long as it has any children
+      node->mail = NULL;
+      FreeUnusedNodes(tree, node);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// DeleteThreadTree
+// free the folder's thread tree
+void DeleteThreadTree(struct Folder *folder)
+{
+  struct ThreadTree *tree = folder->threadTree;
+
+  ENTER();
+
+  if(tree != NULL)
+  {
+    struct ThreadNode *node;
+    struct ThreadNode *next;
+
+    SafeIterateList(&tree->nodes, struct ThreadNode *, node, next)
+    {
+      free(node);
+    }
+
+    HashTableCleanup(&tree->ids);
+    HashTableCleanup(&tree->mails);
+    free(tree);
+
+    folder->threadTree = NULL;
+  }
+
+  LEAVE();
+}
+
+///
+/// GetThreadTree
+// get the thread tree of a folder, it is built on first use. The
+// folder's mail list must be locked exclusively by the caller.
+struct ThreadTree *GetThreadTree(struct Folder *folder)
+{
+  ENTER();
+
+  if(folder->threadTree == NULL)
+    BuildThreadTree(folder);
+
+  RETURN(folder->threadTree);
+  return folder->threadTree;
+}
+
+///
+/// FindThreadTreeMail
+// find the next (first answer) or previous (question) mail of a mail's
+// thread within a folder. The mail itself may belong to another folder.
+// The folder's mail list must be locked exclusively by the caller.
+struct Mail *FindThreadTreeMail(struct Folder *folder, const struct Mail *srcMail, const BOOL nextThread)
+{
+  struct Mail *result = NULL;
+  struct ThreadTree *tree;
+
+  ENTER();
+
+  if((tree = GetThreadTree(folder)) != NULL)
+  {
+    struct ThreadNode *node;
+
+    // the mail is either part of this folder or it might be
+    // represented by a placeholder
+    if((node = LookupNode(&tree->mails, srcMail)) == NULL && srcMail->cMsgID != 0)
+      node = LookupNode(&tree->ids, (const void *)srcMail->cMsgID);
+
+    if(nextThread == TRUE)
+    {
+      // find the first answer to the srcMail
+      if(node != NULL)
+        result = FirstMailBelow(node);
+    }
+    else
+    {
+      // find the question to the srcMail
+      if(node != NULL)
+        node = node->parent;
+      else
+      {
+        ULONG parentID = (srcMail->cParentMsgID != 0) ? srcMail->cParentMsgID : srcMail->cIRTMsgID;
+
+        if(parentID != 0)
+          node = LookupNode(&tree->ids, (const void *)parentID);
+
+        if(node == NULL && srcMail->cRootMsgID != 0)
+          node = LookupNode(&tree->ids, (const void *)srcMail->cRootMsgID);
+      }
+
+      // skip all placeholders for mails not being part of this folder
+      while(node != NULL && node->mail == NULL)
+        node = node->parent;
+
+      if(node != NULL)
+        result = node->mail;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
@@ -0,0 +1,72 @@
+#ifndef THREADTREE_H
+#define THREADTREE_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/lists.h>
+#include <exec/nodes.h>
+
+#include "HashTable.h"
+
+// forward declarations
+struct Folder;
+struct Mail;
+
+// a single node of a thread tree. Nodes without a mail are placeholders
+// for mails which are referenced by other mails, but which are not part
+// of the folder (i.e. they were deleted or moved to another folder).
+struct ThreadNode
+{
+  struct MinNode node;             // to be part of the list of all nodes
+  struct ThreadNode *parent;       // the parent node, NULL for the root of a thread
+  struct ThreadNode *children;     // the first child node
+  struct ThreadNode *lastChild;    // the last child node
+  struct ThreadNode *next;         // the next sibling
+  struct ThreadNode *prev;         // the previous sibling
+  struct Mail *mail;               // the mail or NULL for a placeholder
+  ULONG msgID;                     // the compressed message ID of the mail
+  BOOL hashed;                     // is the node registered for its message ID?
+};
+
+// the thread forest of a folder
+struct ThreadTree
+{
+  struct HashTable ids;            // compressed message ID -> node
+  struct HashTable mails;          // mail -> node
+  struct MinList nodes;            // list of all nodes
+  struct ThreadNode *roots;        // the first thread root
+  struct ThreadNode *lastRoot;     // the last thread root
+};
+
+void AddMailToThreadTree(struct Folder *folder, struct Mail *mail);
+void RemoveMailFromThreadTree(struct Folder *folder, const struct Mail *mail);
+void DeleteThreadTree(struct Folder *folder);
+struct ThreadTree *GetThreadTree(struct Folder *folder);
+struct Mail *FindThreadTreeMail(struct Folder *folder, const struct Mail *srcMail, const BOOL nextThread);
+
+#endif /* THREADTREE_H */
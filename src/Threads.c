@@ -55,6 +55,7 @@
 #endif
 
 #include "YAM.h"
+#include "YAM_mainFolder.h"
 #include "YAM_utilities.h"
 
 #include "SDI_stdarg.h"
@@ -64,12 +65,14 @@
 #include "Locale.h"
 #include "MailExport.h"
 #include "MailImport.h"
+#include "MailServers.h"
 #include "MethodStack.h"
 #include "Requesters.h"
 #include "Threads.h"
 
 #include "mui/ClassesExtra.h"
 #include "tcp/http.h"
+#include "tcp/imap.h"
 #include "tcp/pop3.h"
 #include "tcp/smtp.h"
 
@@ -249,9 +252,21 @@ static LONG DoThreadMessage(struct ThreadMessage *msg)
 
     case TA_ReceiveMails:
     {
-      result = ReceiveMails((struct MailServerNode *)GetTagData(TT_ReceiveMails_MailServer, (IPTR)NULL, msg->actionTags),
-                            GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
-                            (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      struct MailServerNode *msn = (struct MailServerNode *)GetTagData(TT_ReceiveMails_MailServer, (IPTR)NULL, msg->actionTags);
+
+      // IMAP accounts share the POP3 account list, but use their own protocol
+      if(msn != NULL && hasServerIMAP(msn))
+      {
+        result = ReceiveMailsIMAP(msn,
+                                  GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
+                                  (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      }
+      else
+      {
+        result = ReceiveMails(msn,
+                              GetTagData(TT_ReceiveMails_Flags, 0, msg->actionTags),
+                              (struct DownloadResult *)GetTagData(TT_ReceiveMails_Result, (IPTR)NULL, msg->actionTags));
+      }
     }
     break;
 
@@ -279,6 +294,12 @@ static LONG DoThreadMessage(struct ThreadMessage *msg)
                            GetTagData(TT_DownloadURL_Flags, 0, msg->actionTags));
     }
     break;
+
+    case TA_ExamineMails:
+    {
+      result = ExamineMailFiles((struct FolderScan *)GetTagData(TT_ExamineMails_Scan, (IPTR)NULL, msg->actionTags));
+    }
+    break;
   }
 
   D(DBF_THREAD, "thread '%s' finished action %ld, result %ld", msg->thread->name, msg->action, result);
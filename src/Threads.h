@@ -44,6 +44,7 @@ enum ThreadAction
   TA_ImportMails,
   TA_ExportMails,
   TA_DownloadURL,
+  TA_ExamineMails,
 };
 
 #define TT_Priority                                0xf001 // priority of the thread
@@ -74,6 +75,8 @@ enum ThreadAction
 #define TT_DownloadURL_Filename      (TAG_STRING | (TAG_USER + 3))
 #define TT_DownloadURL_Flags                       (TAG_USER + 4)
 
+#define TT_ExamineMails_Scan                       (TAG_USER + 1)
+
 /*** Thread system init/cleanup functions ***/
 BOOL InitThreads(void);
 void CleanupThreads(void);
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libraries/iffparse.h>
 #include <proto/dos.h>
 #if defined(__amigaos4__)
 #include <dos/obsolete.h>
@@ -45,6 +46,122 @@
 
 #include "Debug.h"
 
+// The UIDL database file starts with a header followed by any number of
+// segments. Each segment lists the fingerprints of the UIDLs which have
+// been added and removed during a single POP3 session, hence a session
+// appends its changes only. The first segment after a compaction contains
+// all known UIDLs in ascending order. This base segment is searched right
+// within the file's data, only the fingerprints of the following segments
+// and the fingerprints actually looked up are put into the hash table.
+struct UIDLFileHeader
+{
+  ULONG ID; // UIDL_FILE_VER
+};
+
+struct UIDLSegment
+{
+  ULONG numAdded;   // number of added fingerprints following this header
+  ULONG numRemoved; // number of removed fingerprints following the added ones
+};
+
+#define UIDL_FILE_VER (MAKE_ID('Y','U','D','1'))
+
+// number of outdated records we accept in addition to the number of
+// current UIDLs before the file is compacted
+#define UIDL_COMPACT_SLACK 1024
+
+/// GetUIDLFingerprint
+// calculate a 64 bit fingerprint of an UIDL by two independent 32 bit hashes,
+// FNV-1a and Jenkins' one-at-a-time hash
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static void GetUIDLFingerprint(const char *uidl, ULONG fingerprint[2])
+{
+  ULONG fnv = 0x811c9dc5UL;
+  ULONG oat = 0;
+  const unsigned char *s;
+
+  for(s = (const unsigned char *)uidl; *s != '\0'; s++)
+  {
+    fnv = (fnv ^ *s) * 0x01000193UL;
+
+    oat += *s;
+    oat += (oat << 10);
+    oat ^= (oat >> 6);
+  }
+
+  oat += (oat << 3);
+  oat ^= (oat >> 11);
+  oat += (oat << 15);
+
+  fingerprint[0] = fnv;
+  fingerprint[1] = oat;
+}
+
+///
+
+/*** Hash table operators ***/
+/// UIDLHashGetKey
+//
+static const void *UIDLHashGetKey(UNUSED struct HashTable *table, const struct HashEntryHeader *entry)
+{
+  const struct UIDLtoken *token = (const struct UIDLtoken *)entry;
+  const void *result;
+
+  ENTER();
+
+  result = (const void *)token->fingerprint;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// UIDLHashHashKey
+// the fingerprints are hash values already, hence they can be used directly
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static ULONG UIDLHashHashKey(UNUSED struct HashTable *table, const void *key)
+{
+  return ((const ULONG *)key)[0];
+}
+
+///
+/// UIDLHashMatchEntry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static BOOL UIDLHashMatchEntry(UNUSED struct HashTable *table, const struct HashEntryHeader *entry, const void *key)
+{
+  const struct UIDLtoken *token = (const struct UIDLtoken *)entry;
+  const ULONG *fingerprint = (const ULONG *)key;
+
+  return (token->fingerprint[0] == fingerprint[0] && token->fingerprint[1] == fingerprint[1]);
+}
+
+///
+/// GetUIDLHashOps
+//
+static const struct HashTableOps *GetUIDLHashOps(void)
+{
+  static const struct HashTableOps uidlHashOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    UIDLHashGetKey,
+    UIDLHashHashKey,
+    UIDLHashMatchEntry,
+    DefaultHashMoveEntry,
+    DefaultHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    NULL
+  };
+
+  ENTER();
+  RETURN(&uidlHashOps);
+  return &uidlHashOps;
+}
+
+///
+
+/*** Private functions ***/
 /// BuildUIDLFilename
 // set up a name for a UIDL file to be accessed
 static void BuildUIDLFilename(const struct MailServerNode *msn, char *uidlPath, const size_t uidlPathSize)
@@ -73,6 +190,383 @@ static void BuildUIDLFilename(const struct MailServerNode *msn, char *uidlPath,
 }
 
 ///
+/// CompareFingerprints
+// compare two fingerprints, used to sort and to search the base segment
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static int CompareFingerprints(const void *p1, const void *p2)
+{
+  const ULONG *f1 = (const ULONG *)p1;
+  const ULONG *f2 = (const ULONG *)p2;
+  int result;
+
+  if(f1[0] != f2[0])
+    result = (f1[0] < f2[0]) ? -1 : 1;
+  else if(f1[1] != f2[1])
+    result = (f1[1] < f2[1]) ? -1 : 1;
+  else
+    result = 0;
+
+  return result;
+}
+
+///
+/// TakeBaseFingerprint
+// look up a fingerprint in the base segment and mark it as taken, returns
+// TRUE if the fingerprint is part of the base segment and was not taken before
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static BOOL TakeBaseFingerprint(const struct UIDLhash *uidlHash, const ULONG fingerprint[2])
+{
+  BOOL result = FALSE;
+
+  if(uidlHash->base != NULL)
+  {
+    const ULONG *found;
+
+    if((found = bsearch(fingerprint, uidlHash->base, uidlHash->numBase, 2*sizeof(ULONG), CompareFingerprints)) != NULL)
+    {
+      ULONG index = (found - uidlHash->base) / 2;
+
+      if(uidlHash->baseTaken[index] == FALSE)
+      {
+        uidlHash->baseTaken[index] = TRUE;
+        result = TRUE;
+      }
+    }
+  }
+
+  return result;
+}
+
+///
+/// CountBaseFingerprints
+// count the fingerprints of the base segment which have not been taken
+static ULONG CountBaseFingerprints(const struct UIDLhash *uidlHash)
+{
+  ULONG count = 0;
+  ULONG i;
+
+  ENTER();
+
+  for(i = 0; i < uidlHash->numBase; i++)
+  {
+    if(uidlHash->baseTaken[i] == FALSE)
+      count++;
+  }
+
+  RETURN(count);
+  return count;
+}
+
+///
+/// InsertFingerprint
+// add a fingerprint to the hash table or update the flags of an existing entry
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static struct UIDLtoken *InsertFingerprint(struct HashTable *hash, const ULONG fingerprint[2], const ULONG flags)
+{
+  struct UIDLtoken *token;
+
+  if((token = (struct UIDLtoken *)HashTableOperate(hash, fingerprint, htoAdd)) != NULL)
+  {
+    token->fingerprint[0] = fingerprint[0];
+    token->fingerprint[1] = fingerprint[1];
+    token->flags |= flags;
+  }
+
+  return token;
+}
+
+///
+/// AddFingerprint
+// add a fingerprint to the hash or update the flags of an existing entry, a
+// fingerprint of the base segment is moved to the hash as a known one
+// no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+static struct UIDLtoken *AddFingerprint(struct UIDLhash *uidlHash, const ULONG fingerprint[2], ULONG flags)
+{
+  if(TakeBaseFingerprint(uidlHash, fingerprint) == TRUE)
+    setFlag(flags, UIDLF_OLD);
+
+  return InsertFingerprint(uidlHash->hash, fingerprint, flags);
+}
+
+///
+/// IsSortedSegment
+// check whether the fingerprints of a segment are in strictly ascending order
+static BOOL IsSortedSegment(const ULONG *fingerprint, const ULONG num)
+{
+  BOOL sorted = TRUE;
+  ULONG i;
+
+  ENTER();
+
+  for(i = 1; i < num; i++, fingerprint += 2)
+  {
+    if(CompareFingerprints(fingerprint, fingerprint + 2) >= 0)
+    {
+      sorted = FALSE;
+      break;
+    }
+  }
+
+  RETURN(sorted);
+  return sorted;
+}
+
+///
+/// LoadUIDLDatabase
+// load all segments of a binary UIDL database which has been read into memory,
+// a sorted first segment is used in place as base segment. Returns TRUE if the
+// data is referenced by the base segment and must be kept.
+static BOOL LoadUIDLDatabase(struct UIDLhash *uidlHash, const char *data, const LONG size)
+{
+  const char *ptr = data + sizeof(struct UIDLFileHeader);
+  const char *end = data + size;
+
+  ENTER();
+
+  while(ptr < end)
+  {
+    struct UIDLSegment seg;
+    const ULONG *fingerprint;
+    ULONG i;
+
+    // a segment which was not written completely is ignored, the file
+    // will be rewritten on the next save
+    if((size_t)(end - ptr) < sizeof(seg))
+    {
+      W(DBF_UIDL, "truncated segment header found");
+      uidlHash->compact = TRUE;
+      break;
+    }
+
+    memcpy(&seg, ptr, sizeof(seg));
+    ptr += sizeof(seg);
+
+    if(seg.numAdded > (ULONG)(end - ptr) / (2*sizeof(ULONG)) ||
+       seg.numRemoved > (ULONG)(end - ptr) / (2*sizeof(ULONG)) - seg.numAdded)
+    {
+      W(DBF_UIDL, "truncated segment found, %ld added, %ld removed", seg.numAdded, seg.numRemoved);
+      uidlHash->compact = TRUE;
+      break;
+    }
+
+    fingerprint = (const ULONG *)ptr;
+
+    // the first segment of a compacted file doesn't need to be hashed, it
+    // is searched in place instead
+    if(ptr == data + sizeof(struct UIDLFileHeader) + sizeof(seg) &&
+       seg.numAdded > 0 && seg.numRemoved == 0 &&
+       IsSortedSegment(fingerprint, seg.numAdded) == TRUE &&
+       (uidlHash->baseTaken = calloc(seg.numAdded, sizeof(*uidlHash->baseTaken))) != NULL)
+    {
+      uidlHash->base = fingerprint;
+      uidlHash->numBase = seg.numAdded;
+      fingerprint += 2 * seg.numAdded;
+    }
+    else
+    {
+      for(i = 0; i < seg.numAdded; i++, fingerprint += 2)
+        AddFingerprint(uidlHash, fingerprint, UIDLF_OLD);
+    }
+
+    for(i = 0; i < seg.numRemoved; i++, fingerprint += 2)
+    {
+      struct HashEntryHeader *entry;
+
+      if((entry = HashTableOperate(uidlHash->hash, fingerprint, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
+        HashTableRawRemove(uidlHash->hash, entry);
+      else
+        TakeBaseFingerprint(uidlHash, fingerprint);
+    }
+
+    uidlHash->fileRecords += seg.numAdded + seg.numRemoved;
+    ptr = (const char *)fingerprint;
+  }
+
+  RETURN((uidlHash->base != NULL));
+  return (uidlHash->base != NULL);
+}
+
+///
+/// LoadUIDLTextFile
+// load the UIDLs of an old style text file line by line
+static void LoadUIDLTextFile(struct UIDLhash *uidlHash, FILE *fh, const char *uidlPath, const BOOL oldUIDLFile)
+{
+  char *uidl = NULL;
+  size_t uidlLen = 0;
+  BOOL validFile = FALSE;
+
+  ENTER();
+
+  setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+  if(oldUIDLFile == TRUE)
+  {
+    // old UIDL files are considered to be always valid
+    validFile = TRUE;
+  }
+  else
+  {
+    // text UIDL files must contain the usual header
+    if(GetLine(&uidl, &uidlLen, fh) >= 0 && strncmp(uidl, "UIDL", 4) == 0)
+      validFile = TRUE;
+  }
+
+  if(validFile == TRUE)
+  {
+    // add all read UIDLs to the hash marking them as OLD
+    while(GetLine(&uidl, &uidlLen, fh) >= 0)
+    {
+      ULONG fingerprint[2];
+
+      GetUIDLFingerprint(uidl, fingerprint);
+      AddFingerprint(uidlHash, fingerprint, UIDLF_OLD);
+    }
+  }
+  else
+    W(DBF_UIDL, "file '%s' is no valid UIDL database file", uidlPath);
+
+  free(uidl);
+
+  LEAVE();
+}
+
+///
+/// CollectUIDLtoken
+// HashTable callback function to collect the fingerprints of a compacted database
+struct CollectUIDLData
+{
+  ULONG *fingerprints; // the collected fingerprints
+  ULONG count;         // the number of collected fingerprints
+  ULONG mask;          // the flags to be checked
+  ULONG value;         // the required state of the checked flags
+};
+
+static enum HashTableOperator CollectUIDLtoken(UNUSED struct HashTable *table,
+                                               struct HashEntryHeader *entry,
+                                               UNUSED ULONG number,
+                                               void *arg)
+{
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+  struct CollectUIDLData *data = (struct CollectUIDLData *)arg;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if((token->flags & data->mask) == data->value)
+  {
+    data->fingerprints[2*data->count+0] = token->fingerprint[0];
+    data->fingerprints[2*data->count+1] = token->fingerprint[1];
+    data->count++;
+  }
+
+  return htoNext;
+}
+
+///
+/// WriteUIDLDatabase
+// rewrite the database file with a single sorted segment holding all
+// fingerprints with matching flags, the untaken fingerprints of the base
+// segment count as old ones. The new file is written under a temporary
+// name first and replaces the database only if it was written completely.
+static BOOL WriteUIDLDatabase(struct UIDLhash *uidlHash, const char *uidlPath, const ULONG mask, const ULONG value)
+{
+  BOOL success = FALSE;
+  struct CollectUIDLData data;
+  ULONG max = uidlHash->hash->entryCount + uidlHash->numBase;
+
+  ENTER();
+
+  // we need at least one entry to avoid a zero sized allocation
+  if((data.fingerprints = malloc((max > 0 ? max : 1) * 2 * sizeof(ULONG))) != NULL)
+  {
+    char tmpPath[SIZE_PATHFILE];
+    FILE *fh;
+
+    data.count = 0;
+    data.mask = mask;
+    data.value = value;
+    HashTableEnumerate(uidlHash->hash, CollectUIDLtoken, &data);
+
+    if((UIDLF_OLD & mask) == value)
+    {
+      ULONG i;
+
+      for(i = 0; i < uidlHash->numBase; i++)
+      {
+        if(uidlHash->baseTaken[i] == FALSE)
+        {
+          data.fingerprints[2*data.count+0] = uidlHash->base[2*i+0];
+          data.fingerprints[2*data.count+1] = uidlHash->base[2*i+1];
+          data.count++;
+        }
+      }
+    }
+
+    // the base segment of the next session must be sorted
+    qsort(data.fingerprints, data.count, 2*sizeof(ULONG), CompareFingerprints);
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", uidlPath);
+
+    if((fh = fopen(tmpPath, "w")) != NULL)
+    {
+      struct UIDLFileHeader header;
+      struct UIDLSegment seg;
+
+      setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+      header.ID = UIDL_FILE_VER;
+      seg.numAdded = data.count;
+      seg.numRemoved = 0;
+
+      if(fwrite(&header, sizeof(header), 1, fh) == 1 &&
+         fwrite(&seg, sizeof(seg), 1, fh) == 1 &&
+         (data.count == 0 || fwrite(data.fingerprints, 2*sizeof(ULONG), data.count, fh) == data.count))
+      {
+        success = TRUE;
+      }
+
+      if(fclose(fh) != 0)
+        success = FALSE;
+
+      // Rename() doesn't replace existing files, hence the old database must
+      // be deleted first. Should anything fail inbetween, the complete file
+      // is picked up again by InitUIDLhash()
+      if(success == TRUE)
+      {
+        DeleteFile(uidlPath);
+
+        if(Rename(tmpPath, uidlPath) == DOSFALSE)
+        {
+          E(DBF_UIDL, "couldn't rename '%s' to '%s'", tmpPath, uidlPath);
+          success = FALSE;
+        }
+      }
+      else
+      {
+        E(DBF_UIDL, "couldn't write to '%s'", tmpPath);
+        DeleteFile(tmpPath);
+      }
+
+      if(success == TRUE)
+      {
+        D(DBF_UIDL, "rewrote UIDL database '%s' with %ld UIDLs", uidlPath, data.count);
+
+        uidlHash->fileRecords = data.count;
+        uidlHash->compact = FALSE;
+      }
+    }
+    else
+      E(DBF_UIDL, "couldn't open '%s' for writing", tmpPath);
+
+    free(data.fingerprints);
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+
+/*** Public functions ***/
 /// InitUIDLhash
 // Initialize the UIDL list and load it from the .uidl file
 struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
@@ -81,18 +575,32 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
 
   ENTER();
 
-  if((uidlHash = malloc(sizeof(*uidlHash))) != NULL)
+  if((uidlHash = calloc(1, sizeof(*uidlHash))) != NULL)
   {
     // allocate a new hashtable for managing the UIDL data
-    if((uidlHash->hash = HashTableNew(HashTableGetDefaultStringOps(), NULL, sizeof(struct UIDLtoken), 512)) != NULL)
+    if((uidlHash->hash = HashTableNew(GetUIDLHashOps(), NULL, sizeof(struct UIDLtoken), 512)) != NULL)
     {
       char uidlPath[SIZE_PATHFILE];
       LONG size;
       FILE *fh = NULL;
       BOOL oldUIDLFile = FALSE;
 
+      // anything but a valid binary database is rewritten completely upon cleanup
+      uidlHash->compact = TRUE;
+
       // try to access the account specific .uidl file first
       BuildUIDLFilename(msn, uidlPath, sizeof(uidlPath));
+      if(FileExists(uidlPath) == FALSE)
+      {
+        char tmpPath[SIZE_PATHFILE];
+
+        // a compaction might have been interrupted after the old database was
+        // deleted, but the new one is complete already
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", uidlPath);
+        if(FileExists(tmpPath) == TRUE && Rename(tmpPath, uidlPath) != DOSFALSE)
+          W(DBF_UIDL, "recovered UIDL database file '%s'", tmpPath);
+      }
+
       if(ObtainFileInfo(uidlPath, FI_SIZE, &size) == TRUE && size > 0)
       {
         fh = fopen(uidlPath, "r");
@@ -112,39 +620,61 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
 
       if(fh != NULL)
       {
-        // now read in the UIDL/MsgIDs line-by-line
-        char *uidl = NULL;
-        size_t uidlLen = 0;
-        BOOL validFile = FALSE;
+        struct UIDLFileHeader header;
 
         D(DBF_UIDL, "opened UIDL database file '%s'", uidlPath);
 
-        setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
-
-        if(oldUIDLFile == TRUE)
+        if(oldUIDLFile == FALSE && (size_t)size >= sizeof(header) &&
+           fread(&header, sizeof(header), 1, fh) == 1 && header.ID == UIDL_FILE_VER)
         {
-          // old UIDL files are considered to be always valid
-          validFile = TRUE;
+          char *data;
+
+          // read the complete binary database at once and process it in memory
+          if((data = malloc(size)) != NULL)
+          {
+            memcpy(data, &header, sizeof(header));
+
+            if((size_t)size == sizeof(header) || fread(&data[sizeof(header)], size - sizeof(header), 1, fh) == 1)
+            {
+              uidlHash->compact = FALSE;
+
+              // the base segment is searched within the data
+              if(LoadUIDLDatabase(uidlHash, data, size) == TRUE)
+              {
+                uidlHash->data = data;
+                data = NULL;
+              }
+            }
+            else
+              E(DBF_UIDL, "couldn't read UIDL database file '%s'", uidlPath);
+
+            free(data);
+          }
         }
         else
         {
-          // new UIDL files must contain the usual header
-          if(GetLine(&uidl, &uidlLen, fh) >= 0 && strncmp(uidl, "UIDL", 4) == 0)
-            validFile = TRUE;
+          // this is a text file of an older version, start over
+          rewind(fh);
+          LoadUIDLTextFile(uidlHash, fh, uidlPath, oldUIDLFile);
         }
 
-        if(validFile == TRUE)
+        fclose(fh);
+
+        // compact the database right now instead of replaying all its segments
+        // again on every mail check until the end of the session
+        if(uidlHash->compact == FALSE &&
+           uidlHash->fileRecords > 2 * (uidlHash->hash->entryCount + CountBaseFingerprints(uidlHash)) + UIDL_COMPACT_SLACK)
         {
-          // add all read UIDLs to the hash marking them as OLD
-          while(GetLine(&uidl, &uidlLen, fh) >= 0)
-            AddUIDLtoHash(uidlHash, uidl, UIDLF_OLD);
+          D(DBF_UIDL, "too many outdated records, compacting UIDL database");
+          uidlHash->compact = TRUE;
         }
-        else
-          W(DBF_UIDL, "file '%s' is no valid UIDL database file", uidlPath);
-
-        fclose(fh);
 
-        free(uidl);
+        if(uidlHash->compact == TRUE)
+        {
+          // all known fingerprints are kept
+          BuildUIDLFilename(msn, uidlPath, sizeof(uidlPath));
+          WriteUIDLDatabase(uidlHash, uidlPath, 0, 0);
+        }
       }
       else
         W(DBF_UIDL, "UIDL database file '%s' does not exist", uidlPath);
@@ -155,6 +685,7 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
       uidlHash->isDirty = FALSE;
 
       SHOWVALUE(DBF_UIDL, uidlHash->hash->entryCount);
+      SHOWVALUE(DBF_UIDL, uidlHash->fileRecords);
     }
     else
     {
@@ -171,71 +702,178 @@ struct UIDLhash *InitUIDLhash(const struct MailServerNode *msn)
 }
 
 ///
-/// SaveUIDLtoken
-// HashTable callback function to save an UIDLtoken
-static enum HashTableOperator SaveUIDLtoken(UNUSED struct HashTable *table,
-                                            struct HashEntryHeader *entry,
-                                            UNUSED ULONG number,
-                                            void *arg)
+/// CountUIDLtokens
+// HashTable callback function to count the changes of the current session
+static enum HashTableOperator CountUIDLtokens(UNUSED struct HashTable *table,
+                                              struct HashEntryHeader *entry,
+                                              UNUSED ULONG number,
+                                              void *arg)
 {
   struct UIDLtoken *token = (struct UIDLtoken *)entry;
+  ULONG *counts = (ULONG *)arg;
 
-  ENTER();
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
   // Check whether the UIDL is a new one (received from the server), then we keep it.
   // Otherwise (OLD set, but not NEW) we skip it, because the mail belonging to this
   // UIDL does no longer exist on the server and we can forget about it.
   if(isFlagSet(token->flags, UIDLF_NEW))
   {
-    FILE *fh = (FILE *)arg;
+    counts[0]++;
 
-    fprintf(fh, "%s\n", token->uidl);
-    D(DBF_UIDL, "saved UIDL '%s' to .uidl file", token->uidl);
+    if(isFlagClear(token->flags, UIDLF_OLD))
+      counts[1]++;
   }
   else
-    D(DBF_UIDL, "outdated UIDL '%s' found and deleted", token->uidl);
+    counts[2]++;
 
-  RETURN(htoNext);
   return htoNext;
 }
 
 ///
-/// CleanupUIDLhash
-// Cleanup the whole UIDL hash
-void CleanupUIDLhash(struct UIDLhash *uidlHash)
+/// SaveUIDLtoken
+// HashTable callback function to save the fingerprint of an UIDLtoken
+struct SaveUIDLData
+{
+  FILE *fh;    // the database file
+  ULONG mask;  // the flags to be checked
+  ULONG value; // the required state of the checked flags
+  BOOL error;  // did a write operation fail?
+};
+
+static enum HashTableOperator SaveUIDLtoken(UNUSED struct HashTable *table,
+                                            struct HashEntryHeader *entry,
+                                            UNUSED ULONG number,
+                                            void *arg)
+{
+  struct UIDLtoken *token = (struct UIDLtoken *)entry;
+  struct SaveUIDLData *data = (struct SaveUIDLData *)arg;
+  enum HashTableOperator result = htoNext;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if((token->flags & data->mask) == data->value)
+  {
+    if(fwrite(token->fingerprint, sizeof(token->fingerprint), 1, data->fh) != 1)
+    {
+      data->error = TRUE;
+      result = htoStop;
+    }
+  }
+
+  return result;
+}
+
+///
+/// SaveUIDLhash
+// write the changes of the current session to the database file, either by
+// appending a new segment or by rewriting the file if it carries too many
+// outdated records
+static void SaveUIDLhash(struct UIDLhash *uidlHash)
 {
+  // [0] = current UIDLs, [1] = added UIDLs, [2] = removed UIDLs
+  ULONG counts[3] = { 0, 0, 0 };
+
   ENTER();
 
-  if(uidlHash != NULL)
+  HashTableEnumerate(uidlHash->hash, CountUIDLtokens, counts);
+
+  // the untaken fingerprints of the base segment have not been seen on the
+  // server during this session
+  counts[2] += CountBaseFingerprints(uidlHash);
+
+  D(DBF_UIDL, "%ld current UIDLs, %ld added, %ld removed, %ld records in file", counts[0], counts[1], counts[2], uidlHash->fileRecords);
+
+  if(uidlHash->compact == FALSE &&
+     uidlHash->fileRecords + counts[1] + counts[2] > 2 * counts[0] + UIDL_COMPACT_SLACK)
   {
-    if(uidlHash->hash != NULL)
+    D(DBF_UIDL, "too many outdated records, compacting UIDL database");
+    uidlHash->compact = TRUE;
+  }
+
+  if(uidlHash->compact == TRUE || counts[1] != 0 || counts[2] != 0)
+  {
+    char uidlPath[SIZE_PATHFILE];
+
+    // we are saving account specific .uidl files only, the old one will be kept
+    // in case it still contains UIDLs of multiple accounts
+    BuildUIDLFilename(uidlHash->mailServer, uidlPath, sizeof(uidlPath));
+
+    if(uidlHash->compact == TRUE)
     {
-      // save the UIDLs only if something has been changed
-      if(uidlHash->isDirty == TRUE)
+      // a single segment with all current UIDLs
+      WriteUIDLDatabase(uidlHash, uidlPath, UIDLF_NEW, UIDLF_NEW);
+    }
+    else
+    {
+      FILE *fh;
+
+      if((fh = fopen(uidlPath, "a")) != NULL)
       {
-        char uidlPath[SIZE_PATHFILE];
-        FILE *fh;
+        struct SaveUIDLData data;
+        struct UIDLSegment seg;
+        BOOL success = TRUE;
+
+        setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+        data.fh = fh;
+        data.error = FALSE;
 
-        // we are saving account specific .uidl files only, the old one will be kept
-        // in case it still contains UIDLs of multiple accounts
-        BuildUIDLFilename(uidlHash->mailServer, uidlPath, sizeof(uidlPath));
+        // one segment with the changes of this session
+        seg.numAdded = counts[1];
+        seg.numRemoved = counts[2];
 
-        // before we go and destroy the UIDL hash we have to
-        // write it to the .uidl file back again.
-        if((fh = fopen(uidlPath, "w")) != NULL)
+        if(fwrite(&seg, sizeof(seg), 1, fh) == 1)
         {
-          setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+          ULONG i;
 
-          fprintf(fh, "UIDL - YAM UIDL database for %s@%s\n", uidlHash->mailServer->username, uidlHash->mailServer->hostname);
+          data.mask = UIDLF_OLD|UIDLF_NEW;
+          data.value = UIDLF_NEW;
+          HashTableEnumerate(uidlHash->hash, SaveUIDLtoken, &data);
 
-          // call HashTableEnumerate with the SaveUIDLtoken callback function
-          HashTableEnumerate(uidlHash->hash, SaveUIDLtoken, fh);
+          data.value = UIDLF_OLD;
+          if(data.error == FALSE)
+            HashTableEnumerate(uidlHash->hash, SaveUIDLtoken, &data);
 
-          fclose(fh);
+          for(i = 0; i < uidlHash->numBase && data.error == FALSE; i++)
+          {
+            if(uidlHash->baseTaken[i] == FALSE && fwrite(&uidlHash->base[2*i], 2*sizeof(ULONG), 1, fh) != 1)
+              data.error = TRUE;
+          }
         }
         else
-          E(DBF_UIDL, "couldn't open '%s' for writing", uidlPath);
+          success = FALSE;
+
+        if(fclose(fh) != 0 || data.error == TRUE)
+          success = FALSE;
+
+        if(success == FALSE)
+          E(DBF_UIDL, "couldn't write to '%s'", uidlPath);
+        else
+          D(DBF_UIDL, "updated UIDL database '%s'", uidlPath);
       }
+      else
+        E(DBF_UIDL, "couldn't open '%s' for writing", uidlPath);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// CleanupUIDLhash
+// Cleanup the whole UIDL hash
+void CleanupUIDLhash(struct UIDLhash *uidlHash)
+{
+  ENTER();
+
+  if(uidlHash != NULL)
+  {
+    if(uidlHash->hash != NULL)
+    {
+      // save the UIDLs only if something has been changed
+      if(uidlHash->isDirty == TRUE)
+        SaveUIDLhash(uidlHash);
 
       // now we can destroy the uidl hash
       HashTableDestroy(uidlHash->hash);
@@ -243,6 +881,9 @@ void CleanupUIDLhash(struct UIDLhash *uidlHash)
       D(DBF_UIDL, "destroyed UIDL hash table");
     }
 
+    free(uidlHash->baseTaken);
+    free(uidlHash->data);
+
     free(uidlHash);
 
     D(DBF_UIDL, "cleaned up UIDLhash");
@@ -256,28 +897,16 @@ void CleanupUIDLhash(struct UIDLhash *uidlHash)
 // adds the UIDL of a mail transfer node to the hash
 struct UIDLtoken *AddUIDLtoHash(struct UIDLhash *uidlHash, const char *uidl, const ULONG flags)
 {
-  struct UIDLtoken *token = NULL;
-  struct HashEntryHeader *entry;
+  struct UIDLtoken *token;
+  ULONG fingerprint[2];
 
   ENTER();
 
-  if((entry = HashTableOperate(uidlHash->hash, uidl, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
-  {
-    token = (struct UIDLtoken *)entry;
+  GetUIDLFingerprint(uidl, fingerprint);
 
-    token->flags |= flags;
-
-    D(DBF_UIDL, "updated flags for UIDL '%s' (%08lx)", uidl, token);
-    uidlHash->isDirty = TRUE;
-  }
-  else if((entry = HashTableOperate(uidlHash->hash, uidl, htoAdd)) != NULL)
+  if((token = AddFingerprint(uidlHash, fingerprint, flags)) != NULL)
   {
-    token = (struct UIDLtoken *)entry;
-
-    token->uidl = strdup(uidl);
-    token->flags = flags;
-
-    D(DBF_UIDL, "added UIDL '%s' (%08lx) to hash", uidl, token);
+    D(DBF_UIDL, "added/updated UIDL '%s' (%08lx%08lx), flags %08lx", uidl, fingerprint[0], fingerprint[1], token->flags);
     uidlHash->isDirty = TRUE;
   }
   else
@@ -294,13 +923,22 @@ struct UIDLtoken *FindUIDL(const struct UIDLhash *uidlHash, const char *uidl)
 {
   struct UIDLtoken *token = NULL;
   struct HashEntryHeader *entry;
+  ULONG fingerprint[2];
 
   ENTER();
 
-  if((entry = HashTableOperate(uidlHash->hash, uidl, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
+  GetUIDLFingerprint(uidl, fingerprint);
+
+  if((entry = HashTableOperate(uidlHash->hash, fingerprint, htoLookup)) != NULL && HASH_ENTRY_IS_LIVE(entry))
   {
     token = (struct UIDLtoken *)entry;
   }
+  else if(TakeBaseFingerprint(uidlHash, fingerprint) == TRUE)
+  {
+    // move the fingerprint from the base segment to the hash, so that its
+    // flags can be changed
+    token = InsertFingerprint(uidlHash->hash, fingerprint, UIDLF_OLD);
+  }
 
   RETURN(token);
   return token;
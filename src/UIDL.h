@@ -36,13 +36,19 @@ struct UIDLhash
 {
   struct HashTable *hash;            // the hash table to hold all data
   struct MailServerNode *mailServer; // the mail server for which the data are to be managed
+  char *data;                        // the database file as read from disk
+  const ULONG *base;                 // the sorted fingerprints of the first segment within data
+  UBYTE *baseTaken;                  // TRUE for each base fingerprint moved to the hash or removed
+  ULONG numBase;                     // number of base fingerprints
+  ULONG fileRecords;                 // number of records in the database file incl. outdated ones
   BOOL isDirty;                      // did anything change during the POP/IMAP session?
+  BOOL compact;                      // rewrite the database file instead of appending the changes
 };
 
 struct UIDLtoken
 {
   struct HashEntryHeader hash; // a standard hash entry header
-  const char *uidl;            // the UIDL token
+  ULONG fingerprint[2];        // the hashed UIDL token, this is the key
   ULONG flags;                 // flags for this UIDL, see below
 };
 
@@ -112,8 +112,10 @@
 #include "MailList.h"
 #include "MailServers.h"
 #include "MethodStack.h"
+#include "PartCache.h"
 #include "Requesters.h"
 #include "Rexx.h"
+#include "StringPool.h"
 #include "Threads.h"
 #include "Timer.h"
 #include "TZone.h"
@@ -751,6 +753,9 @@ static void Terminate(void)
   }
   NewMinList(&G->readMailDataList);
 
+  D(DBF_STARTUP, "freeing part cache...");
+  PartCacheCleanup();
+
   D(DBF_STARTUP, "freeing writeMailData...");
   // cleanup the still existing writemailData objects
   SafeIterateList(&G->writeMailDataList, struct WriteMailData *, wmData, nextWMD)
@@ -987,6 +992,10 @@ static void Terminate(void)
     G->mailNodeItemPool = NULL;
   }
 
+  // free the string pool after all mails are gone
+  DeleteStringPool(G->stringPool);
+  G->stringPool = NULL;
+
   if(G->mailsInTransfer != NULL)
   {
     if(IsMailListEmpty(G->mailsInTransfer) == FALSE)
@@ -2524,6 +2533,12 @@ int main(int argc, char **argv)
       break;
     }
 
+    if((G->stringPool = CreateStringPool()) == NULL)
+    {
+      // break out immediately to signal an error!
+      break;
+    }
+
     if((G->mailsInTransfer = CreateMailList()) == NULL)
     {
       // break out immediately to signal an error!
@@ -2605,6 +2620,9 @@ int main(int argc, char **argv)
     // setup our ImageCache
     ImageCacheSetup();
 
+    // setup the cache for decoded attachments
+    PartCacheSetup();
+
     if(yamFirst == TRUE)
     {
       InitBeforeLogin(args.hide ? TRUE : FALSE);
@@ -66,6 +66,7 @@ struct ReadMailData;
 struct codeset;
 struct codesetList;
 struct HashTable;
+struct StringPool;
 struct NotifyRequest;
 struct Process;
 struct TZoneInfo;
@@ -116,6 +117,7 @@ struct Global
   struct codeset *         editorCodeset;        // the codeset YAM will use for external editors
   struct codesetList *     codesetsList;
   struct HashTable *       imageCacheHashTable;
+  struct HashTable *       partCacheHashTable;
   struct FolderList *      folders;
   struct MinList *         xpkPackerList;
   struct SignalSemaphore * globalSemaphore;      // a semaphore for certain variables in this structure, i.e. currentFolder
@@ -126,6 +128,7 @@ struct Global
   struct Folder *          currentFolder;        // the currently active folder
   APTR                     mailItemPool;         // item pool for struct Mail
   APTR                     mailNodeItemPool;     // item pool for struct MailNode
+  struct StringPool *      stringPool;           // pooled strings shared by all mails
   struct Screen *          workbenchScreen;
   struct MailList *        mailsInTransfer;      // list of mail currently being sent
   struct Interrupt *       lowMemHandler;        // low memory handler to flush all indexes
@@ -142,6 +145,7 @@ struct Global
   int                      ER_NumErr;
   int                      currentAppIcon;
   int                      activeConnections;
+  int                      usedConnectionSlots;  // number of connections granted by ObtainConnectionSlot()
   #if defined(__amigaos4__)
   int                      LastIconID;
   #endif
@@ -174,6 +178,9 @@ struct Global
   struct MinList           normalBusyList;       // list of active busy actions, normal usage
   struct MinList           arexxBusyList;        // list of active busy actions, ARexx usage
   struct MinList           tzoneContinentList;   // parsed stuff from zone.tab file
+  struct MinList           connectionSlotList;   // hosts with granted connection slots
+  struct MinList           connectionWaiterList; // threads waiting for a connection slot
+  struct MinList           sslSessionList;       // cached TLS sessions and verified certificates per server
   struct Theme             theme;
   struct TokenAnalyzer     spamFilter;
   struct Timers            timerData;
@@ -62,12 +62,14 @@
 #include "mui/WriteWindow.h"
 #include "mui/YAMApplication.h"
 
+#include "AhoCorasickSearch.h"
 #include "BayesFilter.h"
 #include "BoyerMooreSearch.h"
 #include "Busy.h"
 #include "Config.h"
 #include "DynamicString.h"
 #include "FolderList.h"
+#include "FullTextIndex.h"
 #include "Locale.h"
 #include "Logfile.h"
 #include "MailList.h"
@@ -78,8 +80,31 @@
 
 #include "Debug.h"
 
+// the header fields which are scanned by a compiled filter program
+enum FilterProgramField
+{
+  FPF_FROM_ADDRESS=0,
+  FPF_FROM_NAME,
+  FPF_TO_ADDRESS,
+  FPF_TO_NAME,
+  FPF_REPLYTO_ADDRESS,
+  FPF_REPLYTO_NAME,
+  FPF_SUBJECT,
+  FPF_COUNT,
+  FPF_NONE=FPF_COUNT
+};
+
+// all substring rules of a filter list merged into one automaton per field
+struct FilterProgram
+{
+  struct AhoCorasickContext *fields[FPF_COUNT]; // the automatons, NULL for unused fields
+  UBYTE *found;                                 // one bit per compiled rule for the current mail
+  ULONG numRules;                               // number of compiled rules
+};
+
 /* local protos */
 static BOOL CopySearchData(struct Search *dstSearch, struct Search *srcSearch);
+static void FI_DeleteFilterProgram(struct FilterProgram *program, const struct MinList *filterList);
 
 /***************************************************************************
  Module: Find & Filters
@@ -189,13 +214,13 @@ static BOOL FI_MatchString(const struct Search *search, const char *string)
 ///
 /// FI_MatchPerson
 //  Matches string against a person's name or address
-static BOOL FI_MatchPerson(const struct Search *search, const struct Person *pe)
+static BOOL FI_MatchPerson(const struct Search *search, const char *address, const char *realName)
 {
   BOOL match;
 
   ENTER();
 
-  match = FI_MatchString(search, search->PersMode ? pe->RealName : pe->Address);
+  match = FI_MatchString(search, search->PersMode ? realName : address);
 
   RETURN(match);
   return match;
@@ -217,7 +242,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->From) == TRUE)
+      if(FI_MatchPerson(search, mail->From.Address, mail->From.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -227,7 +252,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSFrom; i++)
         {
-          if(FI_MatchPerson(search, &email->SFrom[i]) == TRUE)
+          if(FI_MatchPerson(search, email->SFrom[i].Address, email->SFrom[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -244,7 +269,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->To) == TRUE)
+      if(FI_MatchPerson(search, mail->To.Address, mail->To.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -254,7 +279,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSTo; i++)
         {
-          if(FI_MatchPerson(search, &email->STo[i]) == TRUE)
+          if(FI_MatchPerson(search, email->STo[i].Address, email->STo[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -277,7 +302,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumCC; i++)
         {
-          if(FI_MatchPerson(search, &email->CC[i]) == TRUE)
+          if(FI_MatchPerson(search, email->CC[i].Address, email->CC[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -294,7 +319,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
     {
       struct ExtendedMail *email;
 
-      if(FI_MatchPerson(search, &mail->ReplyTo) == TRUE)
+      if(FI_MatchPerson(search, mail->ReplyTo.Address, mail->ReplyTo.RealName) == TRUE)
       {
         found = TRUE;
       }
@@ -304,7 +329,7 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 
         for(i=0; i < email->NumSReplyTo; i++)
         {
-          if(FI_MatchPerson(search, &email->SReplyTo[i]) == TRUE)
+          if(FI_MatchPerson(search, email->SReplyTo[i].Address, email->SReplyTo[i].RealName) == TRUE)
           {
             found = TRUE;
             break;
@@ -433,11 +458,21 @@ static BOOL FI_SearchPatternFast(const struct Search *search, const struct Mail
 static BOOL FI_SearchPatternInBody(const struct Search *search, const struct Mail *mail)
 {
   BOOL found = FALSE;
+  enum FullTextResult ftResult = FTR_UNKNOWN;
   struct ReadMailData *rmData;
 
   ENTER();
 
-  if((rmData = AllocPrivateRMData(mail, PM_TEXTS|PM_QUIET)) != NULL)
+  // ask the folder's full text index first, this saves reading and
+  // decoding all mails which cannot contain the searched text at all
+  if(search->ftQuery != NULL)
+    ftResult = CheckFullTextQuery(search->ftQuery, mail);
+
+  if(ftResult == FTR_NOMATCH)
+  {
+    D(DBF_FILTER, "full text index rules out mail '%s'", mail->MailFile);
+  }
+  else if((rmData = AllocPrivateRMData(mail, PM_TEXTS|PM_QUIET)) != NULL)
   {
     char *cmsg;
 
@@ -446,6 +481,11 @@ static BOOL FI_SearchPatternInBody(const struct Search *search, const struct Mai
       char *rptr = cmsg;
       char *ptr;
 
+      // index the text now that it has been decoded anyway, but never
+      // keep tokens of encrypted mails
+      if(ftResult == FTR_UNKNOWN && isMP_CryptedMail(mail) == FALSE)
+        AddMailToFullTextIndex(mail, cmsg);
+
       while(*rptr != '\0' && found == FALSE)
       {
         for(ptr = rptr; *ptr && *ptr != '\n'; ptr++);
@@ -799,6 +839,11 @@ BOOL FI_PrepareSearch(struct Search *search, const enum SearchMode mode,
         // do an exact string match
         // there is nothing to prepare here
       }
+
+      // body searches for plain strings can be pruned by the full text
+      // indices, NULL is returned if the string contains no indexable words
+      if(success == TRUE && isFlagClear(flags, SEARCHF_DOS_PATTERN) && (mode == SM_BODY || mode == SM_WHOLE))
+        search->ftQuery = CreateFullTextQuery(search->Match);
     }
   }
 
@@ -1020,9 +1065,202 @@ BOOL FI_DoSearch(struct Search *search, const struct Mail *mail)
 }
 
 ///
-/// DoFilterSearch()
+/// FI_GetProgramField
+//  Returns the header field a rule must be matched against in a compiled
+//  filter program or FPF_NONE if the rule cannot be compiled
+static enum FilterProgramField FI_GetProgramField(const struct Search *search)
+{
+  enum FilterProgramField field = FPF_NONE;
+
+  ENTER();
+
+  // only plain substring searches in the fast header fields can be merged,
+  // all other searches are still performed one by one
+  if(search->Mode <= SM_HEADLINE && search->bmContext != NULL &&
+     isFlagSet(search->flags, SEARCHF_SUBSTRING) && isFlagClear(search->flags, SEARCHF_DOS_PATTERN) &&
+     (search->Compare == CP_EQUAL || search->Compare == CP_NOTEQUAL))
+  {
+    switch(search->Fast)
+    {
+      case FS_FROM:
+        field = search->PersMode ? FPF_FROM_NAME : FPF_FROM_ADDRESS;
+      break;
+
+      case FS_TO:
+        field = search->PersMode ? FPF_TO_NAME : FPF_TO_ADDRESS;
+      break;
+
+      case FS_REPLYTO:
+        field = search->PersMode ? FPF_REPLYTO_NAME : FPF_REPLYTO_ADDRESS;
+      break;
+
+      case FS_SUBJECT:
+        field = FPF_SUBJECT;
+      break;
+
+      default:
+        // no fast field or a field which is not part of struct Mail
+      break;
+    }
+  }
+
+  RETURN(field);
+  return field;
+}
+
+///
+/// FI_CompileFilterProgram
+//  Merges the substring rules of all filters into one Aho/Corasick automaton
+//  per header field. Returns NULL if there are no such rules.
+static struct FilterProgram *FI_CompileFilterProgram(const struct MinList *filterList)
+{
+  struct FilterProgram *program;
+
+  ENTER();
+
+  if((program = calloc(1, sizeof(*program))) != NULL)
+  {
+    struct FilterNode *filter;
+    BOOL success = TRUE;
+    int i;
+
+    IterateList(filterList, struct FilterNode *, filter)
+    {
+      struct RuleNode *rule;
+
+      IterateList(&filter->ruleList, struct RuleNode *, rule)
+      {
+        struct Search *search = rule->search;
+        enum FilterProgramField field;
+
+        if(search != NULL && (field = FI_GetProgramField(search)) != FPF_NONE)
+        {
+          if(program->fields[field] == NULL)
+            program->fields[field] = AhoCorasickInit();
+
+          if(AhoCorasickAddPattern(program->fields[field], search->Match, isFlagSet(search->flags, SEARCHF_CASE_SENSITIVE), program->numRules) == TRUE)
+          {
+            program->numRules++;
+            search->programRule = program->numRules;
+          }
+          else
+            success = FALSE;
+        }
+      }
+    }
+
+    for(i = 0; i < FPF_COUNT; i++)
+    {
+      if(program->fields[i] != NULL && AhoCorasickCompile(program->fields[i]) == FALSE)
+        success = FALSE;
+    }
+
+    if(success == TRUE && program->numRules > 0)
+      success = ((program->found = malloc((program->numRules + 7) / 8)) != NULL);
+
+    if(success == FALSE || program->numRules == 0)
+    {
+      // let all rules be evaluated one by one again
+      FI_DeleteFilterProgram(program, filterList);
+      program = NULL;
+    }
+    else
+      D(DBF_FILTER, "compiled %ld rules into filter program", program->numRules);
+  }
+
+  RETURN(program);
+  return program;
+}
+
+///
+/// FI_DeleteFilterProgram
+//  Frees a compiled filter program and detaches the rules from it
+static void FI_DeleteFilterProgram(struct FilterProgram *program, const struct MinList *filterList)
+{
+  ENTER();
+
+  if(program != NULL)
+  {
+    struct FilterNode *filter;
+    int i;
+
+    IterateList(filterList, struct FilterNode *, filter)
+    {
+      struct RuleNode *rule;
+
+      IterateList(&filter->ruleList, struct RuleNode *, rule)
+      {
+        if(rule->search != NULL)
+          rule->search->programRule = 0;
+      }
+    }
+
+    for(i = 0; i < FPF_COUNT; i++)
+      AhoCorasickCleanup(program->fields[i]);
+
+    free(program->found);
+    free(program);
+  }
+
+  LEAVE();
+}
+
+///
+/// FI_RunFilterProgram
+//  Scans each header field of a mail exactly once for all compiled rules
+static void FI_RunFilterProgram(struct FilterProgram *program, const struct Mail *mail)
+{
+  ENTER();
+
+  memset(program->found, 0, (program->numRules + 7) / 8);
+
+  AhoCorasickSearch(program->fields[FPF_FROM_ADDRESS], mail->From.Address, program->found);
+  AhoCorasickSearch(program->fields[FPF_FROM_NAME], mail->From.RealName, program->found);
+  AhoCorasickSearch(program->fields[FPF_TO_ADDRESS], mail->To.Address, program->found);
+  AhoCorasickSearch(program->fields[FPF_TO_NAME], mail->To.RealName, program->found);
+  AhoCorasickSearch(program->fields[FPF_REPLYTO_ADDRESS], mail->ReplyTo.Address, program->found);
+  AhoCorasickSearch(program->fields[FPF_REPLYTO_NAME], mail->ReplyTo.RealName, program->found);
+  AhoCorasickSearch(program->fields[FPF_SUBJECT], mail->Subject, program->found);
+
+  LEAVE();
+}
+
+///
+/// FI_DoProgramSearch
+//  Checks a single rule against a mail, compiled rules take their result
+//  from the last run of the filter program
+static BOOL FI_DoProgramSearch(struct Search *search, const struct Mail *mail, const struct FilterProgram *program)
+{
+  BOOL found;
+
+  ENTER();
+
+  // mails with several senders or recipients need the complete check of
+  // all addresses as the program only knows about the first one
+  if(program == NULL || search->programRule == 0 ||
+     (search->Fast == FS_FROM && isMultiSenderMail(mail)) ||
+     (search->Fast == FS_TO && isMultiRCPTMail(mail)) ||
+     (search->Fast == FS_REPLYTO && isMultiReplyToMail(mail)))
+  {
+    found = FI_DoSearch(search, mail);
+  }
+  else
+  {
+    found = AC_ISBITSET(program->found, search->programRule-1);
+
+    // invert the result in case a non-matching search was requested
+    if(search->Compare == CP_NOTEQUAL)
+      found = !found;
+  }
+
+  RETURN(found);
+  return found;
+}
+
+///
+/// FI_DoFilterSearch()
 //  Does a complex search with combined criterias based on the rules of a filter
-BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
+static BOOL FI_DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail, const struct FilterProgram *program)
 {
   ULONG numRules;
   ULONG matchedRules;
@@ -1044,7 +1282,7 @@ BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
 
     if(rule->search != NULL)
     {
-      if(FI_DoSearch(rule->search, mail) == TRUE)
+      if(FI_DoProgramSearch(rule->search, mail, program) == TRUE)
         matchedRules++;
     }
   }
@@ -1083,9 +1321,114 @@ BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
 }
 
 ///
-/// FI_FilterSingleMail
-//  applies the configured filters on a single mail
-BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, int *matches, struct FilterResult *result)
+/// DoFilterSearch()
+//  Does a complex search with combined criterias based on the rules of a filter
+BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail)
+{
+  BOOL result;
+
+  ENTER();
+
+  result = FI_DoFilterSearch(filter, mail, NULL);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// FilterListNeedsMailFile
+//  Checks whether checking the filters of a list against a mail will have to
+//  read the mail file, because only the mail's basic information is known.
+//  This is the case for complete header and body searches and for the
+//  additional addresses of mails with several senders or recipients.
+BOOL FilterListNeedsMailFile(const struct MinList *filterList, const struct Mail *mail)
+{
+  BOOL needsFile = FALSE;
+  struct FilterNode *filter;
+
+  ENTER();
+
+  IterateList(filterList, struct FilterNode *, filter)
+  {
+    struct RuleNode *rule;
+
+    IterateList(&filter->ruleList, struct RuleNode *, rule)
+    {
+      struct Search *search = rule->search;
+
+      // rules without a prepared search are skipped by the filter search
+      if(search == NULL)
+        continue;
+
+      switch(search->Mode)
+      {
+        case SM_FROM:
+        case SM_TO:
+        case SM_CC:
+        case SM_REPLYTO:
+        case SM_SUBJECT:
+        case SM_DATE:
+        case SM_HEADLINE:
+        case SM_SIZE:
+        {
+          switch(search->Fast)
+          {
+            case FS_FROM:
+              needsFile = isMultiSenderMail(mail);
+            break;
+
+            case FS_TO:
+            case FS_CC:
+              needsFile = isMultiRCPTMail(mail);
+            break;
+
+            case FS_REPLYTO:
+              needsFile = isMultiReplyToMail(mail);
+            break;
+
+            case FS_SUBJECT:
+            case FS_DATE:
+            case FS_SIZE:
+              needsFile = FALSE;
+            break;
+
+            default:
+              needsFile = TRUE;
+            break;
+          }
+        }
+        break;
+
+        case SM_STATUS:
+        {
+          needsFile = FALSE;
+        }
+        break;
+
+        default:
+        {
+          // header, body and spam searches always need the complete mail
+          needsFile = TRUE;
+        }
+        break;
+      }
+
+      if(needsFile == TRUE)
+        break;
+    }
+
+    if(needsFile == TRUE)
+      break;
+  }
+
+  RETURN(needsFile);
+  return needsFile;
+}
+
+///
+/// FI_FilterMail
+//  applies the filters on a single mail, using a compiled filter program if available
+static BOOL FI_FilterMail(const struct MinList *filterList, const struct FilterProgram *program, struct Mail *mail, int *matches, struct FilterResult *result)
 {
   BOOL success = TRUE;
   struct FilterNode *filter;
@@ -1095,7 +1438,7 @@ BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, in
 
   IterateList(filterList, struct FilterNode *, filter)
   {
-    if(DoFilterSearch(filter, mail) == TRUE)
+    if(FI_DoFilterSearch(filter, mail, program) == TRUE)
     {
       match++;
 
@@ -1116,6 +1459,21 @@ BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, in
   return success;
 }
 
+///
+/// FI_FilterSingleMail
+//  applies the configured filters on a single mail
+BOOL FI_FilterSingleMail(const struct MinList *filterList, struct Mail *mail, int *matches, struct FilterResult *result)
+{
+  BOOL success;
+
+  ENTER();
+
+  success = FI_FilterMail(filterList, NULL, mail, matches, result);
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// FreeSearchData
 // Function to free the search data
@@ -1140,6 +1498,13 @@ void FreeSearchData(struct Search *search)
     search->bmContext = NULL;
   }
 
+  // free the full text query, this also saves the last used index
+  if(search->ftQuery != NULL)
+  {
+    DeleteFullTextQuery(search->ftQuery);
+    search->ftQuery = NULL;
+  }
+
   LEAVE();
 }
 
@@ -1567,6 +1932,7 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
 
   if((filterList = CloneFilterList(mode)) != NULL)
   {
+    struct FilterProgram *program;
     struct BusyNode *busy;
     struct Folder *spamfolder = FO_GetFolderByType(FT_SPAM, NULL);
     struct MailNode *mnode;
@@ -1576,6 +1942,10 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
     struct TimeVal lastStatsUpdate;
     struct FilterResult lastResult;
 
+    // merge the substring rules of all filters, so that each header field
+    // of each mail needs to be scanned only once
+    program = FI_CompileFilterProgram(filterList);
+
     set(G->MA->GUI.PG_MAILLIST, MUIA_NList_Quiet, TRUE);
     G->AppIconQuiet = TRUE;
 
@@ -1660,7 +2030,10 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
           result->Checked++;
 
           // now we process the search
-          FI_FilterSingleMail(filterList, mail, &matches, result);
+          if(program != NULL)
+            FI_RunFilterProgram(program, mail);
+
+          FI_FilterMail(filterList, program, mail, &matches, result);
         }
 
         // we update the busy gauge and
@@ -1684,6 +2057,7 @@ void FilterMails(const struct MailList *mlist, const int mode, struct FilterResu
 
     UnlockMailList(mlist);
 
+    FI_DeleteFilterProgram(program, filterList);
     DeleteFilterList(filterList);
 
     if(result->Checked != 0)
@@ -1790,6 +2164,8 @@ static BOOL CopySearchData(struct Search *dstSearch, struct Search *srcSearch)
   memcpy(dstSearch, srcSearch, sizeof(*dstSearch));
 
   dstSearch->bmContext = NULL;
+  dstSearch->ftQuery = NULL;
+  dstSearch->programRule = 0;
 
   // now we have to copy the patternList as well
   NewMinList(&dstSearch->patternList);
@@ -1488,6 +1488,18 @@ BOOL FO_MoveFolderDir(struct Folder *fo, struct Folder *oldfo)
     }
     else
     {
+      // the journal belongs to the index and must be moved as well
+      AddPath(srcbuf, oldfo->Fullpath, ".journal", sizeof(srcbuf));
+      AddPath(dstbuf, fo->Fullpath, ".journal", sizeof(dstbuf));
+      if(FileExists(srcbuf) == TRUE && MoveFile(srcbuf, dstbuf) == FALSE)
+        W(DBF_FOLDER, "failed to move file '%s' to '%s'", srcbuf, dstbuf);
+
+      // the full text index is rebuilt on demand if it cannot be moved
+      AddPath(srcbuf, oldfo->Fullpath, ".ftindex", sizeof(srcbuf));
+      AddPath(dstbuf, fo->Fullpath, ".ftindex", sizeof(dstbuf));
+      if(FileExists(srcbuf) == TRUE && MoveFile(srcbuf, dstbuf) == FALSE)
+        W(DBF_FOLDER, "failed to move file '%s' to '%s'", srcbuf, dstbuf);
+
       // now we try to move the .fimage file aswell
       AddPath(srcbuf, oldfo->Fullpath, ".fimage", sizeof(srcbuf));
       AddPath(dstbuf, fo->Fullpath, ".fimage", sizeof(dstbuf));
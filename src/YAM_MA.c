@@ -102,6 +102,7 @@
 #include "Requesters.h"
 #include "Rexx.h"
 #include "Threads.h"
+#include "ThreadTree.h"
 #include "UserIdentity.h"
 
 #include "Debug.h"
@@ -442,8 +443,8 @@ void MA_ChangeMailStatus(struct Mail *mail, int addflags, int clearflags)
       // set the comment to the Mailfile
       MA_UpdateMailFile(mail);
 
-      // flag the index as expired
-      MA_ExpireIndex(mail->Folder);
+      // record the new status in the index journal
+      MA_JournalMailStatus(mail);
 
       // update the status of the readmaildata (window)
       // of the mail here
@@ -544,12 +545,17 @@ BOOL MA_UpdateMailFile(struct Mail *mail)
     else
     {
       struct ReadMailData *rmData;
+      char oldFileName[SIZE_MFILE];
 
       D(DBF_MAIL, "renamed '%s' to '%s'", oldFilePath, newFilePath);
 
+      strlcpy(oldFileName, mail->MailFile, sizeof(oldFileName));
       strlcpy(mail->MailFile, newFileName, sizeof(mail->MailFile));
       success = TRUE;
 
+      // record the new file name in the index journal
+      MA_JournalRenameMail(mail, oldFileName);
+
       // before we exit we check through all our read windows if
       // they contain the mail we have changed the status, so
       // that we can update the filename in the read window structure
@@ -1139,38 +1145,18 @@ unsigned int MA_FromXStatusHeader(char *xstatusflags)
 /*** Mail Thread Nagivation ***/
 /// FindThreadInFolder
 // Find the next/prev message in a thread within one folder
-struct Mail *FindThreadInFolder(const struct Mail *srcMail, const struct Folder *folder, const BOOL nextThread)
+struct Mail *FindThreadInFolder(const struct Mail *srcMail, struct Folder *folder, const BOOL nextThread)
 {
-  struct Mail *result = NULL;
-  struct MailNode *mnode;
+  struct Mail *result;
 
   ENTER();
 
-  LockMailListShared(folder->messages);
-
-  ForEachMailNode(folder->messages, mnode)
-  {
-    struct Mail *mail = mnode->mail;
+  // an exclusive lock is required, because the thread tree might
+  // have to be built first
+  LockMailList(folder->messages);
 
-    if(nextThread == TRUE)
-    {
-      // find the answer to the srcMail
-      if(mail->cIRTMsgID != 0 && mail->cIRTMsgID == srcMail->cMsgID)
-      {
-        result = mail;
-        break;
-      }
-    }
-    else
-    {
-      // else we have to find the question to the srcMail
-      if(mail->cMsgID != 0 && mail->cMsgID == srcMail->cIRTMsgID)
-      {
-        result = mail;
-        break;
-      }
-    }
-  }
+  // find the answer or the question to the srcMail
+  result = FindThreadTreeMail(folder, srcMail, nextThread);
 
   UnlockMailList(folder->messages);
 
@@ -1465,7 +1451,7 @@ void MA_RemoveAttach(struct Mail *mail, struct Part **whichParts, BOOL warning)
                     // undecoded parts are simply appended without change
                     FILE *in;
 
-                    if((in = fopen(part->Filename, "r")) != NULL)
+                    if(RE_WritePartFile(part) == TRUE && (in = fopen(part->Filename, "r")) != NULL)
                     {
                       char *buf = NULL;
                       size_t buflen = 0;
@@ -2249,7 +2235,7 @@ void MA_GetAddress(struct MailList *mlist, struct MUI_NListtree_TreeNode *dropTa
   BOOL isSentFolder = (folder != NULL) ? isSentMailFolder(folder) : FALSE;
   BOOL isMLFolder = (folder != NULL) ? folder->MLSupport : FALSE;
   struct ExtendedMail *email;
-  struct Person *pe = NULL;
+  const struct MailPerson *pe = NULL;
   struct ABookNode abn;
 
   ENTER();
@@ -3233,7 +3219,7 @@ void MA_ChangeSubject(struct Mail *mail, char *subj)
           mail->Size = -1;
 
         AppendToLogfile(LF_ALL, 82, tr(MSG_LOG_ChangingSubject), mail->Subject, mail->MailFile, fo->Name, subj);
-        strlcpy(mail->Subject, subj, sizeof(mail->Subject));
+        SetMailSubject(mail, subj);
         MA_ExpireIndex(fo);
 
         if(fo->Mode > FM_SIMPLE)
@@ -3319,11 +3305,11 @@ MakeHook(MA_ChangeSubjectHook, MA_ChangeSubjectFunc);
 ///
 /// MA_GetRealSubject
 //  Strips reply prefix / mailing list name from subject
-char *MA_GetRealSubject(char *sub)
+const char *MA_GetRealSubject(const char *sub)
 {
-  char *p;
+  const char *p;
   int sublen;
-  char *result = sub;
+  const char *result = sub;
 
   ENTER();
 
@@ -3333,7 +3319,7 @@ char *MA_GetRealSubject(char *sub)
   {
     if(sub[2] == ':' && !sub[3])
     {
-      result = (char *)"";
+      result = "";
     }
     // check if the subject contains some strings embedded in brackets like [test]
     // and return only the real subject after the last bracket.
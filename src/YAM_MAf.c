@@ -30,6 +30,7 @@
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <stddef.h>
 
 #include <clib/alib_protos.h>
 #include <libraries/gadtools.h>
@@ -72,12 +73,15 @@
 #include "DynamicString.h"
 #include "FileInfo.h"
 #include "FolderList.h"
+#include "HashTable.h"
 #include "Locale.h"
 #include "MailList.h"
+#include "MsgIDHash.h"
 #include "MUIObjects.h"
 #include "Requesters.h"
 #include "Rexx.h"
 #include "Signature.h"
+#include "Threads.h"
 #include "UserIdentity.h"
 
 #include "Debug.h"
@@ -154,12 +158,176 @@ struct FIndex
   long  reserved[2];  // reserved unused area
 };
 
-// whenever you change something up there (in FIndex or ComprMail) you
-// need to increase this version ID!
-#define FINDEX_VER  (MAKE_ID('Y','I','N','8'))
+/*
+** directory of the record table and the string heap which
+** directly follows the FIndex header since index version 'YIN9'.
+** All offsets are relative to the end of the FIndex header.
+**
+** DO NOT CHANGE ALIGNMENT here or the .index
+** files of a folder will be corrupt !
+**
+*/
+struct FIndexTable
+{
+  ULONG recordCount;  // number of records in the record table
+  ULONG recordSize;   // size of a single record (the stride of the table)
+  ULONG recordOffset; // offset of the first record
+  ULONG heapOffset;   // offset of the string heap
+  ULONG heapSize;     // size of the string heap including the final NUL byte
+  ULONG journalID;    // ID of the journal belonging to this index
+  ULONG reserved[2];  // reserved unused area
+};
+
+/*
+** structure of a single record in the record table of a
+** 'YIN9' index. Each record has the same fixed size, so the
+** n-th mail of an index can be accessed directly without
+** parsing all preceeding mails.
+**
+** The strings of a mail are kept in the string heap in the
+** same linefeed separated format as the 'moreBytes' area of
+** a ComprMail. The blocks of all records are stored in the
+** same order as the records themselves.
+**
+** DO NOT CHANGE ALIGNMENT here or the .index
+** files of a folder will be corrupt ! Adding new members
+** at the end is fine, because the loader respects the record
+** size stored in FIndexTable.
+**
+*/
+struct IndexRecord
+{
+  char             mailFile[SIZE_MFILE]; // mail filename without path
+  struct DateStamp date;                 // the creation date of the mail (UTC)
+  struct TimeVal   transDate;            // the received/sent date with ms (UTC)
+  unsigned int     sflags;               // mail status flags
+  unsigned int     mflags;               // general mail flags
+  unsigned long    cMsgID;               // compressed MessageID
+  unsigned long    cIRTMsgID;            // compressed InReturnTo MessageID
+  long             size;                 // the total size of the message
+  ULONG            moreOffset;           // offset of the string block in the heap
+  ULONG            moreBytes;            // length of the string block
+  ULONG            moreLines;            // number of lines in the string block
+  unsigned long    cParentMsgID;         // compressed MessageID of the parent mail
+  unsigned long    cRootMsgID;           // compressed MessageID of the thread's first mail
+};
+
+// the size of a record as written by the first 'YIN9' versions, which
+// didn't know about the thread links yet
+#define INDEXRECORD_MINSIZE (offsetof(struct IndexRecord, cParentMsgID))
+
+/*
+** header of the append-only journal (.journal) of a folder index.
+** The journal records all changes to a folder since the index was
+** written the last time and is replayed when the index is loaded.
+** The header is rewritten after each appended entry to keep the
+** folder statistics up to date.
+**
+** DO NOT CHANGE ALIGNMENT here or the .journal
+** files of a folder will be corrupt !
+**
+*/
+struct FJournal
+{
+  ULONG ID;           // version of the journal (must be FJOURNAL_VER)
+  ULONG journalID;    // must match the journalID of the index
+  int   Total;        // number of total mails in folder
+  int   New;          // number of new mails in folder
+  int   Unread;       // number of unread mails in folder
+  int   Size;         // size of folder (bytes)
+  long  reserved[2];  // reserved unused area
+};
+
+// the types of journal entries
+enum JournalEntryType
+{
+  JET_ADD=1,    // a mail was added, the string block follows the entry
+  JET_REMOVE,   // a mail was removed
+  JET_STATUS,   // the status flags of a mail changed
+  JET_RENAME,   // the mail file of a mail was renamed
+};
+
+/*
+** structure of a single journal entry. The record contains the
+** current state of the mail, newMailFile is used for JET_RENAME
+** entries only. JET_ADD entries are followed by 'moreBytes' bytes
+** of the mail's string block.
+**
+** DO NOT CHANGE ALIGNMENT here or the .journal
+** files of a folder will be corrupt !
+**
+*/
+struct JournalEntry
+{
+  ULONG              type;                    // enum JournalEntryType
+  char               newMailFile[SIZE_MFILE]; // the new mail filename (JET_RENAME)
+  struct IndexRecord record;                  // the mail the entry refers to
+};
+
+// whenever you change something up there (in FIndex, FIndexTable or
+// IndexRecord) you need to increase this version ID! Only appending new
+// members to IndexRecord is possible without doing so.
+#define FINDEX_VER      (MAKE_ID('Y','I','N','9'))
+
+// the previous index version with streamed ComprMail structures, which is
+// still loaded and converted to the current version upon the next save
+#define FINDEX_VER_YIN8 (MAKE_ID('Y','I','N','8'))
+
+// the version of the journal, this must be increased whenever FJournal
+// or JournalEntry (and thus IndexRecord) is changed
+#define FJOURNAL_VER    (MAKE_ID('Y','J','N','2'))
+
+// the journal size beyond which the index is rewritten completely
+// as soon as the folder indexes are flushed the next time
+#define FJOURNAL_COMPACTSIZE (256*1024)
 
 #include "default-align.h"
 
+// the number of worker threads examining the mail files of a folder scan
+#define SCAN_THREADS              3
+// the minimum number of mail files for each worker thread to be started
+#define SCAN_MIN_FILES_PER_THREAD 8
+// the number of mail files examined at once before the mails are added to the folder
+#define SCAN_CHUNK_SIZE           128
+
+// an entry of the table of mail file names used while replaying a journal,
+// the layout of the first two members must match struct HashEntry
+struct MailFileHashEntry
+{
+  struct HashEntryHeader hash;        // standard hash table header
+  const char *mailFile;               // the key, points to the mail's MailFile
+  struct MailNode *mnode;             // the mail node with this file name
+};
+
+struct ScanEntry
+{
+  char name[SIZE_MFILE];              // the name of the mail file
+  struct ExtendedMail *email;         // the result of MA_ExamineMail()
+};
+
+// a folder scan shared by the main thread and the worker threads
+struct FolderScan
+{
+  struct SignalSemaphore *semaphore;  // protects the counters below
+  struct Folder *folder;              // the folder being scanned
+  ULONG numEntries;                   // number of collected mail files
+  ULONG nextEntry;                    // the next mail file to be examined
+  ULONG examinedEntries;              // number of examined mail files
+  ULONG activeWorkers;                // number of still working threads
+  BOOL abort;                         // has the scan been aborted?
+  BOOL ignoreInvalids;                // ignore all invalid mail files?
+  struct ScanEntry entries[SCAN_CHUNK_SIZE];
+};
+
+// the source of the header lines read by ReadHeader(), either a file
+// or a memory buffer like a POP3 TOP response
+struct HeaderSource
+{
+  FILE *fh;                           // the file to read from or NULL
+  const char *ptr;                    // the current position within the buffer
+  const char *end;                    // the end of the buffer
+};
+
 /* local protos */
 static BOOL MA_ScanMailBox(struct Folder *folder);
 
@@ -176,99 +344,1064 @@ BOOL MA_PromptFolderPassword(struct Folder *fo, APTR win)
 
   ENTER();
 
-  if(isFreeAccess(fo))
-  {
-    D(DBF_FOLDER, "folder '%s' has no access restrictions", fo->Name);
-    success = TRUE;
-  }
-  else
+  if(isFreeAccess(fo))
+  {
+    D(DBF_FOLDER, "folder '%s' has no access restrictions", fo->Name);
+    success = TRUE;
+  }
+  else
+  {
+    struct User *user;
+
+    user = US_GetCurrentUser();
+
+    if(Stricmp(fo->Password, user->Password) == 0)
+    {
+      D(DBF_FOLDER, "folder '%s' and user '%s' share the same password", fo->Name, user->Name);
+      success = TRUE;
+    }
+    else
+    {
+      BOOL retry = TRUE;
+      char prompt[SIZE_LARGE];
+
+      snprintf(prompt, sizeof(prompt), tr(MSG_MA_GetFolderPass), fo->Name);
+
+      do
+      {
+        char passwd[SIZE_PASSWORD];
+
+        passwd[0] = '\0';
+        if(StringRequest(passwd, SIZE_PASSWORD, tr(MSG_Folder), prompt, tr(MSG_Okay), NULL, tr(MSG_Cancel), TRUE, win) > 0)
+          // try again if the password doesn't match
+          success = (Stricmp(passwd, fo->Password) == 0);
+        else
+          // the user cancelled the requester, no more tries
+          retry = FALSE;
+      }
+      while(success == FALSE && retry);
+    }
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_ValidateStatus
+//  Avoids invalid status values
+static void MA_ValidateStatus(struct Folder *folder)
+{
+  ENTER();
+
+  // the whole job only makes sense if there are new mails at all
+  if(folder->New > 0)
+  {
+    BOOL sent = isSentFolder(folder);
+
+    // mark new mails as unread during the startup phase only, but not upon reloading a folder index
+    if(sent == TRUE || (C->UpdateNewMail == TRUE && G->InStartupPhase == TRUE))
+    {
+      struct MailNode *mnode;
+
+      D(DBF_FOLDER, "validating status of new messages in folder '%s'", folder->Name);
+
+      LockMailListShared(folder->messages);
+
+      ForEachMailNode(folder->messages, mnode)
+      {
+        struct Mail *mail = mnode->mail;
+
+        if(hasStatusNew(mail))
+        {
+          if(sent == TRUE)
+          {
+            D(DBF_FOLDER, "set status 'sent' of mail with subject '%s'", mail->Subject);
+            setStatusToSent(mail);
+          }
+          else
+          {
+            D(DBF_FOLDER, "set status 'unread' of mail with subject '%s'", mail->Subject);
+            setStatusToUnread(mail);
+          }
+        }
+      }
+
+      UnlockMailList(folder->messages);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// MA_ParseIndexLines
+//  Fills the string members of a mail from a linefeed separated block of
+//  an index file. The block is modified in place. Returns a pointer to the
+//  first character behind the parsed lines or NULL if the block contains
+//  less than the expected number of lines.
+static char *MA_ParseIndexLines(struct Mail *mail, char *line, const ULONG numLines)
+{
+  ULONG lineNr = 0;
+
+  ENTER();
+
+  while(line != NULL && lineNr < numLines)
+  {
+    char *nextLine;
+
+    if((nextLine = strchr(line, '\n')) != NULL)
+      *nextLine++ = '\0';
+
+    lineNr++;
+
+    switch(lineNr)
+    {
+      case 1:
+        SetMailSubject(mail, line);
+      break;
+
+      case 2:
+        SetMailPerson(&mail->From, line, mail->From.RealName);
+      break;
+
+      case 3:
+        SetMailPerson(&mail->From, mail->From.Address, line);
+      break;
+
+      case 4:
+        SetMailPerson(&mail->To, line, mail->To.RealName);
+      break;
+
+      case 5:
+        SetMailPerson(&mail->To, mail->To.Address, line);
+      break;
+
+      case 6:
+        SetMailPerson(&mail->ReplyTo, line, mail->ReplyTo.RealName);
+      break;
+
+      case 7:
+        SetMailPerson(&mail->ReplyTo, mail->ReplyTo.Address, line);
+      break;
+
+      case 8:
+        SetMailAccount(mail, line);
+      break;
+    }
+
+    line = nextLine;
+  }
+
+  // signal a short block
+  if(lineNr < numLines)
+    line = NULL;
+
+  RETURN(line);
+  return line;
+}
+
+///
+/// MA_LoadIndexYIN8
+//  Loads the mails of a 'YIN8' index by streaming one ComprMail after
+//  the other from the file. This is the fallback for index files written
+//  by previous versions.
+static BOOL MA_LoadIndexYIN8(struct Folder *folder, struct Folder *tempFolder, FILE *fh, const char *indexFileName, BOOL *corrupt)
+{
+  BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+  BOOL error = FALSE;
+
+  ENTER();
+
+  do
+  {
+    struct Mail *mail;
+    struct ComprMail cmail;
+    char utf8buf[SIZE_LARGE];
+    char *buf;
+
+    if(fread(&cmail, sizeof(struct ComprMail), 1, fh) != 1)
+    {
+      // check if we are here because of an error or EOF
+      if(ferror(fh) != 0 || feof(fh) == 0)
+      {
+        E(DBF_FOLDER, "error while loading ComprMail struct from .index file");
+        error = TRUE;
+      }
+
+      // if we end up here it is just a EOF and no error.
+      break;
+    }
+
+    if(cmail.moreBytes > sizeof(utf8buf)-1)
+    {
+      ER_NewError(tr(MSG_ER_INDEX_CORRUPTED), indexFileName, folder->Name, ftell(fh), cmail.mailFile, cmail.moreBytes);
+      *corrupt = TRUE;
+      break;
+    }
+
+    // read the moreBytes data
+    if(fread(utf8buf, cmail.moreBytes, 1, fh) != 1)
+    {
+      E(DBF_FOLDER, "fread error while reading index file");
+      error = TRUE;
+      break;
+    }
+
+    // make sure to NUL terminate the utf8 string
+    utf8buf[cmail.moreBytes] = '\0';
+
+    if(systemIsUTF8 == TRUE)
+    {
+      // no conversion required
+      buf = utf8buf;
+    }
+    else
+    {
+      // convert the utf8 encoded buffer to the local charset
+      if((buf = CodesetsUTF8ToStr(CSA_Source,          utf8buf,
+                                  CSA_SourceLen,       cmail.moreBytes,
+                                  CSA_DestCodeset,     G->systemCodeset,
+                                  CSA_MapForeignChars, C->MapForeignChars,
+                                  TAG_DONE)) == NULL)
+      {
+        E(DBF_FOLDER, "error while converting UTF8 data to local charset");
+        error = TRUE;
+        break;
+      }
+    }
+
+    // create a new mail structure
+    if((mail = AllocMail()) != NULL)
+    {
+      MA_ParseIndexLines(mail, buf, COMPRMAIL_MORELINES);
+
+      mail->mflags = cmail.mflags;
+      mail->sflags = cmail.sflags;
+      // we have to make sure that the volatile flag field isn't loaded
+      setVOLValue(mail, 0);
+      strlcpy(mail->MailFile, cmail.mailFile, sizeof(mail->MailFile));
+      mail->Date = cmail.date;
+      mail->transDate = cmail.transDate;
+      mail->cMsgID = cmail.cMsgID;
+      mail->cIRTMsgID = cmail.cIRTMsgID;
+      mail->Size = cmail.size;
+
+      // finally add the new mail structure to the temporary folder
+      // no message list locking or index expiring is necessary here,
+      // because it is a temporary folder which is not publically known
+      AddMailToFolderSimple(mail, tempFolder);
+
+      // the AddMailToFolderSimple() call set the mail's folder pointer to the
+      // temporary folder. But since this is a temporary one only and will be
+      // invalid after leaving this function we must set the mail's folder
+      // pointer to the correct current folder.
+      mail->Folder = folder;
+    }
+    else
+      error = TRUE;
+
+    if(systemIsUTF8 == FALSE)
+    {
+      // free the codesets buffer
+      CodesetsFreeA(buf, NULL);
+    }
+  }
+  while(error == FALSE);
+
+  RETURN(error);
+  return error;
+}
+
+///
+/// MA_GetIndexRecord
+//  Returns a copy of the n-th record of a 'YIN9' record table. The copy
+//  is necessary, because the record table might not be aligned properly
+//  for direct access on all CPUs. Members missing in records written by
+//  older versions are cleared.
+static void MA_GetIndexRecord(struct IndexRecord *record, const char *table, const struct FIndexTable *fit, const ULONG n)
+{
+  ENTER();
+
+  memset(record, 0, sizeof(*record));
+  memcpy(record, &table[fit->recordOffset + n * fit->recordSize], MIN(fit->recordSize, sizeof(*record)));
+
+  LEAVE();
+}
+
+///
+/// MA_RecordToMail
+//  Copies the fixed members of an index record to a mail
+static void MA_RecordToMail(struct Mail *mail, struct IndexRecord *record)
+{
+  ENTER();
+
+  // make sure the mail file name is NUL terminated
+  record->mailFile[sizeof(record->mailFile)-1] = '\0';
+
+  mail->mflags = record->mflags;
+  mail->sflags = record->sflags;
+  // we have to make sure that the volatile flag field isn't loaded
+  setVOLValue(mail, 0);
+  strlcpy(mail->MailFile, record->mailFile, sizeof(mail->MailFile));
+  mail->Date = record->date;
+  mail->transDate = record->transDate;
+  mail->cMsgID = record->cMsgID;
+  mail->cIRTMsgID = record->cIRTMsgID;
+  mail->cParentMsgID = record->cParentMsgID;
+  mail->cRootMsgID = record->cRootMsgID;
+  mail->Size = record->size;
+
+  LEAVE();
+}
+
+///
+/// MA_MailToRecord
+//  Copies the fixed members of a mail to an index record
+static void MA_MailToRecord(struct IndexRecord *record, const struct Mail *mail)
+{
+  ENTER();
+
+  memset(record, 0, sizeof(*record));
+  strlcpy(record->mailFile, mail->MailFile, sizeof(record->mailFile));
+  record->date = mail->Date;
+  record->transDate = mail->transDate;
+  record->sflags = mail->sflags;
+  record->mflags = mail->mflags;
+  // we have to make sure that the volatile flag field isn't saved
+  setVOLValue(record, 0);
+  record->cMsgID = mail->cMsgID;
+  record->cIRTMsgID = mail->cIRTMsgID;
+  record->cParentMsgID = mail->cParentMsgID;
+  record->cRootMsgID = mail->cRootMsgID;
+  record->size = mail->Size;
+
+  LEAVE();
+}
+
+///
+/// MA_CreateIndexLines
+//  Creates the UTF8 encoded string block of a mail as it is stored in the
+//  string heap of an index and in the journal. The supplied buffer is used
+//  for the local charset version of the block. The result must be freed
+//  with MA_FreeIndexLines().
+static UTF8 *MA_CreateIndexLines(const struct Mail *mail, char *buf, const size_t bufSize, ULONG *length)
+{
+  BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+  UTF8 *utf8buf;
+
+  ENTER();
+
+  snprintf(buf, bufSize, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
+                         mail->Subject,
+                         mail->From.Address, mail->From.RealName,
+                         mail->To.Address, mail->To.RealName,
+                         mail->ReplyTo.Address, mail->ReplyTo.RealName,
+                         mail->MailAccount);
+
+  if(systemIsUTF8 == TRUE)
+  {
+    // no conversion required
+    utf8buf = (UTF8 *)buf;
+    *length = strlen(buf);
+  }
+  else
+  {
+    // convert the buffer string to UTF8
+    utf8buf = CodesetsUTF8Create(CSA_Source, buf,
+                                 CSA_SourceCodeset, G->systemCodeset,
+                                 CSA_DestLenPtr, length,
+                                 TAG_DONE);
+  }
+
+  RETURN(utf8buf);
+  return utf8buf;
+}
+
+///
+/// MA_FreeIndexLines
+//  Frees a string block created by MA_CreateIndexLines()
+static void MA_FreeIndexLines(UTF8 *utf8buf, const char *buf)
+{
+  ENTER();
+
+  // only a converted block must be freed
+  if(utf8buf != NULL && utf8buf != (UTF8 *)buf)
+    CodesetsFreeA(utf8buf, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_LoadIndexTable
+//  Loads the mails of a 'YIN9' index. The complete remainder of the file
+//  is read with one single call and the mails are created directly from
+//  the record table and the string heap. In case the system's charset is
+//  UTF8 the strings are taken directly from the heap, otherwise the whole
+//  heap is converted with one single call.
+static BOOL MA_LoadIndexTable(struct Folder *folder, struct Folder *tempFolder, FILE *fh, const ULONG tableSize, ULONG *journalID, BOOL *corrupt)
+{
+  BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+  BOOL error = FALSE;
+  char *table;
+
+  ENTER();
+
+  if((table = malloc(tableSize)) != NULL)
+  {
+    struct FIndexTable fit;
+
+    if(tableSize < sizeof(fit) || fread(table, tableSize, 1, fh) != 1)
+    {
+      E(DBF_FOLDER, "error while loading record table from .index file");
+      error = TRUE;
+    }
+    else
+    {
+      memcpy(&fit, table, sizeof(fit));
+
+      // validate the directory before we trust any of the offsets
+      if(fit.recordSize < INDEXRECORD_MINSIZE ||
+         fit.recordOffset < sizeof(fit) ||
+         fit.recordOffset > tableSize ||
+         (tableSize - fit.recordOffset) / fit.recordSize < fit.recordCount ||
+         fit.heapSize == 0 ||
+         fit.heapOffset > tableSize ||
+         fit.heapSize > tableSize - fit.heapOffset ||
+         table[fit.heapOffset + fit.heapSize - 1] != '\0')
+      {
+        E(DBF_FOLDER, "invalid record table, count %ld, size %ld, offset %ld, heap %ld/%ld", fit.recordCount, fit.recordSize, fit.recordOffset, fit.heapOffset, fit.heapSize);
+        *corrupt = TRUE;
+      }
+      else
+      {
+        char *heap = &table[fit.heapOffset];
+        char *line;
+
+        *journalID = fit.journalID;
+
+        if(systemIsUTF8 == TRUE)
+        {
+          // no conversion required
+          line = heap;
+        }
+        else
+        {
+          // convert all strings of the heap to the local charset in one go
+          if((line = CodesetsUTF8ToStr(CSA_Source,          heap,
+                                       CSA_SourceLen,       fit.heapSize - 1,
+                                       CSA_DestCodeset,     G->systemCodeset,
+                                       CSA_MapForeignChars, C->MapForeignChars,
+                                       TAG_DONE)) == NULL)
+          {
+            E(DBF_FOLDER, "error while converting UTF8 data to local charset");
+            error = TRUE;
+          }
+          else
+            heap = line;
+        }
+
+        if(error == FALSE)
+        {
+          ULONG i;
+
+          for(i=0; i < fit.recordCount; i++)
+          {
+            struct IndexRecord record;
+            struct Mail *mail;
+
+            MA_GetIndexRecord(&record, table, &fit, i);
+
+            // the unconverted heap can be accessed directly by the record's offset,
+            // a converted heap must be walked sequentially as the lengths differ
+            if(systemIsUTF8 == TRUE)
+            {
+              if(record.moreOffset >= fit.heapSize || record.moreBytes > fit.heapSize - 1 - record.moreOffset)
+                line = NULL;
+              else
+                line = &heap[record.moreOffset];
+            }
+
+            if(line == NULL)
+            {
+              E(DBF_FOLDER, "invalid string block of record %ld", i);
+              *corrupt = TRUE;
+              break;
+            }
+
+            // create a new mail structure
+            if((mail = AllocMail()) == NULL)
+            {
+              error = TRUE;
+              break;
+            }
+
+            line = MA_ParseIndexLines(mail, line, record.moreLines);
+            MA_RecordToMail(mail, &record);
+
+            // add the new mail structure to the temporary folder, see
+            // MA_LoadIndexYIN8() for details
+            AddMailToFolderSimple(mail, tempFolder);
+            mail->Folder = folder;
+          }
+        }
+
+        if(systemIsUTF8 == FALSE && heap != &table[fit.heapOffset])
+        {
+          // free the codesets buffer
+          CodesetsFreeA(heap, NULL);
+        }
+      }
+    }
+
+    free(table);
+  }
+  else
+    error = TRUE;
+
+  RETURN(error);
+  return error;
+}
+
+///
+/// MA_DeleteJournal
+//  Deletes the index journal of a folder and deactivates journaling
+static void MA_DeleteJournal(struct Folder *folder)
+{
+  char journalFileName[SIZE_PATHFILE];
+
+  ENTER();
+
+  AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
+  DeleteFile(journalFileName);
+
+  folder->journalID = 0;
+  folder->journalSize = 0;
+
+  LEAVE();
+}
+
+///
+/// MA_ReadJournalHeader
+//  Opens the journal of a folder and reads its header. Returns the opened
+//  file if the journal belongs to the given index journal ID. A journal
+//  which belongs to the index but was written by an older version cannot
+//  be replayed and is reported as outdated.
+static FILE *MA_ReadJournalHeader(const struct Folder *folder, const ULONG journalID, struct FJournal *fj, BOOL *outdated)
+{
+  char journalFileName[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
+
+  if((fh = fopen(journalFileName, "r")) != NULL)
+  {
+    if(fread(fj, sizeof(*fj), 1, fh) != 1 || fj->ID != FJOURNAL_VER || fj->journalID != journalID)
+    {
+      if(outdated != NULL && fj->journalID == journalID && fj->ID != FJOURNAL_VER)
+      {
+        W(DBF_FOLDER, "outdated journal '%s' with version %08lx", journalFileName, fj->ID);
+        *outdated = TRUE;
+      }
+      else
+        W(DBF_FOLDER, "ignoring stale journal '%s'", journalFileName);
+
+      fclose(fh);
+      fh = NULL;
+    }
+  }
+
+  RETURN(fh);
+  return fh;
+}
+
+///
+/// GetMailFileHashOps
+//  The operators of the mail file table. The keys are not copied, they point
+//  to the MailFile member of the mails in the table.
+static const struct HashTableOps *GetMailFileHashOps(void)
+{
+  static const struct HashTableOps mailFileHashOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    StringHashHashKey,
+    StringHashMatchEntry,
+    DefaultHashMoveEntry,
+    DefaultHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    NULL
+  };
+
+  ENTER();
+  RETURN(&mailFileHashOps);
+  return &mailFileHashOps;
+}
+
+///
+/// MA_AddReplayMailFile
+//  Adds a mail node to the mail file table. Returns FALSE in case of
+//  insufficient memory.
+static BOOL MA_AddReplayMailFile(struct HashTable *mailFiles, struct MailNode *mnode)
+{
+  struct MailFileHashEntry *entry;
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if((entry = (struct MailFileHashEntry *)HashTableOperate(mailFiles, mnode->mail->MailFile, htoAdd)) != NULL)
+  {
+    entry->mailFile = mnode->mail->MailFile;
+    entry->mnode = mnode;
+    success = TRUE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_RemoveReplayMail
+//  Removes a mail from the temporary folder of a journal replay, including
+//  its statistics
+static void MA_RemoveReplayMail(struct Folder *tempFolder, struct HashTable *mailFiles, struct MailFileHashEntry *entry)
+{
+  struct MailNode *mnode = entry->mnode;
+  struct Mail *mail = mnode->mail;
+
+  ENTER();
+
+  tempFolder->Total--;
+  tempFolder->Size -= mail->Size;
+
+  if(hasStatusNew(mail))
+    tempFolder->New--;
+
+  if(!hasStatusRead(mail))
+    tempFolder->Unread--;
+
+  if(hasStatusSent(mail))
+    tempFolder->Sent--;
+
+  // the key points into the mail, hence the entry must go first
+  HashTableRawRemove(mailFiles, &entry->hash);
+
+  RemoveMailNode(tempFolder->messages, mnode);
+  DeleteMailNode(mnode);
+
+  LEAVE();
+}
+
+///
+/// MA_ReplayJournalEntry
+//  Applies a single journal entry to the mails loaded from the index. The
+//  mails are looked up by their file names in the mailFiles table, which
+//  is kept up to date with the temporary folder. Replaying an entry twice
+//  has no further effect, because an index might already contain a change
+//  which is recorded in the journal belonging to it as well.
+static BOOL MA_ReplayJournalEntry(struct Folder *folder, struct Folder *tempFolder, struct HashTable *mailFiles, struct JournalEntry *entry, char *more)
+{
+  BOOL success = TRUE;
+  struct MailFileHashEntry *fentry;
+
+  ENTER();
+
+  // make sure the mail file names are NUL terminated
+  entry->record.mailFile[sizeof(entry->record.mailFile)-1] = '\0';
+  entry->newMailFile[sizeof(entry->newMailFile)-1] = '\0';
+
+  fentry = (struct MailFileHashEntry *)HashTableOperate(mailFiles, entry->record.mailFile, htoLookup);
+  if(fentry != NULL && HASH_ENTRY_IS_LIVE(&fentry->hash) == FALSE)
+    fentry = NULL;
+
+  if(entry->type == JET_ADD)
+  {
+    BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+    char *buf;
+
+    // a mail which is known already is replaced by the journal's version
+    if(fentry != NULL)
+    {
+      D(DBF_FOLDER, "journal adds known mail '%s' to folder '%s' again", entry->record.mailFile, folder->Name);
+      MA_RemoveReplayMail(tempFolder, mailFiles, fentry);
+    }
+
+    if(systemIsUTF8 == TRUE)
+    {
+      // no conversion required
+      buf = more;
+    }
+    else
+    {
+      // convert the utf8 encoded buffer to the local charset
+      buf = CodesetsUTF8ToStr(CSA_Source,          more,
+                              CSA_SourceLen,       entry->record.moreBytes,
+                              CSA_DestCodeset,     G->systemCodeset,
+                              CSA_MapForeignChars, C->MapForeignChars,
+                              TAG_DONE);
+    }
+
+    if(buf != NULL)
+    {
+      struct Mail *mail;
+      struct MailNode *mnode;
+
+      if((mail = AllocMail()) != NULL)
+      {
+        MA_ParseIndexLines(mail, buf, entry->record.moreLines);
+        MA_RecordToMail(mail, &entry->record);
+
+        AddMailToFolderSimple(mail, tempFolder);
+        mail->Folder = folder;
+
+        // the new node is the last one of the list
+        if((mnode = (struct MailNode *)GetTail((struct List *)&tempFolder->messages->list)) != NULL && mnode->mail == mail)
+          success = MA_AddReplayMailFile(mailFiles, mnode);
+        else
+          success = FALSE;
+      }
+      else
+        success = FALSE;
+
+      if(systemIsUTF8 == FALSE)
+        CodesetsFreeA(buf, NULL);
+    }
+    else
+      success = FALSE;
+  }
+  else if(fentry != NULL)
+  {
+    // all other entries refer to an already existing mail
+    if(entry->type == JET_REMOVE)
+    {
+      MA_RemoveReplayMail(tempFolder, mailFiles, fentry);
+    }
+    else
+    {
+      struct MailNode *mnode = fentry->mnode;
+      struct Mail *mail = mnode->mail;
+
+      // remove the mail's current status from the stats
+      tempFolder->Size -= mail->Size;
+
+      if(hasStatusNew(mail))
+        tempFolder->New--;
+
+      if(!hasStatusRead(mail))
+        tempFolder->Unread--;
+
+      if(hasStatusSent(mail))
+        tempFolder->Sent--;
+
+      // take over all fixed members, as these might have been changed
+      // after the mail was added (i.e. the transfer date)
+      MA_RecordToMail(mail, &entry->record);
+
+      if(entry->type == JET_RENAME)
+      {
+        // the key changes together with the file name
+        HashTableRawRemove(mailFiles, &fentry->hash);
+        strlcpy(mail->MailFile, entry->newMailFile, sizeof(mail->MailFile));
+        success = MA_AddReplayMailFile(mailFiles, mnode);
+      }
+
+      // add the mail's new status to the stats again
+      tempFolder->Size += mail->Size;
+
+      if(hasStatusNew(mail))
+        tempFolder->New++;
+
+      if(!hasStatusRead(mail))
+        tempFolder->Unread++;
+
+      if(hasStatusSent(mail))
+        tempFolder->Sent++;
+    }
+  }
+  else
+    W(DBF_FOLDER, "journal entry %ld refers to unknown mail '%s' in folder '%s'", entry->type, entry->record.mailFile, folder->Name);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_ReplayJournal
+//  Replays all entries of a folder's journal on top of the mails just
+//  loaded from the index. Returns FALSE if the journal could not be
+//  replayed completely.
+static BOOL MA_ReplayJournal(struct Folder *folder, struct Folder *tempFolder, const ULONG journalID)
+{
+  BOOL success = TRUE;
+  BOOL outdated = FALSE;
+  struct FJournal fj;
+  struct HashTable mailFiles;
+  FILE *fh;
+
+  ENTER();
+
+  memset(&fj, 0, sizeof(fj));
+
+  if((fh = MA_ReadJournalHeader(folder, journalID, &fj, &outdated)) != NULL)
+  {
+    struct JournalEntry entry;
+    ULONG numEntries = 0;
+    ULONG offset = sizeof(fj);
+
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    // look up the mails by their file names in a table instead of walking
+    // the complete mail list for every single entry
+    if(HashTableInit(&mailFiles, GetMailFileHashOps(), NULL, sizeof(struct MailFileHashEntry), tempFolder->messages->count) == TRUE)
+    {
+      struct MailNode *mnode;
+
+      ForEachMailNode(tempFolder->messages, mnode)
+      {
+        if(MA_AddReplayMailFile(&mailFiles, mnode) == FALSE)
+        {
+          success = FALSE;
+          break;
+        }
+      }
+    }
+    else
+    {
+      // make the cleanup below a no-op
+      memset(&mailFiles, 0, sizeof(mailFiles));
+      success = FALSE;
+    }
+
+    while(success == TRUE && fread(&entry, sizeof(entry), 1, fh) == 1)
+    {
+      if(entry.type == JET_ADD)
+      {
+        char more[SIZE_LARGE];
+
+        if(entry.record.moreBytes > sizeof(more)-1 || fread(more, entry.record.moreBytes, 1, fh) != 1)
+        {
+          W(DBF_FOLDER, "incomplete journal entry %ld of folder '%s'", numEntries, folder->Name);
+          success = FALSE;
+        }
+        else
+        {
+          more[entry.record.moreBytes] = '\0';
+          success = MA_ReplayJournalEntry(folder, tempFolder, &mailFiles, &entry, more);
+          offset += entry.record.moreBytes;
+        }
+      }
+      else if(entry.type == JET_REMOVE || entry.type == JET_STATUS || entry.type == JET_RENAME)
+        success = MA_ReplayJournalEntry(folder, tempFolder, &mailFiles, &entry, NULL);
+      else
+      {
+        W(DBF_FOLDER, "unknown journal entry type %ld in folder '%s'", entry.type, folder->Name);
+        success = FALSE;
+      }
+
+      offset += sizeof(entry);
+      numEntries++;
+    }
+
+    HashTableCleanup(&mailFiles);
+
+    if(success == TRUE)
+    {
+      // a partially written entry at the end is treated as failure as well,
+      // because further entries must not be appended to it
+      if(ferror(fh) != 0 || ftell(fh) != (long)offset)
+      {
+        W(DBF_FOLDER, "incomplete journal of folder '%s' after %ld entries", folder->Name, numEntries);
+        success = FALSE;
+      }
+      else
+      {
+        folder->journalSize = offset;
+        D(DBF_FOLDER, "replayed %ld journal entries (%ld bytes) of folder '%s'", numEntries, offset, folder->Name);
+      }
+    }
+
+    fclose(fh);
+  }
+  else if(outdated == TRUE)
+  {
+    // the changes recorded in an outdated journal are lost
+    success = FALSE;
+  }
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// MA_AppendJournal
+//  Appends a single entry to the journal of a folder. The journal header
+//  is rewritten with the current folder statistics afterwards. If the
+//  folder has no active journal or the journal cannot be written the index
+//  is expired instead, which will cause a complete rewrite later.
+static void MA_AppendJournal(struct Folder *folder, const struct JournalEntry *entry, const UTF8 *more)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  // mails may be added and renamed by our worker threads as well, hence
+  // the global semaphore serializes all journal writes
+  ObtainSemaphore(G->globalSemaphore);
+
+  if(folder->journalID != 0 && folder->LoadedMode == LM_VALID)
   {
-    struct User *user;
+    char journalFileName[SIZE_PATHFILE];
+    FILE *fh;
 
-    user = US_GetCurrentUser();
+    AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
 
-    if(Stricmp(fo->Password, user->Password) == 0)
-    {
-      D(DBF_FOLDER, "folder '%s' and user '%s' share the same password", fo->Name, user->Name);
-      success = TRUE;
-    }
-    else
+    // append to an existing journal or start a new one
+    if((fh = fopen(journalFileName, folder->journalSize > 0 ? "r+" : "w")) != NULL)
     {
-      BOOL retry = TRUE;
-      char prompt[SIZE_LARGE];
+      struct FJournal fj;
+
+      memset(&fj, 0, sizeof(fj));
+      fj.ID = FJOURNAL_VER;
+      fj.journalID = folder->journalID;
+      fj.Total = folder->Total;
+      fj.New = folder->New;
+      fj.Unread = folder->Unread;
+      fj.Size = folder->Size;
+
+      // a new journal gets its header first, then the entry is appended
+      // and finally the header is updated in place
+      if((folder->journalSize > 0 || fwrite(&fj, sizeof(fj), 1, fh) == 1) &&
+         fseek(fh, 0, SEEK_END) == 0 &&
+         fwrite(entry, sizeof(*entry), 1, fh) == 1 &&
+         (entry->type != JET_ADD || fwrite(more, entry->record.moreBytes, 1, fh) == 1))
+      {
+        folder->journalSize = ftell(fh);
 
-      snprintf(prompt, sizeof(prompt), tr(MSG_MA_GetFolderPass), fo->Name);
+        if(fseek(fh, 0, SEEK_SET) == 0 && fwrite(&fj, sizeof(fj), 1, fh) == 1)
+          success = TRUE;
+      }
 
-      do
-      {
-        char passwd[SIZE_PASSWORD];
+      if(fclose(fh) != 0)
+        success = FALSE;
+    }
 
-        passwd[0] = '\0';
-        if(StringRequest(passwd, SIZE_PASSWORD, tr(MSG_Folder), prompt, tr(MSG_Okay), NULL, tr(MSG_Cancel), TRUE, win) > 0)
-          // try again if the password doesn't match
-          success = (Stricmp(passwd, fo->Password) == 0);
-        else
-          // the user cancelled the requester, no more tries
-          retry = FALSE;
+    if(success == TRUE)
+    {
+      // let the next regular flush of the folder indexes rewrite a grown journal
+      // into a fresh index
+      if(folder->journalSize > FJOURNAL_COMPACTSIZE && !isModified(folder))
+      {
+        D(DBF_FOLDER, "journal of folder '%s' exceeds %ld bytes, compacting on next flush", folder->Name, FJOURNAL_COMPACTSIZE);
+        setFlag(folder->Flags, FOFL_MODIFY);
       }
-      while(success == FALSE && retry);
     }
+    else
+      E(DBF_FOLDER, "writing journal entry %ld to '%s' failed", entry->type, journalFileName);
   }
 
-  RETURN(success);
-  return success;
+  ReleaseSemaphore(G->globalSemaphore);
+
+  // fall back to a complete rewrite of the index
+  if(success == FALSE)
+    MA_ExpireIndex(folder);
+
+  LEAVE();
 }
 
 ///
-/// MA_ValidateStatus
-//  Avoids invalid status values
-static void MA_ValidateStatus(struct Folder *folder)
+/// MA_JournalAddMail
+//  Records a mail which was added to its folder
+void MA_JournalAddMail(const struct Mail *mail)
 {
+  struct JournalEntry entry;
+  char buf[SIZE_LARGE];
+  UTF8 *utf8buf;
+  ULONG length = 0;
+
   ENTER();
 
-  // the whole job only makes sense if there are new mails at all
-  if(folder->New > 0)
+  memset(&entry, 0, sizeof(entry));
+  entry.type = JET_ADD;
+  MA_MailToRecord(&entry.record, mail);
+
+  if((utf8buf = MA_CreateIndexLines(mail, buf, sizeof(buf), &length)) != NULL)
   {
-    BOOL sent = isSentFolder(folder);
+    entry.record.moreBytes = length;
+    entry.record.moreLines = COMPRMAIL_MORELINES;
 
-    // mark new mails as unread during the startup phase only, but not upon reloading a folder index
-    if(sent == TRUE || (C->UpdateNewMail == TRUE && G->InStartupPhase == TRUE))
-    {
-      struct MailNode *mnode;
+    MA_AppendJournal(mail->Folder, &entry, utf8buf);
 
-      D(DBF_FOLDER, "validating status of new messages in folder '%s'", folder->Name);
+    MA_FreeIndexLines(utf8buf, buf);
+  }
+  else
+    MA_ExpireIndex(mail->Folder);
 
-      LockMailListShared(folder->messages);
+  LEAVE();
+}
 
-      ForEachMailNode(folder->messages, mnode)
-      {
-        struct Mail *mail = mnode->mail;
+///
+/// MA_JournalRemoveMail
+//  Records a mail which was removed from the given folder
+void MA_JournalRemoveMail(const struct Mail *mail, struct Folder *folder)
+{
+  struct JournalEntry entry;
 
-        if(hasStatusNew(mail))
-        {
-          if(sent == TRUE)
-          {
-            D(DBF_FOLDER, "set status 'sent' of mail with subject '%s'", mail->Subject);
-            setStatusToSent(mail);
-          }
-          else
-          {
-            D(DBF_FOLDER, "set status 'unread' of mail with subject '%s'", mail->Subject);
-            setStatusToUnread(mail);
-          }
-        }
-      }
+  ENTER();
 
-      UnlockMailList(folder->messages);
-    }
-  }
+  memset(&entry, 0, sizeof(entry));
+  entry.type = JET_REMOVE;
+  MA_MailToRecord(&entry.record, mail);
+
+  MA_AppendJournal(folder, &entry, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalMailStatus
+//  Records a status change of a mail
+void MA_JournalMailStatus(const struct Mail *mail)
+{
+  struct JournalEntry entry;
+
+  ENTER();
+
+  memset(&entry, 0, sizeof(entry));
+  entry.type = JET_STATUS;
+  MA_MailToRecord(&entry.record, mail);
+
+  MA_AppendJournal(mail->Folder, &entry, NULL);
+
+  LEAVE();
+}
+
+///
+/// MA_JournalRenameMail
+//  Records a renamed mail file, the mail already carries its new name
+void MA_JournalRenameMail(const struct Mail *mail, const char *oldMailFile)
+{
+  struct JournalEntry entry;
+
+  ENTER();
+
+  memset(&entry, 0, sizeof(entry));
+  entry.type = JET_RENAME;
+  MA_MailToRecord(&entry.record, mail);
+  strlcpy(entry.record.mailFile, oldMailFile, sizeof(entry.record.mailFile));
+  strlcpy(entry.newMailFile, mail->MailFile, sizeof(entry.newMailFile));
+
+  MA_AppendJournal(mail->Folder, &entry, NULL);
 
   LEAVE();
 }
 
 ///
 /// MA_LoadIndex
-//  Loads a folder index from disk
+//  Loads a folder index from disk and replays its journal
 enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
 {
   char indexFileName[SIZE_PATHFILE];
@@ -276,6 +1409,9 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
   enum LoadedMode indexloaded = LM_UNLOAD;
   BOOL corrupt = FALSE;
   BOOL error = FALSE;
+  BOOL convert = FALSE;
+  BOOL compact = FALSE;
+  BOOL expire = FALSE;
 
   ENTER();
 
@@ -303,7 +1439,7 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
         E(DBF_FOLDER, "error while loading struct FIndex from .index file");
         error = TRUE;
       }
-      else if(fi.ID == FINDEX_VER)
+      else if(fi.ID == FINDEX_VER || fi.ID == FINDEX_VER_YIN8)
       {
         folder->Total  = fi.Total;
         folder->New    = fi.New;
@@ -317,165 +1453,78 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
 
           ClearFolderMails(folder, TRUE);
 
+          // forget about any previous journal until we know the index is valid
+          folder->journalID = 0;
+          folder->journalSize = 0;
+
           // allocate a temporary folder structure to avoid having to lock the real folder's
           // mail list for each single mail we get from the index
           if((tempFolder = AllocFolder()) != NULL)
           {
-            BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
-
-            do
+            if(fi.ID == FINDEX_VER)
             {
-              struct Mail *mail;
-              struct ComprMail cmail;
-              char utf8buf[SIZE_LARGE];
-              char *buf;
-              char *line;
-              char *nextLine;
-              int lineNr;
-
-              if(fread(&cmail, sizeof(struct ComprMail), 1, fh) != 1)
-              {
-                // check if we are here because of an error or EOF
-                if(ferror(fh) != 0 || feof(fh) == 0)
-                {
-                  E(DBF_FOLDER, "error while loading ComprMail struct from .index file");
-                  error = TRUE;
-                }
-
-                // if we end up here it is just a EOF and no error.
-                break;
-              }
-
-              if(cmail.moreBytes > sizeof(utf8buf)-1)
-              {
-                ER_NewError(tr(MSG_ER_INDEX_CORRUPTED), indexFileName, folder->Name, ftell(fh), cmail.mailFile, cmail.moreBytes);
-                corrupt = TRUE;
-                break;
-              }
-
-              // read the moreBytes data
-              if(fread(utf8buf, cmail.moreBytes, 1, fh) != 1)
-              {
-                E(DBF_FOLDER, "fread error while reading index file");
-                error = TRUE;
-                break;
-              }
+              ULONG journalID = 0;
 
-              // make sure to NUL terminate the utf8 string
-              utf8buf[cmail.moreBytes] = '\0';
+              error = MA_LoadIndexTable(folder, tempFolder, fh, indexFileSize - sizeof(fi), &journalID, &corrupt);
 
-              if(systemIsUTF8 == TRUE)
+              // apply all changes recorded since the index was written
+              if(error == FALSE && corrupt == FALSE && journalID != 0)
               {
-                // no conversion required
-                buf = utf8buf;
-			  }
-			  else
-			  {
-                // convert the utf8 encoded buffer to the local charset
-                if((buf = CodesetsUTF8ToStr(CSA_Source,          utf8buf,
-                                            CSA_SourceLen,       cmail.moreBytes,
-                                            CSA_DestCodeset,     G->systemCodeset,
-                                            CSA_MapForeignChars, C->MapForeignChars,
-                                            TAG_DONE)) == NULL)
+                if(MA_ReplayJournal(folder, tempFolder, journalID) == TRUE)
                 {
-                  E(DBF_FOLDER, "error while converting UTF8 data to local charset");
-                  error = TRUE;
-                  break;
-                }
-              }
+                  folder->journalID = journalID;
 
-              // create a new mail structure
-              if((mail = AllocMail()) != NULL)
-              {
-                line = buf;
-                lineNr = 0;
-                do
+                  // a large journal is compacted upon the next flush
+                  if(folder->journalSize > FJOURNAL_COMPACTSIZE)
+                    compact = TRUE;
+                }
+                else
                 {
-                  if((nextLine = strchr(line, '\n')) != NULL)
-                    *nextLine++ = '\0';
-
-                  lineNr++;
-
-                  switch(lineNr)
-                  {
-                    case 1:
-                      strlcpy(mail->Subject, line, sizeof(mail->Subject));
-                    break;
-
-                    case 2:
-                      strlcpy(mail->From.Address, line, sizeof(mail->From.Address));
-                    break;
-
-                    case 3:
-                      strlcpy(mail->From.RealName, line, sizeof(mail->From.RealName));
-                    break;
-
-                    case 4:
-                      strlcpy(mail->To.Address, line, sizeof(mail->To.Address));
-                    break;
-
-                    case 5:
-                      strlcpy(mail->To.RealName, line, sizeof(mail->To.RealName));
-                    break;
-
-                    case 6:
-                      strlcpy(mail->ReplyTo.Address, line, sizeof(mail->ReplyTo.Address));
-                    break;
-
-                    case 7:
-                      strlcpy(mail->ReplyTo.RealName, line, sizeof(mail->ReplyTo.RealName));
-                    break;
-
-                    case 8:
-                      strlcpy(mail->MailAccount, line, sizeof(mail->MailAccount));
-                    break;
-                  }
-
-                  line = nextLine;
+                  // the state on disk is unreliable now, so let the index be
+                  // rewritten completely
+                  W(DBF_FOLDER, "journal of folder '%s' could not be replayed completely", folder->Name);
+                  MA_DeleteJournal(folder);
+                  expire = TRUE;
                 }
-                while(line != NULL && lineNr < COMPRMAIL_MORELINES);
-
-                mail->mflags = cmail.mflags;
-                mail->sflags = cmail.sflags;
-                // we have to make sure that the volatile flag field isn't loaded
-                setVOLValue(mail, 0);
-                strlcpy(mail->MailFile, cmail.mailFile, sizeof(mail->MailFile));
-                mail->Date = cmail.date;
-                mail->transDate = cmail.transDate;
-                mail->cMsgID = cmail.cMsgID;
-                mail->cIRTMsgID = cmail.cIRTMsgID;
-                mail->Size = cmail.size;
-
-                // finally add the new mail structure to the temporary folder
-                // no message list locking or index expiring is necessary here,
-                // because it is a temporary folder which is not publically known
-                AddMailToFolderSimple(mail, tempFolder);
-
-                // the AddMailToFolderSimple() call set the mail's folder pointer to the
-                // temporary folder. But since this is a temporary one only and will be
-                // invalid after leaving this function we must set the mail's folder
-                // pointer to the correct current folder.
-                mail->Folder = folder;
               }
-              else
-                error = TRUE;
+            }
+            else
+            {
+              D(DBF_FOLDER, "loading old 'YIN8' index of folder '%s'", folder->Name);
+              error = MA_LoadIndexYIN8(folder, tempFolder, fh, indexFileName, &corrupt);
 
-              if(systemIsUTF8 == FALSE)
-              {
-                // free the codesets buffer
-                CodesetsFreeA(buf, NULL);
-              }
+              // make sure the index is converted to the current format upon the next save
+              convert = TRUE;
             }
-            while(error == FALSE);
+
+            // if everything went well then move all mails from the temporary folder
+            // to the real folder
+            if(error == FALSE)
+              MoveFolderContents(folder, tempFolder);
+
+            // free the temporary folder in any case
+            FreeFolder(tempFolder);
           }
+          else
+            error = TRUE;
+        }
+        else if(fi.ID == FINDEX_VER)
+        {
+          struct FIndexTable fit;
+          struct FJournal fj;
+          FILE *jfh;
 
-          // if everything went well then move all mails from the temporary folder
-          // to the real folder
-          if(error == FALSE)
-            MoveFolderContents(folder, tempFolder);
+          // take the statistics from the journal, because they are more recent
+          if(fread(&fit, sizeof(fit), 1, fh) == 1 && fit.journalID != 0 &&
+             (jfh = MA_ReadJournalHeader(folder, fit.journalID, &fj, NULL)) != NULL)
+          {
+            folder->Total  = fj.Total;
+            folder->New    = fj.New;
+            folder->Unread = fj.Unread;
+            folder->Size   = fj.Size;
 
-          // free the temporary folder in any case
-          FreeFolder(tempFolder);
+            fclose(jfh);
+          }
         }
       }
 
@@ -487,6 +1536,10 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
 
       BusyEnd(busy);
       fclose(fh);
+
+      // an index without its journal does not reflect the folder anymore
+      if(expire == TRUE)
+        DeleteFile(indexFileName);
     }
     else if(errno != ENOENT)
     {
@@ -534,7 +1587,14 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
   else if(full == TRUE)
   {
     indexloaded = LM_VALID;
-    clearFlag(folder->Flags, FOFL_MODIFY);
+
+    // an old or expired index will be rewritten in the current format and
+    // a large journal will be compacted as soon as the folder is flushed or
+    // saved the next time
+    if(convert == TRUE || compact == TRUE || expire == TRUE)
+      setFlag(folder->Flags, FOFL_MODIFY);
+    else
+      clearFlag(folder->Flags, FOFL_MODIFY);
   }
 
   RETURN(indexloaded);
@@ -543,7 +1603,9 @@ enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full)
 
 ///
 /// MA_SaveIndex
-//  Saves a folder index to disk
+//  Saves a folder index to disk. The index is written as a fixed-stride
+//  record table followed by a string heap, so that it can be loaded with
+//  one single read operation. A previous journal is obsolete afterwards.
 BOOL MA_SaveIndex(struct Folder *folder)
 {
   BOOL success = FALSE;
@@ -560,101 +1622,168 @@ BOOL MA_SaveIndex(struct Folder *folder)
   {
     struct BusyNode *busy;
     struct FIndex fi;
-    struct MailNode *mnode;
+    struct FIndexTable fit;
+    struct IndexRecord *records;
+    char *heap = NULL;
+    ULONG heapSize = 0;
+    ULONG heapLen = 0;
+    ULONG count;
 
     setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
     busy = BusyBegin(BUSY_TEXT);
     BusyText(busy, tr(MSG_BusySavingIndex), folder->Name);
 
-    // lets prepare the Folder Index struct and write it out
-    // we clear it first, so that the reserved field is also 0
-    memset(&fi, 0, sizeof(struct FIndex));
-    fi.ID = FINDEX_VER;
-    fi.Total = folder->Total;
-    fi.New = folder->New;
-    fi.Unread = folder->Unread;
-    fi.Size = folder->Size;
+    // the journal lock is held until the new journal ID is installed, so
+    // that no change made after the snapshot below ends up in the journal
+    // which is deleted afterwards
+    ObtainSemaphore(G->globalSemaphore);
 
-    // write the index header out first
-    if(fwrite(&fi, sizeof(fi), 1, fh) == 1)
+    LockMailListShared(folder->messages);
+
+    // the index will reflect the mail list as it is right now, hence every
+    // change made to the folder after this point must flag it as modified
+    // again. Clearing the flag only after the index has been written would
+    // lose these changes.
+    clearFlag(folder->Flags, FOFL_MODIFY);
+
+    // allocate the record table for all mails at once, we need at
+    // least one record to avoid a zero sized allocation
+    count = folder->messages->count;
+    if((records = calloc(count > 0 ? count : 1, sizeof(*records))) != NULL)
     {
-      BOOL systemIsUTF8 = (G->systemCodeset != NULL && G->systemCodeset->name != NULL && stricmp(G->systemCodeset->name, "utf-8") == 0);
+      struct MailNode *mnode;
+      ULONG i = 0;
 
       // assume success at first
       success = TRUE;
 
-      LockMailListShared(folder->messages);
       ForEachMailNode(folder->messages, mnode)
       {
         struct Mail *mail = mnode->mail;
-        struct ComprMail cmail;
         char buf[SIZE_LARGE];
         UTF8 *utf8buf;
+        ULONG utf8len = 0;
 
-        // create the moreBytes string we append at the end
-        snprintf(buf, sizeof(buf), "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
-                                   mail->Subject,
-                                   mail->From.Address, mail->From.RealName,
-                                   mail->To.Address, mail->To.RealName,
-                                   mail->ReplyTo.Address, mail->ReplyTo.RealName,
-                                   mail->MailAccount);
-
-        if(systemIsUTF8 == TRUE)
-        {
-          // no conversion required;
-          utf8buf = (UTF8 *)buf;
-		}
-		else
-		{
-          // convert the buffer string to UTF8
-          // the length of the generated string is directly put into the moreBytes variable
-          utf8buf = CodesetsUTF8Create(CSA_Source, buf,
-                                       CSA_SourceCodeset, G->systemCodeset,
-                                       CSA_DestLenPtr, &cmail.moreBytes,
-                                       TAG_DONE);
-        }
-
-        if(utf8buf != NULL)
+        // create the string block we append to the heap
+        if((utf8buf = MA_CreateIndexLines(mail, buf, sizeof(buf), &utf8len)) != NULL)
         {
-          strlcpy(cmail.mailFile, mail->MailFile, sizeof(cmail.mailFile));
-          cmail.date = mail->Date;
-          cmail.transDate = mail->transDate;
-          cmail.sflags = mail->sflags;
-          cmail.mflags = mail->mflags;
-          // we have to make sure that the volatile flag field isn't saved
-          setVOLValue(&cmail, 0);
-          cmail.cMsgID = mail->cMsgID;
-          cmail.cIRTMsgID = mail->cIRTMsgID;
-          cmail.size = mail->Size;
-
-          if(fwrite(&cmail, sizeof(cmail), 1, fh) != 1 ||
-             fwrite(utf8buf, cmail.moreBytes, 1, fh) != 1)
+          // make sure the heap is large enough for the new block and the final NUL byte
+          if(heapLen + utf8len + 1 > heapSize)
           {
-            E(DBF_FOLDER, "couldn't write index data of mail '%s'", cmail.mailFile);
-            success = FALSE;
+            char *newHeap;
+            ULONG newSize = (heapSize > 0) ? heapSize : SIZE_FILEBUF;
+
+            while(heapLen + utf8len + 1 > newSize)
+              newSize *= 2;
+
+            if((newHeap = realloc(heap, newSize)) != NULL)
+            {
+              heap = newHeap;
+              heapSize = newSize;
+            }
+            else
+              success = FALSE;
           }
 
-          if(systemIsUTF8 == FALSE)
+          if(success == TRUE)
           {
-            // free the codesets buffer
-            CodesetsFreeA(utf8buf, NULL);
+            memcpy(&heap[heapLen], utf8buf, utf8len);
+
+            MA_MailToRecord(&records[i], mail);
+            records[i].moreOffset = heapLen;
+            records[i].moreBytes = utf8len;
+            records[i].moreLines = COMPRMAIL_MORELINES;
+
+            heapLen += utf8len;
           }
+
+          MA_FreeIndexLines(utf8buf, buf);
         }
         else
           success = FALSE;
 
         // break out if something went wrong
         if(success == FALSE)
+        {
+          E(DBF_FOLDER, "couldn't prepare index data of mail '%s'", mail->MailFile);
           break;
+        }
+
+        i++;
       }
 
-      UnlockMailList(folder->messages);
+      // the number of written records must match the number of mails
+      count = i;
+    }
 
-      clearFlag(folder->Flags, FOFL_MODIFY);
+    // lets prepare the Folder Index struct while the statistics still
+    // match the snapshot, we clear it first, so that the reserved field
+    // is also 0
+    memset(&fi, 0, sizeof(struct FIndex));
+    fi.ID = FINDEX_VER;
+    fi.Total = folder->Total;
+    fi.New = folder->New;
+    fi.Unread = folder->Unread;
+    fi.Size = folder->Size;
+
+    UnlockMailList(folder->messages);
+
+    if(success == TRUE)
+    {
+      struct TimeVal now;
+
+      // every index gets a new journal ID, so that a journal of a previous
+      // index will never be replayed on top of this one
+      GetSysTimeUTC(&now);
+
+      // the record table directly follows the directory, the heap
+      // directly follows the record table
+      memset(&fit, 0, sizeof(struct FIndexTable));
+      fit.recordCount = count;
+      fit.recordSize = sizeof(struct IndexRecord);
+      fit.recordOffset = sizeof(struct FIndexTable);
+      fit.heapOffset = fit.recordOffset + count * fit.recordSize;
+      fit.heapSize = heapLen + 1;
+      fit.journalID = (now.Seconds ^ (now.Microseconds << 12)) | 1;
+
+      if(fwrite(&fi, sizeof(fi), 1, fh) != 1 ||
+         fwrite(&fit, sizeof(fit), 1, fh) != 1 ||
+         (count > 0 && fwrite(records, sizeof(*records), count, fh) != count) ||
+         (heapLen > 0 && fwrite(heap, heapLen, 1, fh) != 1) ||
+         fputc('\0', fh) == EOF)
+      {
+        E(DBF_FOLDER, "couldn't write index data of folder '%s'", folder->Name);
+        success = FALSE;
+      }
     }
 
-    fclose(fh);
+    free(heap);
+    free(records);
+
+    if(fclose(fh) != 0)
+      success = FALSE;
+
+    // the old journal is either included in the new index now or
+    // obsolete because of a failure
+    MA_DeleteJournal(folder);
+
+    if(success == TRUE)
+    {
+      // all further changes will be recorded in a new journal
+      folder->journalID = fit.journalID;
+    }
+    else
+    {
+      // never leave a partially written index behind
+      DeleteFile(indexFileName);
+
+      // the folder must be saved again
+      setFlag(folder->Flags, FOFL_MODIFY);
+    }
+
+    ReleaseSemaphore(G->globalSemaphore);
+
     BusyEnd(busy);
   }
   else
@@ -734,7 +1863,9 @@ void MA_ExpireIndex(struct Folder *folder)
 {
   ENTER();
 
-  if(!isModified(folder))
+  // the index on disk is up to date as long as it is not modified
+  // or as long as its journal is still active
+  if(!isModified(folder) || folder->journalID != 0)
   {
     char indexFileName[SIZE_PATHFILE];
 
@@ -742,6 +1873,9 @@ void MA_ExpireIndex(struct Folder *folder)
     DeleteFile(indexFileName);
   }
 
+  // a journal without its index is useless
+  MA_DeleteJournal(folder);
+
   setFlag(folder->Flags, FOFL_MODIFY);
 
   LEAVE();
@@ -765,16 +1899,24 @@ void MA_RebuildIndexes(void)
     if(folder != NULL && !isGroupFolder(folder))
     {
       char indexFileName[SIZE_PATHFILE];
+      char journalFileName[SIZE_PATHFILE];
       ULONG dirDate;
       ULONG indexDate;
+      ULONG journalDate;
 
       AddPath(indexFileName, folder->Fullpath, ".index", sizeof(indexFileName));
+      AddPath(journalFileName, folder->Fullpath, ".journal", sizeof(journalFileName));
 
       // get date of the folder directory and the .index file
       // itself
       if(ObtainFileInfo(folder->Fullpath, FI_TIME, &dirDate) == TRUE &&
          ObtainFileInfo(indexFileName, FI_TIME, &indexDate) == TRUE)
       {
+        // an existing journal keeps the index up to date, so its
+        // date counts as the index date
+        if(indexDate > 0 && ObtainFileInfo(journalFileName, FI_TIME, &journalDate) == TRUE && journalDate > indexDate)
+          indexDate = journalDate;
+
         // only consider starting to rebuilding the .index if
         // either the date of the directory is greater than the
         // date of the .index file itself, or if there is no index
@@ -798,7 +1940,10 @@ void MA_RebuildIndexes(void)
               // make sure MA_GetIndex() is going to
               // rebuild it.
               if(indexDate > 0)
+              {
                 DeleteFile(indexFileName);
+                MA_DeleteJournal(folder);
+              }
 
               // then lets call GetIndex() to start rebuilding
               // the .index - but only if this folder is one of the folders
@@ -1205,21 +2350,19 @@ static unsigned long CompressMsgID(const char *msgid)
 struct Mail *FindMailByMsgID(struct Folder *folder, const char *msgid)
 {
   struct Mail *result = NULL;
-  struct MailNode *mnode;
-  unsigned long msgidCRC;
+  const struct MsgIDHashEntry *entry;
 
   ENTER();
 
-  msgidCRC = CompressMsgID(msgid);
-
   LockMailList(folder->messages);
 
-  ForEachMailNode(folder->messages, mnode)
+  // look up all mails with the same compressed message-id first
+  if((entry = FindMsgIDHashEntry(folder, CompressMsgID(msgid), MHT_MSGID)) != NULL)
   {
-    struct Mail *mail = mnode->mail;
+    struct Mail *mail;
+    ULONG i = 0;
 
-    // compare the compressed message-ids only for speed reasons
-    if(mail->cMsgID == msgidCRC)
+    while(result == NULL && (mail = GetMsgIDHashMail(entry, i)) != NULL)
     {
       // now go into detail and check if the full message-id matches
       struct ExtendedMail *email;
@@ -1235,8 +2378,7 @@ struct Mail *FindMailByMsgID(struct Folder *folder, const char *msgid)
         MA_FreeEMailStruct(email);
       }
 
-      if(result != NULL)
-        break;
+      i++;
     }
   }
 
@@ -1294,14 +2436,81 @@ BOOL MA_NewMailFile(const struct Folder *folder, char *fullPath, const size_t fu
 
   free(dateFilePart);
 
-  RETURN(result);
-  return result;
+  RETURN(result);
+  return result;
+}
+
+///
+/// GetHeaderLine
+// gets a NUL terminated line either from a file handle or from a memory
+// buffer and strips any trailing CR or LF, works like GetLine()
+static ssize_t GetHeaderLine(char **buffer, size_t *size, struct HeaderSource *src)
+{
+  ssize_t len;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  if(src->fh != NULL)
+  {
+    len = GetLine(buffer, size, src->fh);
+  }
+  else if(src->ptr < src->end)
+  {
+    const char *eol;
+    size_t lineLen;
+
+    // find the end of the current line, the last line may be unterminated
+    if((eol = memchr(src->ptr, '\n', src->end - src->ptr)) != NULL)
+      lineLen = eol - src->ptr;
+    else
+      lineLen = src->end - src->ptr;
+
+    // make sure the line plus the terminating NUL byte fits into the buffer
+    if(*buffer == NULL || *size < lineLen+1)
+    {
+      char *newBuffer;
+
+      if((newBuffer = realloc(*buffer, lineLen+1)) != NULL)
+      {
+        *buffer = newBuffer;
+        *size = lineLen+1;
+      }
+    }
+
+    if(*buffer != NULL && *size >= lineLen+1)
+    {
+      char *buf = *buffer;
+
+      memcpy(buf, src->ptr, lineLen);
+      len = lineLen;
+
+      // strip a possible CR character in front of the LF
+      if(eol != NULL && len > 0 && buf[len-1] == '\r')
+        len--;
+
+      buf[len] = '\0';
+
+      // skip the line including the LF
+      src->ptr += lineLen;
+      if(eol != NULL)
+        src->ptr++;
+    }
+    else
+    {
+      E(DBF_MAIL, "failed to allocate %ld bytes for a header line", lineLen+1);
+      len = -1;
+    }
+  }
+  else
+    len = -1;
+
+  return len;
 }
 
 ///
 /// MA_DetectUUE
 //  Checks if message contains an uuencoded file
-static BOOL MA_DetectUUE(FILE *fh)
+static BOOL MA_DetectUUE(struct HeaderSource *src)
 {
   char *buffer = NULL;
   size_t size = 0;
@@ -1311,7 +2520,7 @@ static BOOL MA_DetectUUE(FILE *fh)
 
   // Now we process the whole mailfile and check if there is any line that
   // starts with "begin xxx"
-  while(GetLine(&buffer, &size, fh) >= 7)
+  while(GetHeaderLine(&buffer, &size, src) >= 7)
   {
     // lets check for digit first because this will throw out many others first
     if(isdigit((int)buffer[6]) && strncmp(buffer, "begin ", 6) == 0)
@@ -1573,9 +2782,9 @@ static char *ValidateAddressLine(const char *line)
 }
 
 ///
-/// MA_ReadHeader
-//  Reads header lines of a message into memory
-BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, enum ReadHeaderMode mode)
+/// ReadHeader
+//  Reads header lines of a message from a file or a memory buffer
+static BOOL ReadHeader(const char *mailFile, struct HeaderSource *src, struct MinList *headerList, enum ReadHeaderMode mode)
 {
   BOOL success = FALSE;
 
@@ -1596,7 +2805,7 @@ BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, e
 
     // we read out the whole header line by line and
     // concatenate lines that are belonging together.
-    while((GetLine(&buffer, &size, fh) >= 0 && (++linesread, buffer[0] != '\0')) ||
+    while((GetHeaderLine(&buffer, &size, src) >= 0 && (++linesread, buffer[0] != '\0')) ||
           (finished == FALSE && (finished = TRUE)))
     {
       // if the start of this line is a space or a tabulator sign
@@ -1784,6 +2993,26 @@ BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, e
   return success;
 }
 
+///
+/// MA_ReadHeader
+//  Reads header lines of a message into memory
+BOOL MA_ReadHeader(const char *mailFile, FILE *fh, struct MinList *headerList, enum ReadHeaderMode mode)
+{
+  struct HeaderSource src;
+  BOOL success;
+
+  ENTER();
+
+  src.fh = fh;
+  src.ptr = NULL;
+  src.end = NULL;
+
+  success = ReadHeader(mailFile, &src, headerList, mode);
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// MA_FreeEMailStruct
 //  Frees an extended email structure
@@ -1793,6 +3022,8 @@ void MA_FreeEMailStruct(struct ExtendedMail *email)
 
   if(email != NULL)
   {
+    FreeMailStrings(&email->Mail);
+
     dstrfree(email->SenderInfo);
     email->SenderInfo = NULL;
 
@@ -2237,17 +3468,72 @@ static BOOL MA_ScanDate(struct Mail *mail, const char *date)
   return success;
 }
 ///
-/// MA_ExamineMail
-//  Parses the header lines of a message and fills email structure
-struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *file, const BOOL deep)
+/// MA_SetThreadLinks
+//  Determines the parent and the root of a mail's thread. Following the
+//  usual threading rules the last message ID in References: is the parent
+//  and the first one is the root of the thread. Without any References:
+//  the In-Reply-To: message ID is used as parent.
+static void MA_SetThreadLinks(struct Mail *mail, const char *references)
+{
+  ENTER();
+
+  mail->cParentMsgID = 0;
+  mail->cRootMsgID = 0;
+
+  if(references != NULL)
+  {
+    const char *p = references;
+    const char *first = NULL;
+    const char *last = NULL;
+
+    // find the first and the last complete message ID
+    while((p = strchr(p, '<')) != NULL)
+    {
+      const char *end;
+
+      if((end = strchr(p, '>')) == NULL)
+        break;
+
+      if(first == NULL)
+        first = p;
+      last = p;
+
+      p = end+1;
+    }
+
+    if(first != NULL)
+    {
+      mail->cRootMsgID = CompressMsgID(first);
+      mail->cParentMsgID = CompressMsgID(last);
+    }
+  }
+
+  if(mail->cParentMsgID == 0)
+    mail->cParentMsgID = mail->cIRTMsgID;
+
+  // a mail must not refer to itself
+  if(mail->cParentMsgID == mail->cMsgID)
+    mail->cParentMsgID = 0;
+  if(mail->cRootMsgID == mail->cMsgID || mail->cRootMsgID == mail->cParentMsgID)
+    mail->cRootMsgID = 0;
+
+  LEAVE();
+}
+
+///
+/// ExamineMail
+//  Parses the header lines of a message either from the given mail file or
+//  from the given memory buffer and fills email structure
+static struct ExtendedMail *ExamineMail(const struct Folder *folder, const char *file, const char *text, const size_t length, const BOOL deep)
 {
   struct ExtendedMail *email;
-  static struct Person pe;
+  struct Person pe;
   struct MinList headerList;
+  struct HeaderSource src;
   struct Mail *mail;
   char fullfile[SIZE_PATHFILE];
   BOOL dateFound = FALSE;
-  FILE *fh;
+  FILE *fh = NULL;
 
   ENTER();
 
@@ -2261,47 +3547,61 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
   }
 
   mail = &email->Mail;
-  strlcpy(mail->MailFile, file, sizeof(mail->MailFile));
+  InitMailStrings(mail);
 
-  GetMailFile(fullfile, sizeof(fullfile), folder, mail);
-  if((fh = fopen(fullfile, "r")) != NULL)
+  if(text != NULL)
   {
-    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+    // the mail is already in memory, the file name is used for messages only
+    strlcpy(fullfile, file, sizeof(fullfile));
+  }
+  else
+  {
+    strlcpy(mail->MailFile, file, sizeof(mail->MailFile));
 
-    // if the first three bytes are 'X' 'P' 'K', then this is an XPK packed
-    // file and we have to unpack it first.
-    if(fgetc(fh) == 'X' && fgetc(fh) == 'P' && fgetc(fh) == 'K')
+    GetMailFile(fullfile, sizeof(fullfile), folder, mail);
+    if((fh = fopen(fullfile, "r")) != NULL)
     {
-      char mailfile[SIZE_PATHFILE];
-
-      // temporary close the file
-      fclose(fh);
+      setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
-      GetMailFile(mailfile, sizeof(mailfile), folder, mail);
-      // then unpack the file with XPK routines.
-      if(StartUnpack(mailfile, fullfile, folder) == NULL)
+      // if the first three bytes are 'X' 'P' 'K', then this is an XPK packed
+      // file and we have to unpack it first.
+      if(fgetc(fh) == 'X' && fgetc(fh) == 'P' && fgetc(fh) == 'K')
       {
-        MA_FreeEMailStruct(email);
+        char mailfile[SIZE_PATHFILE];
 
-        E(DBF_MAIL, "couldn't unpack mailfile");
+        // temporary close the file
+        fclose(fh);
 
-        RETURN(NULL);
-        return NULL;
-      }
+        GetMailFile(mailfile, sizeof(mailfile), folder, mail);
+        // then unpack the file with XPK routines.
+        if(StartUnpack(mailfile, fullfile, folder) == NULL)
+        {
+          MA_FreeEMailStruct(email);
+
+          E(DBF_MAIL, "couldn't unpack mailfile");
 
-      // reopen it again.
-      if((fh = fopen(fullfile, "r")) != NULL)
-        setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+          RETURN(NULL);
+          return NULL;
+        }
+
+        // reopen it again.
+        if((fh = fopen(fullfile, "r")) != NULL)
+          setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+      }
+      else
+        rewind(fh); // rewind the file handle to the start
     }
     else
-      rewind(fh); // rewind the file handle to the start
+      E(DBF_MAIL, "couldn't open mail file for reading main header");
   }
-  else
-    E(DBF_MAIL, "couldn't open mail file for reading main header");
 
-  // check if the file handle is valid and then immediatly read in the
-  // header lines
-  if(fh != NULL && MA_ReadHeader(fullfile, fh, &headerList, RHM_MAINHEADER) == TRUE)
+  src.fh = fh;
+  src.ptr = text;
+  src.end = (text != NULL) ? text + length : NULL;
+
+  // check if the file handle or the buffer is valid and then immediatly
+  // read in the header lines
+  if((fh != NULL || text != NULL) && ReadHeader(fullfile, &src, &headerList, RHM_MAINHEADER) == TRUE)
   {
     BOOL foundFrom = FALSE;
     BOOL foundTo = FALSE;
@@ -2336,7 +3636,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
 
         // extract the main mail address
         ExtractAddress(value, &pe);
-        mail->From = pe;
+        SetMailPerson(&mail->From, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2387,7 +3687,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
          *p++ = '\0';
 
         ExtractAddress(value, &pe);
-        mail->ReplyTo = pe;
+        SetMailPerson(&mail->ReplyTo, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2456,7 +3756,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
             *p++ = '\0';
 
           ExtractAddress(value, &pe);
-          mail->To = pe;
+          SetMailPerson(&mail->To, pe.Address, pe.RealName);
 
           // we have to check if we can match the user identity
           // from the email address
@@ -2586,7 +3886,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
       }
       else if(stricmp(field, "subject") == 0)
       {
-        strlcpy(mail->Subject, Trim(value), sizeof(mail->Subject));
+        SetMailSubject(mail, Trim(value));
       }
       else if(stricmp(field, "message-id") == 0)
       {
@@ -2672,7 +3972,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
       }
       else if(stricmp(field, "x-yam-mailaccount") == 0)
       {
-        strlcpy(mail->MailAccount, value, sizeof(mail->MailAccount));
+        SetMailAccount(mail, value);
       }
       else if(deep == TRUE) // and if we end up here we check if we really have to go further
       {
@@ -2759,8 +4059,11 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
       }
     }
 
+    // now that all headers are known we can link the mail into its thread
+    MA_SetThreadLinks(mail, email->references);
+
     // if now the mail is still not MULTIPART we have to check for uuencoded attachments
-    if(!isMP_MixedMail(mail) && MA_DetectUUE(fh) == TRUE)
+    if(!isMP_MixedMail(mail) && MA_DetectUUE(&src) == TRUE)
       setFlag(mail->mflags, MFLAG_MP_MIXED);
 
     // in case we found no From: head line we try to construct a name
@@ -2780,7 +4083,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
 
         // extract the main mail address
         ExtractAddress(value, &pe);
-        mail->From = pe;
+        SetMailPerson(&mail->From, pe.Address, pe.RealName);
 
         // we have to check if we can match the user identity
         // from the email address
@@ -2827,7 +4130,8 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
     }
 
     // And now we close the Mailfile and clear the temporary headerList again
-    fclose(fh);
+    if(fh != NULL)
+      fclose(fh);
     ClearHeaderList(&headerList);
 
     // Now choose the user identity from the identities found in the loop
@@ -2860,7 +4164,7 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
     // completly the same like the from address we go and copy the realname as both
     // are the same.
     if(foundReplyTo == TRUE && mail->ReplyTo.RealName[0] != '\0' && stricmp(mail->ReplyTo.Address, mail->From.Address) == 0)
-      strlcpy(mail->ReplyTo.RealName, mail->From.RealName, sizeof(mail->ReplyTo.RealName));
+      SetMailPerson(&mail->ReplyTo, mail->ReplyTo.Address, mail->From.RealName);
 
     // if this function call has a folder of NULL then we are examining a virtual mail
     // which means this mail doesn't have any folder and also no filename that may contain
@@ -2975,6 +4279,14 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
         // convert the UTC transDate to a UTC mail Date
         TimeVal2DateStamp(&mail->transDate, &mail->Date, TZC_NONE);
       }
+      else if(text != NULL)
+      {
+        struct TimeVal now;
+
+        // a mail in memory has no file date, so we take the current time
+        GetSysTimeUTC(&now);
+        TimeVal2DateStamp(&now, &mail->Date, TZC_NONE);
+      }
       else
       {
         // and as a fallback we take the date of the mail file
@@ -2992,12 +4304,15 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
     }
 
     // lets calculate the mailSize out of the FileSize() function
-    if(ObtainFileInfo(fullfile, FI_SIZE, &size) == TRUE)
+    if(text != NULL)
+      mail->Size = length;
+    else if(ObtainFileInfo(fullfile, FI_SIZE, &size) == TRUE)
       mail->Size = size;
     else
       mail->Size = -1;
 
-    FinishUnpack(fullfile);
+    if(text == NULL)
+      FinishUnpack(fullfile);
 
     RETURN(email);
     return email;
@@ -3005,7 +4320,8 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
   else
     E(DBF_MAIL, "couldn't read/parse mail header of mail file '%s'", fullfile);
 
-  FinishUnpack(fullfile);
+  if(text == NULL)
+    FinishUnpack(fullfile);
 
   // finish up everything before we exit with an error
   if(fh != NULL)
@@ -3017,6 +4333,295 @@ struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *fil
   return NULL;
 }
 
+///
+/// MA_ExamineMail
+//  Parses the header lines of a mail file and fills email structure
+struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *file, const BOOL deep)
+{
+  struct ExtendedMail *email;
+
+  ENTER();
+
+  email = ExamineMail(folder, file, NULL, 0, deep);
+
+  RETURN(email);
+  return email;
+}
+
+///
+/// MA_ExamineMailBuffer
+//  Parses the header lines of a message kept in memory, i.e. the response
+//  to a POP3 TOP command, and fills email structure. The name is used for
+//  messages only.
+struct ExtendedMail *MA_ExamineMailBuffer(const char *name, const char *text, const size_t length, const BOOL deep)
+{
+  struct ExtendedMail *email;
+
+  ENTER();
+
+  // an empty response still must not be mistaken for a mail file
+  email = ExamineMail(NULL, name, (text != NULL) ? text : "", length, deep);
+
+  RETURN(email);
+  return email;
+}
+
+///
+/// NextScanEntry
+// get the number of the next mail file of a folder scan to be examined,
+// returns -1 if there is nothing left to do
+static LONG NextScanEntry(struct FolderScan *scan)
+{
+  LONG next = -1;
+
+  ENTER();
+
+  ObtainSemaphore(scan->semaphore);
+
+  if(scan->abort == FALSE && scan->nextEntry < scan->numEntries)
+    next = scan->nextEntry++;
+
+  ReleaseSemaphore(scan->semaphore);
+
+  RETURN(next);
+  return next;
+}
+
+///
+/// ExamineScanEntry
+// examine a single mail file of a folder scan
+static void ExamineScanEntry(struct FolderScan *scan, LONG i)
+{
+  struct ScanEntry *entry = &scan->entries[i];
+
+  ENTER();
+
+  D(DBF_FOLDER, "examining mail file '%s'", entry->name);
+
+  entry->email = MA_ExamineMail(scan->folder, entry->name, FALSE);
+
+  ObtainSemaphore(scan->semaphore);
+  scan->examinedEntries++;
+  ReleaseSemaphore(scan->semaphore);
+
+  LEAVE();
+}
+
+///
+/// ExamineMailFiles
+// examine the mail files of a folder scan until there is nothing left to do,
+// this is executed by the worker threads of MA_ScanMailBox()
+LONG ExamineMailFiles(struct FolderScan *scan)
+{
+  LONG examined = 0;
+  LONG i;
+
+  ENTER();
+
+  while((i = NextScanEntry(scan)) != -1)
+  {
+    ExamineScanEntry(scan, i);
+    examined++;
+
+    // stop taking further files if we have been aborted
+    if(ThreadWasAborted() == TRUE)
+      break;
+  }
+
+  // tell the main thread that we are done
+  ObtainSemaphore(scan->semaphore);
+  scan->activeWorkers--;
+  ReleaseSemaphore(scan->semaphore);
+
+  RETURN(examined);
+  return examined;
+}
+
+///
+/// AddScannedMail
+// add a mail found by MA_ScanMailBox() to the temporary folder
+static void AddScannedMail(struct Folder *folder, struct Folder *tempFolder, const struct ExtendedMail *email)
+{
+  struct Mail *newMail;
+
+  ENTER();
+
+  if((newMail = CloneMail(&email->Mail)) != NULL)
+  {
+    // add the mail to the temporary folder
+    AddMailToFolderSimple(newMail, tempFolder);
+
+    // the AddMailToFolderSimple() call set the mail's folder pointer to the
+    // temporary folder. But since this is a temporary one only and will be
+    // invalid after leaving this function we must set the mail's folder
+    // pointer to the correct current folder.
+    newMail->Folder = folder;
+
+    // if this new mail hasn't got a valid transDate we have to check if we
+    // have to take the fileDate as a fallback value.
+    if(newMail->transDate.Seconds == 0)
+    {
+      // only if it is _not_ a "waitforsend" and "hold" message we can take the fib_Date
+      // as the fallback
+      if(isDraftsFolder(folder) == FALSE && isOutgoingFolder(folder) == FALSE)
+      {
+        char mailfile[SIZE_PATHFILE];
+        struct DateStamp ds;
+
+        W(DBF_FOLDER, "no transfer date information found in mail file, using file date...");
+
+        GetMailFile(mailfile, sizeof(mailfile), NULL, newMail);
+        // obtain the datestamp information from  and as a fallback we take the date of the mail file
+        if(ObtainFileInfo(mailfile, FI_DATE, &ds) == TRUE)
+        {
+          // now convert the local TZ fib_Date to a UTC transDate
+          DateStamp2TimeVal(&ds, &newMail->transDate, TZC_LOCAL2UTC);
+        }
+
+        // then we update the mailfilename
+        MA_UpdateMailFile(newMail);
+      }
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// ScanMailFiles
+// examine all collected mail files of a folder scan with the help of some
+// worker threads and add the mails to the temporary folder in the order of
+// the directory
+static BOOL ScanMailFiles(struct FolderScan *scan, struct Folder *tempFolder, struct BusyNode *busy, long *processedFiles, long filecount)
+{
+  BOOL result = TRUE;
+  struct Folder *folder = scan->folder;
+  ULONG threadSig = (1UL << G->threadPort->mp_SigBit);
+  ULONG workers;
+  LONG i;
+
+  ENTER();
+
+  scan->nextEntry = 0;
+  scan->examinedEntries = 0;
+
+  // let the worker threads do most of the work, but don't bother them
+  // with just a few files
+  for(workers = 0; workers < SCAN_THREADS && scan->numEntries > (workers + 1) * SCAN_MIN_FILES_PER_THREAD; workers++)
+  {
+    ObtainSemaphore(scan->semaphore);
+    scan->activeWorkers++;
+    ReleaseSemaphore(scan->semaphore);
+
+    if(DoAction(NULL, TA_ExamineMails, TT_ExamineMails_Scan, scan,
+                                       TAG_DONE) == NULL)
+    {
+      ObtainSemaphore(scan->semaphore);
+      scan->activeWorkers--;
+      ReleaseSemaphore(scan->semaphore);
+      break;
+    }
+  }
+
+  D(DBF_FOLDER, "examining %ld files with %ld worker threads", scan->numEntries, workers);
+
+  // the main thread examines files as well, but it also keeps the GUI alive
+  while((i = NextScanEntry(scan)) != -1)
+  {
+    ExamineScanEntry(scan, i);
+
+    // set the gauge and check the stopButton status as well.
+    if(BusyProgress(busy, *processedFiles + scan->examinedEntries, filecount) == FALSE)
+    {
+      D(DBF_FOLDER, "scan process aborted by user");
+
+      ObtainSemaphore(scan->semaphore);
+      scan->abort = TRUE;
+      ReleaseSemaphore(scan->semaphore);
+
+      result = FALSE;
+    }
+
+    // give the GUI the chance to refresh
+    DoMethod(G->App, MUIM_Application_InputBuffered);
+  }
+
+  // wait until all worker threads have finished their last file
+  while(scan->activeWorkers != 0)
+  {
+    Wait(threadSig);
+    HandleThreads(TRUE);
+  }
+
+  *processedFiles += scan->numEntries;
+
+  // now add the mails in the order of the directory
+  for(i = 0; result == TRUE && i < (LONG)scan->numEntries; i++)
+  {
+    struct ScanEntry *entry = &scan->entries[i];
+    struct ExtendedMail *email = entry->email;
+
+    entry->email = NULL;
+
+    while(email == NULL && scan->ignoreInvalids == FALSE)
+    {
+      // if the MA_ExamineMail() operation failed we
+      // warn the user and ask him how to proceed with
+      // the file
+      int res = MUI_Request(G->App, G->MA != NULL ? G->MA->GUI.WI : NULL, MUIF_NONE,
+                           tr(MSG_MA_INVALIDMFILE_TITLE),
+                           tr(MSG_MA_INVALIDMFILE_BT),
+                           tr(MSG_MA_INVALIDMFILE),
+                           entry->name, folder->Name);
+
+      if(res == 0) // cancel/ESC
+      {
+        result = FALSE;
+        break;
+      }
+      else if(res == 1) // Retry
+        email = MA_ExamineMail(folder, entry->name, FALSE);
+      else if(res == 2) // Ignore
+        break;
+      else if(res == 3) // Ignore All
+      {
+        scan->ignoreInvalids = TRUE;
+        break;
+      }
+      else if(res == 4) // Delete
+      {
+        char path[SIZE_PATHFILE+1];
+
+        AddPath(path, folder->Fullpath, entry->name, sizeof(path));
+        DeleteFile(path);
+
+        break;
+      }
+    }
+
+    if(email != NULL)
+    {
+      AddScannedMail(folder, tempFolder, email);
+      MA_FreeEMailStruct(email);
+    }
+  }
+
+  // free everything which was left over in case of an error
+  for(i = 0; i < (LONG)scan->numEntries; i++)
+  {
+    if(scan->entries[i].email != NULL)
+    {
+      MA_FreeEMailStruct(scan->entries[i].email);
+      scan->entries[i].email = NULL;
+    }
+  }
+
+  scan->numEntries = 0;
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// MA_ScanMailBox
 //  Scans for message files in a folder directory
@@ -3024,7 +4629,6 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
 {
   long filecount;
   BOOL result = TRUE;
-  static BOOL alreadyScanning = FALSE;
 
   ENTER();
 
@@ -3043,9 +4647,9 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
   }
   else
   {
-    // check if we are already in this function or not
-    // (due to a previously started scanning
-    if(alreadyScanning == TRUE)
+    // check if this folder is already being scanned (due to a previously
+    // started scanning). Other folders may be scanned at the same time.
+    if(folder->LoadedMode == LM_REBUILD)
     {
       result = FALSE;
     }
@@ -3054,10 +4658,7 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
       struct MA_GUIData *gui = &G->MA->GUI;
       struct BusyNode *busy;
       struct Folder *tempFolder;
-
-      // make sure others notice that an index scanning already
-      // runs
-      alreadyScanning = TRUE;
+      struct FolderScan *scan;
 
       // now we make sure some GUI components will be disabled
       // or cleared if the rescanning folder is the current one
@@ -3087,7 +4688,21 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
 
       // allocate a temporary folder structure to avoid having to lock the real folder's
       // mail list for each single mail we get from the index
-      if((tempFolder = AllocFolder()) != NULL)
+      tempFolder = AllocFolder();
+
+      // the list of mail files to be examined by the worker threads
+      if((scan = calloc(1, sizeof(*scan))) != NULL)
+      {
+        if((scan->semaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
+          scan->folder = folder;
+        else
+        {
+          free(scan);
+          scan = NULL;
+        }
+      }
+
+      if(tempFolder != NULL && scan != NULL)
       {
         APTR context;
 
@@ -3104,7 +4719,6 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
           BOOL skipAllOld = FALSE;
           BOOL convertAllUnknown = FALSE;
           BOOL skipAllUnknown = FALSE;
-          BOOL ignoreInvalids = FALSE;
 
           // Now that the folder is locked we go and define its loaded
           // mode to LM_REBUILD so that others don't try to access it
@@ -3115,8 +4729,9 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
 
           while((ed = ExamineDir(context)) != NULL)
           {
-            // set the gauge and check the stopButton status as well.
-            if(BusyProgress(busy, ++processedFiles, filecount) == FALSE)
+            // check the stopButton status, the gauge is set while the
+            // collected mail files are examined
+            if(BusyProgress(busy, processedFiles, filecount) == FALSE)
             {
               D(DBF_FOLDER, "scan process aborted by user");
               result = FALSE;
@@ -3280,91 +4895,15 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
               // check the filesize of the mail file
               if(ed->FileSize > 0)
               {
-                struct ExtendedMail *email;
-
-                D(DBF_FOLDER, "examining mail file '%s'", fname);
-
-                while((email = MA_ExamineMail(folder, fname, FALSE)) == NULL &&
-                      ignoreInvalids == FALSE)
-                {
-                  // if the MA_ExamineMail() operation failed we
-                  // warn the user and ask him how to proceed with
-                  // the file
-
-                  int res = MUI_Request(G->App, G->MA != NULL ? G->MA->GUI.WI : NULL, MUIF_NONE,
-                                       tr(MSG_MA_INVALIDMFILE_TITLE),
-                                       tr(MSG_MA_INVALIDMFILE_BT),
-                                       tr(MSG_MA_INVALIDMFILE),
-                                       fname, folder->Name);
-
-                  if(res == 0) // cancel/ESC
-                  {
-                    result = FALSE;
-                    break;
-                  }
-                  else if(res == 1) // Retry
-                    continue;
-                  else if(res == 2) // Ignore
-                    break;
-                  else if(res == 3) // Ignore All
-                  {
-                    ignoreInvalids = TRUE;
-                    break;
-                  }
-                  else if(res == 4) // Delete
-                  {
-                    char path[SIZE_PATHFILE+1];
-
-                    AddPath(path, folder->Fullpath, fname, sizeof(path));
-                    DeleteFile(path);
+                // collect the file and let the worker threads examine
+                // the collected files as soon as there are enough
+                strlcpy(scan->entries[scan->numEntries].name, fname, sizeof(scan->entries[scan->numEntries].name));
+                scan->numEntries++;
 
-                    break;
-                  }
-                }
-
-                if(email != NULL)
+                if(scan->numEntries == SCAN_CHUNK_SIZE && ScanMailFiles(scan, tempFolder, busy, &processedFiles, filecount) == FALSE)
                 {
-                  struct Mail *newMail;
-
-                  if((newMail = CloneMail(&email->Mail)) != NULL)
-                  {
-                    // add the mail to the temporary folder
-                    AddMailToFolderSimple(newMail, tempFolder);
-
-                    // the AddMailToFolderSimple() call set the mail's folder pointer to the
-                    // temporary folder. But since this is a temporary one only and will be
-                    // invalid after leaving this function we must set the mail's folder
-                    // pointer to the correct current folder.
-                    newMail->Folder = folder;
-
-                    // if this new mail hasn't got a valid transDate we have to check if we
-                    // have to take the fileDate as a fallback value.
-                    if(newMail->transDate.Seconds == 0)
-                    {
-                      // only if it is _not_ a "waitforsend" and "hold" message we can take the fib_Date
-                      // as the fallback
-                      if(isDraftsFolder(folder) == FALSE && isOutgoingFolder(folder) == FALSE)
-                      {
-                        char mailfile[SIZE_PATHFILE];
-                        struct DateStamp ds;
-
-                        W(DBF_FOLDER, "no transfer date information found in mail file, using file date...");
-
-                        GetMailFile(mailfile, sizeof(mailfile), NULL, newMail);
-                        // obtain the datestamp information from  and as a fallback we take the date of the mail file
-                        if(ObtainFileInfo(mailfile, FI_DATE, &ds) == TRUE)
-                        {
-                          // now convert the local TZ fib_Date to a UTC transDate
-                          DateStamp2TimeVal(&ds, &newMail->transDate, TZC_LOCAL2UTC);
-                        }
-
-                        // then we update the mailfilename
-                        MA_UpdateMailFile(newMail);
-                      }
-                    }
-                  }
-
-                  MA_FreeEMailStruct(email);
+                  result = FALSE;
+                  break;
                 }
               }
               else
@@ -3383,6 +4922,10 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
           if(error != 0 && error != ERROR_NO_MORE_ENTRIES)
             E(DBF_FOLDER, "ExamineDir() failed, error %ld", error);
 
+          // examine the remaining mail files
+          if(result == TRUE && scan->numEntries > 0)
+            result = ScanMailFiles(scan, tempFolder, busy, &processedFiles, filecount);
+
           ReleaseDirContext(context);
         }
         else
@@ -3395,17 +4938,23 @@ static BOOL MA_ScanMailBox(struct Folder *folder)
         // to the real folder
         if(result == TRUE)
           MoveFolderContents(folder, tempFolder);
+      }
+      else
+        result = FALSE;
 
-        // free the temporary folder again
-        FreeFolder(tempFolder);
+      if(scan != NULL)
+      {
+        FreeSysObject(ASOT_SEMAPHORE, scan->semaphore);
+        free(scan);
       }
 
+      // free the temporary folder again
+      if(tempFolder != NULL)
+        FreeFolder(tempFolder);
+
       D(DBF_FOLDER, "scanning finished %s", result ? "successfully" : "unsuccessfully");
 
       BusyEnd(busy);
-
-      // make sure others can use this function again
-      alreadyScanning = FALSE;
     }
   }
 
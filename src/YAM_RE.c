@@ -68,6 +68,7 @@
 #include "mui/YAMApplication.h"
 #include "mime/rfc2231.h"
 #include "mime/base64.h"
+#include "mime/decodechain.h"
 #include "mime/qprintable.h"
 #include "mime/uucode.h"
 #include "tcp/Connection.h"
@@ -87,6 +88,7 @@
 #include "MimeTypes.h"
 #include "MUIObjects.h"
 #include "ParseEmail.h"
+#include "PartCache.h"
 #include "Requesters.h"
 #include "Threads.h"
 #include "UserIdentity.h"
@@ -100,6 +102,7 @@ enum SMsgType { SMT_NORMAL=0, SMT_MDN, SMT_SIGNED, SMT_ENCRYPTED };
 
 /* local protos */
 static BOOL RE_HandleMDNReport(const struct Part *frp);
+static void RE_UndoPart(struct Part *rp);
 
 /***************************************************************************
  Module: Read
@@ -1211,7 +1214,7 @@ static void RE_ParseContentParameters(char *str, struct Part *rp, enum parameter
 ///
 /// RE_ScanHeader
 //  Parses the header of the message or of a message part
-static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderMode mode)
+static BOOL RE_ScanHeader(struct Part *rp, FILE *in, const BOOL reportErrors, enum ReadHeaderMode mode)
 {
   struct HeaderNode *hdrNode;
   BOOL quietParsing = isAnyFlagSet(rp->rmData->parseFlags, PM_QUIET);
@@ -1236,7 +1239,7 @@ static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderM
   // we read in the headers from our mail file
   if(MA_ReadHeader(rp->rmData->readFile, in, rp->headerList, mode) == FALSE)
   {
-    if(out != NULL && quietParsing == FALSE)
+    if(reportErrors == TRUE && quietParsing == FALSE)
     {
       if(mode == RHM_MAINHEADER)
         ER_NewError(tr(MSG_ER_MIME_ERROR), rp->rmData->readFile);
@@ -1259,10 +1262,6 @@ static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderM
     char *field = hdrNode->name;
     char *value = hdrNode->content;
 
-    // if we have a fileoutput pointer lets write out the header immediatly
-    if(out != NULL)
-      fprintf(out, "%s: %s\n", field, value);
-
     if(stricmp(field, "content-type") == 0)
     {
       // we check whether we have a content-type value or not, because otherwise
@@ -1393,11 +1392,10 @@ static BOOL RE_ScanHeader(struct Part *rp, FILE *in, FILE *out, enum ReadHeaderM
 }
 ///
 /// RE_ConsumeRestOfPart
-//  Processes body of a message part and takes care to convert the text
-//  to UTF-8 if a srcCodeset has been supplied and the encoding of the part is
-//  either 7bit or 8bit which should signal that it is actually readable text
-static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *srcCodeset,
-                                 const struct Part *rp, const BOOL allowAutoDetect)
+//  Skips the body of a message part up to the next boundary or the end of
+//  the file. If 'partEnd' is given it receives the file position where the
+//  data of the part ends.
+static BOOL RE_ConsumeRestOfPart(FILE *ifh, const struct Part *rp, long *partEnd)
 {
   BOOL result = FALSE;
 
@@ -1407,104 +1405,34 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
   if(ifh != NULL)
   {
     char *buf = NULL;
-    char *dstr = NULL;
     size_t buflen = 0;
     ssize_t curlen = 0;
     int boundaryLen = 0;
     int numLines = 0;
-    BOOL skipCodesets = FALSE;
+    long lineStart = 0;
+    BOOL prevCRLF = FALSE;
 
-    // if a part was specified we go and extract some information from
-    // it
+    // if a part was specified we go and extract the boundary from it
     if(rp != NULL)
-    {
       boundaryLen = strlen(rp->CParBndr);
 
-      // if the encoding of this part is not 7bit or 8bit ascii we go
-      // and set the srcCodeset = NULL so that no codesets.library stuff
-      // gets activated.
-      if(isDecoded(rp) == FALSE &&
-         rp->EncodingCode != ENC_7BIT && rp->EncodingCode != ENC_8BIT)
-      {
-        skipCodesets = TRUE;
-      }
-
-      if(ofh != NULL)
+    // we process the file line-by-line and check each line for the boundary
+    while(TRUE)
+    {
+      // remember where each line starts to be able to tell where the part ends
+      if(partEnd != NULL)
       {
-        // preallocate a buffer for the part
-        size_t encodedSize = 0;
-
-        if(rp->Size <= 0 && isAttachment(rp) == TRUE)
-        {
-          // the attachment's size is unknown hence we do a *VERY* rough
-          // estimation by assuming that the current part is the only remaining
-          // part. Although this estimation will result in far too big numbers
-          // if there are further parts following it speeds up parsing large
-          // attachments without size information a lot. And since the amount of
-          // memory will be required anyway this rough estimation is better than
-          // having to reallocate a constantly growing buffer in lots of small
-          // steps.
-          struct stat st;
-
-          if(fstat(fileno(ifh), &st) != -1)
-          {
-            encodedSize = st.st_size - ftell(ifh);
-
-            D(DBF_MIME, "estimated part size %ld", encodedSize);
-          }
-          else
-            W(DBF_MIME, "cannot fstat() input file: %s", strerror(errno));
-        }
-        else if(rp->Size > 0)
-        {
-          // the decoded size is known already, depending on the encoding we
-          // we do a very good estimation of the encoded part size
-          switch(rp->EncodingCode)
-          {
-            case ENC_7BIT:
-            case ENC_8BIT:
-            case ENC_BIN:
-            case ENC_QP:
-            {
-              encodedSize = rp->Size;
-            }
-            break;
+        long pos = ftell(ifh);
 
-            case ENC_B64:
-            {
-              // base64 encodes 3 input bytes in 4 output bytes
-              encodedSize = rp->Size * 4 / 3;
-
-              // each encoded line consists of 72 characters at most
-              // add the number of lines for the LF characters inbetween
-              encodedSize += (encodedSize + 71) / 72;
-            }
-            break;
-
-            case ENC_UUE:
-            {
-              // uue encodes 3 input bytes in 4 output bytes
-              encodedSize = rp->Size * 4 / 3;
-
-              // each encoded line consists of 63 characters at most
-              // add the number of lines for the LF characters inbetween
-              encodedSize += (encodedSize + 62) / 63;
-            }
-            break;
-          }
-        }
-
-        // all other parts (no attachment, no size) will be read 100% dynamically
-
-        if(encodedSize != 0)
-          dstr = dstralloc(encodedSize);
+        // GetLine() strips a CRLF as well as a single LF, so the previous
+        // line ended with CRLF if it took two more bytes than returned
+        prevCRLF = (numLines > 0 && pos - lineStart == curlen + 2);
+        lineStart = pos;
       }
-    }
 
-    // we process the file line-by-line, analyze it if it is between the boundary
-    // do an eventually existing charset translation and write it out again.
-    while((curlen = GetLine(&buf, &buflen, ifh)) >= 0)
-    {
+      if((curlen = GetLine(&buf, &buflen, ifh)) < 0)
+        break;
+
       // count number of lines
       numLines++;
 
@@ -1534,6 +1462,10 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
           {
             D(DBF_MAIL, "found end MIME boundary");
 
+            // the LF or CRLF in front of the boundary belongs to the boundary
+            if(partEnd != NULL)
+              *partEnd = lineStart - (prevCRLF == TRUE ? 2 : 1);
+
             // we had success, so lets break out
             result = TRUE;
             break;
@@ -1551,127 +1483,28 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
           {
             D(DBF_MAIL, "found new start MIME boundary");
 
+            // the LF or CRLF in front of the boundary belongs to the boundary
+            if(partEnd != NULL)
+              *partEnd = lineStart - (prevCRLF == TRUE ? 2 : 1);
+
             // no success, return FALSE
             break;
           }
         }
       }
-
-      // check if the data should be written out at the end of this function
-      // or if we plainly read data only. If we should write out later we stuff
-      // all our data into a dynamic array first so that we can do any potential
-      // codeset conversion in one run.
-      if(ofh != NULL)
-      {
-        // as we use GetLine() above (with no LF) we have to output a LF before we
-        // go on. This will in fact strip the last newline right where the mime boundary
-        // comes.
-        if(numLines > 1)
-          dstrcat(&dstr, "\n");
-
-        // now stuff the whole buf into the dstr
-        dstrcat(&dstr, buf);
-      }
     }
 
     // free the buffer allocated by GetLine()
     free(buf);
 
-    // if we end up here because of a EOF we have to check
-    // if there is still something in c and then write it into the out fh.
+    // if we end up here because of a EOF the part ends with the file
     if(result == FALSE && curlen == -1 && feof(ifh) != 0)
     {
-      // if we read at least one line we must add a line feed, because GetLine() strips these
-      if(numLines > 1 && ofh != NULL)
-        dstrcat(&dstr, "\n");
+      if(partEnd != NULL)
+        *partEnd = ftell(ifh);
 
       result = TRUE;
     }
-
-    // now that we have the whole text in dstr we can check if we need to convert it to
-    // a different codeset or write it out right away.
-    if(ofh != NULL)
-    {
-      char *dststr = NULL;
-      size_t dstlen = 0;
-      BOOL codesetConverted = FALSE;
-
-      if(skipCodesets == FALSE)
-      {
-        // in case the user wants us to detect the correct codeset we do it now
-        if(allowAutoDetect == TRUE)
-        {
-          if(srcCodeset == NULL ||
-             (C->DetectCyrillic == TRUE && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-          {
-            struct codeset *cs = CodesetsFindBest(CSA_Source,            dstr,
-                                                  CSA_SourceLen,         dstrlen(dstr),
-                                                  CSA_CodesetFamily,     C->DetectCyrillic == TRUE ? CSV_CodesetFamily_Cyrillic : CSV_CodesetFamily_Latin,
-                                                  CSA_FallbackToDefault, FALSE,
-                                                  TAG_DONE);
-
-            if(cs != NULL && cs != srcCodeset)
-            {
-              D(DBF_MAIL, "Detected [%s] codeset using CodesetsFindBest()", cs->name);
-              srcCodeset = cs;
-            }
-            else
-              W(DBF_MAIL, "Couldn't autodetect codeset for supplied src text");
-          }
-        }
-
-        // if this function was invoked with a source Codeset we have to make sure
-        // we convert from the supplied source Codeset to our current local codeset with
-        // help of the functions codesets.library provides.
-        if(srcCodeset != NULL && srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-        {
-          ULONG utf8len = 0;
-
-          // convert from the srcCodeset to UTF8
-          UTF8 *utf8str = CodesetsUTF8Create(CSA_Source,          dstr,
-                                             CSA_SourceLen,       dstrlen(dstr),
-                                             CSA_SourceCodeset,   srcCodeset,
-                                             CSA_DestLenPtr,      &utf8len,
-                                             TAG_DONE);
-
-          // check if operations succeeded
-          if(utf8str != NULL && utf8len > 0)
-          {
-            dststr = (char *)utf8str;
-            dstlen = utf8len;
-
-            // signal that the destination string had
-            // been converted
-            codesetConverted = TRUE;
-          }
-          else
-            W(DBF_MAIL, "couldn't convert dstr with CodesetsUTF8Create(): %08lx %ld", dstr, dstrlen(dstr));
-        }
-        else
-          D(DBF_MAIL, "srcCodeset is [%s], no codeset conversion performed/necessary", srcCodeset == NULL ? "<NULL>" : srcCodeset->name);
-      }
-
-      // make sure we fallback to dstr
-      if(codesetConverted == FALSE)
-      {
-        dststr = dstr;
-        dstlen = dstrlen(dstr);
-      }
-
-      // now write back exactly the same amount of bytes we read previously
-      if(fwrite(dststr, dstlen, 1, ofh) <= 0)
-      {
-        E(DBF_MAIL, "error during write operation!");
-        result = FALSE;
-      }
-
-      // free the codesets converted string
-      if(codesetConverted == TRUE)
-        CodesetsFreeA(dststr, NULL);
-    }
-
-    // free the dynamic string
-    dstrfree(dstr);
   }
 
   RETURN(result);
@@ -1679,14 +1512,18 @@ static BOOL RE_ConsumeRestOfPart(FILE *ifh, FILE *ofh, const struct codeset *src
 }
 ///
 /// RE_DecodeStream
-//  Decodes contents of a part
-static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
+//  Decodes contents of a part, at most 'length' bytes are read from the
+//  input stream or everything up to the end of the file for a negative length
+static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out, long length)
 {
   BOOL decodeResult = FALSE;
   struct codeset *sourceCodeset = NULL;
   struct ReadMailData *rmData = rp->rmData;
   BOOL quietParsing = isAnyFlagSet(rmData->parseFlags, PM_QUIET);
   BOOL isText;
+  struct DecodeChain dc;
+  enum DecodeType decodeType;
+  int decodeFlags = 0;
 
   ENTER();
 
@@ -1721,6 +1558,49 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
   isText = rp->ContentType != NULL && strnicmp(rp->ContentType, "text", 4) == 0 && stricmp(rp->ContentType, "text/html") != 0;
   SHOWVALUE(DBF_MIME, isText);
 
+  // set up the stages of the decoding chain, the transfer decoding is
+  // followed by the conversion of texts to UTF-8 and the normalisation
+  // of CRLF line breaks in printable parts
+  switch(rp->EncodingCode)
+  {
+    case ENC_B64:
+    case ENC_QP:
+    case ENC_UUE:
+    {
+      if(rp->EncodingCode == ENC_B64)
+        decodeType = DCT_BASE64;
+      else if(rp->EncodingCode == ENC_QP)
+        decodeType = DCT_QP;
+      else
+        decodeType = DCT_NONE;
+
+      if(isText == TRUE)
+        setFlag(decodeFlags, DCF_CONVERT|DCF_DETECT);
+    }
+    break;
+
+    default:
+    {
+      decodeType = DCT_NONE;
+
+      if(isPrintable(rp) == TRUE)
+        setFlag(decodeFlags, DCF_CONVERT|DCF_DETECT);
+    }
+    break;
+  }
+
+  // plain text lines lose their CR as before, but binary data is kept as is
+  if(isPrintable(rp) == TRUE || rp->EncodingCode == ENC_7BIT || rp->EncodingCode == ENC_8BIT)
+    setFlag(decodeFlags, DCF_CRLF);
+
+  if(decodechain_init(&dc, decodeType, decodeFlags, sourceCodeset, decodechain_fwrite, out) == FALSE)
+  {
+    E(DBF_MAIL, "couldn't set up decoding chain for part %ld", rp->Nr);
+
+    RETURN(FALSE);
+    return FALSE;
+  }
+
   // lets check if we got some encoding here and
   // if so we have to decode it immediatly
   switch(rp->EncodingCode)
@@ -1728,7 +1608,11 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process a base64 decoding.
     case ENC_B64:
     {
-      long decoded = base64decode_file(in, out, sourceCodeset, isText, isPrintable(rp));
+      long decoded = -1;
+
+      if(decodechain_file(&dc, in, length) == TRUE)
+        decoded = (dc.dec.b64.problem == TRUE) ? -2 : dc.decoded;
+
       D(DBF_MAIL, "base64 decoded %ld bytes of part %ld.", decoded, rp->Nr);
 
       if(decoded > 0)
@@ -1746,6 +1630,8 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
 
           case -2:
           {
+            W(DBF_MAIL, "invalid or truncated base64 data");
+
             if(quietParsing == FALSE)
               ER_NewWarning(tr(MSG_ER_B64DEC_WARN), rp->Nr, rmData->readFile);
 
@@ -1767,7 +1653,18 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process a Quoted-Printable decoding
     case ENC_QP:
     {
-      long decoded = qpdecode_file(in, out, sourceCodeset, isText);
+      long decoded = -1;
+
+      if(decodechain_file(&dc, in, length) == TRUE)
+      {
+        if(dc.dec.qp.unfinished == TRUE)
+          decoded = -2; // -2 means "unfinished decoding"
+        else if(dc.dec.qp.result != 0)
+          decoded = dc.dec.qp.result;
+        else
+          decoded = dc.dec.qp.decoded;
+      }
+
       D(DBF_MAIL, "quoted-printable decoded %ld chars of part %ld.", decoded, rp->Nr);
 
       if(decoded >= 0)
@@ -1826,7 +1723,9 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
     // process UU-Encoded decoding
     case ENC_UUE:
     {
-      long decoded = uudecode_file(in, out, sourceCodeset, isText);
+      // uuencoded parts are always decoded from their own file as the
+      // decoder doesn't stop at the end of the part, see RE_DecodePart()
+      long decoded = uudecode_file(in, &dc);
       D(DBF_MAIL, "UU decoded %ld chars of part %ld.", decoded, rp->Nr);
 
       if(decoded >= 0)
@@ -1893,32 +1792,31 @@ static BOOL RE_DecodeStream(struct Part *rp, FILE *in, FILE *out)
 
     default:
     {
-      if(RE_ConsumeRestOfPart(in, out, sourceCodeset, NULL, TRUE))
+      if(decodechain_file(&dc, in, length) == TRUE)
         decodeResult = TRUE;
     }
     break;
   }
 
+  decodechain_cleanup(&dc);
+
   RETURN(decodeResult);
   return decodeResult;
 }
 ///
-/// RE_OpenNewPart
-//  Adds a new entry to the message part list
-static FILE *RE_OpenNewPart(struct ReadMailData *rmData,
-                            struct Part **new,
-                            struct Part *prev,
-                            struct Part *first)
+/// RE_NewPart
+//  Adds a new entry to the message part list. The part's data stays in the
+//  mail file until it is needed, only its position is recorded while parsing.
+static struct Part *RE_NewPart(struct ReadMailData *rmData,
+                               struct Part *prev,
+                               struct Part *first)
 {
-  FILE *fp = NULL;
   struct Part *newPart;
 
   ENTER();
 
   if((newPart = calloc(1, sizeof(*newPart))) != NULL)
   {
-    char file[SIZE_FILE];
-
     if(prev != NULL)
     {
       // link in the new Part
@@ -1957,32 +1855,100 @@ static FILE *RE_OpenNewPart(struct ReadMailData *rmData,
     newPart->CParBndr = strdup(first ? first->CParBndr : (prev ? prev->CParBndr : ""));
 
     newPart->rmData = rmData;
-    snprintf(file, sizeof(file), "YAMr%08x-p%d.txt", (unsigned int)rmData->uniqueID, newPart->Nr);
-    AddPath(newPart->Filename, C->TempDir, file, sizeof(newPart->Filename));
 
     D(DBF_MAIL, "New Part #%ld [%08lx]", newPart->Nr, newPart);
     D(DBF_MAIL, "  IsAltPart..: %ld",  isAlternativePart(newPart));
-    D(DBF_MAIL, "  Filename...: [%s]", newPart->Filename);
     D(DBF_MAIL, "  Nextptr....: %08lx",  newPart->Next);
     D(DBF_MAIL, "  Prevptr....: %08lx",  newPart->Prev);
     D(DBF_MAIL, "  Parentptr..: %08lx",  newPart->Parent);
     D(DBF_MAIL, "  MainAltPart: %08lx",  newPart->MainAltPart);
+  }
+  else
+    E(DBF_MAIL, "Error: Couldn't create a new Part!");
 
-    if((fp = fopen(newPart->Filename, "w")) != NULL)
+  RETURN(newPart);
+  return newPart;
+}
+///
+/// RE_PartFilename
+//  Builds the name of the temporary file of a part
+static void RE_PartFilename(const struct Part *rp, char *filename, size_t size)
+{
+  char file[SIZE_FILE];
+
+  ENTER();
+
+  snprintf(file, sizeof(file), "YAMr%08x-p%d.txt", (unsigned int)rp->rmData->uniqueID, rp->Nr);
+  AddPath(filename, C->TempDir, file, size);
+
+  LEAVE();
+}
+///
+/// RE_RenamePartFile
+//  Renames an existing temporary file of a part to match the part's number
+static void RE_RenamePartFile(struct Part *rp)
+{
+  ENTER();
+
+  // the name of a cached file is not derived from the part
+  if(rp->Filename[0] != '\0' && isCached(rp) == FALSE)
+  {
+    char tmpFile[SIZE_PATHFILE];
+    char file[SIZE_FILE];
+    const char *ext = strchr(FilePart(rp->Filename), '.');
+
+    snprintf(file, sizeof(file), "YAM%c%08x-p%d%s", isDecoded(rp) ? 'm' : 'r', (unsigned int)rp->rmData->uniqueID, rp->Nr, ext != NULL ? ext : "");
+    AddPath(tmpFile, C->TempDir, file, sizeof(tmpFile));
+
+    if(strcmp(rp->Filename, tmpFile) != 0)
+    {
+      D(DBF_MAIL, "renaming '%s' to '%s'", rp->Filename, tmpFile);
+
+      RenameFile(rp->Filename, tmpFile);
+      strlcpy(rp->Filename, tmpFile, sizeof(rp->Filename));
+    }
+  }
+
+  LEAVE();
+}
+///
+/// RE_OpenNewPart
+//  Adds a new entry to the message part list and opens its temporary file
+//  for parts which don't exist in the mail file as is
+static FILE *RE_OpenNewPart(struct ReadMailData *rmData,
+                            struct Part **new,
+                            struct Part *prev,
+                            struct Part *first)
+{
+  FILE *fp = NULL;
+  struct Part *newPart;
+
+  ENTER();
+
+  if((newPart = RE_NewPart(rmData, prev, first)) != NULL)
+  {
+    char filename[SIZE_PATHFILE];
+
+    RE_PartFilename(newPart, filename, sizeof(filename));
+
+    D(DBF_MAIL, "  Filename...: [%s]", filename);
+
+    if((fp = fopen(filename, "w")) != NULL)
     {
       setvbuf(fp, NULL, _IOFBF, SIZE_FILEBUF);
+      strlcpy(newPart->Filename, filename, sizeof(newPart->Filename));
     }
     else
     {
       // opening the file failed, so we return failure
-      free(newPart);
+      E(DBF_MAIL, "Error: Couldn't create file '%s' for new Part!", filename);
+
+      RE_UndoPart(newPart);
       newPart = NULL;
     }
   }
 
   *new = newPart;
-  if(newPart == NULL)
-    E(DBF_MAIL, "Error: Couldn't create a new Part!");
 
   RETURN(fp);
   return fp;
@@ -1999,46 +1965,19 @@ static void RE_UndoPart(struct Part *rp)
   D(DBF_MAIL, "Undoing part #%ld [%08lx]", rp->Nr, rp);
 
   // lets delete the file first so that we can cleanly "undo" the part
-  DeleteFile(rp->Filename);
-
-  // we only iterate through our partlist if there is
-  // a next item, if not we can simply relink it
-  if(trp->Next != NULL)
+  if(isCached(rp) == TRUE)
+    ReleaseCachedPart(rp);
+  else if(rp->Filename[0] != '\0')
+    DeleteFile(rp->Filename);
+
+  // if we remove a part from the part list we have to take
+  // care of the part index number aswell. So all following
+  // parts have to be descreased somehow by one and their
+  // temporary files have to follow.
+  for(trp = rp->Next; trp != NULL; trp = trp->Next)
   {
-    // if we remove a part from the part list we have to take
-    // care of the part index number aswell. So all following
-    // parts have to be descreased somehow by one.
-    //
-    // p2->p3->p4->p5
-    do
-    {
-      // use the next element as the current trp
-      trp = trp->Next;
-
-      // decrease the part number aswell
-      trp->Nr--;
-
-      // Now we also have to rename the temporary filename also
-      Rename(trp->Filename, trp->Prev->Filename);
-
-    }
-    while(trp->Next != NULL);
-
-    // now go from the end to the start again and copy
-    // the filenames strings as we couldn't do that in the previous
-    // loop also
-    //
-    // p5->p4->p3->p2
-    do
-    {
-      // iterate backwards
-      trp = trp->Prev;
-
-      // now copy the filename string
-      strlcpy(trp->Next->Filename, trp->Filename, sizeof(trp->Next->Filename));
-
-    }
-    while(trp->Prev != NULL && trp != rp);
+    trp->Nr--;
+    RE_RenamePartFile(trp);
   }
 
   // relink the partlist
@@ -2169,13 +2108,27 @@ static BOOL RE_SaveThisPart(struct Part *rp)
 //  Determines size and other information of a message part
 static void RE_SetPartInfo(struct Part *rp)
 {
-  LONG size;
+  LONG size = 0;
   const char *comment;
 
   ENTER();
 
-  // get the part's filesize
-  ObtainFileInfo(rp->Filename, FI_SIZE, &size);
+  // get the part's filesize or the size of its data within the mail file
+  if(rp->Filename[0] != '\0')
+    ObtainFileInfo(rp->Filename, FI_SIZE, &size);
+  else if(rp->Nr == PART_RAW)
+  {
+    struct HeaderNode *hdrNode;
+
+    // the header part consists of the parsed header lines
+    if(rp->headerList != NULL)
+    {
+      IterateList(rp->headerList, struct HeaderNode *, hdrNode)
+        size += strlen(hdrNode->name) + strlen(hdrNode->content) + 3;
+    }
+  }
+  else
+    size = rp->Length;
 
   // let's calculate the partsize of an undecoded part, if this
   // part isn't the RAW part and we found a positive size.
@@ -2274,7 +2227,8 @@ static void RE_SetPartInfo(struct Part *rp)
       comment = rp->ContentType;
   }
 
-  SetComment(rp->Filename, comment);
+  if(rp->Filename[0] != '\0')
+    SetComment(rp->Filename, comment);
 
   LEAVE();
 }
@@ -2298,22 +2252,16 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
 
   if(in != NULL)
   {
-    FILE *out = NULL;
     struct Part *rp;
 
     if(hrp == NULL)
     {
-      if((out = RE_OpenNewPart(rmData, &hrp, NULL, NULL)) != NULL)
+      if((hrp = RE_NewPart(rmData, NULL, NULL)) != NULL)
       {
-        BOOL parse_ok = RE_ScanHeader(hrp, in, out, RHM_MAINHEADER);
-
-        fclose(out);
-        out = NULL;
-
-        if(parse_ok == TRUE)
+        if(RE_ScanHeader(hrp, in, TRUE, RHM_MAINHEADER) == TRUE)
           RE_SetPartInfo(hrp);
       }
-      else if(isAnyFlagSet(rp->rmData->parseFlags, PM_QUIET) == FALSE)
+      else if(isAnyFlagSet(rmData->parseFlags, PM_QUIET) == FALSE)
         ER_NewError(tr(MSG_ER_CantCreateTempfile));
     }
 
@@ -2326,7 +2274,7 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
       if(isMIMEconform(hrp) == TRUE &&
          hrp->CParBndr != NULL && strnicmp(hrp->ContentType, "multipart", 9) == 0)
       {
-        BOOL done = RE_ConsumeRestOfPart(in, NULL, NULL, hrp, FALSE);
+        BOOL done = RE_ConsumeRestOfPart(in, hrp, NULL);
 
         rp = hrp;
 
@@ -2334,77 +2282,73 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
         {
           struct Part *prev = rp;
 
-          out = RE_OpenNewPart(rmData, &rp, prev, hrp);
-          if(out == NULL)
+          if((rp = RE_NewPart(rmData, prev, hrp)) == NULL)
             break;
 
-          if(RE_ScanHeader(rp, in, out, RHM_SUBHEADER) == FALSE)
-          {
-            fclose(out);
-            out = NULL;
+          // the part's data including its own headers starts here
+          rp->Offset = ftell(in);
 
+          if(RE_ScanHeader(rp, in, TRUE, RHM_SUBHEADER) == FALSE)
+          {
             RE_UndoPart(rp);
             break;
           }
 
           if(strnicmp(rp->ContentType, "multipart", 9) == 0)
           {
-            fclose(out);
-            out = NULL;
-
             if(RE_ParseMessage(rmData, in, NULL, rp) != NULL)
             {
               // undo the dummy part
               RE_UndoPart(rp);
 
               // but consume all rest of the part
-              done = RE_ConsumeRestOfPart(in, NULL, NULL, prev, FALSE);
+              done = RE_ConsumeRestOfPart(in, prev, NULL);
               for(rp = prev; rp->Next; rp = rp->Next)
                 ;
             }
           }
           else if(RE_SaveThisPart(rp) == TRUE || RE_RequiresSpecialHandling(hrp) == SMT_ENCRYPTED)
           {
-            fputc('\n', out);
-            done = RE_ConsumeRestOfPart(in, out, NULL, rp, FALSE);
-            fclose(out);
-            out = NULL;
+            long partEnd = rp->Offset;
+
+            // just remember where the part ends, its data is read
+            // from the mail file as soon as it is needed
+            done = RE_ConsumeRestOfPart(in, rp, &partEnd);
+            rp->Length = MAX(partEnd - rp->Offset, 0);
             RE_SetPartInfo(rp);
           }
           else
           {
-            fclose(out);
-            out = NULL;
-            done = RE_ConsumeRestOfPart(in, NULL, NULL, rp, FALSE);
+            done = RE_ConsumeRestOfPart(in, rp, NULL);
             RE_UndoPart(rp);
             rp = prev;
           }
         }
       }
-      else if((out = RE_OpenNewPart(rmData, &rp, hrp, hrp)) != NULL)
+      else if((rp = RE_NewPart(rmData, hrp, hrp)) != NULL)
       {
         if(RE_SaveThisPart(rp) == TRUE || RE_RequiresSpecialHandling(hrp) == SMT_ENCRYPTED)
         {
-          RE_ConsumeRestOfPart(in, out, NULL, NULL, FALSE);
-          fclose(out);
-          out = NULL;
+          long partEnd;
+
+          // the body of a single part mail extends up to the end of the file
+          rp->Offset = ftell(in);
+          partEnd = rp->Offset;
+
+          RE_ConsumeRestOfPart(in, NULL, &partEnd);
+          rp->Length = MAX(partEnd - rp->Offset, 0);
           RE_SetPartInfo(rp);
         }
         else
         {
-          fclose(out);
-          out = NULL;
           RE_UndoPart(rp);
-          RE_ConsumeRestOfPart(in, NULL, NULL, NULL, FALSE);
+          RE_ConsumeRestOfPart(in, NULL, NULL);
         }
       }
     }
 
     if(fname != NULL && in != NULL)
       fclose(in);
-
-    if(out != NULL)
-      fclose(out);
   }
 
   #if defined(DEBUG)
@@ -2433,6 +2377,8 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
       D(DBF_MAIL, "  Printable..: %ld",  isPrintable(rp));
       D(DBF_MAIL, "  Encoding...: %ld",  rp->EncodingCode);
       D(DBF_MAIL, "  Filename...: [%s]", SafeStr(rp->Filename));
+      D(DBF_MAIL, "  Offset.....: %ld",  rp->Offset);
+      D(DBF_MAIL, "  Length.....: %ld",  rp->Length);
       D(DBF_MAIL, "  Size.......: %ld",  rp->Size);
       D(DBF_MAIL, "  Nextptr....: %08lx",  rp->Next);
       D(DBF_MAIL, "  Prevptr....: %08lx",  rp->Prev);
@@ -2447,6 +2393,100 @@ static struct Part *RE_ParseMessage(struct ReadMailData *rmData,
   return hrp;
 }
 
+///
+/// RE_WritePartFile
+//  Makes sure the undecoded data of a part is available in a temporary file
+//  of its own. While parsing only the position of the data within the mail
+//  file is recorded, the file is written on demand only.
+BOOL RE_WritePartFile(struct Part *rp)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  if(rp->Filename[0] == '\0')
+  {
+    char filename[SIZE_PATHFILE];
+    FILE *out;
+
+    result = FALSE;
+
+    RE_PartFilename(rp, filename, sizeof(filename));
+
+    D(DBF_MAIL, "writing part #%ld to '%s'", rp->Nr, filename);
+
+    if((out = fopen(filename, "w")) != NULL)
+    {
+      setvbuf(out, NULL, _IOFBF, SIZE_FILEBUF);
+
+      if(rp->Nr == PART_RAW)
+      {
+        // the header part consists of the parsed header lines
+        if(rp->headerList != NULL)
+        {
+          struct HeaderNode *hdrNode;
+
+          IterateList(rp->headerList, struct HeaderNode *, hdrNode)
+            fprintf(out, "%s: %s\n", hdrNode->name, hdrNode->content);
+        }
+
+        result = TRUE;
+      }
+      else
+      {
+        FILE *in;
+
+        // all other parts are copied from the mail file
+        if((in = fopen(rp->rmData->readFile, "r")) != NULL)
+        {
+          char *buf;
+
+          if(fseek(in, rp->Offset, SEEK_SET) == 0 && (buf = malloc(SIZE_FILEBUF)) != NULL)
+          {
+            long left = rp->Length;
+
+            while(left > 0)
+            {
+              size_t todo = MIN(left, SIZE_FILEBUF);
+
+              if(fread(buf, 1, todo, in) != todo || fwrite(buf, 1, todo, out) != todo)
+                break;
+
+              left -= todo;
+            }
+
+            if(left == 0)
+              result = TRUE;
+
+            free(buf);
+          }
+
+          fclose(in);
+        }
+      }
+
+      if(ferror(out) != 0)
+        result = FALSE;
+
+      fclose(out);
+
+      if(result == TRUE)
+      {
+        strlcpy(rp->Filename, filename, sizeof(rp->Filename));
+        RE_SetPartInfo(rp);
+      }
+      else
+      {
+        E(DBF_MAIL, "couldn't write part #%ld to '%s'", rp->Nr, filename);
+        DeleteFile(filename);
+      }
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// RE_DecodePart
 //  Decodes a single message part
@@ -2454,20 +2494,52 @@ BOOL RE_DecodePart(struct Part *rp)
 {
   ENTER();
 
+  // the header part is never decoded, it just needs its file
+  if(rp->Nr == PART_RAW)
+    RE_WritePartFile(rp);
+  // attachments which were decoded before are taken from the part cache
+  else if(isDecoded(rp) == FALSE && rp->Filename[0] == '\0' && isPrintable(rp) == FALSE &&
+          ObtainCachedPart(rp) == TRUE)
+  {
+    RE_SetPartInfo(rp);
+  }
   // it only makes sense to go on here if
   // the data wasn't decoded before.
-  if(isDecoded(rp) == FALSE)
+  else if(isDecoded(rp) == FALSE)
   {
-    FILE *in;
+    FILE *in = NULL;
     FILE *out;
+    long length = -1;
     char filepath[SIZE_PATHFILE];
     char file[SIZE_FILE];
     char ext[SIZE_FILE];
+    // only attachments decoded straight from the mail file are worth to be
+    // cached, texts are decoded whenever the mail is displayed anyway
+    BOOL cachePart = (rp->Filename[0] == '\0' && isPrintable(rp) == FALSE);
 
     // start with an empty extension string
     ext[0] = '\0';
 
-    if((in = fopen(rp->Filename, "r")) != NULL)
+    // the uudecoder doesn't know where the part ends, so
+    // uuencoded parts are decoded from a file of their own
+    if(rp->EncodingCode == ENC_UUE)
+      RE_WritePartFile(rp);
+
+    if(rp->Filename[0] != '\0')
+      in = fopen(rp->Filename, "r");
+    else if((in = fopen(rp->rmData->readFile, "r")) != NULL)
+    {
+      // decode the part's data straight from the mail file
+      if(fseek(in, rp->Offset, SEEK_SET) == 0)
+        length = rp->Length;
+      else
+      {
+        fclose(in);
+        in = NULL;
+      }
+    }
+
+    if(in != NULL)
     {
       setvbuf(in, NULL, _IOFBF, SIZE_FILEBUF);
 
@@ -2500,6 +2572,10 @@ BOOL RE_DecodePart(struct Part *rp)
           RETURN(FALSE);
           return FALSE;
         }
+
+        // the headers don't count for the data to be decoded
+        if(length >= 0)
+          length = MAX(rp->Offset + rp->Length - ftell(in), 0);
       }
 
       // we try to get a proper file extension for our decoded part which we
@@ -2599,7 +2675,7 @@ BOOL RE_DecodePart(struct Part *rp)
       snprintf(file, sizeof(file), "YAMm%08x-p%d.%s", (unsigned int)rp->rmData->uniqueID, rp->Nr, ext);
       AddPath(filepath, C->TempDir, file, sizeof(filepath));
 
-      D(DBF_MAIL, "decoding '%s' to '%s'", rp->Filename, filepath);
+      D(DBF_MAIL, "decoding '%s' to '%s'", rp->Filename[0] != '\0' ? rp->Filename : rp->rmData->readFile, filepath);
 
       // now open the stream and decode it afterwards.
       if((out = fopen(filepath, "w")) != NULL)
@@ -2609,7 +2685,7 @@ BOOL RE_DecodePart(struct Part *rp)
         setvbuf(out, NULL, _IOFBF, SIZE_FILEBUF);
 
         // decode the stream
-        decodeResult = RE_DecodeStream(rp, in, out);
+        decodeResult = RE_DecodeStream(rp, in, out, length);
 
         // close the streams
         fclose(out);
@@ -2618,13 +2694,17 @@ BOOL RE_DecodePart(struct Part *rp)
         // check if we were successfull in decoding the data.
         if(decodeResult == TRUE)
         {
-          D(DBF_MAIL, "successfully decoded file [%s] to [%s]", rp->Filename, filepath);
+          D(DBF_MAIL, "successfully decoded part #%ld to [%s]", rp->Nr, filepath);
 
-          DeleteFile(rp->Filename);
+          if(rp->Filename[0] != '\0')
+            DeleteFile(rp->Filename);
           setFlag(rp->Flags, PFLAG_DECODED);
 
           strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
           RE_SetPartInfo(rp);
+
+          if(cachePart == TRUE)
+            AddCachedPart(rp);
         }
         else
         {
@@ -2638,7 +2718,8 @@ BOOL RE_DecodePart(struct Part *rp)
         // and if so we use it because it is locked actually and already decoded
         fclose(out);
         fclose(in);
-        DeleteFile(rp->Filename);
+        if(rp->Filename[0] != '\0')
+          DeleteFile(rp->Filename);
         strlcpy(rp->Filename, filepath, sizeof(rp->Filename));
         setFlag(rp->Flags, PFLAG_DECODED);
         RE_SetPartInfo(rp);
@@ -2763,8 +2844,10 @@ static void RE_HandleEncryptedMessage(struct Part *frp)
     if((tf = OpenTempFile("w")) != NULL)
     {
       // first we copy our encrypted part because the DecryptPGP()
-      // function will overwrite it
-      if(CopyFile(NULL, tf->FP, encrPart->Filename, NULL) == TRUE)
+      // function will overwrite it, the warning part's file will
+      // receive the decrypted text later
+      if(RE_WritePartFile(encrPart) == TRUE && RE_WritePartFile(warnPart) == TRUE &&
+         CopyFile(NULL, tf->FP, encrPart->Filename, NULL) == TRUE)
       {
         int decryptResult;
 
@@ -2796,7 +2879,7 @@ static void RE_HandleEncryptedMessage(struct Part *frp)
               setFlag(warnPart->Flags, PFLAG_PRINTABLE);
               warnPart->EncodingCode = ENC_7BIT;
               *warnPart->Description = '\0';
-              RE_ScanHeader(warnPart, in, NULL, RHM_MAINHEADER);
+              RE_ScanHeader(warnPart, in, FALSE, RHM_MAINHEADER);
               fclose(in);
 
               clearFlag(warnPart->Flags, PFLAG_DECODED);
@@ -2944,17 +3027,8 @@ BOOL RE_LoadMessage(struct ReadMailData *rmData)
     {
       if(part->Nr != i)
       {
-        char tmpFile[SIZE_PATHFILE];
-        char file[SIZE_FILE];
-
         part->Nr = i;
-        snprintf(file, sizeof(file), "YAMm%08x-p%d%s", (unsigned int)rmData->uniqueID, i, strchr(part->Filename, '.'));
-        AddPath(tmpFile, C->TempDir, file, sizeof(tmpFile));
-
-        D(DBF_MAIL, "renaming '%s' to '%s'", part->Filename, tmpFile);
-
-        RenameFile(part->Filename, tmpFile);
-        strlcpy(part->Filename, tmpFile, sizeof(part->Filename));
+        RE_RenamePartFile(part);
       }
     }
 
@@ -3162,6 +3236,9 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
       {
         FILE *fh;
 
+        // a part which couldn't be decoded is displayed as is
+        RE_WritePartFile(part);
+
         D(DBF_MAIL, "  adding text of [%s] to display", part->Filename);
 
         if((fh = fopen(part->Filename, "r")) != NULL)
@@ -3343,9 +3420,18 @@ char *RE_ReadInMessage(struct ReadMailData *rmData, enum ReadInMode mode)
                   if(old_pos >= 0 &&
                      fseek(fh, rptr-msg, SEEK_SET) == 0)
                   {
+                    struct DecodeChain dc;
+                    long decoded = -1;
+
                     // now that we are on the correct position, we
-                    // call the uudecoding function accordingly.
-                    long decoded = uudecode_file(fh, outfh, NULL, FALSE); // no translation table
+                    // call the uudecoding function accordingly, the
+                    // data is written as is without any further stage
+                    if(decodechain_init(&dc, DCT_NONE, 0, NULL, decodechain_fwrite, outfh) == TRUE)
+                    {
+                      decoded = uudecode_file(fh, &dc);
+                      decodechain_cleanup(&dc);
+                    }
+
                     D(DBF_MAIL, "UU decoded %ld chars of part %ld.", decoded, uup->Nr);
 
                     if(decoded >= 0)
@@ -4609,7 +4695,8 @@ static BOOL RE_HandleMDNReport(const struct Part *frp)
 
       // replace the original decoded part
       // message
-      DeleteFile(rp[0]->Filename);
+      if(rp[0]->Filename[0] != '\0')
+        DeleteFile(rp[0]->Filename);
       strlcpy(rp[0]->Filename, buf, sizeof(rp[0]->Filename));
       setFlag(rp[0]->Flags, PFLAG_DECODED);
       RE_SetPartInfo(rp[0]);
@@ -4781,7 +4868,10 @@ BOOL CleanupReadMailData(struct ReadMailData *rmData, BOOL fullCleanup)
 
     D(DBF_MAIL, "freeing mail part %08lx, next %08lx", part, next);
 
-    if(part->Filename[0] != '\0')
+    // cached files stay in the cache for the next time the mail is read
+    if(isCached(part) == TRUE)
+      ReleaseCachedPart(part);
+    else if(part->Filename[0] != '\0')
     {
       if(DeleteFile(part->Filename) == 0)
         AddZombieFile(part->Filename);
@@ -5016,8 +5106,10 @@ char *SuggestPartFileName(const struct Part *part)
     result = strdup(part->CParName);
   else if(part->Name != NULL && part->nameIsArtificial == FALSE) // next is Name if not artificial
     result = strdup(part->Name);
-  else
+  else if(part->Filename[0] != '\0')
     result = strdup(FilePart(part->Filename));
+  else
+    result = strdup(part->Name);
 
   // make sure we return a valid filename
   if(result != NULL)
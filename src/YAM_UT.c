@@ -109,15 +109,18 @@
 #include "Config.h"
 #include "FileInfo.h"
 #include "FolderList.h"
+#include "FullTextIndex.h"
 #include "Locale.h"
 #include "MailList.h"
 #include "MailServers.h"
 #include "MethodStack.h"
 #include "MimeTypes.h"
+#include "MsgIDHash.h"
 #include "MUIObjects.h"
 #include "ParseEmail.h"
 #include "Requesters.h"
 #include "Threads.h"
+#include "ThreadTree.h"
 
 #include "Debug.h"
 
@@ -1729,7 +1732,9 @@ BOOL DeleteMailDir(const char *dir, BOOL isroot)
         if(isValidMailFile(filename) == TRUE  ||
            stricmp(filename, ".fconfig") == 0 ||
            stricmp(filename, ".fimage") == 0  ||
-           stricmp(filename, ".index") == 0)
+           stricmp(filename, ".index") == 0   ||
+           stricmp(filename, ".journal") == 0 ||
+           stricmp(filename, ".ftindex") == 0)
         {
           if(DeleteFile(fname) == 0)
           {
@@ -3544,8 +3549,8 @@ void AddMailToFolder(struct Mail *mail, struct Folder *folder)
     AddMailToFolderSimple(mail, folder);
     UnlockMailList(folder->messages);
 
-    // expire the folder's index as we just added a new message
-    MA_ExpireIndex(folder);
+    // record the new message in the folder's index journal
+    MA_JournalAddMail(mail);
   }
 
   LEAVE();
@@ -3562,6 +3567,8 @@ void AddMailToFolderSimple(struct Mail *mail, struct Folder *folder)
 
   // let's add the new message to the folder's message list
   AddNewMailNode(folder->messages, mail);
+  AddMailToMsgIDHash(folder, mail);
+  AddMailToThreadTree(folder, mail);
 
   // let's summarize the stats
   folder->Total++;
@@ -3627,6 +3634,14 @@ void RemoveMailFromFolder(struct Mail *mail, const BOOL closeWindows, const BOOL
       // remove the mail from the folder's mail list
       D(DBF_UTIL, "removing mail with subject '%s' from folder '%s'", mail->Subject, folder->Name);
       RemoveMailNode(folder->messages, mnode);
+
+      // forget about the mail in all lookup structures before the node is
+      // deleted, because this drops the folder's reference to the mail and
+      // might free it
+      RemoveMailFromMsgIDHash(folder, mail);
+      RemoveMailFromThreadTree(folder, mail);
+      RemoveMailFromFullTextIndex(folder, mail);
+
       DeleteMailNode(mnode);
     }
 
@@ -3682,9 +3697,9 @@ void RemoveMailFromFolder(struct Mail *mail, const BOOL closeWindows, const BOOL
       }
     }
 
-    // then we have to mark the folder index as expired so
-    // that it will be saved next time.
-    MA_ExpireIndex(folder);
+    // then we have to record the removal in the folder's
+    // index journal
+    MA_JournalRemoveMail(mail, folder);
   }
   else
   {
@@ -3773,6 +3788,12 @@ struct Mail *ReplaceMailInFolder(const char *mailFile, struct Mail *mail, struct
       mnode->mail = mail;
       mail->Folder = folder;
 
+      // update the message ID lookup tables and the thread tree as well
+      RemoveMailFromMsgIDHash(folder, replacedMail);
+      AddMailToMsgIDHash(folder, mail);
+      RemoveMailFromThreadTree(folder, replacedMail);
+      AddMailToThreadTree(folder, mail);
+
       // increase the reference counter
       ReferenceMail(mail);
     }
@@ -3837,7 +3858,11 @@ BOOL ClearFolderMails(struct Folder *folder, BOOL resetstats)
   if(doClear == TRUE)
   {
     LockMailList(folder->messages);
+    // save the full text index while the mail list is still complete
+    DeleteFullTextIndex(folder, TRUE);
     ClearMailList(folder->messages);
+    DeleteMsgIDHash(folder);
+    DeleteThreadTree(folder);
     UnlockMailList(folder->messages);
 
     if(resetstats == TRUE)
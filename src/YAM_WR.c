@@ -1431,27 +1431,27 @@ mimebody:
 ///
 /// AppendRcpt()
 //  Appends a recipient address to a string
-static char *AppendRcpt(char *sbuf, const struct Person *pe,
+static char *AppendRcpt(char *sbuf, const char *address, const char *realName,
                         const struct UserIdentityNode *uin, const BOOL excludeme)
 {
   ENTER();
 
-  if(pe != NULL)
+  if(address != NULL && realName != NULL)
   {
-    D(DBF_MAIL, "add recipient for person named '%s', address '%s', %s address '%s'", SafeStr(pe->RealName), SafeStr(pe->Address), excludeme ? "excluding" : "including", uin != NULL ? uin->address : "NULL");
+    D(DBF_MAIL, "add recipient for person named '%s', address '%s', %s address '%s'", SafeStr(realName), SafeStr(address), excludeme ? "excluding" : "including", uin != NULL ? uin->address : "NULL");
 
     // Make sure that the person has at least either name or address and
     // that these are non-empty strings. Otherwise we will add invalid
     // recipients like '@domain' without any real name and user name.
-    if(IsStrEmpty(pe->Address) == FALSE || IsStrEmpty(pe->RealName) == FALSE)
+    if(IsStrEmpty(address) == FALSE || IsStrEmpty(realName) == FALSE)
     {
-      char address[SIZE_LARGE];
+      char buffer[SIZE_LARGE];
       char *ins;
       BOOL skip = FALSE;
 
-      if(strchr(pe->Address, '@') != NULL)
+      if(strchr(address, '@') != NULL)
       {
-        ins = BuildAddress(address, sizeof(address), pe->Address, pe->RealName);
+        ins = BuildAddress(buffer, sizeof(buffer), address, realName);
       }
       else
       {
@@ -1462,14 +1462,14 @@ static char *AppendRcpt(char *sbuf, const struct Person *pe,
         if(uin != NULL)
           p = strchr(uin->address, '@');
 
-        snprintf(addr, sizeof(addr), "%s%s", pe->Address, p != NULL ? p : "");
-        ins = BuildAddress(address, sizeof(address), addr, pe->RealName);
+        snprintf(addr, sizeof(addr), "%s%s", address, p != NULL ? p : "");
+        ins = BuildAddress(buffer, sizeof(buffer), addr, realName);
       }
 
       if(ins != NULL)
       {
         // exclude the given person if it is ourself
-        if(excludeme == TRUE && uin != NULL && stricmp(pe->Address, uin->address) == 0)
+        if(excludeme == TRUE && uin != NULL && stricmp(address, uin->address) == 0)
           skip = TRUE;
 
         // if the string already contains this person then skip it
@@ -1867,7 +1867,7 @@ struct WriteMailData *NewWriteMailWindow(struct Mail *mail, const int flags)
         if(IsStrEmpty(mail->ReplyTo.Address) == FALSE)
         {
           // add the Reply-To: address as the new To: address
-          toAddr = AppendRcpt(toAddr, &mail->ReplyTo, wmData->identity, FALSE);
+          toAddr = AppendRcpt(toAddr, mail->ReplyTo.Address, mail->ReplyTo.RealName, wmData->identity, FALSE);
 
           // if the mail has multiple reply-to recipients
           // we have to get them and add them as well
@@ -1878,7 +1878,7 @@ struct WriteMailData *NewWriteMailWindow(struct Mail *mail, const int flags)
 
             // add all "ReplyTo:" recipients of the mail
             for(i=0; i < email->NumSReplyTo; i++)
-              toAddr = AppendRcpt(toAddr, &email->SReplyTo[i], email->identity, FALSE);
+              toAddr = AppendRcpt(toAddr, email->SReplyTo[i].Address, email->SReplyTo[i].RealName, email->identity, FALSE);
 
             // save the user identity
             userIdentity = email->identity;
@@ -1889,7 +1889,7 @@ struct WriteMailData *NewWriteMailWindow(struct Mail *mail, const int flags)
         else
         {
           // add the From: address as the new To: address
-          toAddr = AppendRcpt(toAddr, &mail->From, wmData->identity, FALSE);
+          toAddr = AppendRcpt(toAddr, mail->From.Address, mail->From.RealName, wmData->identity, FALSE);
 
           // if the mail has multiple From: recipients
           // we have to get them and add them as well
@@ -1900,7 +1900,7 @@ struct WriteMailData *NewWriteMailWindow(struct Mail *mail, const int flags)
 
             // add all "From:" recipients of the mail
             for(i=0; i < email->NumSFrom; i++)
-              toAddr = AppendRcpt(toAddr, &email->SFrom[i], email->identity, FALSE);
+              toAddr = AppendRcpt(toAddr, email->SFrom[i].Address, email->SFrom[i].RealName, email->identity, FALSE);
 
             // save the user identity
             userIdentity = email->identity;
@@ -2114,7 +2114,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumSReplyTo; i++)
           {
             D(DBF_MAIL, "adding ReplyTo recipient '%s'", email->SReplyTo[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->SReplyTo[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->SReplyTo[i].Address, email->SReplyTo[i].RealName, email->identity, FALSE);
           }
           set(wmData->window, MUIA_WriteWindow_ReplyTo, sbuf);
         }
@@ -2125,7 +2125,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumResentTo; i++)
           {
             D(DBF_MAIL, "adding Resent-To recipient '%s'", email->ResentTo[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->ResentTo[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->ResentTo[i].Address, email->ResentTo[i].RealName, email->identity, FALSE);
           }
         }
         else
@@ -2135,7 +2135,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumSTo; i++)
           {
             D(DBF_MAIL, "adding To recipient '%s'", email->STo[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->STo[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->STo[i].Address, email->STo[i].RealName, email->identity, FALSE);
           }
         }
         set(wmData->window, MUIA_WriteWindow_To, sbuf);
@@ -2147,7 +2147,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumResentCC; i++)
           {
             D(DBF_MAIL, "adding Resent-CC recipient '%s'", email->ResentCC[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->ResentCC[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->ResentCC[i].Address, email->ResentCC[i].RealName, email->identity, FALSE);
           }
         }
         else
@@ -2155,7 +2155,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumCC; i++)
           {
             D(DBF_MAIL, "adding CC recipient '%s'", email->CC[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->CC[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->CC[i].Address, email->CC[i].RealName, email->identity, FALSE);
           }
         }
         set(wmData->window, MUIA_WriteWindow_CC, sbuf);
@@ -2167,7 +2167,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumResentBCC; i++)
           {
             D(DBF_MAIL, "adding Resent-BCC recipient '%s'", email->ResentBCC[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->ResentBCC[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->ResentBCC[i].Address, email->ResentBCC[i].RealName, email->identity, FALSE);
           }
         }
         else
@@ -2175,7 +2175,7 @@ struct WriteMailData *NewEditMailWindow(struct Mail *mail, const int flags)
           for(i=0; i < email->NumBCC; i++)
           {
             D(DBF_MAIL, "adding BCC recipient '%s'", email->BCC[i].Address);
-            sbuf = AppendRcpt(sbuf, &email->BCC[i], email->identity, FALSE);
+            sbuf = AppendRcpt(sbuf, email->BCC[i].Address, email->BCC[i].RealName, email->identity, FALSE);
           }
         }
         set(wmData->window, MUIA_WriteWindow_BCC, sbuf);
@@ -2408,6 +2408,7 @@ struct WriteMailData *NewForwardMailWindow(struct MailList *mlist, const int fla
             {
               char *cmsg;
 
+              RE_WritePartFile(rmData->firstPart);
               etd.HeaderFile = rmData->firstPart->Filename;
               InsertIntroText(out, C->ForwardIntro, &etd);
 
@@ -2506,22 +2507,29 @@ static BOOL FindMLIdentity(struct Folder *folder, struct ExtendedMail *email, ch
     // mailing list address
     for(k=-1; k < email->NumSTo; k++)
     {
-      struct Person *person;
+      const char *address;
+      const char *realName;
 
       if(k == -1)
-        person = &email->Mail.To;
+      {
+        address = email->Mail.To.Address;
+        realName = email->Mail.To.RealName;
+      }
       else
-        person = &email->STo[k];
+      {
+        address = email->STo[k].Address;
+        realName = email->STo[k].RealName;
+      }
 
-      if(MatchNoCase(person->Address, folder->MLPattern) == TRUE)
+      if(MatchNoCase(address, folder->MLPattern) == TRUE)
       {
-        D(DBF_MAIL, "address '%s' matches pattern '%s'", person->Address, folder->MLPattern);
+        D(DBF_MAIL, "address '%s' matches pattern '%s'", address, folder->MLPattern);
         result = TRUE;
         break;
       }
-      else if(MatchNoCase(person->RealName, folder->MLPattern) == TRUE)
+      else if(MatchNoCase(realName, folder->MLPattern) == TRUE)
       {
-        D(DBF_MAIL, "name '%s' matches pattern '%s'", person->RealName, folder->MLPattern);
+        D(DBF_MAIL, "name '%s' matches pattern '%s'", realName, folder->MLPattern);
         result = TRUE;
         break;
       }
@@ -2815,11 +2823,11 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
               // and as such when he presses "reply" on it we send it to
               // the To: address recipient instead.
               D(DBF_MAIL, "adding To recipient '%s'", mail->To.Address);
-              rto = AppendRcpt(rto, &mail->To, email->identity, FALSE);
+              rto = AppendRcpt(rto, mail->To.Address, mail->To.RealName, email->identity, FALSE);
               for(k=0; k < email->NumSTo; k++)
               {
                 D(DBF_MAIL, "adding To recipient '%s'", email->STo[k].Address);
-                rto = AppendRcpt(rto, &email->STo[k], email->identity, FALSE);
+                rto = AppendRcpt(rto, email->STo[k].Address, email->STo[k].RealName, email->identity, FALSE);
               }
             }
             else if(hasPrivateFlag(flags) == FALSE && foundMLFolder == TRUE && IsStrEmpty(mlistTo) == FALSE)
@@ -2843,7 +2851,7 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
 
                   ExtractAddress(ptr, &pe);
                   D(DBF_MAIL, "adding To recipient '%s'", pe.Address);
-                  rto = AppendRcpt(rto, &pe, email->identity, FALSE);
+                  rto = AppendRcpt(rto, pe.Address, pe.RealName, email->identity, FALSE);
 
                   ptr = next;
                 }
@@ -2858,17 +2866,17 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                   for(k=0; k < email->NumFollowUpTo; k++)
                   {
                     D(DBF_MAIL, "adding To recipient '%s'", email->FollowUpTo[k].Address);
-                    rto = AppendRcpt(rto, &email->FollowUpTo[k], email->identity, FALSE);
+                    rto = AppendRcpt(rto, email->FollowUpTo[k].Address, email->FollowUpTo[k].RealName, email->identity, FALSE);
                   }
                 }
                 else if(IsStrEmpty(mail->ReplyTo.Address) == FALSE)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", mail->ReplyTo.Address);
-                  rto = AppendRcpt(rto, &mail->ReplyTo, email->identity, FALSE);
+                  rto = AppendRcpt(rto, mail->ReplyTo.Address, mail->ReplyTo.RealName, email->identity, FALSE);
                   for(k=0; k < email->NumSReplyTo; k++)
                   {
                     D(DBF_MAIL, "adding To recipient '%s'", email->SReplyTo[k].Address);
-                    rto = AppendRcpt(rto, &email->SReplyTo[k], email->identity, FALSE);
+                    rto = AppendRcpt(rto, email->SReplyTo[k].Address, email->SReplyTo[k].RealName, email->identity, FALSE);
                   }
                 }
               }
@@ -2890,7 +2898,7 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
 
                   ExtractAddress(ptr, &pe);
                   D(DBF_MAIL, "adding ReplyTo recipient '%s'", pe.Address);
-                  rrepto = AppendRcpt(rrepto, &pe, email->identity, FALSE);
+                  rrepto = AppendRcpt(rrepto, pe.Address, pe.RealName, email->identity, FALSE);
 
                   ptr = next;
                 }
@@ -2953,11 +2961,11 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                   {
                     // add all From: addresses to the CC: list
                     D(DBF_MAIL, "adding CC recipient '%s'", mail->From.Address);
-                    rcc = AppendRcpt(rcc, &mail->From, email->identity, FALSE);
+                    rcc = AppendRcpt(rcc, mail->From.Address, mail->From.RealName, email->identity, FALSE);
                     for(k=0; k < email->NumSFrom; k++)
                     {
                       D(DBF_MAIL, "adding CC recipient '%s'", email->SFrom[k].Address);
-                      rcc = AppendRcpt(rcc, &email->SFrom[k], email->identity, FALSE);
+                      rcc = AppendRcpt(rcc, email->SFrom[k].Address, email->SFrom[k].RealName, email->identity, FALSE);
                     }
                   }
                   // continue
@@ -2973,11 +2981,11 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                   case 1:
                   {
                     D(DBF_MAIL, "adding To recipient '%s'", mail->From.Address);
-                    rto = AppendRcpt(rto, &mail->From, email->identity, FALSE);
+                    rto = AppendRcpt(rto, mail->From.Address, mail->From.RealName, email->identity, FALSE);
                     for(k=0; k < email->NumSFrom; k++)
                     {
                       D(DBF_MAIL, "adding To recipient '%s'", email->SFrom[k].Address);
-                      rto = AppendRcpt(rto, &email->SFrom[k], email->identity, FALSE);
+                      rto = AppendRcpt(rto, email->SFrom[k].Address, email->SFrom[k].RealName, email->identity, FALSE);
                     }
                   }
                   break;
@@ -3016,7 +3024,7 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                 for(k=0; k < email->NumMailReplyTo; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->MailReplyTo[k].Address);
-                  rto = AppendRcpt(rto, &email->MailReplyTo[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->MailReplyTo[k].Address, email->MailReplyTo[k].RealName, email->identity, FALSE);
                 }
               }
               else if(email->NumFollowUpTo > 0 && hasMListFlag(flags) == TRUE)
@@ -3024,27 +3032,27 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                 for(k=0; k < email->NumFollowUpTo; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->FollowUpTo[k].Address);
-                  rto = AppendRcpt(rto, &email->FollowUpTo[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->FollowUpTo[k].Address, email->FollowUpTo[k].RealName, email->identity, FALSE);
                 }
               }
               else if(IsStrEmpty(mail->ReplyTo.Address) == FALSE && hasPrivateFlag(flags) == FALSE)
               {
                 D(DBF_MAIL, "adding To recipient '%s'", mail->ReplyTo.Address);
-                rto = AppendRcpt(rto, &mail->ReplyTo, email->identity, FALSE);
+                rto = AppendRcpt(rto, mail->ReplyTo.Address, mail->ReplyTo.RealName, email->identity, FALSE);
                 for(k=0; k < email->NumSReplyTo; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->SReplyTo[k].Address);
-                  rto = AppendRcpt(rto, &email->SReplyTo[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->SReplyTo[k].Address, email->SReplyTo[k].RealName, email->identity, FALSE);
                 }
               }
               else
               {
                 D(DBF_MAIL, "adding To recipient '%s'", mail->From.Address);
-                rto = AppendRcpt(rto, &mail->From, email->identity, FALSE);
+                rto = AppendRcpt(rto, mail->From.Address, mail->From.RealName, email->identity, FALSE);
                 for(k=0; k < email->NumSFrom; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->SFrom[k].Address);
-                  rto = AppendRcpt(rto, &email->SFrom[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->SFrom[k].Address, email->SFrom[k].RealName, email->identity, FALSE);
                 }
               }
             }
@@ -3062,7 +3070,7 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
               for(k=0; k < email->NumFollowUpTo; k++)
               {
                 D(DBF_MAIL, "adding To recipient '%s'", email->FollowUpTo[k].Address);
-                rto = AppendRcpt(rto, &email->FollowUpTo[k], email->identity, FALSE);
+                rto = AppendRcpt(rto, email->FollowUpTo[k].Address, email->FollowUpTo[k].RealName, email->identity, FALSE);
               }
             }
             else
@@ -3072,44 +3080,44 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
                 for(k=0; k < email->NumMailReplyTo; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->MailReplyTo[k].Address);
-                  rto = AppendRcpt(rto, &email->MailReplyTo[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->MailReplyTo[k].Address, email->MailReplyTo[k].RealName, email->identity, FALSE);
                 }
               }
               else if(mail->ReplyTo.Address[0] != '\0')
               {
                 // add Reply-To: addresses to To:
                 D(DBF_MAIL, "adding To recipient '%s'", mail->ReplyTo.Address);
-                rto = AppendRcpt(rto, &mail->ReplyTo, email->identity, FALSE);
+                rto = AppendRcpt(rto, mail->ReplyTo.Address, mail->ReplyTo.RealName, email->identity, FALSE);
                 for(k=0; k < email->NumSReplyTo; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->SReplyTo[k].Address);
-                  rto = AppendRcpt(rto, &email->SReplyTo[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->SReplyTo[k].Address, email->SReplyTo[k].RealName, email->identity, FALSE);
                 }
               }
               else
               {
                 // add From: addresses to To:
                 D(DBF_MAIL, "adding To recipient '%s'", mail->From.Address);
-                rto = AppendRcpt(rto, &mail->From, email->identity, FALSE);
+                rto = AppendRcpt(rto, mail->From.Address, mail->From.RealName, email->identity, FALSE);
                 for(k=0; k < email->NumSFrom; k++)
                 {
                   D(DBF_MAIL, "adding To recipient '%s'", email->SFrom[k].Address);
-                  rto = AppendRcpt(rto, &email->SFrom[k], email->identity, FALSE);
+                  rto = AppendRcpt(rto, email->SFrom[k].Address, email->SFrom[k].RealName, email->identity, FALSE);
                 }
               }
 
               // add To: addresses to CC:
               D(DBF_MAIL, "adding CC recipient '%s'", mail->To.Address);
-              rcc = AppendRcpt(rcc, &mail->To, email->identity, TRUE);
+              rcc = AppendRcpt(rcc, mail->To.Address, mail->To.RealName, email->identity, TRUE);
               for(k=0; k < email->NumSTo; k++)
               {
                 D(DBF_MAIL, "adding CC recipient '%s'", email->STo[k].Address);
-                rcc = AppendRcpt(rcc, &email->STo[k], email->identity, TRUE);
+                rcc = AppendRcpt(rcc, email->STo[k].Address, email->STo[k].RealName, email->identity, TRUE);
               }
               for(k=0; k < email->NumCC; k++)
               {
                 D(DBF_MAIL, "adding CC recipient '%s'", email->CC[k].Address);
-                rcc = AppendRcpt(rcc, &email->CC[k], email->identity, TRUE);
+                rcc = AppendRcpt(rcc, email->CC[k].Address, email->CC[k].RealName, email->identity, TRUE);
               }
             }
           }
@@ -3121,17 +3129,17 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
           {
             // now add all original To: addresses to To:
             D(DBF_MAIL, "adding To recipient '%s'", mail->To.Address);
-            rto = AppendRcpt(rto, &mail->To, email->identity, TRUE);
+            rto = AppendRcpt(rto, mail->To.Address, mail->To.RealName, email->identity, TRUE);
             for(k=0; k < email->NumSTo; k++)
             {
               D(DBF_MAIL, "adding To recipient '%s'", email->STo[k].Address);
-              rto = AppendRcpt(rto, &email->STo[k], email->identity, TRUE);
+              rto = AppendRcpt(rto, email->STo[k].Address, email->STo[k].RealName, email->identity, TRUE);
             }
             // add the CC: addresses as well
             for(k=0; k < email->NumCC; k++)
             {
               D(DBF_MAIL, "adding CC recipient '%s'", email->CC[k].Address);
-              rcc = AppendRcpt(rcc, &email->CC[k], email->identity, TRUE);
+              rcc = AppendRcpt(rcc, email->CC[k].Address, email->CC[k].RealName, email->identity, TRUE);
             }
           }
           break;
@@ -3202,6 +3210,7 @@ struct WriteMailData *NewReplyMailWindow(struct MailList *mlist, const int flags
           {
             char *cmsg;
 
+            RE_WritePartFile(rmData->firstPart);
             etd.HeaderFile = rmData->firstPart->Filename;
 
             // put some introduction right before the quoted text.
@@ -36,6 +36,7 @@
 
 // forward declarations
 struct BoyerMooreContext;
+struct FullTextQuery;
 
 enum ApplyFilterMode
 {
@@ -159,6 +160,8 @@ struct Search
   struct DateTime      dateTime;
   struct MinList       patternList;               // for storing search patterns, including the embedded singlePattern
   struct BoyerMooreContext *bmContext;
+  struct FullTextQuery *ftQuery;                  // for pruning body searches via the folders' full text indices
+  ULONG                programRule;               // number of the rule in a compiled filter program plus one, 0 if not compiled
 };
 
 // A rule structure which is used to be placed
@@ -231,6 +234,7 @@ void FreeFilterList(struct MinList *filterList);
 struct RuleNode *CreateNewRule(struct FilterNode *filter, const int flags);
 struct RuleNode *GetFilterRule(struct FilterNode *filter, int pos);
 BOOL DoFilterSearch(const struct FilterNode *filter, const struct Mail *mail);
+BOOL FilterListNeedsMailFile(const struct MinList *filterList, const struct Mail *mail);
 BOOL CompareFilterLists(const struct MinList *fl1, const struct MinList *fl2);
 void FilterMails(const struct MailList *mlist, const int mode, struct FilterResult *result);
 BOOL FolderIsUsedByFilters(const struct Folder *folder);
@@ -34,7 +34,10 @@
 
 // forward declarations
 struct Config;
+struct FullTextIndex;
 struct MailList;
+struct MsgIDHash;
+struct ThreadTree;
 struct UserIdentityList;
 
 // Foldertype macros
@@ -125,6 +128,9 @@ struct Folder
   int               ID;                    // unique id for the folder
   Object *          imageObject;
   struct MailList * messages;
+  struct MsgIDHash *msgIDHash;             // message ID lookup tables, built on demand
+  struct ThreadTree *threadTree;           // the thread forest, built on demand
+  struct FullTextIndex *ftIndex;           // the inverted index of the mail texts, loaded on demand
   struct MUI_NListtree_TreeNode *Treenode; // links to MainFolderListtree
   struct FolderNode *self;                 // ptr back to own folder node
   struct FolderNode *parent;               // ptr to parent folder node, NULL if parent is root
@@ -145,6 +151,8 @@ struct Folder
   enum LoadedMode   LoadedMode;
 
   time_t            lastAccessTime;        // when the folder was last accessed/loaded
+  ULONG             journalID;             // ID of the index journal, 0 if no journal is active
+  ULONG             journalSize;           // current size of the index journal in bytes
 
   char              Name[SIZE_NAME];       // the name of the folder
   char              Path[SIZE_PATH];       // relative or absolute path of the folder's directory
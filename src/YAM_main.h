@@ -402,12 +402,12 @@ char *MA_ToStatusHeader(struct Mail *mail);
 char *MA_ToXStatusHeader(struct Mail *mail);
 unsigned int MA_FromStatusHeader(char *statusflags);
 unsigned int MA_FromXStatusHeader(char *xstatusflags);
-char *MA_GetRealSubject(char *sub);
+const char *MA_GetRealSubject(const char *sub);
 void  MA_ChangeSelected(BOOL forceUpdate);
 
 enum NewMailMode CheckNewMailQualifier(const enum NewMailMode mode, const ULONG qualifier, int *flags);
 struct WriteMailData *NewMessage(enum NewMailMode mode, const int flags);
-struct Mail *FindThreadInFolder(const struct Mail *srcMail, const struct Folder *folder, const BOOL nextThread);
+struct Mail *FindThreadInFolder(const struct Mail *srcMail, struct Folder *folder, const BOOL nextThread);
 struct Mail *FindThread(const struct Mail *srcMail, const BOOL nextThread);
 
 BOOL ReceiveMailsFromPOP(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *dlResult);
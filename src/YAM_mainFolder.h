@@ -34,14 +34,26 @@
 
 // forward declarations
 struct Folder;
+struct FolderScan;
 struct UserIdentityNode;
 
+// the main persons of a mail. The strings are shared with all other
+// mails via the global string pool and must be set by SetMailPerson()
+// only, an empty string is never NULL.
+struct MailPerson
+{
+  const char *Address;
+  const char *RealName;
+};
+
 struct Mail
 {
   short            RefCounter; // how many struct MailNode are referencing us?
   struct Folder *  Folder;     // pointer to the folder this mail belongs to
   unsigned long    cMsgID;     // compressed message ID
   unsigned long    cIRTMsgID;  // compressed in-return-to message ID
+  unsigned long    cParentMsgID; // compressed message ID of the parent mail
+  unsigned long    cRootMsgID;   // compressed message ID of the thread's first mail
   long             Size;       // the message size in bytes
   unsigned int     mflags;     // internal mail flags (no status flags)
   unsigned int     sflags;     // mail status flags (read/new etc.)
@@ -49,13 +61,13 @@ struct Mail
   short            gmtOffset;  // the offset to GMT this mail is based on
   struct DateStamp Date;       // the datestamp of the mail (UTC)
   struct TimeVal   transDate;  // the date/time when this messages arrived/was sent. (UTC)
-  struct Person    From;       // The main sender (normally first entry in "From:")
-  struct Person    To;         // The main mail recipient (first entry in "To:")
-  struct Person    ReplyTo;    // The main Reply-To recipients (first entry in "Reply-To:")
+  struct MailPerson From;      // The main sender (normally first entry in "From:")
+  struct MailPerson To;        // The main mail recipient (first entry in "To:")
+  struct MailPerson ReplyTo;   // The main Reply-To recipients (first entry in "Reply-To:")
+  const char *     MailAccount; // pooled name of mail account used to receive/sent mail, see SetMailAccount()
+  const char *     Subject;    // pooled copy of the mail Subject: header, see SetMailSubject()
 
   char tzAbbr[SIZE_SMALL];        // copy of the timezone abbreviation
-  char MailAccount[SIZE_DEFAULT]; // name of mail account used to receive/sent mail
-  char Subject[SIZE_SUBJECT];     // copy of the mail Subject: header
   char MailFile[SIZE_MFILE];      // name of mail file (without path)
 };
 
@@ -109,8 +121,14 @@ enum ReadHeaderMode
 void  MA_ChangeFolder(struct Folder *folder, BOOL set_active);
 void  MA_ExpireIndex(struct Folder *folder);
 struct ExtendedMail *MA_ExamineMail(const struct Folder *folder, const char *file, const BOOL deep);
+struct ExtendedMail *MA_ExamineMailBuffer(const char *name, const char *text, const size_t length, const BOOL deep);
 void  MA_FreeEMailStruct(struct ExtendedMail *email);
+LONG  ExamineMailFiles(struct FolderScan *scan);
 BOOL  MA_GetIndex(struct Folder *folder);
+void  MA_JournalAddMail(const struct Mail *mail);
+void  MA_JournalRemoveMail(const struct Mail *mail, struct Folder *folder);
+void  MA_JournalMailStatus(const struct Mail *mail);
+void  MA_JournalRenameMail(const struct Mail *mail, const char *oldMailFile);
 enum LoadedMode MA_LoadIndex(struct Folder *folder, BOOL full);
 BOOL  MA_NewMailFile(const struct Folder *folder, char *fullPath, const size_t fullPathSize);
 BOOL  MA_PromptFolderPassword(struct Folder *fo, APTR win);
@@ -110,12 +110,14 @@ struct ReadMailData
 #define PFLAG_ALTPART       (1<<3)  // this part is an alternative part (multipart/alternative)
 #define PFLAG_MIME          (1<<4)  // this part conforms to the MIME standard
 #define PFLAG_ATTACHMENT    (1<<5)  // this part is explicitly declared as attachment
+#define PFLAG_CACHED        (1<<6)  // the decoded file belongs to the part cache
 #define hasSubHeaders(part)     (isFlagSet((part)->Flags, PFLAG_SUBHEADERS))
 #define isPrintable(part)       (isFlagSet((part)->Flags, PFLAG_PRINTABLE))
 #define isDecoded(part)         (isFlagSet((part)->Flags, PFLAG_DECODED))
 #define isAlternativePart(part) (isFlagSet((part)->Flags, PFLAG_ALTPART))
 #define isMIMEconform(part)     (isFlagSet((part)->Flags, PFLAG_MIME))
 #define isAttachment(part)      (isFlagSet((part)->Flags, PFLAG_ATTACHMENT))
+#define isCached(part)          (isFlagSet((part)->Flags, PFLAG_CACHED))
 
 // a struct Part is a structure for managing certain message
 // parts according to the hierarchical structuring of e-mails
@@ -137,6 +139,9 @@ struct Part
   char                *CParDesc;           // ptr to the content-type "description"
   char                *CParRType;          // ptr to the content-type "report-type"
   char                *CParCSet;           // ptr to the content-type "charset" "iso8859-1"
+  char                *cacheKey;           // ptr to the key of the part cache node or NULL
+  long                 Offset;             // position of the undecoded data within the mail file
+  long                 Length;             // length of the undecoded data within the mail file
   long                 Size;               // the calculated size in bytes
   int                  Flags;              // PFLAG_#? flags
   int                  Nr;
@@ -156,6 +161,7 @@ struct HeaderNode
 };
 
 BOOL RE_DecodePart(struct Part *rp);
+BOOL RE_WritePartFile(struct Part *rp);
 void RE_DisplayMIME(const char *srcfile, const char *dstfile, const char *ctype, const BOOL convertFromUTF8);
 BOOL RE_ProcessMDN(const enum MDNMode mode, struct Mail *mail, const BOOL multi, const BOOL autoAction, Object *win);
 
@@ -30,14 +30,11 @@
 #include <string.h>
 
 #include <proto/exec.h>
-#include <proto/codesets.h>
 
 #include "YAM.h"
 
 #include "mime/base64.h"
 
-#include "Config.h"
-
 #include "Debug.h"
 
 // Global variables
@@ -54,10 +51,404 @@ static const unsigned char index_64[128] =
    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255
 };
 
+// the decoding table of the streaming decoder, it covers all 256 byte values
+// and marks everything which is not a base64 character. All marks have the
+// two upper bits set, so four characters can be checked at once.
+#define WS  0xfd // whitespace, skipped silently
+#define PAD 0xfe // the padding character '='
+#define INV 0xff // invalid character
+
+static const unsigned char decode_64[256] =
+{
+  INV,INV,INV,INV,INV,INV,INV,INV,INV, WS, WS, WS, WS, WS,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+   WS,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV, 62,INV,INV,INV, 63,
+   52, 53, 54, 55, 56, 57, 58, 59, 60, 61,INV,INV,INV,PAD,INV,INV,
+  INV,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,INV,INV,INV,INV,INV,
+  INV, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+  INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV
+};
+
+#undef WS
+#undef PAD
+#undef INV
+
+#define B64_WS      0xfd
+#define B64_PAD     0xfe
+
 // some defines that can be usefull
-#define B64_LINELEN 72    // number of chars before the b64encode_file() issues a CRLF
-#define B64DEC_BUF  4096  // bytes to use as a base64 file decoding buffer
-#define B64ENC_BUF  4095  // bytes to use as a base64 file encoding buffer (must be a multiple of 3)
+#define B64ENC_BUF  49152 // bytes to use as a base64 file encoding buffer
+
+/*** BASE64 encode/decode kernels ***/
+/// EncodeGroups()
+// encode a number of complete 3 byte groups and break the output into
+// lines if requested
+static char *EncodeGroups(struct B64Encoder *enc, const unsigned char *in, size_t groups, char *out)
+{
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(groups > 0)
+  {
+    size_t n = groups;
+
+    if(enc->lineBreaks == TRUE)
+    {
+      if(enc->lineLength >= B64_LINELEN)
+      {
+        *out++ = '\n';
+        enc->lineLength = 0;
+      }
+
+      // the line length is a multiple of 4, hence at least one group fits
+      if(n > (size_t)(B64_LINELEN - enc->lineLength) / 4)
+        n = (B64_LINELEN - enc->lineLength) / 4;
+
+      enc->lineLength += n * 4;
+    }
+
+    enc->encoded += n * 4;
+    groups -= n;
+
+    // encode 3 bytes as a single 24 bit value to 4 characters
+    while(n > 0)
+    {
+      ULONG v = ((ULONG)in[0] << 16) | ((ULONG)in[1] << 8) | (ULONG)in[2];
+
+      out[0] = basis_64[v >> 18];
+      out[1] = basis_64[(v >> 12) & 0x3f];
+      out[2] = basis_64[(v >> 6) & 0x3f];
+      out[3] = basis_64[v & 0x3f];
+
+      in += 3;
+      out += 4;
+      n--;
+    }
+  }
+
+  return out;
+}
+
+///
+/// EncodeBytes()
+// encode an arbitrary number of bytes, incomplete groups are kept for later
+static char *EncodeBytes(struct B64Encoder *enc, const unsigned char *in, size_t inlen, char *out)
+{
+  size_t groups;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  // complete a pending group first
+  if(enc->restLength > 0)
+  {
+    while(enc->restLength < 3 && inlen > 0)
+    {
+      enc->rest[enc->restLength++] = *in++;
+      inlen--;
+    }
+
+    if(enc->restLength < 3)
+      return out;
+
+    out = EncodeGroups(enc, enc->rest, 1, out);
+    enc->restLength = 0;
+  }
+
+  groups = inlen / 3;
+  out = EncodeGroups(enc, in, groups, out);
+  in += groups * 3;
+  inlen -= groups * 3;
+
+  // keep the remaining bytes
+  while(inlen > 0)
+  {
+    enc->rest[enc->restLength++] = *in++;
+    inlen--;
+  }
+
+  return out;
+}
+
+///
+/// DecodeQuanta()
+// decode as many complete quanta of four valid base64 characters as possible,
+// anything else (whitespace, padding, invalid characters) stops the decoding
+static void DecodeQuanta(const unsigned char **in, size_t *inlen, unsigned char **out)
+{
+  const unsigned char *inp = *in;
+  unsigned char *outp = *out;
+  size_t len = *inlen;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(len >= 4)
+  {
+    ULONG a = decode_64[inp[0]];
+    ULONG b = decode_64[inp[1]];
+    ULONG c = decode_64[inp[2]];
+    ULONG d = decode_64[inp[3]];
+    ULONG v;
+
+    // all marks have the upper two bits set
+    if(((a | b | c | d) & 0xc0) != 0)
+      break;
+
+    v = (a << 18) | (b << 12) | (c << 6) | d;
+
+    outp[0] = (unsigned char)(v >> 16);
+    outp[1] = (unsigned char)(v >> 8);
+    outp[2] = (unsigned char)v;
+
+    inp += 4;
+    outp += 3;
+    len -= 4;
+  }
+
+  *in = inp;
+  *inlen = len;
+  *out = outp;
+}
+
+///
+/// FlushQuantum()
+// write out the bytes of an incomplete quantum, i.e. at the padding or at
+// the end of the data
+static unsigned char *FlushQuantum(struct B64Decoder *dec, unsigned char *out)
+{
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  switch(dec->quantumLength)
+  {
+    case 0:
+      // nothing to do
+    break;
+
+    case 1:
+    {
+      // a single character doesn't make up a byte
+      dec->problem = TRUE;
+    }
+    break;
+
+    case 2:
+    {
+      *out++ = (dec->quantum[0] << 2) | (dec->quantum[1] >> 4);
+    }
+    break;
+
+    default:
+    {
+      *out++ = (dec->quantum[0] << 2) | (dec->quantum[1] >> 4);
+      *out++ = (dec->quantum[1] << 4) | (dec->quantum[2] >> 2);
+    }
+    break;
+  }
+
+  dec->quantumLength = 0;
+
+  return out;
+}
+
+///
+
+/*** BASE64 streaming encode/decode routines (RFC 2045) ***/
+/// base64encode_init()
+// prepare a streaming base64 encoder
+void base64encode_init(struct B64Encoder *enc, BOOL lineBreaks, BOOL convLF)
+{
+  ENTER();
+
+  memset(enc, 0, sizeof(*enc));
+  enc->lineBreaks = lineBreaks;
+  enc->convLF = convLF;
+
+  LEAVE();
+}
+
+///
+/// base64encode_buffer()
+// encode a block of data and return the number of characters written to
+// 'out', which must provide space for B64ENC_MAXLEN(inlen) characters.
+// Lines are separated by a single LF, but the final line is not terminated.
+size_t base64encode_buffer(struct B64Encoder *enc, const char *in, size_t inlen, char *out)
+{
+  const unsigned char *inp = (const unsigned char *)in;
+  char *outp = out;
+
+  ENTER();
+
+  if(enc->convLF == TRUE)
+  {
+    const unsigned char *end = inp + inlen;
+
+    // encode the data line by line and insert a CR in front of each LF
+    while(inp < end)
+    {
+      const unsigned char *eol;
+
+      if((eol = memchr(inp, '\n', end - inp)) != NULL)
+      {
+        outp = EncodeBytes(enc, inp, eol - inp, outp);
+        outp = EncodeBytes(enc, (const unsigned char *)"\r\n", 2, outp);
+        inp = eol + 1;
+      }
+      else
+      {
+        outp = EncodeBytes(enc, inp, end - inp, outp);
+        inp = end;
+      }
+    }
+  }
+  else
+    outp = EncodeBytes(enc, inp, inlen, outp);
+
+  RETURN((size_t)(outp - out));
+  return outp - out;
+}
+
+///
+/// base64encode_finish()
+// encode the remaining bytes including the necessary padding
+size_t base64encode_finish(struct B64Encoder *enc, char *out)
+{
+  char *outp = out;
+
+  ENTER();
+
+  if(enc->restLength > 0)
+  {
+    unsigned char c0 = enc->rest[0];
+    unsigned char c1 = (enc->restLength > 1) ? enc->rest[1] : 0;
+
+    if(enc->lineBreaks == TRUE && enc->lineLength >= B64_LINELEN)
+    {
+      *outp++ = '\n';
+      enc->lineLength = 0;
+    }
+
+    *outp++ = basis_64[c0 >> 2];
+    *outp++ = basis_64[((c0 << 4) & 0x30) | (c1 >> 4)];
+    *outp++ = (enc->restLength > 1) ? basis_64[(c1 << 2) & 0x3c] : '=';
+    *outp++ = '=';
+
+    enc->lineLength += 4;
+    enc->encoded += 4;
+    enc->restLength = 0;
+  }
+
+  RETURN((size_t)(outp - out));
+  return outp - out;
+}
+
+///
+/// base64decode_init()
+// prepare a streaming base64 decoder
+void base64decode_init(struct B64Decoder *dec)
+{
+  ENTER();
+
+  memset(dec, 0, sizeof(*dec));
+
+  LEAVE();
+}
+
+///
+/// base64decode_buffer()
+// decode a block of base64 encoded data and return the number of bytes written
+// to 'out', which must provide space for B64DEC_MAXLEN(inlen) bytes. Whitespace
+// is skipped, invalid characters are skipped as well but flagged as problem.
+size_t base64decode_buffer(struct B64Decoder *dec, const char *in, size_t inlen, char *out)
+{
+  const unsigned char *inp = (const unsigned char *)in;
+  unsigned char *outp = (unsigned char *)out;
+
+  ENTER();
+
+  while(inlen > 0)
+  {
+    unsigned char c;
+
+    // decode as many complete quanta as possible at once, this stops at
+    // the end of each line
+    if(dec->quantumLength == 0 && dec->padding == FALSE)
+    {
+      DecodeQuanta(&inp, &inlen, &outp);
+
+      if(inlen == 0)
+        break;
+    }
+
+    // now handle a single character
+    c = decode_64[*inp++];
+    inlen--;
+
+    if(c < 64)
+    {
+      // data following the padding is decoded as well, but it is a sign
+      // of broken data
+      if(dec->padding == TRUE)
+      {
+        dec->padding = FALSE;
+        dec->problem = TRUE;
+      }
+
+      dec->quantum[dec->quantumLength++] = c;
+      if(dec->quantumLength == 4)
+      {
+        outp[0] = (dec->quantum[0] << 2) | (dec->quantum[1] >> 4);
+        outp[1] = (dec->quantum[1] << 4) | (dec->quantum[2] >> 2);
+        outp[2] = (dec->quantum[2] << 6) | dec->quantum[3];
+        outp += 3;
+
+        dec->quantumLength = 0;
+      }
+    }
+    else if(c == B64_PAD)
+    {
+      // the first padding character terminates the data
+      if(dec->padding == FALSE)
+      {
+        outp = FlushQuantum(dec, outp);
+        dec->padding = TRUE;
+      }
+    }
+    else if(c != B64_WS)
+      dec->problem = TRUE;
+  }
+
+  RETURN((size_t)((char *)outp - out));
+  return (char *)outp - out;
+}
+
+///
+/// base64decode_finish()
+// decode the bytes of an incomplete final quantum, which is flagged as problem
+size_t base64decode_finish(struct B64Decoder *dec, char *out)
+{
+  unsigned char *outp = (unsigned char *)out;
+
+  ENTER();
+
+  if(dec->quantumLength > 0)
+  {
+    // the padding is missing
+    dec->problem = TRUE;
+    outp = FlushQuantum(dec, outp);
+  }
+
+  RETURN((size_t)((char *)outp - out));
+  return (char *)outp - out;
+}
+
+///
 
 /*** BASE64 encode/decode routines (RFC 2045) ***/
 /// base64encode()
@@ -80,65 +471,21 @@ int base64encode(char **out, const char *in, size_t inlen)
   if(inlen > 0 && outlen > 0 &&
      (buffer = malloc(outlen + 1)) != NULL) // +1 for the \0
   {
-    char *outp = buffer;
-    const char *inp = in;
-    unsigned char cbyte;
-    unsigned char obyte;
+    struct B64Encoder enc;
+    size_t len;
 
-    for(; inlen >= 3; inlen -= 3)
-    {
-      cbyte = *inp++;
-      *outp++ = basis_64[(int)(cbyte >> 2)];
-      obyte = (cbyte << 4) & 0x30;             // 0011 0000
-
-      cbyte = *inp++;
-      obyte |= (cbyte >> 4);                   // 0000 1111
-      *outp++ = basis_64[(int)obyte];
-      obyte = (cbyte << 2) & 0x3C;             // 0011 1100
-
-      cbyte = *inp++;
-      obyte |= (cbyte >> 6);                   // 0000 0011
-      *outp++ = basis_64[(int)obyte];
-      *outp++ = basis_64[(int)(cbyte & 0x3F)]; // 0011 1111
-    }
-
-    if(inlen > 0)
-    {
-      char end[3];
-
-      end[0] = *inp++;
-      if(--inlen)
-        end[1] = *inp++;
-      else
-        end[1] = '\0';
-
-      end[2] = '\0';
-
-      cbyte = end[0];
-      *outp++ = basis_64[(int)(cbyte >> 2)];
-      obyte = (cbyte << 4) & 0x30;            // 0011 0000
-
-      cbyte = end[1];
-      obyte |= (cbyte >> 4);
-      *outp++ = basis_64[(int)obyte];
-      obyte = (cbyte << 2) & 0x3C;            // 0011 1100
-
-      if(inlen > 0)
-        *outp++ = basis_64[(int)obyte];
-      else
-        *outp++ = '=';
-
-      *outp++ = '=';
-    }
+    base64encode_init(&enc, FALSE, FALSE);
+    len = base64encode_buffer(&enc, in, inlen, buffer);
+    len += base64encode_finish(&enc, &buffer[len]);
 
     // NUL-terminate the array
-    *outp = '\0';
+    buffer[len] = '\0';
 
     // now write the addr of buffer to out
     *out = buffer;
 
     // return the length of the filled buffer
-    result = outp - buffer;
+    result = len;
   }
 
   RETURN(result);
@@ -167,6 +514,19 @@ int base64decode(char **out, const char *in, size_t inlen)
     unsigned char *outp = buffer;
 
     SHOWVALUE(DBF_MIME,buffer);
+
+    // decode all leading quanta of four valid characters at once, the
+    // last quantum is left to the loop below as it may contain padding
+    if(inlen > 4)
+    {
+      const unsigned char *fastp = inp;
+      size_t fastlen = inlen - 4;
+
+      DecodeQuanta(&fastp, &fastlen, &outp);
+      inp += fastp - inp;
+      inlen = fastlen + 4;
+    }
+
     while(inlen >= 4)
     {
       unsigned char x;
@@ -274,463 +634,71 @@ int base64decode(char **out, const char *in, size_t inlen)
 ///
 /// base64encode_file()
 //  Encodes a file in base64 format. It reads in a file from a supplied FILE*
-//  pointer stepwise by filling up a buffer, encoding it and writing it down
-//  as soon as it reached the length of 72 characters. This makes sure the
-//  base64 encoded parts can be embeded into an RFC822 compliant mail
-//  It returns the total number of encoded characters written to the destination
-//  file.
+//  pointer in large blocks, encodes them via the streaming encoder and writes
+//  out lines of 72 characters. This makes sure the base64 encoded parts can be
+//  embeded into an RFC822 compliant mail. It returns the total number of encoded
+//  characters written to the destination file.
 long base64encode_file(FILE *in, FILE *out, BOOL convLF)
 {
-  char inbuffer[B64ENC_BUF*2+2];  // we use a buffer of 8192 bytes here because we read out
-                                  // data in 4095 byte chunks out of file 'in' and as we
-                                  // probably need to convert each LF into a CRLF we have to
-                                  // have a buffer with a maximum space of 8190 bytes.
-                                  // the other 2 bytes are to be safe. :)
-  char *outbuffer = NULL;
-  char *optr;
-  BOOL eof_reached = FALSE;
-  int next_unget = 0;
-  int missing_chars = 0;
-  int sumencoded = 0;
-  int towrite;
-  int encoded;
-  size_t read = 0;
+  long result = -1;
+  char *inbuffer;
+  char *outbuffer;
 
   ENTER();
   SHOWVALUE(DBF_MIME, convLF);
 
-  while(eof_reached == FALSE)
-  {
-    // before we go on with reading in more data we move
-    // the last next_unget characters of inbuffer to the start
-    // of inbuffer
-    if(next_unget > 0)
-      memmove(inbuffer, &inbuffer[read], next_unget);
-
-    // read in 4095 byte chunks
-    read = fread(&inbuffer[0]+next_unget, 1, B64ENC_BUF-next_unget, in);
-    read += next_unget;
-    next_unget = 0;
-
-    // on a short item count we check for a potential
-    // error and return immediatly.
-    if(read != B64ENC_BUF)
-    {
-      if(feof(in) != 0)
-      {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
-
-        eof_reached = TRUE; // we found an EOF
-
-        // if the last read was zero we can exit immediatly
-        if(read == 0)
-          break;
-      }
-      else
-      {
-        E(DBF_MIME, "error on reading data!");
-
-        // an error occurred, lets return -1
-        RETURN(-1);
-        return -1;
-      }
-    }
-
-    // now we check whether the user want to convert each LF into a CRLF
-    // and if so we need to parse the whole read bytes for \n and convert
-    // them to \r\n before the base64 encoding.
-    if(convLF)
-    {
-      char convbuffer[B64ENC_BUF*2+2];
-      char *sptr = convbuffer;
-      char *dptr = inbuffer;
-      long toconvert = read;
-      long converted = 0;
-
-      // lets fill the convbuffer with the data
-      // of inbuffer first
-      memcpy(convbuffer, inbuffer, toconvert);
-
-      while(toconvert--)
-      {
-        if(*sptr == '\n')
-        {
-          // now write a \r first
-          *dptr = '\r';
-          dptr++;
-
-          converted++;
-        }
-
-        // copy the current character;
-        *dptr = *sptr;
-
-        // increase the pointers
-        dptr++;
-        sptr++;
-      }
-
-      // increase the read counter
-      read += converted;
-
-      // now that we have converted something we have to
-      // make sure that read is still a multiple of 3 if this
-      // isn`t an EOF run.
-      if(eof_reached == FALSE)
-      {
-        // lets check how many chars we have to skip and move
-        // back later
-        next_unget = read % 3;
-        read -= next_unget;
-      }
-    }
-
-    // now everything should be prepared so that we can call the
-    // base64 encoding routine and let it convert our inbuffer to
-    // the apropiate outbuffer
-    encoded = base64encode(&outbuffer, inbuffer, read);
-    sumencoded += encoded;
-
-    // if the base64encoding routine returns <= 0 then there is obviously
-    // something wrong
-    if(encoded <= 0)
-    {
-      E(DBF_MIME, "error on encoding data!");
-
-      RETURN(-1);
-      return -1;
-    }
-
-    // now that we seem to have everything encoded we write out
-    // the encoded sting in 72 character long chunks followed by
-    // a newline
-    optr = outbuffer;
-    towrite = encoded;
-
-    while(towrite > 0)
-    {
-      size_t todo;
-
-      // how many chars should be written?
-      if(missing_chars == 0)
-      {
-        if(towrite >= B64_LINELEN)
-        {
-          todo = B64_LINELEN;
-        }
-        else
-          todo = towrite;
-      }
-      else
-        todo = towrite < missing_chars ? towrite : missing_chars;
-
-      // now we do a binary write of the data
-      if(fwrite(optr, 1, todo, out) != todo)
-      {
-        E(DBF_MIME, "error on writing data!");
-
-        free(outbuffer);
-
-        // an error must have occurred.
-        RETURN(-1);
-        return -1;
-      }
-
-      // lets modify our counters
-      towrite -= todo;
-      optr += todo;
-
-      // then we have to check whether we have written
-      // a full 72 char long line or not and if so we can attach
-      // a newline.
-      if(missing_chars == 0 &&
-         todo < B64_LINELEN && eof_reached == FALSE)
-      {
-        // if we end up here we don`t write any newline,
-        // but we remember how many characters we are
-        // going to write in advance next time.
-        missing_chars = B64_LINELEN-todo;
-      }
-      else if((towrite > 0 || eof_reached == FALSE) && fputc('\n', out) == EOF)
-      {
-        E(DBF_MIME, "error on writing newline");
-
-        free(outbuffer);
-
-        RETURN(-1);
-        return -1;
-      }
-      else
-        missing_chars = 0;
-    }
+  // the buffers are too large for the stack
+  inbuffer = malloc(B64ENC_BUF);
+  outbuffer = malloc(B64ENC_MAXLEN(B64ENC_BUF));
 
-    free(outbuffer);
-    outbuffer = NULL;
-  }
-
-  RETURN(sumencoded);
-  return sumencoded;
-}
-
-///
-/// base64decode_file()
-//  Decodes a file in base64 format. Takes care of an eventually specified translation
-//  table as well as a CRLF->LF translation for printable text. It reads in the base64
-//  strings line by line from the in file stream, decodes it and writes out the
-//  decoded data with fwrite() to the out stream. It returns the total bytes of
-//  written (decoded) data. In case of an error it returns -1 and in case it
-//  found a short item count during decoding it return -2 asking the user
-//  to still consider the string decoded (however it should be treated with
-//  care)
-long base64decode_file(FILE *in, FILE *out,
-                       struct codeset *srcCodeset, BOOL isText, BOOL convCRLF)
-{
-  char inbuffer[B64DEC_BUF+1];
-  char *outbuffer = NULL;
-  char ungetbuf[3];
-  long decodedChars = 0;
-  size_t next_unget = 0;
-  BOOL eof_reached = FALSE;
-  BOOL problemDuringDecode = FALSE;
-
-  ENTER();
-
-  D(DBF_MIME, "codeset '%s'", srcCodeset != NULL ? srcCodeset->name : "none");
-
-  while(eof_reached == FALSE)
+  if(inbuffer != NULL && outbuffer != NULL)
   {
-    int outLength = 0;
-    char *sptr;
-    char *dptr;
+    struct B64Encoder enc;
+    BOOL error = FALSE;
     size_t read;
-    size_t todo;
-
-    // if we do have some unget chars lets copy them first at the
-    // beginning of the inbuffer
-    if(next_unget > 0)
-      memcpy(inbuffer, ungetbuf, next_unget);
+    size_t encoded;
 
-    // do a binary read of ~4096 chunks
-    read = fread(&inbuffer[next_unget], sizeof(char), B64DEC_BUF-next_unget, in);
+    base64encode_init(&enc, TRUE, convLF);
 
-    // on a short item count we check for a potential
-    // error and return immediatly.
-    if(read != B64DEC_BUF-next_unget)
+    do
     {
-      if(feof(in) != 0)
-      {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
-
-        eof_reached = TRUE; // we found an EOF
+      read = fread(inbuffer, 1, B64ENC_BUF, in);
 
-        // if the last read was zero we can exit immediatly
-        if(read == 0 && next_unget == 0)
-          break;
-      }
-      else
+      // on a short item count we check for a potential error
+      if(read != B64ENC_BUF && ferror(in) != 0)
       {
         E(DBF_MIME, "error on reading data!");
-
-        // an error occurred, lets return -1
-        RETURN(-1);
-        return -1;
+        error = TRUE;
+        break;
       }
-    }
-
-    // increase/reset the counters
-    read += next_unget;
-    next_unget = 0;
 
-    // now that we have read 4096 bytes into our buffer
-    // we have to iterate through this buffer and "eliminate"
-    // white spaces which aren`t normally part of base64 encoded
-    // string and can be safely skipped without
-    // corrupting the decoded file.
-    sptr = inbuffer;
-    dptr = inbuffer;
-    todo = read;
-
-    while(todo > 0)
-    {
-      if(!isspace(*sptr))
-      {
-        *dptr = *sptr;
-        dptr++;
-      }
-      else read--;
-
-      sptr++;
-      todo--;
-    }
-
-    // if we end up with read == 0 we had only spaces in our
-    // source string, so lets skip to the next iteration
-    if(read == 0)
-      continue;
-
-    // before we going to decode the string we have to make sure
-    // that the encoded string is a multiple of 4 as 4 encoded
-    // base64 chars will get out 2 unencoded ones.
-    next_unget = read % 4;
-    if(next_unget > 0)
-    {
-      if(eof_reached == FALSE)
-      {
-        read -= next_unget;
-        memcpy(ungetbuf, &inbuffer[read], next_unget);
-      }
+      if(read > 0)
+        encoded = base64encode_buffer(&enc, inbuffer, read, outbuffer);
       else
-      {
-        W(DBF_MIME, "unget chars at EOF???");
-
-        problemDuringDecode = TRUE;
-      }
-    }
+        encoded = 0;
 
-    // now that we have a whitespace free somewhat base64 encoded
-    // string, we can call the base64decode() function to finally
-    // decode the string
-    if(read <= 0 ||
-       (outLength = base64decode(&outbuffer, inbuffer, read)) <= 0)
-    {
-      E(DBF_MIME, "error on decoding: %ld %ld", read, outLength);
+      // add the padding at the end of the file
+      if(read != B64ENC_BUF)
+        encoded += base64encode_finish(&enc, &outbuffer[encoded]);
 
-      if(outLength < 0)
-      {
-        // we faced a short item count. That can actually be a sign that the text
-        // in question is not a fully base64 compliant string. However, to
-        // at least display the text to the user we redefine the outLength and
-        // let the write function output that string (even if not correctly
-        // decoded)
-        outLength = -outLength;
-
-        problemDuringDecode = TRUE;
-      }
-      else
-      {
-        // it should not happen that we face a shortCount
-        // or error
-        free(outbuffer);
-        RETURN(-1);
-        return -1;
-      }
-    }
-
-    // in case the user wants us to detect the correct cyrillic codeset
-    // we do it now, but just if the source codeset isn't UTF-8
-    if(C->DetectCyrillic == TRUE && isText == TRUE)
-    {
-      if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-      {
-        struct codeset *cs = CodesetsFindBest(CSA_Source,         outbuffer,
-                                              CSA_SourceLen,      outLength,
-                                              CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                              TAG_DONE);
-
-        if(cs != NULL && cs != srcCodeset)
-        {
-          D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-          srcCodeset = cs;
-        }
-      }
-    }
-
-    // if the caller supplied a source codeset, we have to
-    // make sure we convert our outbuffer before writing it out
-    // to the file in UTF8, but we must not touch binary/non-text data
-    if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-    {
-      ULONG strLen = 0;
-
-      UTF8 *str = CodesetsUTF8Create(CSA_Source,          outbuffer,
-                                     CSA_SourceLen,       outLength,
-                                     CSA_SourceCodeset,   srcCodeset,
-                                     CSA_DestLenPtr,      &strLen,
-                                     TAG_DONE);
-
-      if(str != NULL && strLen > 0)
-      {
-        // if we end up here we successfully converted the
-        // sourcebuffer to a destination buffer which complies to our local
-        // charset
-        dptr = (char *)str;
-        outLength = strLen;
-      }
-      else
-      {
-        W(DBF_MIME, "error while trying to convert base64decoded string to UTF8");
-        dptr = outbuffer;
-      }
-    }
-    else
-      dptr = outbuffer;
-
-    if(dptr != NULL)
-    {
-      // if the user also wants to convert CRLF to LF only,
-      // we do it right now
-      if(convCRLF == TRUE)
-      {
-        long r;
-        char *rc = dptr;
-        char *wc = dptr;
-
-        for(r=0; r < outLength; r++, rc++)
-        {
-          // check if this is a CRLF
-          if(*rc == '\r' &&
-             outLength-r > 1 && rc[1] == '\n')
-          {
-            // if so, skip the \r
-            continue;
-          }
-          else
-          {
-            // if no CRLF is found, lets copy
-            // the plain character
-            *wc = *rc;
-
-            // increase the write counter
-            wc++;
-          }
-        }
-
-        // make sure we reduce outLength by the
-        // number of "overjumped" chars.
-        outLength -= (rc-wc);
-      }
-
-      // now that we got the string decoded we write it into
-      // our file
-      if(fwrite(dptr, sizeof(char), (size_t)outLength, out) != (size_t)outLength)
+      if(encoded > 0 && fwrite(outbuffer, 1, encoded, out) != encoded)
       {
         E(DBF_MIME, "error on writing data!");
-
-        // an error occurred while writing...
-        RETURN(-1);
-        return -1;
+        error = TRUE;
+        break;
       }
     }
+    while(read == B64ENC_BUF);
 
-    // in case the dptr buffer was allocated by codesets.library,
-    // we have to free it now
-    if(dptr != outbuffer && dptr != NULL)
-      CodesetsFreeA(dptr, NULL);
-
-    free(outbuffer);
-
-    // increase the decodedChars counter
-    decodedChars += outLength;
+    if(error == FALSE)
+      result = enc.encoded;
   }
 
-  // if there was a problem during
-  // the decoding phase we go and warn the user with a
-  // return value of -2
-  if(problemDuringDecode == TRUE)
-    decodedChars = -2;
+  free(inbuffer);
+  free(outbuffer);
 
-  RETURN(decodedChars);
-  return decodedChars;
+  RETURN(result);
+  return result;
 }
 
 ///
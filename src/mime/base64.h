@@ -30,17 +30,47 @@
 
 #include <exec/types.h>
 
-// forward declarations
-struct codeset;
-
 // static variables
 static const char basis_64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+// the state of a streaming base64 encoder
+struct B64Encoder
+{
+  unsigned char rest[3]; // input bytes not yet making up a full group
+  int restLength;
+  int lineLength;        // number of characters in the current output line
+  long encoded;          // number of encoded characters without line breaks
+  BOOL lineBreaks;       // break the output into lines of B64_LINELEN characters
+  BOOL convLF;           // encode each LF as CRLF
+};
+
+// the state of a streaming base64 decoder
+struct B64Decoder
+{
+  unsigned char quantum[4]; // decoded characters not yet making up a full quantum
+  int quantumLength;
+  BOOL padding;             // the padding of the current data has been seen
+  BOOL problem;             // invalid or truncated data has been found
+};
+
+#define B64_LINELEN 72 // number of chars before the base64 encoder issues a LF
+
+// the maximum number of bytes base64encode_buffer()/base64encode_finish() and
+// base64decode_buffer()/base64decode_finish() produce for inlen input bytes
+#define B64ENC_MAXLEN(inlen) ((inlen)*3+8)
+#define B64DEC_MAXLEN(inlen) ((inlen)/4*3+3)
+
+// streaming base64 encoding/decoding of memory buffers
+void base64encode_init(struct B64Encoder *enc, BOOL lineBreaks, BOOL convLF);
+size_t base64encode_buffer(struct B64Encoder *enc, const char *in, size_t inlen, char *out);
+size_t base64encode_finish(struct B64Encoder *enc, char *out);
+void base64decode_init(struct B64Decoder *dec);
+size_t base64decode_buffer(struct B64Decoder *dec, const char *in, size_t inlen, char *out);
+size_t base64decode_finish(struct B64Decoder *dec, char *out);
+
 // base64 encoding/decoding routines
 int base64encode(char **out, const char *in, size_t inlen);
 int base64decode(char **out, const char *in, size_t inlen);
 long base64encode_file(FILE *in, FILE *out, BOOL convLF);
-long base64decode_file(FILE *in, FILE *out,
-                       struct codeset *srcCodeset, BOOL isText, BOOL convCRLF);
 
 #endif // BASE64_H
@@ -0,0 +1,443 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <proto/exec.h>
+#include <proto/codesets.h>
+
+#include "YAM.h"
+
+#include "mime/decodechain.h"
+
+#include "Config.h"
+
+#include "Debug.h"
+
+// an 8bit character takes at most 3 bytes in UTF-8
+#define DC_CONVSIZE (DC_BLOCKSIZE*3+1)
+
+// the least free space of a block the transfer decoding is continued in,
+// the decoders never put out more than 3 bytes for a partial input
+#define DC_MINSPACE 8
+
+/*** Decoding chain stages ***/
+/// IsUTF8Codeset()
+// check whether a codeset is UTF-8 which doesn't need any conversion
+static BOOL IsUTF8Codeset(const struct codeset *cs)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(cs != NULL && cs->name != NULL && stricmp(cs->name, "utf-8") == 0)
+    result = TRUE;
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// DetectCodeset()
+// detect the codeset of the text by its first block in case the part didn't
+// specify one or if the user wants us to detect cyrillic codesets
+static void DetectCodeset(struct DecodeChain *dc, const char *data, size_t len)
+{
+  ENTER();
+
+  if(dc->srcCodeset == NULL || (C->DetectCyrillic == TRUE && IsUTF8Codeset(dc->srcCodeset) == FALSE))
+  {
+    struct codeset *cs = CodesetsFindBest(CSA_Source,            data,
+                                          CSA_SourceLen,         len,
+                                          CSA_CodesetFamily,     C->DetectCyrillic == TRUE ? CSV_CodesetFamily_Cyrillic : CSV_CodesetFamily_Latin,
+                                          CSA_FallbackToDefault, FALSE,
+                                          TAG_DONE);
+
+    if(cs != NULL && cs != dc->srcCodeset)
+    {
+      D(DBF_MIME, "using codeset '%s' instead of '%s'", cs->name, dc->srcCodeset != NULL ? dc->srcCodeset->name : "none");
+      dc->srcCodeset = cs;
+    }
+    else
+      D(DBF_MIME, "couldn't detect a codeset for the text");
+  }
+
+  dc->detected = TRUE;
+
+  LEAVE();
+}
+
+///
+/// NormaliseCRLF()
+// convert CRLF to LF in place and return the new length. A CR at the end of
+// the block is kept back as the LF might follow in the next block.
+static size_t NormaliseCRLF(struct DecodeChain *dc, char *data, size_t len)
+{
+  char *rc;
+
+  ENTER();
+
+  // find the first CR and then move the data in place
+  if((rc = memchr(data, '\r', len)) != NULL)
+  {
+    char *wc = rc;
+    char *end = data + len;
+
+    while(rc < end)
+    {
+      if(*rc == '\r' && (rc + 1 == end || rc[1] == '\n'))
+      {
+        // skip a CR in front of a LF and keep back a trailing one
+        if(rc + 1 == end)
+          dc->pendingCR = TRUE;
+
+        rc++;
+      }
+      else
+        *wc++ = *rc++;
+    }
+
+    len = wc - data;
+  }
+
+  RETURN(len);
+  return len;
+}
+
+///
+/// FlushBlock()
+// pass the current block through the charset conversion and the CRLF
+// normalisation to the sink
+static BOOL FlushBlock(struct DecodeChain *dc)
+{
+  ENTER();
+
+  if(dc->error == FALSE && dc->blockLength > 0)
+  {
+    char *data = dc->block;
+    size_t len = dc->blockLength;
+    UTF8 *utf8 = NULL;
+
+    // the charset conversion stage
+    if(isFlagSet(dc->flags, DCF_CONVERT))
+    {
+      if(isFlagSet(dc->flags, DCF_DETECT) && dc->detected == FALSE)
+        DetectCodeset(dc, data, len);
+
+      if(dc->srcCodeset != NULL && IsUTF8Codeset(dc->srcCodeset) == FALSE)
+      {
+        ULONG utf8Length = 0;
+
+        utf8 = CodesetsUTF8Create(CSA_Source,          data,
+                                  CSA_SourceLen,       len,
+                                  CSA_SourceCodeset,   dc->srcCodeset,
+                                  CSA_Dest,            dc->convBuffer,
+                                  CSA_DestLen,         DC_CONVSIZE,
+                                  CSA_DestLenPtr,      &utf8Length,
+                                  TAG_DONE);
+
+        if(utf8 != NULL && utf8Length > 0)
+        {
+          data = (char *)utf8;
+          len = utf8Length;
+        }
+        else
+          W(DBF_MIME, "error while trying to convert decoded text to UTF8");
+      }
+    }
+
+    // the CRLF normalisation stage, a CR from the previous
+    // block is dropped if a LF follows
+    if(isFlagSet(dc->flags, DCF_CRLF))
+    {
+      if(dc->pendingCR == TRUE)
+      {
+        dc->pendingCR = FALSE;
+
+        if(data[0] != '\n' && dc->sink("\r", 1, dc->sinkData) == FALSE)
+          dc->error = TRUE;
+      }
+
+      len = NormaliseCRLF(dc, data, len);
+    }
+
+    if(dc->error == FALSE && len > 0 && dc->sink(data, len, dc->sinkData) == FALSE)
+    {
+      E(DBF_MIME, "error on writing data!");
+      dc->error = TRUE;
+    }
+
+    // in case the conversion didn't fit into our buffer
+    // the string was allocated by codesets.library
+    if(utf8 != NULL && (char *)utf8 != dc->convBuffer)
+      CodesetsFreeA(utf8, NULL);
+  }
+
+  dc->blockLength = 0;
+
+  RETURN(!dc->error);
+  return !dc->error;
+}
+
+///
+
+/*** Decoding chain functions ***/
+/// decodechain_init()
+// set up a decoding chain which passes the decoded data to the given sink
+BOOL decodechain_init(struct DecodeChain *dc, enum DecodeType type, int flags, struct codeset *srcCodeset,
+                      BOOL (* sink)(const char *data, size_t len, void *userData), void *sinkData)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  D(DBF_MIME, "decoding type %ld, flags %08lx, codeset '%s'", type, flags, srcCodeset != NULL ? srcCodeset->name : "none");
+
+  memset(dc, 0, sizeof(*dc));
+  dc->type = type;
+  dc->flags = flags;
+  dc->srcCodeset = srcCodeset;
+  dc->sink = sink;
+  dc->sinkData = sinkData;
+
+  if(type == DCT_BASE64)
+    base64decode_init(&dc->dec.b64);
+  else if(type == DCT_QP)
+    qpdecode_init(&dc->dec.qp);
+
+  // the buffers are too large for the stack
+  if((dc->block = malloc(DC_BLOCKSIZE)) != NULL)
+  {
+    if(isFlagClear(flags, DCF_CONVERT) || (dc->convBuffer = malloc(DC_CONVSIZE)) != NULL)
+      result = TRUE;
+  }
+
+  if(result == FALSE)
+    decodechain_cleanup(dc);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// decodechain_write()
+// put data into the chain, the transfer decoding stage decodes it straight
+// into the current block which is passed on as soon as it is filled up
+BOOL decodechain_write(struct DecodeChain *dc, const char *in, size_t inlen)
+{
+  ENTER();
+
+  while(dc->error == FALSE && inlen > 0)
+  {
+    size_t space = DC_BLOCKSIZE - dc->blockLength;
+    size_t chunk;
+    size_t decoded;
+
+    // the amount of input which is guaranteed to fit into the block
+    if(space < DC_MINSPACE)
+      chunk = 0;
+    else if(dc->type == DCT_BASE64)
+      chunk = (space - 3) / 3 * 4;
+    else if(dc->type == DCT_QP)
+      chunk = space - 3;
+    else
+      chunk = space;
+
+    if(chunk == 0)
+    {
+      FlushBlock(dc);
+      continue;
+    }
+
+    if(chunk > inlen)
+      chunk = inlen;
+
+    if(dc->type == DCT_BASE64)
+      decoded = base64decode_buffer(&dc->dec.b64, in, chunk, &dc->block[dc->blockLength]);
+    else if(dc->type == DCT_QP)
+      decoded = qpdecode_buffer(&dc->dec.qp, in, chunk, &dc->block[dc->blockLength]);
+    else
+    {
+      memcpy(&dc->block[dc->blockLength], in, chunk);
+      decoded = chunk;
+    }
+
+    dc->blockLength += decoded;
+    dc->decoded += decoded;
+
+    in += chunk;
+    inlen -= chunk;
+  }
+
+  RETURN(!dc->error);
+  return !dc->error;
+}
+
+///
+/// decodechain_finish()
+// finish the transfer decoding and pass all remaining data to the sink
+BOOL decodechain_finish(struct DecodeChain *dc)
+{
+  ENTER();
+
+  if(dc->error == FALSE && dc->type != DCT_NONE)
+  {
+    size_t decoded;
+
+    if(DC_BLOCKSIZE - dc->blockLength < DC_MINSPACE)
+      FlushBlock(dc);
+
+    // decode an incomplete final quantum or sequence
+    if(dc->type == DCT_BASE64)
+      decoded = base64decode_finish(&dc->dec.b64, &dc->block[dc->blockLength]);
+    else
+      decoded = qpdecode_finish(&dc->dec.qp, &dc->block[dc->blockLength]);
+
+    dc->blockLength += decoded;
+    dc->decoded += decoded;
+  }
+
+  FlushBlock(dc);
+
+  // a trailing CR is written as is
+  if(dc->error == FALSE && dc->pendingCR == TRUE)
+  {
+    dc->pendingCR = FALSE;
+
+    if(dc->sink("\r", 1, dc->sinkData) == FALSE)
+      dc->error = TRUE;
+  }
+
+  RETURN(!dc->error);
+  return !dc->error;
+}
+
+///
+/// decodechain_file()
+// read the data from a file in large blocks and put it through the chain.
+// At most 'length' bytes are read, a negative length reads up to the end
+// of the file.
+BOOL decodechain_file(struct DecodeChain *dc, FILE *in, long length)
+{
+  ENTER();
+
+  // plain data is read straight into the blocks, only encoded
+  // data needs a buffer of its own
+  if(dc->type != DCT_NONE && dc->inBuffer == NULL && (dc->inBuffer = malloc(DC_BLOCKSIZE)) == NULL)
+    dc->error = TRUE;
+
+  while(dc->error == FALSE && length != 0)
+  {
+    size_t toRead;
+    size_t read;
+    char *buf;
+
+    if(dc->type == DCT_NONE)
+    {
+      if(dc->blockLength == DC_BLOCKSIZE)
+        FlushBlock(dc);
+
+      buf = &dc->block[dc->blockLength];
+      toRead = DC_BLOCKSIZE - dc->blockLength;
+    }
+    else
+    {
+      buf = dc->inBuffer;
+      toRead = DC_BLOCKSIZE;
+    }
+
+    if(length >= 0 && (size_t)length < toRead)
+      toRead = length;
+
+    read = fread(buf, 1, toRead, in);
+
+    // on a short item count we check for a potential error
+    if(read != toRead && ferror(in) != 0)
+    {
+      E(DBF_MIME, "error on reading data!");
+      dc->error = TRUE;
+      break;
+    }
+
+    if(length >= 0)
+      length -= read;
+
+    if(dc->type == DCT_NONE)
+    {
+      dc->blockLength += read;
+      dc->decoded += read;
+    }
+    else
+      decodechain_write(dc, buf, read);
+
+    // stop at the end of the file
+    if(read != toRead)
+      break;
+  }
+
+  decodechain_finish(dc);
+
+  RETURN(!dc->error);
+  return !dc->error;
+}
+
+///
+/// decodechain_cleanup()
+// free the buffers of a decoding chain
+void decodechain_cleanup(struct DecodeChain *dc)
+{
+  ENTER();
+
+  free(dc->block);
+  dc->block = NULL;
+  free(dc->convBuffer);
+  dc->convBuffer = NULL;
+  free(dc->inBuffer);
+  dc->inBuffer = NULL;
+
+  LEAVE();
+}
+
+///
+/// decodechain_fwrite()
+// a sink writing the decoded data to the FILE stream given as user data
+BOOL decodechain_fwrite(const char *data, size_t len, void *userData)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  if(fwrite(data, 1, len, (FILE *)userData) != len)
+    result = FALSE;
+
+  RETURN(result);
+  return result;
+}
+
+///
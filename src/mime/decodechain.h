@@ -0,0 +1,92 @@
+#ifndef DECODECHAIN_H
+#define DECODECHAIN_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+#include "mime/base64.h"
+#include "mime/qprintable.h"
+
+// forward declarations
+struct codeset;
+
+// the transfer decoding done by the first stage of a decoding chain
+enum DecodeType
+{
+  DCT_NONE,   // plain 7bit/8bit/binary data or data decoded already
+  DCT_BASE64, // base64 encoded data
+  DCT_QP      // quoted-printable encoded data
+};
+
+// flags for the further stages of a decoding chain
+#define DCF_CONVERT (1<<0)  // convert text from its source codeset to UTF-8
+#define DCF_DETECT  (1<<1)  // detect the source codeset of the text by its first block
+#define DCF_CRLF    (1<<2)  // normalise CRLF line breaks to LF
+
+#define DC_BLOCKSIZE 16384  // size of the blocks passed between the stages
+
+// A decoding chain passes data through the transfer decoding, the charset
+// conversion and the CRLF normalisation stage to a sink. The stages work on
+// fixed size blocks, so no stage ever needs a buffer for the whole part.
+struct DecodeChain
+{
+  enum DecodeType type;
+  int flags;                  // DCF_#? flags
+  struct codeset *srcCodeset; // the source codeset of the text or NULL
+  union
+  {
+    struct B64Decoder b64;
+    struct QPDecoder qp;
+  } dec;                      // the state of the transfer decoding
+  char *block;                // the current block of transfer decoded data
+  size_t blockLength;
+  char *convBuffer;           // the current block converted to UTF-8
+  char *inBuffer;             // input buffer for reading encoded data from a file
+  long decoded;               // number of bytes put out by the transfer decoding
+  BOOL detected;              // the source codeset has been detected already
+  BOOL pendingCR;             // a CR at the end of the last block
+  BOOL error;                 // reading or writing the data failed
+
+  // the sink which receives the blocks of the last stage
+  BOOL (* sink)(const char *data, size_t len, void *userData);
+  void *sinkData;
+};
+
+// the prototypes for our public available functions
+BOOL decodechain_init(struct DecodeChain *dc, enum DecodeType type, int flags, struct codeset *srcCodeset,
+                      BOOL (* sink)(const char *data, size_t len, void *userData), void *sinkData);
+BOOL decodechain_write(struct DecodeChain *dc, const char *in, size_t inlen);
+BOOL decodechain_finish(struct DecodeChain *dc);
+BOOL decodechain_file(struct DecodeChain *dc, FILE *in, long length);
+void decodechain_cleanup(struct DecodeChain *dc);
+
+// a sink writing the decoded data to a FILE stream
+BOOL decodechain_fwrite(const char *data, size_t len, void *userData);
+
+#endif // DECODECHAIN_H
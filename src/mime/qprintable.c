@@ -30,503 +30,527 @@
 #include <string.h>
 
 #include <proto/exec.h>
-#include <proto/codesets.h>
 
 #include "YAM.h"
 
 #include "mime/qprintable.h"
 
-#include "Config.h"
-
 #include "Debug.h"
 
 // Global variables
 
 // some defines that can be usefull
 #define QP_LINELEN  76    // number of chars before qpencode_file() issues a CRLF
-#define QPENC_BUF   4096  // bytes to use as a quoted-printable file encoding buffer
-#define QPDEC_BUF   4096  // bytes to use as a quoted-printable file decoding buffer
+#define QPENC_BUF   32768 // bytes to use as a quoted-printable file encoding buffer
 
-/*** Quoted-Printable encode/decode routines (RFC 2045) ***/
-/// qpencode_file()
-// Encodes a whole file using the quoted-printable format defined in
-// RFC 2045 (page 19)
-long qpencode_file(FILE *in, FILE *out)
+// the maximum number of characters of an encoded line, one space is left
+// for the trailing '=' of a soft line break
+#define QP_MAXCHARS (QP_LINELEN-2)
+
+// characters which the decoder copies as they are
+#define is_qpplain(c) ((c) < 0x80 && (c) != '=' && (c) != '\r')
+
+/*** Quoted-Printable encode/decode kernels ***/
+/// SoftBreak()
+// put a soft line break if the line has no space left for len characters
+static char *SoftBreak(struct QPEncoder *enc, char *out, const int len)
 {
-  unsigned char inbuffer[QPENC_BUF+1]; // we read out data in ~4096 byte chunks
-  unsigned char outbuffer[QPENC_BUF+5];// the output buffer should not be more than
-                                       // the input buffer with an additional space
-                                       // for 5 chars which could be used during
-                                       // encoding.
-
-  unsigned char *iptr;
-  unsigned char *optr = outbuffer;
-  unsigned char c;
-  int last = -1;
-  long encoded_chars = 0;
-  int line_len = 0;
-  BOOL eof_reached = FALSE;
-  size_t read;
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
-  ENTER();
+  if(enc->lineLength + len > QP_MAXCHARS)
+  {
+    *out++ = '=';
+    *out++ = '\n';
+
+    enc->lineLength = 0;
+  }
+
+  return out;
+}
+
+///
+/// EncodeChar()
+// encode a single unsafe character as =XX
+static char *EncodeChar(struct QPEncoder *enc, const unsigned char c, char *out)
+{
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  out = SoftBreak(enc, out, 3);
+
+  *out++ = '=';
+  *out++ = basis_hex[(c >> 4) & 0xF];
+  *out++ = basis_hex[c & 0xF];
+
+  enc->lineLength += 3;
+  enc->encoded++;
+  enc->last = c;
+  enc->lineStart = FALSE;
+
+  return out;
+}
+
+///
+/// EncodeBytes()
+// encode a block of data, runs of safe characters are copied at once. A
+// "From " at the start of a line is encoded to keep mbox readers happy,
+// if it is split across two blocks the characters are kept back.
+static char *EncodeBytes(struct QPEncoder *enc, const unsigned char *in, size_t inlen, char *out)
+{
+  const unsigned char *end = in + inlen;
 
-  while(eof_reached == FALSE)
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(in < end)
   {
-    // read in 4096 byte chunks
-    read = fread(inbuffer, 1, QPENC_BUF, in);
+    unsigned char c = *in;
 
-    // on a short item count we check for a potential
-    // error and return immediatly.
-    if(read != QPENC_BUF)
+    if(c == '\n')
     {
-      if(feof(in) != 0)
+      // check if the previous char is a linear whitespace and
+      // if so we have to put a soft break right before the
+      // newline
+      if(enc->last == ' ' || enc->last == '\t')
       {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
+        *out++ = '=';
+        *out++ = '\n';
+      }
+
+      *out++ = '\n';
+
+      enc->lineLength = 0;
+      enc->last = c;
+      enc->lineStart = TRUE;
+      in++;
+    }
+    else if(c == 'F' && enc->lineStart == TRUE)
+    {
+      size_t avail = end - in;
 
-        eof_reached = TRUE; // we found an EOF
+      if(avail >= 5)
+      {
+        if(strncmp((const char *)in, "From ", 5) == 0)
+          out = EncodeChar(enc, c, out);
+        else
+        {
+          out = SoftBreak(enc, out, 1);
+          *out++ = c;
+          enc->lineLength++;
+          enc->last = c;
+          enc->lineStart = FALSE;
+        }
 
-        // if the last read was zero we can exit immediatly
-        if(read == 0)
-          break;
+        in++;
+      }
+      else if(strncmp((const char *)in, "From ", avail) == 0)
+      {
+        // the decision must wait for the next block
+        enc->fromLength = avail;
+        in = end;
       }
       else
       {
-        E(DBF_MIME, "error on reading data!");
-
-        // an error occurred, lets return -1
-        RETURN(-1);
-        return -1;
+        out = SoftBreak(enc, out, 1);
+        *out++ = c;
+        enc->lineLength++;
+        enc->last = c;
+        enc->lineStart = FALSE;
+        in++;
       }
     }
+    else if(is_qpsafe(c))
+    {
+      const unsigned char *run = in + 1;
 
-    // let us now parse through the inbuffer and encode it according
-    // to RFC 2045
-    iptr = inbuffer;
+      // find the end of the run of safe characters
+      while(run < end && *run != '\n' && is_qpsafe(*run))
+        run++;
 
-    while(read)
-    {
-      // decrease the read number and increase
-      // out input buffer pointer
-      c = *iptr++;
-      read--;
+      enc->last = run[-1];
+      enc->lineStart = FALSE;
 
-      if(c == '\n')
+      // and copy it line by line
+      while(in < run)
       {
-        // check if the previous char is a linear whitespace and
-        // if so we have to put a soft break right before the
-        // newline
-        if(last != -1 && (last == ' ' || last == '\t'))
-        {
-          *optr++ = '=';
-          *optr++ = '\n';
-        }
+        size_t n;
 
-        *optr++ = '\n';
+        out = SoftBreak(enc, out, 1);
 
-        // reset the line_len counter
-        line_len = 0;
-        last = -1;
-      }
-        // we encode the current char if:
-        // 1) it is an unsafe safe
-        // 2) it is an upcoming "From " at the start of a line
-      else if(!is_qpsafe(c) ||
-              (last == -1 && c == 'F' && strncmp((char *)iptr, "rom ", 4) == 0))
-      {
+        n = QP_MAXCHARS - enc->lineLength;
+        if(n > (size_t)(run - in))
+          n = run - in;
 
-        // before we can encode the data we have to check
-        // whether there is enough space left on the line
-        // or if we have to put it on the next line
-        if(line_len+3 >= QP_LINELEN-1) // one space for the trailing '='
-        {
-          *optr++ = '=';
-          *optr++ = '\n';
+        memcpy(out, in, n);
+        out += n;
+        in += n;
+        enc->lineLength += n;
+      }
+    }
+    else
+    {
+      out = EncodeChar(enc, c, out);
+      in++;
+    }
+  }
 
-          // reset the line_len counter
-          line_len = 0;
-        }
+  return out;
+}
 
-        // now put out the encoded char
-        *optr++ = '=';
-        *optr++ = basis_hex[(c >> 4) & 0xF];
-        *optr++ = basis_hex[c & 0xF];
+///
+/// ResolveFrom()
+// decide about a "From " at the start of a line which was split across blocks
+// and return the number of input bytes consumed for it, or -1 if the decision
+// must wait for even more data.
+static long ResolveFrom(struct QPEncoder *enc, const unsigned char *in, size_t inlen, char **out, BOOL final)
+{
+  static const char from[] = "From ";
+  long consumed;
+  size_t n = 0;
 
-        // increase the line_len counter
-        line_len += 3;
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
-        // count the number of encoded chars
-        encoded_chars++;
-      }
-      else
-      {
-        // so this char seems to be safe to be directly placed
-        // in the output buffer without any encoding. We just
-        // have to check whether this line is going to be longer
-        // than the limit
-        if(line_len+1 >= QP_LINELEN-1) // one space for the trailing '='
-        {
-          *optr++ = '=';
-          *optr++ = '\n';
+  while(enc->fromLength + n < 5 && n < inlen && in[n] == from[enc->fromLength + n])
+    n++;
 
-          // reset the line_len counter
-          line_len = 0;
-        }
+  if(enc->fromLength + n == 5)
+  {
+    // a complete "From ", the 'F' is encoded and the rest follows as usual
+    enc->fromLength = 0;
+    *out = EncodeChar(enc, 'F', *out);
+    *out = EncodeBytes(enc, (const unsigned char *)&from[1], 4, *out);
+    consumed = n;
+  }
+  else if(n == inlen && final == FALSE)
+  {
+    // still undecided
+    enc->fromLength += n;
+    consumed = -1;
+  }
+  else
+  {
+    // something else, the kept back characters are safe and not at the start of a line anymore
+    int len = enc->fromLength;
 
-        *optr++ = c;
+    enc->fromLength = 0;
+    enc->lineStart = FALSE;
+    *out = EncodeBytes(enc, (const unsigned char *)from, len, *out);
+    consumed = 0;
+  }
 
-        // increase the line_len counter
-        line_len++;
-      }
+  return consumed;
+}
 
-      // let us now check if our outbuffer is filled up so that we can write
-      // out the data to our out stream.
-      if(optr-outbuffer >= QPENC_BUF)
-      {
-        size_t todo = optr-outbuffer;
+///
+/// DecodeSequence()
+// decode an "=XX" sequence, a soft line break or a CR at the start of the
+// data. Returns the number of consumed bytes or 0 if more data is required.
+static size_t DecodeSequence(struct QPDecoder *dec, const unsigned char *in, size_t avail, unsigned char **out)
+{
+  size_t consumed = 0;
+  unsigned char *outp = *out;
 
-        // now we do a binary write of the data
-        if(fwrite(outbuffer, 1, todo, out) != todo)
-        {
-          E(DBF_MIME, "error on writing data!");
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
 
-          // an error must have occurred.
-          RETURN(-1);
-          return -1;
-        }
+  if(in[0] == '=')
+  {
+    if(avail >= 2 && in[1] == '\n')
+    {
+      // a soft line break
+      consumed = 2;
+    }
+    else if(avail >= 3)
+    {
+      unsigned char c1 = hexchar(in[1]);
+      unsigned char c2 = hexchar(in[2]);
 
-        // now reset the outbuffer and stuff
-        optr = outbuffer;
+      // check if the two chars are really hexadecimal chars
+      if(c1 != 255 && c2 != 255)
+      {
+        *outp++ = c1<<4 | c2;
+        dec->decoded++;
+      }
+      else
+      {
+        // as suggested by RFC 2045 we keep the =XX sequence
+        // and report a warning later to the user
+        *outp++ = in[0];
+        *outp++ = in[1];
+        *outp++ = in[2];
+        dec->result = -3; // indicate a "decoding warning"
       }
 
-      last = c;
+      consumed = 3;
     }
   }
-
-  // check if there is something in the outbuffer that
-  // hasn't been written out yet
-  if(optr-outbuffer > 0)
+  else if(in[0] == '\r')
   {
-    size_t todo = optr-outbuffer;
-
-    // now we do a binary write of the data
-    if(fwrite(outbuffer, 1, todo, out) != todo)
+    if(avail >= 2)
     {
-      E(DBF_MIME, "error on writing data!");
+      // only a CR in front of a LF is allowed
+      if(in[1] == '\n')
+        *outp++ = '\r';
+      else
+      {
+        W(DBF_MIME, "nonallowed character '%lc' (%02lx) found", in[0], in[0]);
+        dec->result = -4; // indicate a "unallowed control chars" warning
+      }
 
-      // an error must have occurred.
-      RETURN(-1);
-      return -1;
+      consumed = 1;
     }
   }
+  else
+  {
+    // we found some not allowed char, so lets ignore it
+    // but warn the user
+    W(DBF_MIME, "nonallowed character '%lc' (%02lx) found", in[0], in[0]);
+    dec->result = -4; // indicate a "unallowed control chars" warning
+    consumed = 1;
+  }
+
+  *out = outp;
 
-  RETURN(encoded_chars);
-  return encoded_chars;
+  return consumed;
 }
 
 ///
-/// qpdecode_file()
-// Decodes a whole file using the quoted-printable format defined in
-// RFC 2045 (page 19)
-long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
-{
-  unsigned char inbuffer[QPDEC_BUF+1]; // lets use a 4096 byte large input buffer
-  unsigned char outbuffer[QPDEC_BUF+1];// to speed things up we use the same amount
-                                       // of memory for an output buffer as the
-                                       // decoded string can't be larger than
-                                       // the encoded one.
-
-  unsigned char *iptr;
-  unsigned char *optr = outbuffer;
-  unsigned char c;
-  size_t read = 0;
-  size_t next_unget = 0;
-  long decoded = 0;
-  int result = 0;
-  BOOL eof_reached = FALSE;
 
+/*** Quoted-Printable streaming encode/decode routines (RFC 2045) ***/
+/// qpencode_init()
+// prepare a streaming quoted-printable encoder
+void qpencode_init(struct QPEncoder *enc)
+{
   ENTER();
 
-  D(DBF_MIME, "codeset '%s'", srcCodeset != NULL ? srcCodeset->name : "none");
+  memset(enc, 0, sizeof(*enc));
+  enc->last = -1;
+  enc->lineStart = TRUE;
 
-  while(eof_reached == FALSE)
-  {
-    // do a binary read of ~4096 chunks
-    read = fread(&inbuffer[next_unget], sizeof(char), QPDEC_BUF-next_unget, in);
+  LEAVE();
+}
 
-    // on a short item count we check for a potential
-    // error and return immediatly.
-    if(read != QPDEC_BUF-next_unget)
-    {
-      if(feof(in) != 0)
-      {
-        D(DBF_MIME, "EOF file at %ld", ftell(in));
+///
+/// qpencode_buffer()
+// encode a block of data and return the number of characters written to
+// 'out', which must provide space for QPENC_MAXLEN(inlen) characters
+size_t qpencode_buffer(struct QPEncoder *enc, const char *in, size_t inlen, char *out)
+{
+  const unsigned char *inp = (const unsigned char *)in;
+  char *outp = out;
 
-        eof_reached = TRUE; // we found an EOF
+  ENTER();
 
-        // if the last read was zero we can exit immediatly
-        if(read == 0 && next_unget == 0)
-          break;
-      }
-      else
-      {
-        E(DBF_MIME, "error on reading data!");
+  if(enc->fromLength > 0)
+  {
+    long consumed;
 
-        // an error occurred, lets return -1
-        RETURN(-1);
-        return -1;
-      }
+    if((consumed = ResolveFrom(enc, inp, inlen, &outp, FALSE)) >= 0)
+    {
+      inp += consumed;
+      inlen -= consumed;
     }
+    else
+      inlen = 0;
+  }
 
-    // increase/reset the counters
-    read += next_unget;
-    next_unget = 0;
-
-    // now that we have read in our buffer we have to parse through
-    // it and decode eventually existing quoted printable encoded
-    // chunks. The routines also analyze the data and returns an
-    // error if non quoted-printable safe data is found, however
-    // it still tries to decode the data until the end. This fail-safe
-    // behaviour is suggested in RFC 2045 on page 22.
-    iptr = inbuffer;
+  outp = EncodeBytes(enc, inp, inlen, outp);
 
-    while(read != 0)
-    {
-      c = *iptr++;
-      read--;
+  RETURN((size_t)(outp - out));
+  return outp - out;
+}
 
-      if(c == '=')
-      {
-        // check if the next char is a newline so that
-        // we can skip the current =
-        if(read != 0 && *iptr == '\n')
-        {
-          // skip the newline..
-          iptr++;
-          read--;
+///
+/// qpencode_finish()
+// encode the characters which have been kept back
+size_t qpencode_finish(struct QPEncoder *enc, char *out)
+{
+  char *outp = out;
 
-          continue;
-        }
+  ENTER();
 
-        // a '=' is the sign that a encoded string is following, so
-        // let us check if we have enough space in our input buffer
-        // and then decode it accordingly
-        if(read >= 2)
-        {
-          unsigned char c1 = hexchar(*iptr);
-          unsigned char c2 = hexchar(*(iptr+1));
-
-          // so we have enough space, lets decode it, but let us
-          // check if the two chars are really hexadecimal chars
-          if(c1 != 255 && c2 != 255)
-          {
-            *optr++ = c1<<4 | c2;
-
-            // increase the counters
-            iptr += 2;
-            read -= 2;
-
-            // count the decoded chars
-            decoded++;
-          }
-          else
-          {
-            // as suggested by RFC 2045 we keep the =XX sequence
-            // and report a warning later to the user
-            *optr++ = c;
-            *optr++ = *iptr++;
-            *optr++ = *iptr++;
-            read -= 2;
-            result = -3; // indicate a "decoding warning"
-          }
-        }
-        else
-        {
-          // ok, there isn't enough space in the input buffer
-          // so we break out here and parse the stuff on
-          // the next iteration
-          next_unget = read+1;
-          memcpy(inbuffer, iptr-1, next_unget);
+  if(enc->fromLength > 0)
+    ResolveFrom(enc, NULL, 0, &outp, TRUE);
 
-          break;
-        }
-      }
-      else if(!isascii(c) ||
-              (is_ctrl(c) && c != '\t' && c != '\n' &&
-               c == '\r' && *iptr != '\n'))
-      {
-        // we found some not allowed char, so lets ignore it
-        // but warn the user
-        W(DBF_MIME, "nonallowed character '%lc' (%02lx) found", c, c);
-        result = -4; // indicate a "unallowed control chars" warning
-      }
-      else
-      {
-        // the current char seems to be a normal
-        // char, so lets output it
-        *optr++ = c;
-      }
+  RETURN((size_t)(outp - out));
+  return outp - out;
+}
 
-      // let us now check if our outbuffer is filled up so that we can write
-      // out the data to our out stream.
-      if(optr-outbuffer >= QPDEC_BUF)
-      {
-        unsigned char *dptr = outbuffer;
-        size_t todo = optr-outbuffer;
+///
+/// qpdecode_init()
+// prepare a streaming quoted-printable decoder
+void qpdecode_init(struct QPDecoder *dec)
+{
+  ENTER();
 
-        // in case the user wants us to detect the correct cyrillic codeset
-        // we do it now
-        if(C->DetectCyrillic == TRUE && isText == TRUE)
-        {
-          if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-          {
-            struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                                  CSA_SourceLen,      todo,
-                                                  CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                                  TAG_DONE);
-
-            if(cs != NULL && cs != srcCodeset)
-            {
-              D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-              srcCodeset = cs;
-            }
-          }
-        }
+  memset(dec, 0, sizeof(*dec));
 
-        // if the caller supplied a source codeset, we have to
-        // make sure we convert our outbuffer before writing it out
-        // to the file in UTF8, but we must not touch binary/non-text data
-        if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-        {
-          ULONG strLen = 0;
-
-          UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                         CSA_SourceLen,       todo,
-                                         CSA_SourceCodeset,   srcCodeset,
-                                         CSA_DestLenPtr,      &strLen,
-                                         TAG_DONE);
-
-          if(str != NULL && strLen > 0)
-          {
-            // if we end up here we successfully converted the
-            // sourcebuffer to a destination buffer which complies to our local
-            // charset
-            dptr = (unsigned char *)str;
-            todo = strLen;
-          }
-          else
-            W(DBF_MIME, "error while trying to convert qpdecoded string to UTF8");
-        }
+  LEAVE();
+}
 
-        // now we do a binary write of the data
-        if(fwrite(dptr, 1, todo, out) != todo)
-        {
-          E(DBF_MIME, "error on writing data!");
+///
+/// qpdecode_buffer()
+// decode a block of quoted-printable data and return the number of bytes
+// written to 'out', which must provide space for QPDEC_MAXLEN(inlen) bytes.
+// Invalid data is handled in the fail-safe way suggested by RFC 2045 on
+// page 22 and reported in the decoder's result.
+size_t qpdecode_buffer(struct QPDecoder *dec, const char *in, size_t inlen, char *out)
+{
+  const unsigned char *inp = (const unsigned char *)in;
+  const unsigned char *end = inp + inlen;
+  unsigned char *outp = (unsigned char *)out;
 
-          // in case the dptr buffer was allocated by codesets.library,
-          // we have to free it now
-          if(dptr != outbuffer)
-            CodesetsFreeA(dptr, NULL);
+  ENTER();
 
-          // an error must have occurred.
-          RETURN(-1);
-          return -1;
-        }
+  // complete a sequence which was split across blocks
+  if(dec->pendingLength > 0)
+  {
+    unsigned char tmp[6];
+    size_t avail;
+    size_t consumed;
 
-        // in case the dptr buffer was allocated by codesets.library,
-        // we have to free it now
-        if(dptr != outbuffer)
-          CodesetsFreeA(dptr, NULL);
+    memcpy(tmp, dec->pending, dec->pendingLength);
+    avail = (inlen < 3) ? inlen : 3;
+    memcpy(&tmp[dec->pendingLength], inp, avail);
+    avail += dec->pendingLength;
 
-        // now reset the outbuffer and stuff
-        optr = outbuffer;
-      }
+    if((consumed = DecodeSequence(dec, tmp, avail, &outp)) != 0)
+    {
+      inp += consumed - dec->pendingLength;
+      dec->pendingLength = 0;
+    }
+    else
+    {
+      // still incomplete
+      memcpy(dec->pending, tmp, avail);
+      dec->pendingLength = avail;
+      inp = end;
     }
   }
 
-  // check if there is something in the outbuffer that
-  // hasn't been written out yet
-  if(optr-outbuffer > 0)
+  while(inp < end)
   {
-    unsigned char *dptr = outbuffer;
-    size_t todo = optr-outbuffer;
+    const unsigned char *run = inp;
+    size_t consumed;
 
-    // in case the user wants us to detect the correct cyrillic codeset
-    // we do it now
-    if(C->DetectCyrillic == TRUE && isText == TRUE)
+    // copy a run of plain characters at once
+    while(run < end && is_qpplain(*run))
+      run++;
+
+    if(run > inp)
     {
-      if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-      {
-        struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                              CSA_SourceLen,      todo,
-                                              CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                              TAG_DONE);
+      memcpy(outp, inp, run - inp);
+      outp += run - inp;
+      inp = run;
 
-        if(cs != NULL && cs != srcCodeset)
-        {
-          D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-          srcCodeset = cs;
-        }
-      }
+      if(inp == end)
+        break;
     }
 
-    // if the caller supplied a source codeset, we have to
-    // make sure we convert our outbuffer before writing it out
-    // to the file in UTF8, but we must not touch binary/non-text data
-    if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
+    if((consumed = DecodeSequence(dec, inp, end - inp, &outp)) != 0)
+      inp += consumed;
+    else
     {
-      ULONG strLen = 0;
+      // keep the incomplete sequence for the next block
+      dec->pendingLength = end - inp;
+      memcpy(dec->pending, inp, dec->pendingLength);
+      inp = end;
+    }
+  }
 
-      UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                     CSA_SourceLen,       todo,
-                                     CSA_SourceCodeset,   srcCodeset,
-                                     CSA_DestLenPtr,      &strLen,
-                                     TAG_DONE);
+  RETURN((size_t)((char *)outp - out));
+  return (char *)outp - out;
+}
 
-      if(str != NULL && strLen > 0)
-      {
-        // if we end up here we successfully converted the
-        // sourcebuffer to a destination buffer which complies to our local
-        // charset
-        dptr = (unsigned char *)str;
-        todo = strLen;
-      }
-      else
-        W(DBF_MIME, "error while trying to convert qpdecoded string to UTF8");
+///
+/// qpdecode_finish()
+// handle an incomplete sequence at the end of the data
+size_t qpdecode_finish(struct QPDecoder *dec, char *out)
+{
+  ENTER();
+
+  if(dec->pendingLength > 0)
+  {
+    if(dec->pending[0] == '=')
+    {
+      // the decoding wasn't finished
+      dec->unfinished = TRUE;
+    }
+    else
+    {
+      // a lonely CR at the end
+      W(DBF_MIME, "nonallowed character '%lc' (%02lx) found", dec->pending[0], dec->pending[0]);
+      dec->result = -4;
     }
 
-    // now we do a binary write of the data
-    if(fwrite(dptr, 1, todo, out) != todo)
+    dec->pendingLength = 0;
+  }
+
+  RETURN(0);
+  return 0;
+}
+
+///
+
+/*** Quoted-Printable encode/decode routines (RFC 2045) ***/
+/// qpencode_file()
+// Encodes a whole file using the quoted-printable format defined in
+// RFC 2045 (page 19)
+long qpencode_file(FILE *in, FILE *out)
+{
+  long result = -1;
+  char *inbuffer;
+  char *outbuffer;
+
+  ENTER();
+
+  // the buffers are too large for the stack
+  inbuffer = malloc(QPENC_BUF);
+  outbuffer = malloc(QPENC_MAXLEN(QPENC_BUF));
+
+  if(inbuffer != NULL && outbuffer != NULL)
+  {
+    struct QPEncoder enc;
+    BOOL error = FALSE;
+    size_t read;
+
+    qpencode_init(&enc);
+
+    do
     {
-      E(DBF_MIME, "error on writing data!");
+      size_t encoded;
+
+      read = fread(inbuffer, 1, QPENC_BUF, in);
+
+      // on a short item count we check for a potential error
+      if(read != QPENC_BUF && ferror(in) != 0)
+      {
+        E(DBF_MIME, "error on reading data!");
+        error = TRUE;
+        break;
+      }
+
+      encoded = qpencode_buffer(&enc, inbuffer, read, outbuffer);
 
-      // in case the dptr buffer was allocated by codesets.library,
-      // we have to free it now
-      if(dptr != outbuffer)
-        CodesetsFreeA(dptr, NULL);
+      if(read != QPENC_BUF)
+        encoded += qpencode_finish(&enc, &outbuffer[encoded]);
 
-      // an error must have occurred.
-      RETURN(-1);
-      return -1;
+      // now we do a binary write of the data
+      if(encoded > 0 && fwrite(outbuffer, 1, encoded, out) != encoded)
+      {
+        E(DBF_MIME, "error on writing data!");
+        error = TRUE;
+        break;
+      }
     }
+    while(read == QPENC_BUF);
 
-    // in case the dptr buffer was allocated by codesets.library,
-    // we have to free it now
-    if(dptr != outbuffer)
-      CodesetsFreeA(dptr, NULL);
+    if(error == FALSE)
+      result = enc.encoded;
   }
 
-  // if we end up here and read > 0 then the decoding wasn't finished
-  // and we have to return an error
-  if(read > 0)
-  {
-    RETURN(-2);
-    return -2; // -2 means "unfinished decoding"
-  }
+  free(inbuffer);
+  free(outbuffer);
 
-  // on success lets return the number of decoded
-  // chars
-  RETURN(result == 0 ? decoded : result);
-  return result == 0 ? decoded : result;
+  RETURN(result);
+  return result;
 }
 
 ///
@@ -30,12 +30,41 @@
 
 #include <exec/types.h>
 
-// forward declarations
-struct codeset;
+// the state of a streaming quoted-printable encoder
+struct QPEncoder
+{
+  int lineLength;        // number of characters in the current output line
+  int last;              // the last encoded input character or -1
+  int fromLength;        // length of a "From " at the start of a line split across blocks
+  BOOL lineStart;        // the next character starts a new line
+  long encoded;          // number of characters encoded as =XX
+};
+
+// the state of a streaming quoted-printable decoder
+struct QPDecoder
+{
+  unsigned char pending[3]; // an incomplete "=XX" sequence or CR at the end of the last block
+  int pendingLength;
+  int result;               // 0 or the last warning (-3 invalid sequence, -4 invalid character)
+  long decoded;             // number of decoded =XX sequences
+  BOOL unfinished;          // the data ended within an "=XX" sequence
+};
+
+// the maximum number of bytes qpencode_buffer()/qpencode_finish() and
+// qpdecode_buffer()/qpdecode_finish() produce for inlen input bytes
+#define QPENC_MAXLEN(inlen) ((inlen)*4+16)
+#define QPDEC_MAXLEN(inlen) ((inlen)+3)
+
+// streaming quoted-printable encoding/decoding of memory buffers
+void qpencode_init(struct QPEncoder *enc);
+size_t qpencode_buffer(struct QPEncoder *enc, const char *in, size_t inlen, char *out);
+size_t qpencode_finish(struct QPEncoder *enc, char *out);
+void qpdecode_init(struct QPDecoder *dec);
+size_t qpdecode_buffer(struct QPDecoder *dec, const char *in, size_t inlen, char *out);
+size_t qpdecode_finish(struct QPDecoder *dec, char *out);
 
-// quoted-printable encoding/decoding routines
+// quoted-printable encoding routines
 long qpencode_file(FILE *in, FILE *out);
-long qpdecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText);
 
 // macros & static variables
 static const char basis_hex[] = "0123456789ABCDEF";
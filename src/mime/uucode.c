@@ -30,14 +30,12 @@
 #include <string.h>
 
 #include <proto/exec.h>
-#include <proto/codesets.h>
 
 #include "YAM.h"
 
+#include "mime/decodechain.h"
 #include "mime/qprintable.h"
 
-#include "Config.h"
-
 #include "Debug.h"
 
 // some defines that can be usefull
@@ -221,8 +219,9 @@ long uuencode_file(FILE *in, FILE *out)
 // Decode a UUencoded file using separate input/output buffers to speed up
 // processing. It also takes respect of eventually existing checksums and
 // tries to validate the UUencoded file to conform to the BSD standard or
-// otherwise return an error/warning by returning negative values.
-long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
+// otherwise return an error/warning by returning negative values. The decoded
+// data is passed on to the further stages of the given decoding chain.
+long uudecode_file(FILE *in, struct DecodeChain *dc)
 {
   unsigned char inbuffer[UUDEC_IBUF+1]; // we read out data in ~4500 byte chunks
   unsigned char outbuffer[UUDEC_OBUF+1];// the output buffer
@@ -238,8 +237,6 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
 
   ENTER();
 
-  D(DBF_MIME, "codeset '%s'", srcCodeset != NULL ? srcCodeset->name : "none");
-
   // before we start with our decoding we have to search for
   // the starting "begin XXX" line
   do
@@ -428,73 +425,14 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
         // out the data to our out stream.
         if(optr-outbuffer >= UUDEC_OBUF)
         {
-          unsigned char *dptr = outbuffer;
-          size_t todo = optr-outbuffer;
-
-          // in case the user wants us to detect the correct cyrillic codeset
-          // we do it now
-          if(C->DetectCyrillic == TRUE && isText == TRUE)
+          // pass the decoded data on to the further stages
+          if(decodechain_write(dc, (char *)outbuffer, optr-outbuffer) == FALSE)
           {
-            if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-            {
-              struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                                    CSA_SourceLen,      todo,
-                                                    CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                                    TAG_DONE);
-
-              if(cs != NULL && cs != srcCodeset)
-              {
-                D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-                srcCodeset = cs;
-              }
-            }
-          }
-
-          // if the caller supplied a source codeset, we have to
-          // make sure we convert our outbuffer before writing it out
-          // to the file in UTF8
-          if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-          {
-            ULONG strLen = 0;
-
-            UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                           CSA_SourceLen,       todo,
-                                           CSA_SourceCodeset,   srcCodeset,
-                                           CSA_DestLenPtr,      &strLen,
-                                           TAG_DONE);
-
-            if(str != NULL && strLen > 0)
-            {
-              // if we end up here we successfully converted the
-              // sourcebuffer to a destination buffer which complies to our local
-              // charset
-              dptr = (unsigned char *)str;
-              todo = strLen;
-            }
-            else
-              W(DBF_MIME, "error while trying to convert uudecoded string to UTF8");
-          }
-
-          // now we do a binary write of the data
-          if(fwrite(dptr, 1, todo, out) != todo)
-          {
-            E(DBF_MIME, "error on writing data!");
-
-            // in case the dptr buffer was allocated by codesets.library,
-            // we have to free it now
-            if(dptr != outbuffer)
-              CodesetsFreeA(dptr, NULL);
-
             // an error must have occurred.
             RETURN(-1);
             return -1;
           }
 
-          // in case the dptr buffer was allocated by codesets.library,
-          // we have to free it now
-          if(dptr != outbuffer)
-            CodesetsFreeA(dptr, NULL);
-
           // now reset the outbuffer and stuff
           optr = outbuffer;
         }
@@ -559,76 +497,14 @@ long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText)
     }
   }
 
-  // check if there is something in the outbuffer that
-  // hasn't been written out yet
-  if(optr-outbuffer > 0)
+  // pass the rest of the outbuffer on to the further
+  // stages and let them finish their work
+  if(decodechain_write(dc, (char *)outbuffer, optr-outbuffer) == FALSE ||
+     decodechain_finish(dc) == FALSE)
   {
-    unsigned char *dptr = outbuffer;
-    size_t todo = optr-outbuffer;
-
-    // in case the user wants us to detect the correct cyrillic codeset
-    // we do it now
-    if(C->DetectCyrillic == TRUE && isText == TRUE)
-    {
-      if(srcCodeset == NULL || (srcCodeset->name != NULL && stricmp(srcCodeset->name, "utf-8") != 0))
-      {
-        struct codeset *cs = CodesetsFindBest(CSA_Source,         dptr,
-                                              CSA_SourceLen,      todo,
-                                              CSA_CodesetFamily,  CSV_CodesetFamily_Cyrillic,
-                                              TAG_DONE);
-
-        if(cs != NULL && cs != srcCodeset)
-        {
-          D(DBF_MIME, "using codeset '%s' instead of '%s'", srcCodeset != NULL ? srcCodeset->name : "none", cs->name);
-          srcCodeset = cs;
-        }
-      }
-    }
-
-    // if the caller supplied a source codeset, we have to
-    // make sure we convert our outbuffer before writing it out
-    // to the file in UTF8, but we must not touch binary/non-text data
-    if(isText == TRUE && srcCodeset != NULL && stricmp(srcCodeset->name, "utf-8") != 0)
-    {
-      ULONG strLen = 0;
-
-      UTF8 *str = CodesetsUTF8Create(CSA_Source,          dptr,
-                                     CSA_SourceLen,       todo,
-                                     CSA_SourceCodeset,   srcCodeset,
-                                     CSA_DestLenPtr,      &strLen,
-                                     TAG_DONE);
-
-      if(str != NULL && strLen > 0)
-      {
-        // if we end up here we successfully converted the
-        // sourcebuffer to a destination buffer which complies to our local
-        // charset
-        dptr = (unsigned char *)str;
-        todo = strLen;
-      }
-      else
-        W(DBF_MIME, "error while trying to convert uudecoded string to local charset!");
-    }
-
-    // now we do a binary write of the data
-    if(fwrite(dptr, 1, todo, out) != todo)
-    {
-      E(DBF_MIME, "error on writing data!");
-
-      // in case the dptr buffer was allocated by codesets.library,
-      // we have to free it now
-      if(dptr != outbuffer)
-        CodesetsFreeA(dptr, NULL);
-
-      // an error must have occurred.
-      RETURN(-1);
-      return -1;
-    }
-
-    // in case the dptr buffer was allocated by codesets.library,
-    // we have to free it now
-    if(dptr != outbuffer)
-      CodesetsFreeA(dptr, NULL);
+    // an error must have occurred.
+    RETURN(-1);
+    return -1;
   }
 
   // on success lets return the number of decoded
@@ -31,10 +31,10 @@
 #include <exec/types.h>
 
 // forward declarations
-struct codeset;
+struct DecodeChain;
 
 // uucode encoding/decoding routines
 long uuencode_file(FILE *in, FILE *out);
-long uudecode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText);
+long uudecode_file(FILE *in, struct DecodeChain *dc);
 
 #endif // UUCODE_H
@@ -1025,8 +1025,8 @@ DECLARE(MLAutoDetect)
     {
       #define SCANMSGS  5
       struct MailNode *mnode;
-      char *toPattern;
-      char *toAddress;
+      const char *toPattern;
+      const char *toAddress;
       char *res = NULL;
       BOOL takePattern = TRUE;
       BOOL takeAddress = TRUE;
@@ -825,6 +825,9 @@ DECLARE(NewFolder)
         data->newFolder.imageObject = NULL;
         // erase the message list which might have been copied from the current folder
         data->newFolder.messages = NULL;
+        data->newFolder.msgIDHash = NULL;
+        data->newFolder.threadTree = NULL;
+        data->newFolder.ftIndex = NULL;
         // no image for the folder by default
         data->newFolder.ImageIndex = -1;
       }
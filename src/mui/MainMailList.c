@@ -126,10 +126,10 @@ static int MailCompare(struct Mail *entry1, struct Mail *entry2, LONG column)
 
     case 1:
     {
-      struct Person *pe1;
-      struct Person *pe2;
-      char *addr1;
-      char *addr2;
+      const struct MailPerson *pe1;
+      const struct MailPerson *pe2;
+      const char *addr1;
+      const char *addr2;
 
       if(isSentMailFolder(entry1->Folder))
       {
@@ -150,12 +150,12 @@ static int MailCompare(struct Mail *entry1, struct Mail *entry2, LONG column)
         struct ABookNode *abn1;
         struct ABookNode *abn2;
 
-        if((abn1 = FindPersonInABook(&G->abook, pe1)) != NULL)
+        if((abn1 = FindPersonInABook(&G->abook, pe1->Address)) != NULL)
           addr1 = abn1->RealName[0] != '\0' ? abn1->RealName : AddrName(*pe1);
         else
           addr1 = AddrName(*pe1);
 
-        if((abn2 = FindPersonInABook(&G->abook, pe2)) != NULL)
+        if((abn2 = FindPersonInABook(&G->abook, pe2->Address)) != NULL)
           addr2 = abn2->RealName[0] != '\0' ? abn2->RealName : AddrName(*pe2);
         else
           addr2 = AddrName(*pe2);
@@ -456,8 +456,8 @@ OVERLOAD(MUIM_NList_Display)
       if(hasMColSender(C->MessageCols) || data->inSearchWindow == TRUE)
       {
         BOOL toPrefix = FALSE;
-        struct Person *pe;
-        char *addr = NULL;
+        const struct MailPerson *pe;
+        const char *addr = NULL;
 
         if(((isCustomMixedFolder(mail->Folder) || isTrashFolder(mail->Folder) || isSpamFolder(mail->Folder)) &&
             (hasStatusSent(mail) || hasStatusError(mail))) || (data->inSearchWindow == TRUE && isSentMailFolder(mail->Folder)))
@@ -477,7 +477,7 @@ OVERLOAD(MUIM_NList_Display)
         {
           struct ABookNode *abn;
 
-          if((abn = FindPersonInABook(&G->abook, pe)) != NULL)
+          if((abn = FindPersonInABook(&G->abook, pe->Address)) != NULL)
           {
             if(abn->RealName[0] != '\0')
               addr = abn->RealName;
@@ -512,12 +512,12 @@ OVERLOAD(MUIM_NList_Display)
           ndm->strings[2] = data->replytoBuffer;
         }
         else
-          ndm->strings[2] = AddrName(mail->ReplyTo);
+          ndm->strings[2] = (char *)AddrName(mail->ReplyTo);
       }
 
       // then the Subject
       if(IsStrEmpty(mail->Subject) == FALSE)
-        ndm->strings[3] = mail->Subject;
+        ndm->strings[3] = (char *)mail->Subject;
       else
         ndm->strings[3] = (char *)tr(MSG_MA_NO_SUBJECT);
 
@@ -543,7 +543,7 @@ OVERLOAD(MUIM_NList_Display)
         ndm->strings[7] = data->date2Buffer;
       }
 
-      ndm->strings[8] = mail->MailAccount;
+      ndm->strings[8] = (char *)mail->MailAccount;
 
       // The Folder is just a dummy entry to serve the SearchMailWindow DisplayHook
       ndm->strings[9] = mail->Folder->Name;
@@ -699,7 +699,7 @@ OVERLOAD(MUIM_NList_ContextMenuBuild)
         BOOL isArchive = isArchiveFolder(fo);
         BOOL hasattach = FALSE;
         ULONG numSelected = 0;
-        struct Person *pers = isSentMail ? &mail->To : &mail->From;
+        const struct MailPerson *pers = isSentMail ? &mail->To : &mail->From;
         char address[SIZE_LARGE];
         Object *afterThis;
 
@@ -48,6 +48,7 @@
 #include "BoyerMooreSearch.h"
 #include "Busy.h"
 #include "DynamicString.h"
+#include "FullTextIndex.h"
 #include "Locale.h"
 #include "MailList.h"
 #include "MUIObjects.h"
@@ -109,7 +110,7 @@ enum SearchFlags
 // function to actually check if a struct Mail* matches
 // the currently active criteria
 static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
-                      ULONG searchFlags, const struct BoyerMooreContext *bmContext, struct TimeVal *curTimeUTC)
+                      ULONG searchFlags, const struct BoyerMooreContext *bmContext, struct FullTextQuery *ftQuery, struct TimeVal *curTimeUTC)
 {
   BOOL foundMatch = FALSE;
 
@@ -159,7 +160,7 @@ static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
     // check if the mail comes from a person we know
     case VO_KNOWNPEOPLE:
     {
-      foundMatch = (FindPersonInABook(&G->abook, &mail->From) != NULL);
+      foundMatch = (FindPersonInABook(&G->abook, mail->From.Address) != NULL);
       if(foundMatch == FALSE && isMultiSenderMail(mail))
       {
         struct ExtendedMail *email;
@@ -170,7 +171,7 @@ static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
 
           for(j=0; j < email->NumSFrom && foundMatch == FALSE; j++)
           {
-            foundMatch = (FindPersonInABook(&G->abook, &email->SFrom[j]) != NULL);
+            foundMatch = (FindPersonInABook(&G->abook, email->SFrom[j].Address) != NULL);
           }
 
           MA_FreeEMailStruct(email);
@@ -271,15 +272,24 @@ static BOOL MatchMail(const struct Mail *mail, enum ViewOptions vo,
     if(foundMatch == FALSE && isFlagSet(searchFlags, SF_BODY))
     {
       struct ReadMailData *rmData;
+      enum FullTextResult ftResult;
+
+      // ask the folder's full text index first and skip the mail if its
+      // text cannot contain the search string
+      ftResult = CheckFullTextQuery(ftQuery, mail);
 
       // allocate a private readmaildata object in which we readin
       // the mail text
-      if((rmData = AllocPrivateRMData(mail, PM_TEXTS)) != NULL)
+      if(ftResult != FTR_NOMATCH && (rmData = AllocPrivateRMData(mail, PM_TEXTS)) != NULL)
       {
         char *cmsg;
 
         if((cmsg = RE_ReadInMessage(rmData, RIM_QUIET)) != NULL)
         {
+          // index the text of unencrypted mails for the next search
+          if(ftResult == FTR_UNKNOWN && isMP_CryptedMail(mail) == FALSE)
+            AddMailToFullTextIndex(mail, cmsg);
+
           // perform the search in the complete body
           foundMatch = (BoyerMooreSearch(bmContext, cmsg) != NULL);
 
@@ -656,6 +666,7 @@ DECLARE(ProcessSearch)
     char *searchString = (char *)xget(data->ST_SEARCHSTRING, MUIA_String_Contents);
     struct TimeVal curTimeUTC;
     struct BoyerMooreContext *bmContext;
+    struct FullTextQuery *ftQuery = NULL;
     struct BusyNode *busy;
 
     // get the current time in UTC
@@ -676,8 +687,13 @@ DECLARE(ProcessSearch)
     if(xget(data->BT_SUBJECT, MUIA_Selected) == TRUE)
       setFlag(searchFlags, SF_SUBJECT);
     if(xget(data->BT_BODY, MUIA_Selected) == TRUE)
+    {
       setFlag(searchFlags, SF_BODY);
 
+      // let the folder's full text index rule out as many mails as possible
+      ftQuery = CreateFullTextQuery(searchString);
+    }
+
     // make sure the correct mailview list is visible and quiet
     DoMethod(G->MA->GUI.PG_MAILLIST, MUIM_MainMailListGroup_SwitchToList, LT_QUICKVIEW);
     set(G->MA->GUI.PG_MAILLIST, MUIA_NList_Quiet, TRUE);
@@ -698,7 +714,7 @@ DECLARE(ProcessSearch)
       struct Mail *curMail = mnode->mail;
 
       // check if that mail matches the search/view criteria
-      if(MatchMail(curMail, viewOption, searchFlags, bmContext, &curTimeUTC) == TRUE)
+      if(MatchMail(curMail, viewOption, searchFlags, bmContext, ftQuery, &curTimeUTC) == TRUE)
         DoMethod(G->MA->GUI.PG_MAILLIST, MUIM_MainMailListGroup_AddMailToList, LT_QUICKVIEW, curMail);
 
       DoMethod(_app(obj), MUIM_Application_InputBuffered);
@@ -711,6 +727,8 @@ DECLARE(ProcessSearch)
     UnlockMailList(curFolder->messages);
 
     BoyerMooreCleanup(bmContext);
+    // this saves the updated index as well
+    DeleteFullTextQuery(ftQuery);
 
     // only update the GUI if this search was not aborted
     if(data->abortSearch == FALSE)
@@ -779,7 +797,7 @@ DECLARE(MatchMail) // struct Mail *mail
 
   // now we check that a match is really required and if so we process it
   match = (ULONG)((viewOption != VO_ALL || searchString != NULL) &&
-                  MatchMail(msg->mail, viewOption, searchFlags, bmContext, &curTimeUTC) == TRUE);
+                  MatchMail(msg->mail, viewOption, searchFlags, bmContext, NULL, &curTimeUTC) == TRUE);
 
   BoyerMooreCleanup(bmContext);
 
@@ -1107,7 +1107,7 @@ DECLARE(UpdateHeaderDisplay) // ULONG flags
 {
   GETDATA;
   struct ReadMailData *rmData = data->readMailData;
-  struct Person *from = &rmData->mail->From;
+  const struct MailPerson *from = &rmData->mail->From;
   struct ABookNode *ab = NULL;
   struct ABookNode abtmpl;
   BOOL foundIdentity;
@@ -1384,6 +1384,7 @@ DECLARE(CheckPGPSignature) // ULONG forceRequester
         // decode the letter part first, otherwise PGP might want to check
         // a still encoded file which definitely will fail.
         RE_DecodePart(letterPart);
+        RE_WritePartFile(pgpPart);
 
         snprintf(options, sizeof(options), (G->PGPVersion == 5) ? "%s -o %s +batchmode=1 +force +language=us" : "%s %s +bat +f +lang=en", pgpPart->Filename, letterPart->Filename);
         error = PGPCommand((G->PGPVersion == 5) ? "pgpv": "pgp", options, KEEPLOG);
@@ -54,6 +54,7 @@
 #include "UIDL.h"
 #include "UserIdentity.h"
 
+#include "tcp/imap.h"
 #include "tcp/ssl.h"
 
 #include "Debug.h"
@@ -70,6 +71,7 @@ struct Data
   Object *CH_POPENABLED;
   Object *ST_POPDESC;
   Object *ST_POPHOST;
+  Object *CY_POPPROTOCOL;
   Object *ST_POPPORT;
   Object *LB_POPPORT;
   Object *BT_POPTEST;
@@ -120,6 +122,27 @@ struct Data
 };
 */
 
+/* Private Functions */
+/// DefaultReceivePort
+// returns the standard port for the protocol and security type of
+// an incoming mail server given by the flags
+static int DefaultReceivePort(const unsigned int flags)
+{
+  int port;
+
+  ENTER();
+
+  if(isFlagSet(flags, MSF_PROTO_IMAP))
+    port = isFlagSet(flags, MSF_SEC_SSL) ? 993 : 143;
+  else
+    port = isFlagSet(flags, MSF_SEC_SSL) ? 995 : 110;
+
+  RETURN(port);
+  return port;
+}
+
+///
+
 /* Overloaded Methods */
 /// OVERLOAD(OM_NEW)
 OVERLOAD(OM_NEW)
@@ -128,6 +151,7 @@ OVERLOAD(OM_NEW)
   static const char *securePOP3Methods[4];
   static const char *smtpAuthMethods[7];
   static const char *pop3AuthMethods[3];
+  static const char *receiveProtocols[3];
   static const char *preselectionModes[5];
   static const char *rtitles[3];
   Object *GR_POP3_VIRTROOT;
@@ -139,6 +163,7 @@ OVERLOAD(OM_NEW)
   Object *CH_POPENABLED;
   Object *ST_POPDESC;
   Object *ST_POPHOST;
+  Object *CY_POPPROTOCOL;
   Object *ST_POPPORT;
   Object *LB_POPPORT;
   Object *BT_POPTEST;
@@ -211,6 +236,10 @@ OVERLOAD(OM_NEW)
   pop3AuthMethods[1] = tr(MSG_CO_POP_AUTH_APOP);
   pop3AuthMethods[2] = NULL;
 
+  receiveProtocols[0] = tr(MSG_CO_POP_PROTOCOL_POP3);
+  receiveProtocols[1] = tr(MSG_CO_POP_PROTOCOL_IMAP);
+  receiveProtocols[2] = NULL;
+
   preselectionModes[PSM_NEVER]       = tr(MSG_CO_PSNever);
   preselectionModes[PSM_LARGE]       = tr(MSG_CO_PSLarge);
   preselectionModes[PSM_ALWAYS]      = tr(MSG_CO_PSAlways);
@@ -285,6 +314,9 @@ OVERLOAD(OM_NEW)
                 Child, Label2(tr(MSG_CO_POP_SERVER)),
                 Child, ST_POPHOST = MakeString(SIZE_HOST, tr(MSG_CO_POP_SERVER)),
 
+                Child, Label2(tr(MSG_CO_POP_PROTOCOL)),
+                Child, CY_POPPROTOCOL = MakeCycle(receiveProtocols, tr(MSG_CO_POP_PROTOCOL)),
+
                 Child, Label2(tr(MSG_CO_POP_PORT)),
                 Child, HGroup,
                   Child, ST_POPPORT = BetterStringObject,
@@ -558,6 +590,7 @@ OVERLOAD(OM_NEW)
     data->CH_POPENABLED =             CH_POPENABLED;
     data->ST_POPDESC =                ST_POPDESC;
     data->ST_POPHOST =                ST_POPHOST;
+    data->CY_POPPROTOCOL =            CY_POPPROTOCOL;
     data->ST_POPPORT =                ST_POPPORT;
     data->LB_POPPORT =                LB_POPPORT;
     data->BT_POPTEST =                BT_POPTEST;
@@ -619,6 +652,7 @@ OVERLOAD(OM_NEW)
     SetHelp(BT_PDEL,                   MSG_HELP_CO_BT_PDEL);
     SetHelp(ST_POPDESC,                MSG_HELP_CO_ST_POPDESC);
     SetHelp(ST_POPHOST,                MSG_HELP_CO_ST_POPHOST);
+    SetHelp(CY_POPPROTOCOL,            MSG_HELP_CO_CY_POPPROTOCOL);
     SetHelp(ST_POPPORT,                MSG_HELP_CO_ST_POPPORT);
     SetHelp(BT_POPTEST,                MSG_HELP_CO_BT_POPTEST);
     SetHelp(ST_POPUSERID,              MSG_HELP_CO_ST_POPUSERID);
@@ -649,6 +683,7 @@ OVERLOAD(OM_NEW)
     DoMethod(LV_POP3,                   MUIM_Notify, MUIA_NList_Active,     MUIV_EveryTime, obj, 1, METHOD(POP3ToGUI));
     DoMethod(ST_POPDESC,                MUIM_Notify, MUIA_String_Contents,  MUIV_EveryTime, obj, 1, METHOD(GUIToPOP3));
     DoMethod(ST_POPHOST,                MUIM_Notify, MUIA_String_Contents,  MUIV_EveryTime, obj, 1, METHOD(GUIToPOP3));
+    DoMethod(CY_POPPROTOCOL,            MUIM_Notify, MUIA_Cycle_Active,     MUIV_EveryTime, obj, 1, METHOD(GUIToPOP3));
     DoMethod(ST_POPPORT,                MUIM_Notify, MUIA_String_Contents,  MUIV_EveryTime, obj, 1, METHOD(GUIToPOP3));
     DoMethod(BT_POPTEST,                MUIM_Notify, MUIA_Pressed,          FALSE,          obj, 1, METHOD(TestPOP3Connection));
     DoMethod(ST_POPUSERID,              MUIM_Notify, MUIA_String_Contents,  MUIV_EveryTime, obj, 1, METHOD(GUIToPOP3));
@@ -841,11 +876,14 @@ DECLARE(POP3ToGUI)
 
   if(msn != NULL)
   {
+    char defaultPort[6];
+
     // all notifies here are nnset() notifies so that we don't trigger any additional
     // notify or otherwise we would run into problems.
     nnset(data->CH_POPENABLED,             MUIA_Selected,        isServerActive(msn));
     nnset(data->ST_POPDESC,                MUIA_String_Contents, msn->description);
     nnset(data->ST_POPHOST,                MUIA_String_Contents, msn->hostname);
+    nnset(data->CY_POPPROTOCOL,            MUIA_Cycle_Active,    hasServerIMAP(msn) ? 1 : 0);
     nnset(data->ST_POPPORT,                MUIA_String_Integer,  msn->port);
     nnset(data->ST_POPUSERID,              MUIA_String_Contents, msn->username);
     nnset(data->ST_PASSWD,                 MUIA_String_Contents, msn->password);
@@ -893,10 +931,13 @@ DECLARE(POP3ToGUI)
     // we have to enabled/disable the SSL support accordingly
     set(data->CY_POPSECURE, MUIA_Disabled, G->sslCtx == NULL);
 
-    if(hasServerSSL(msn) == TRUE)
-      nnset(data->LB_POPPORT, MUIA_Text_Contents, "995");
-    else
-      nnset(data->LB_POPPORT, MUIA_Text_Contents, "110");
+    // APOP, preselection and remote filters are available for POP3 only
+    set(data->CY_POPAUTH, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+    set(data->CY_PRESELECTION, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+    set(data->CH_APPLYREMOTEFILTERS, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+
+    snprintf(defaultPort, sizeof(defaultPort), "%d", DefaultReceivePort(msn->flags));
+    nnset(data->LB_POPPORT, MUIA_Text_Contents, defaultPort);
 
     DoMethod(obj, METHOD(ShowSSLCertWarnings), data->GR_POP3_VIRTROOT, data->GR_POP3_SSLCERTWARNINGS, msn);
   }
@@ -923,7 +964,7 @@ DECLARE(GUIToPOP3)
     DoMethod(data->LV_POP3, MUIM_NList_GetEntry, p, &msn);
     if(msn != NULL)
     {
-      unsigned int oldSSLFlags;
+      unsigned int oldFlags;
 
       GetMUIString(msn->description,  data->ST_POPDESC,   sizeof(msn->description));
       GetMUIString(msn->hostname,     data->ST_POPHOST,   sizeof(msn->hostname));
@@ -988,7 +1029,12 @@ DECLARE(GUIToPOP3)
       msn->port = GetMUIInteger(data->ST_POPPORT);
 
       // remember the current flags of the server
-      oldSSLFlags = msn->flags;
+      oldFlags = msn->flags;
+
+      if(GetMUICycle(data->CY_POPPROTOCOL) == 1)
+        setFlag(msn->flags, MSF_PROTO_IMAP);
+      else
+        clearFlag(msn->flags, MSF_PROTO_IMAP);
 
       switch(GetMUICycle(data->CY_POPSECURE))
       {
@@ -1017,29 +1063,26 @@ DECLARE(GUIToPOP3)
         break;
       }
 
-      // check if the user changed something on the SSL/TLS options and
+      // check if the user changed the protocol or the SSL/TLS options and
       // update the port accordingly
-      if(oldSSLFlags != msn->flags)
+      if(oldFlags != msn->flags)
       {
-        if(hasServerSSL(msn) == TRUE)
-        {
-          nnset(data->LB_POPPORT, MUIA_Text_Contents, "995");
-          // adapt the port only if was the standard port for the previous security type before
-          if(msn->port == 110)
-          {
-            nnset(data->ST_POPPORT, MUIA_String_Integer, 995);
-            msn->port = 995;
-          }
-        }
-        else
+        int oldPort = DefaultReceivePort(oldFlags);
+        int newPort = DefaultReceivePort(msn->flags);
+        char defaultPort[6];
+
+        snprintf(defaultPort, sizeof(defaultPort), "%d", newPort);
+        nnset(data->LB_POPPORT, MUIA_Text_Contents, defaultPort);
+
+        set(data->CY_POPAUTH, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+        set(data->CY_PRESELECTION, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+        set(data->CH_APPLYREMOTEFILTERS, MUIA_Disabled, hasServerIMAP(msn) == TRUE);
+
+        // adapt the port only if was the standard port for the previous protocol and security type before
+        if(msn->port == oldPort && oldPort != newPort)
         {
-          nnset(data->LB_POPPORT, MUIA_Text_Contents, "110");
-          // adapt the port only if was the standard port for the previous security type before
-          if(msn->port == 995)
-          {
-            nnset(data->ST_POPPORT, MUIA_String_Integer, 110);
-            msn->port = 110;
-          }
+          nnset(data->ST_POPPORT, MUIA_String_Integer, newPort);
+          msn->port = newPort;
         }
       }
 
@@ -1171,6 +1214,9 @@ DECLARE(DeletePOP3Entry)
     // delete a possibly existing UIDL database file
     DeleteUIDLfile(msn);
 
+    // and the same for the IMAP synchronization state
+    DeleteIMAPStateFile(msn);
+
     FreeSysObject(ASOT_NODE, msn);
   }
 
@@ -68,13 +68,16 @@ struct Data
   ULONG Size_Curr_Max;
   ULONG Clock_Start;
   struct TimeVal Clock_Last;
+  ULONG RTT;
+  ULONG Throughput;
 
-  char stats_label[SIZE_DEFAULT];
+  char stats_label[SIZE_LARGE];
   char size_gauge_label[SIZE_DEFAULT];
   char msg_gauge_label[SIZE_DEFAULT];
   char str_size_done[SIZE_SMALL];
   char str_size_tot[SIZE_SMALL];
   char str_speed[SIZE_SMALL];
+  char str_throughput[SIZE_SMALL];
   char str_size_curr[SIZE_SMALL];
   char str_size_curr_max[SIZE_SMALL];
 
@@ -162,6 +165,20 @@ static void DoUpdateStats(struct Data *data, const int size_incr, const char *st
                                 deltatime / 60, deltatime % 60,
                                 remtime / 60, remtime % 60);
 
+    // append the round trip time and the throughput measured by the
+    // connection, if there is one
+    if(data->RTT != 0 || data->Throughput != 0)
+    {
+      size_t len = strlen(data->stats_label);
+
+      FormatSize(data->Throughput, data->str_throughput, sizeof(data->str_throughput), SF_MIXED);
+
+      snprintf(&data->stats_label[len], sizeof(data->stats_label) - len, "\n");
+      len++;
+      snprintf(&data->stats_label[len], sizeof(data->stats_label) - len, tr(MSG_TR_CONNECTIONSTATUS),
+                                  data->RTT / 1000, (data->RTT / 100) % 10, data->str_throughput);
+    }
+
     set(data->TX_STATS, MUIA_Text_Contents, data->stats_label);
 
     // update the gauge
@@ -395,6 +412,8 @@ DECLARE(Start) // int numberOfMails, ULONG totalSize
   data->Size_Tot = msg->totalSize;
   data->Size_Done = 0;
   data->Size_Curr = 0;
+  data->RTT = 0;
+  data->Throughput = 0;
   data->started = TRUE;
 
   // get the actual time we started the transfer
@@ -474,7 +493,7 @@ DECLARE(Next) // int index, int listpos, ULONG size, const char *status
 /// DECLARE(Update)
 // update the statistics, the visible display will be refreshed
 // 4 times per second at most
-DECLARE(Update) // int size_incr, const char *status
+DECLARE(Update) // int size_incr, const char *status, ULONG rtt, ULONG throughput
 {
   GETDATA;
 
@@ -482,7 +501,14 @@ DECLARE(Update) // int size_incr, const char *status
 
   // update the stats only if the transfer has been started already
   if(data->started == TRUE)
+  {
+    // the round trip time in microseconds and the throughput in bytes per
+    // second of the connection, both are zero for local transfers
+    data->RTT = msg->rtt;
+    data->Throughput = msg->throughput;
+
     DoUpdateStats(data, msg->size_incr, msg->status);
+  }
 
   RETURN(0);
   return 0;
@@ -85,6 +85,7 @@
 #include "MailServers.h"
 #include "MUIObjects.h"
 #include "ParseEmail.h"
+#include "PartCache.h"
 #include "Requesters.h"
 #include "Signature.h"
 #include "Threads.h"
@@ -3828,18 +3829,25 @@ DECLARE(SetupFromOldMail) // struct ReadMailData *rmData
 
       RE_DecodePart(part);
 
-      attach.Size = part->Size;
-      attach.IsTemp = TRUE;
+      // the attachment takes over the part's file, hence a file belonging
+      // to the part cache must be replaced by a private copy first
+      if(DetachCachedPart(part) == TRUE)
+      {
+        attach.Size = part->Size;
+        attach.IsTemp = TRUE;
 
-      if(part->Name)
-        strlcpy(attach.Name, part->Name, sizeof(attach.Name));
+        if(part->Name)
+          strlcpy(attach.Name, part->Name, sizeof(attach.Name));
 
-      strlcpy(attach.FilePath, part->Filename, sizeof(attach.FilePath));
-      *part->Filename = '\0';
-      strlcpy(attach.ContentType, part->ContentType, sizeof(attach.ContentType));
-      strlcpy(attach.Description, part->Description, sizeof(attach.Description));
+        strlcpy(attach.FilePath, part->Filename, sizeof(attach.FilePath));
+        *part->Filename = '\0';
+        strlcpy(attach.ContentType, part->ContentType, sizeof(attach.ContentType));
+        strlcpy(attach.Description, part->Description, sizeof(attach.Description));
 
-      DoMethod(obj, METHOD(InsertAttachment), &attach);
+        DoMethod(obj, METHOD(InsertAttachment), &attach);
+      }
+      else
+        E(DBF_GUI, "couldn't take over the file of part %ld", part->Nr);
 
       BusyEnd(busy);
     }
@@ -4281,7 +4289,12 @@ DECLARE(ComposeMail) // enum WriteMode mode, ULONG closeWindow
               // to the emailCache
               if(C->EmailCache > 0)
               {
-                DoMethod(_app(obj), MUIM_YAMApplication_AddToEmailCache, &newMail->To);
+                struct Person to;
+
+                // the cache expects a complete person
+                strlcpy(to.Address, newMail->To.Address, sizeof(to.Address));
+                strlcpy(to.RealName, newMail->To.RealName, sizeof(to.RealName));
+                DoMethod(_app(obj), MUIM_YAMApplication_AddToEmailCache, &to);
 
                 // if this mail has more than one recipient we have to add the others too
                 if(isMultiRCPTMail(newMail))
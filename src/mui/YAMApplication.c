@@ -462,13 +462,13 @@ DECLARE(AddToEmailCache) // struct Person *person
 
   // We first check the Addressbook if this Person already exists in the AB and if
   // so we cancel this whole operation.
-  if(FindPersonInABook(&G->abook, msg->person) == NULL)
+  if(FindPersonInABook(&G->abook, msg->person->Address) == NULL)
   {
     struct ABookNode *abn;
 
     // Ok, it doesn't exists in the AB, now lets check the cache list
     // itself
-    if((abn = FindPersonInABook(&data->emailCache, msg->person)) != NULL)
+    if((abn = FindPersonInABook(&data->emailCache, msg->person->Address)) != NULL)
     {
       // if we find the same entry already in the list we just move it
       // up to the top
@@ -123,7 +123,7 @@ void rx_getmailinfo(UNUSED struct RexxHost *host, struct RexxParams *params, enu
                                                                    mail->ReplyTo.Address[0] != '\0' ? mail->ReplyTo.RealName : mail->From.RealName);
         }
         else if(!strnicmp(key, "SUB", 3))
-          results->value = mail->Subject;
+          results->value = (char *)mail->Subject;
         else if(!strnicmp(key, "FIL", 3))
         {
           GetMailFile(optional->result, sizeof(optional->result), NULL, mail);
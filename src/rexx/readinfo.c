@@ -88,6 +88,9 @@ void rx_readinfo(UNUSED struct RexxHost *host, struct RexxParams *params, enum R
           results->filename[i] = part->Name;
           results->filetype[i] = part->ContentType;
           results->filesize[i] = (long *)&part->Size;
+
+          // the parts are kept in the mail file until someone needs them
+          RE_WritePartFile(part);
           results->tempfile[i] = part->Filename;
         }
       }
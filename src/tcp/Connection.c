@@ -46,6 +46,7 @@
 #include <proto/dos.h>
 #include <proto/exec.h>
 #include <proto/intuition.h>
+#include <proto/timer.h>
 #if defined(__amigaos3__) || defined(__MORPHOS__)
 #include <proto/miami.h>
 #include <proto/genesis.h>
@@ -72,6 +73,7 @@
 
 #include "YAM.h"
 #include "YAM_error.h"
+#include "YAM_utilities.h"
 
 #include "mui/YAMApplication.h"
 #include "tcp/Connection.h"
@@ -104,6 +106,28 @@
 
 #define INVALID_SOCKET        -1
 
+// the transfer buffers are doubled after this number of consecutive
+// operations which filled the whole buffer, up to the given maximum
+#define BUFFER_GROW_THRESHOLD     4
+#define MAX_TRANSFER_BUFFER_SIZE  (256*1024)
+// upper limit for automatically raised SO_RCVBUF/SO_SNDBUF sizes
+#define MAX_SOCKET_BUFFER_SIZE    (1024*1024)
+
+// the number of connections granted for a single host
+struct ConnectionSlot
+{
+  struct MinNode node;
+  char hostname[SIZE_HOST];
+  int count;
+};
+
+// a thread waiting for a connection slot
+struct ConnectionWaiter
+{
+  struct MinNode node;
+  APTR thread;
+};
+
 /// InitConnections
 // initalize a shared semaphore for all connections
 BOOL InitConnections(void)
@@ -112,6 +136,10 @@ BOOL InitConnections(void)
 
   ENTER();
 
+  NewMinList(&G->connectionSlotList);
+  NewMinList(&G->connectionWaiterList);
+  G->usedConnectionSlots = 0;
+
   if((G->connectionSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL &&
      (G->hostResolveSemaphore = AllocSysObjectTags(ASOT_SEMAPHORE, TAG_DONE)) != NULL)
   {
@@ -144,6 +172,140 @@ void CleanupConnections(void)
   LEAVE();
 }
 
+///
+/// FindConnectionSlot
+// find the connection slot of a host, the connection semaphore must be locked
+static struct ConnectionSlot *FindConnectionSlot(const char *hostname)
+{
+  struct ConnectionSlot *result = NULL;
+  struct ConnectionSlot *slot;
+
+  ENTER();
+
+  IterateList(&G->connectionSlotList, struct ConnectionSlot *, slot)
+  {
+    if(stricmp(slot->hostname, hostname) == 0)
+    {
+      result = slot;
+      break;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ObtainConnectionSlot
+// wait until another connection to the given server may be established
+// without exceeding the configured global and per host limits. Returns
+// FALSE if the waiting thread was aborted.
+BOOL ObtainConnectionSlot(const struct MailServerNode *msn)
+{
+  BOOL granted = FALSE;
+  BOOL waiting = FALSE;
+  struct ConnectionWaiter waiter;
+
+  ENTER();
+
+  waiter.thread = CurrentThread();
+
+  ObtainSemaphore(G->connectionSemaphore);
+
+  do
+  {
+    struct ConnectionSlot *slot = FindConnectionSlot(msn->hostname);
+
+    // a limit of zero means "no limit"
+    if((C->MaxConnections <= 0 || G->usedConnectionSlots < C->MaxConnections) &&
+       (C->MaxConnectionsPerHost <= 0 || slot == NULL || slot->count < C->MaxConnectionsPerHost))
+    {
+      if(slot == NULL && (slot = calloc(1, sizeof(*slot))) != NULL)
+      {
+        strlcpy(slot->hostname, msn->hostname, sizeof(slot->hostname));
+        AddTail((struct List *)&G->connectionSlotList, (struct Node *)slot);
+      }
+
+      // a failed allocation is no reason to refuse the connection
+      if(slot != NULL)
+        slot->count++;
+
+      G->usedConnectionSlots++;
+      granted = TRUE;
+
+      D(DBF_NET, "granted connection slot for server '%s', %ld slots in use", msn->hostname, G->usedConnectionSlots);
+    }
+    else
+    {
+      if(waiting == FALSE)
+      {
+        D(DBF_NET, "waiting for a free connection slot for server '%s'", msn->hostname);
+        AddTail((struct List *)&G->connectionWaiterList, (struct Node *)&waiter);
+        waiting = TRUE;
+      }
+
+      // sleep until another connection has been finished
+      ReleaseSemaphore(G->connectionSemaphore);
+      if(SleepThread() == FALSE)
+      {
+        W(DBF_NET, "waiting for a connection slot for server '%s' was aborted", msn->hostname);
+        ObtainSemaphore(G->connectionSemaphore);
+        break;
+      }
+      ObtainSemaphore(G->connectionSemaphore);
+    }
+  }
+  while(granted == FALSE);
+
+  if(waiting == TRUE)
+    Remove((struct Node *)&waiter);
+
+  ReleaseSemaphore(G->connectionSemaphore);
+
+  // forget about further wakeup signals caused by other finished connections
+  if(waiting == TRUE)
+    SetSignal(0UL, 1UL << ThreadWakeupSignal());
+
+  RETURN(granted);
+  return granted;
+}
+
+///
+/// ReleaseConnectionSlot
+// give back a connection slot obtained by ObtainConnectionSlot() and
+// wake up all threads waiting for a slot
+void ReleaseConnectionSlot(const struct MailServerNode *msn)
+{
+  struct ConnectionSlot *slot;
+  struct ConnectionWaiter *waiter;
+
+  ENTER();
+
+  ObtainSemaphore(G->connectionSemaphore);
+
+  if((slot = FindConnectionSlot(msn->hostname)) != NULL)
+  {
+    slot->count--;
+    if(slot->count <= 0)
+    {
+      Remove((struct Node *)slot);
+      free(slot);
+    }
+  }
+
+  G->usedConnectionSlots--;
+
+  D(DBF_NET, "released connection slot for server '%s', %ld slots in use", msn->hostname, G->usedConnectionSlots);
+
+  // every waiting thread checks itself whether it may connect now
+  IterateList(&G->connectionWaiterList, struct ConnectionWaiter *, waiter)
+    WakeupThread(waiter->thread);
+
+  ReleaseSemaphore(G->connectionSemaphore);
+
+  LEAVE();
+}
+
 ///
 /// DupHostEnt
 // duplicates a whole hostent structure
@@ -376,6 +538,21 @@ static void SetSocketOpts(struct Connection *conn)
       D(DBF_NET, "set SO_RCVTIMEO in socket");
   }
 
+  // remember the socket buffer sizes the connection starts with,
+  // they will be raised during bulk transfers
+  {
+    int optval;
+    socklen_t optlen;
+
+    optlen = sizeof(optval);
+    if(getsockopt(conn->socket, SOL_SOCKET, SO_RCVBUF, &optval, &optlen) >= 0)
+      conn->socketReceiveBufferSize = optval;
+
+    optlen = sizeof(optval);
+    if(getsockopt(conn->socket, SOL_SOCKET, SO_SNDBUF, &optval, &optlen) >= 0)
+      conn->socketSendBufferSize = optval;
+  }
+
   // lets print out the current socket options
   #if defined(DEBUG)
   {
@@ -1200,6 +1377,17 @@ enum ConnectError ConnectToHost(struct Connection *conn, const struct MailServer
               // now we are properly connected
               conn->isConnected = TRUE;
 
+              // start the transfer statistics of this connection
+              GetSysTime(TIMEVAL(&conn->connectTime));
+              conn->bytesSent = 0;
+              conn->bytesReceived = 0;
+              conn->roundTrips = 0;
+              conn->transferredMails = 0;
+              conn->awaitingReply = FALSE;
+              conn->minRTT = 0;
+              conn->fullReads = 0;
+              conn->fullWrites = 0;
+
               // save the msn structure for later reference
               conn->server = (struct MailServerNode *)msn;
 
@@ -1269,6 +1457,67 @@ enum ConnectError ConnectToHost(struct Connection *conn, const struct MailServer
   return error;
 }
 
+///
+/// GetConnectionThroughput
+// calculate the average number of bytes per second transferred in both
+// directions since the connection was established
+ULONG GetConnectionThroughput(const struct Connection *conn)
+{
+  ULONG throughput = 0;
+
+  ENTER();
+
+  if(conn != NULL && conn->isConnected == TRUE)
+  {
+    struct TimeVal now;
+    ULONG millis;
+
+    GetSysTime(TIMEVAL(&now));
+    SubTime(TIMEVAL(&now), TIMEVAL(&conn->connectTime));
+    millis = now.Seconds * 1000 + now.Microseconds / 1000;
+
+    if(millis != 0)
+      throughput = (ULONG)(((unsigned long long)(conn->bytesSent + conn->bytesReceived) * 1000) / millis);
+  }
+
+  RETURN(throughput);
+  return throughput;
+}
+
+///
+/// LogTransferStatistics
+// output the amount of transferred data, the number of round trips and the
+// resulting throughput of a connection which is about to be closed
+static void LogTransferStatistics(const struct Connection *conn)
+{
+  struct TimeVal now;
+  ULONG millis;
+
+  ENTER();
+
+  GetSysTime(TIMEVAL(&now));
+  SubTime(TIMEVAL(&now), TIMEVAL(&conn->connectTime));
+  millis = now.Seconds * 1000 + now.Microseconds / 1000;
+  if(millis == 0)
+    millis = 1;
+
+  D(DBF_NET, "connection to '%s' lasted %ld ms: sent %ld bytes, received %ld bytes, %ld round trips, %ld mails", conn->server->hostname, millis, conn->bytesSent, conn->bytesReceived, conn->roundTrips, conn->transferredMails);
+
+  // perform some debug output on the console if requested
+  // by the user
+  if(G->NetLog == TRUE)
+  {
+    fprintf(stderr, "STATS['%s']: %lu ms, %lu bytes sent, %lu bytes received, %lu round trips, %lu mails\n",
+      conn->server->description, (unsigned long)millis, (unsigned long)conn->bytesSent, (unsigned long)conn->bytesReceived,
+      (unsigned long)conn->roundTrips, (unsigned long)conn->transferredMails);
+    fprintf(stderr, "STATS['%s']: %lu bytes/s, %lu.%02lu mails/s\n",
+      conn->server->description, (unsigned long)(((unsigned long long)(conn->bytesSent + conn->bytesReceived) * 1000) / millis),
+      (unsigned long)((conn->transferredMails * 1000) / millis), (unsigned long)(((conn->transferredMails * 100000) / millis) % 100));
+  }
+
+  LEAVE();
+}
+
 ///
 /// DisconnectFromHost
 //  Terminate and free a connection
@@ -1287,6 +1536,9 @@ void DisconnectFromHost(struct Connection *conn)
     {
       int ret;
 
+      // keep the session for the next connection to this server
+      StoreSSLSession(conn);
+
       // clear any error
       ERR_clear_error();
 
@@ -1332,6 +1584,8 @@ void DisconnectFromHost(struct Connection *conn)
       // we are no longer connected
       conn->isConnected = FALSE;
 
+      LogTransferStatistics(conn);
+
       // one active connection less
       ObtainSemaphore(G->connectionSemaphore);
       G->activeConnections--;
@@ -1555,12 +1809,156 @@ static int ReadFromHost(struct Connection *conn, char *ptr, const int maxlen)
   if(status == -1)
     result = -1;
   else
+  {
     result = nread;
 
+    if(nread > 0)
+    {
+      conn->bytesReceived += nread;
+
+      // the first data received after sending completes a round trip
+      if(conn->awaitingReply == TRUE)
+      {
+        struct TimeVal now;
+        ULONG rtt;
+
+        GetSysTime(TIMEVAL(&now));
+        SubTime(TIMEVAL(&now), TIMEVAL(&conn->sendTime));
+        rtt = now.Seconds * 1000000 + now.Microseconds;
+        if(rtt != 0 && (conn->minRTT == 0 || rtt < conn->minRTT))
+          conn->minRTT = rtt;
+
+        conn->roundTrips++;
+        conn->awaitingReply = FALSE;
+      }
+    }
+  }
+
   RETURN(result);
   return result;
 }
 
+///
+/// AdaptSocketBuffer
+// raise SO_RCVBUF or SO_SNDBUF of the socket to cover twice the buffer size
+// and the bandwidth delay product of the connection, unless the user has
+// configured a fixed size
+static void AdaptSocketBuffer(struct Connection *conn, const int option, const int bufferSize, const ULONG bytes, int *socketBufferSize)
+{
+  int target = bufferSize * 2;
+  GET_SOCKETBASE(conn);
+
+  ENTER();
+
+  if(conn->minRTT != 0)
+  {
+    struct TimeVal now;
+    ULONG elapsed;
+
+    // throughput * RTT = bytes / elapsed time * RTT
+    GetSysTime(TIMEVAL(&now));
+    SubTime(TIMEVAL(&now), TIMEVAL(&conn->connectTime));
+    elapsed = now.Seconds * 1000000 + now.Microseconds;
+
+    if(elapsed != 0)
+    {
+      unsigned long long bdp = ((unsigned long long)bytes * conn->minRTT) / elapsed;
+
+      if(bdp * 2 > (unsigned long long)target)
+        target = (int)MIN(bdp * 2, MAX_SOCKET_BUFFER_SIZE);
+    }
+  }
+
+  target = MIN(target, MAX_SOCKET_BUFFER_SIZE);
+
+  if(target > *socketBufferSize)
+  {
+    if(setsockopt(conn->socket, SOL_SOCKET, option, &target, sizeof(target)) < 0)
+      W(DBF_NET, "setsockopt(%s, %ld) error", option == SO_RCVBUF ? "SO_RCVBUF" : "SO_SNDBUF", target);
+    else
+    {
+      D(DBF_NET, "raised %s from %ld to %ld bytes, min RTT %ld us", option == SO_RCVBUF ? "SO_RCVBUF" : "SO_SNDBUF", *socketBufferSize, target, conn->minRTT);
+      *socketBufferSize = target;
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// FillReceiveBuffer
+// refill the empty receive buffer from the socket. If the socket delivers a
+// full buffer several times in a row more data is waiting than we can take,
+// then the buffer and the socket's receive buffer are enlarged.
+static void FillReceiveBuffer(struct Connection *conn)
+{
+  ENTER();
+
+  if(conn->fullReads >= BUFFER_GROW_THRESHOLD && conn->receiveBufferSize < MAX_TRANSFER_BUFFER_SIZE)
+  {
+    int newSize = MIN(conn->receiveBufferSize * 2, MAX_TRANSFER_BUFFER_SIZE);
+    char *newBuffer;
+
+    // the buffer is empty, hence nothing needs to be preserved
+    if((newBuffer = realloc(conn->receiveBuffer, newSize)) != NULL)
+    {
+      D(DBF_NET, "grew receive buffer from %ld to %ld bytes", conn->receiveBufferSize, newSize);
+
+      conn->receiveBuffer = newBuffer;
+      conn->receiveBufferSize = newSize;
+
+      if(C->SocketOptions.RecvBuffer < 0)
+        AdaptSocketBuffer(conn, SO_RCVBUF, newSize, conn->bytesReceived, &conn->socketReceiveBufferSize);
+    }
+
+    conn->fullReads = 0;
+  }
+
+  // read all data upto the maximum our buffer allows
+  conn->receiveCount = ReadFromHost(conn, conn->receiveBuffer, conn->receiveBufferSize);
+
+  // reset the read_ptr
+  conn->receivePtr = conn->receiveBuffer;
+
+  if(conn->receiveCount >= conn->receiveBufferSize)
+    conn->fullReads++;
+  else
+    conn->fullReads = 0;
+
+  LEAVE();
+}
+
+///
+/// GrowSendBuffer
+// enlarge the send buffer after it was written out completely several times in
+// a row, the buffer must be empty
+static void GrowSendBuffer(struct Connection *conn)
+{
+  ENTER();
+
+  if(conn->fullWrites >= BUFFER_GROW_THRESHOLD && conn->sendBufferSize < MAX_TRANSFER_BUFFER_SIZE)
+  {
+    int newSize = MIN(conn->sendBufferSize * 2, MAX_TRANSFER_BUFFER_SIZE);
+    char *newBuffer;
+
+    if((newBuffer = realloc(conn->sendBuffer, newSize)) != NULL)
+    {
+      D(DBF_NET, "grew send buffer from %ld to %ld bytes", conn->sendBufferSize, newSize);
+
+      conn->sendBuffer = newBuffer;
+      conn->sendPtr = newBuffer;
+      conn->sendBufferSize = newSize;
+
+      if(C->SocketOptions.SendBuffer < 0)
+        AdaptSocketBuffer(conn, SO_SNDBUF, newSize, conn->bytesSent, &conn->socketSendBufferSize);
+    }
+
+    conn->fullWrites = 0;
+  }
+
+  LEAVE();
+}
+
 ///
 /// ReadFromHostBuffered
 // a buffered implementation of read()/recv() which is somehow compatible
@@ -1584,13 +1982,7 @@ static int ReadFromHostBuffered(struct Connection *conn, char *ptr, const int ma
   // data we request from the socket. Here we make sure we
   // take care of non-blocking IO
   if(conn->receiveCount <= 0)
-  {
-    // read all data upto the maximum our buffer allows
-    conn->receiveCount = ReadFromHost(conn, conn->receiveBuffer, conn->receiveBufferSize);
-
-    // reset the read_ptr
-    conn->receivePtr = conn->receiveBuffer;
-  }
+    FillReceiveBuffer(conn);
 
   if(conn->receiveCount > 0)
   {
@@ -1749,6 +2141,79 @@ int ReceiveFromHost(struct Connection *conn, char *recvdata, const int maxlen)
   return nread;
 }
 
+///
+/// PeekFromHost
+// make received data available without copying it. On success the number
+// of available bytes is returned and *data points to them within the receive
+// buffer. The caller may modify the data it is going to consume and must tell
+// how much of it has been processed by calling ConsumeFromHost() before any
+// further receive call. Returns 0 if the connection was closed and -1 on error.
+int PeekFromHost(struct Connection *conn, char **data)
+{
+  int result = -1;
+
+  ENTER();
+
+  if(conn != NULL)
+  {
+    // make sure the socket is active.
+    if(conn->isConnected == TRUE)
+    {
+      conn->error = CONNECTERR_NO_ERROR;
+
+      // if the buffer is empty we fill it again from the socket
+      if(conn->receiveCount <= 0)
+      {
+        FillReceiveBuffer(conn);
+
+        if(G->NetLog == TRUE)
+        {
+          fprintf(stderr, "SERVER['%s', %04d]: ", conn->server->description, conn->receiveCount);
+          if(conn->receiveCount > 0)
+            fwrite(conn->receiveBuffer, 1, conn->receiveCount, stderr);
+          fprintf(stderr, "\n");
+        }
+      }
+
+      if(conn->receiveCount > 0)
+        *data = conn->receivePtr;
+
+      result = conn->receiveCount;
+    }
+    else
+    {
+      W(DBF_NET, "socket not connected");
+      conn->error = CONNECTERR_NOT_CONNECTED;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ConsumeFromHost
+// remove the given number of bytes obtained by PeekFromHost() from the
+// receive buffer. Any remaining bytes will be returned by the next call
+// of one of the receive functions.
+void ConsumeFromHost(struct Connection *conn, const int len)
+{
+  ENTER();
+
+  if(conn != NULL && len > 0)
+  {
+    if(len <= conn->receiveCount)
+    {
+      conn->receivePtr += len;
+      conn->receiveCount -= len;
+    }
+    else
+      E(DBF_NET, "cannot consume %ld bytes, only %ld bytes available", len, conn->receiveCount);
+  }
+
+  LEAVE();
+}
+
 ///
 /// WriteToHost
 // an unbuffered implementation/wrapper for SSL_write/send() where the supplied
@@ -1971,8 +2436,23 @@ static int WriteToHost(struct Connection *conn, const char *ptr, const int len)
   if(status == -1)
     result = -1;
   else
+  {
     result = len-towrite;
 
+    if(result > 0)
+    {
+      conn->bytesSent += result;
+
+      // the round trip time is measured from the first data sent
+      // while no reply is pending
+      if(conn->awaitingReply == FALSE)
+      {
+        GetSysTime(TIMEVAL(&conn->sendTime));
+        conn->awaitingReply = TRUE;
+      }
+    }
+  }
+
   RETURN(result);
   return result;
 }
@@ -2010,10 +2490,17 @@ static int WriteToHostBuffered(struct Connection *conn, const char *ptr, int max
     }
     else
     {
+      if(conn->sendCount >= conn->sendBufferSize)
+        conn->fullWrites++;
+      else
+        conn->fullWrites = 0;
+
       // set the ptr to the start of the buffer
       conn->sendPtr = conn->sendBuffer;
       conn->sendCount = 0;
 
+      GrowSendBuffer(conn);
+
       // if this write operation was just because of a ONLYFLUSH
       // flag we can abort immediately, but make sure we don't
       // return an error but a count of zero
@@ -2060,6 +2547,9 @@ static int WriteToHostBuffered(struct Connection *conn, const char *ptr, int max
         // as we flushed everything
         conn->sendPtr = conn->sendBuffer;
         conn->sendCount = 0;
+
+        conn->fullWrites++;
+        GrowSendBuffer(conn);
       }
     }
 
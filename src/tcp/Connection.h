@@ -35,6 +35,8 @@
 #include <openssl/ssl.h>
 #include <time.h>
 
+#include "timeval.h"
+
 // forward declarations
 struct MailServerNode;
 
@@ -94,6 +96,20 @@ struct Connection
 
   ULONG abortSignal;                // a copy of the thread's abort signal
 
+  struct TimeVal connectTime;       // time when the connection was established
+  ULONG bytesSent;                  // number of bytes sent to the server
+  ULONG bytesReceived;              // number of bytes received from the server
+  ULONG roundTrips;                 // number of turnarounds from sending to receiving
+  ULONG transferredMails;           // number of mails transferred by the protocol layer
+  BOOL awaitingReply;               // has data been sent since the last receive?
+
+  struct TimeVal sendTime;          // time when data was sent with no reply pending
+  ULONG minRTT;                     // smallest measured round trip time in microseconds
+  int fullReads;                    // number of consecutive reads which filled the receive buffer
+  int fullWrites;                   // number of consecutive writes of a full send buffer
+  int socketReceiveBufferSize;      // current SO_RCVBUF size of the socket
+  int socketSendBufferSize;         // current SO_SNDBUF size of the socket
+
   BOOL connectedFromMainThread;     // who created this connection?
   BOOL isConnected;                 // has ConnectToHost() been called before?
   BOOL abort;                       // should the connection be aborted?
@@ -123,11 +139,16 @@ void DeleteConnection(struct Connection *conn);
 BOOL ConnectionIsOnline(struct Connection *conn);
 enum ConnectError ConnectToHost(struct Connection *conn, const struct MailServerNode *server);
 void DisconnectFromHost(struct Connection *conn);
+BOOL ObtainConnectionSlot(const struct MailServerNode *msn);
+void ReleaseConnectionSlot(const struct MailServerNode *msn);
 int ReceiveFromHost(struct Connection *conn, char *vptr, const int maxlen);
 int ReceiveLineFromHost(struct Connection *conn, char *vptr, const int maxlen);
+int PeekFromHost(struct Connection *conn, char **data);
+void ConsumeFromHost(struct Connection *conn, const int len);
 int SendToHost(struct Connection *conn, const char *ptr, const int len, const int flags);
 int SendLineToHost(struct Connection *conn, const char *vptr);
 int FlushConnection(struct Connection *conn);
 int GetFQDN(struct Connection *conn, char *name, size_t namelen);
+ULONG GetConnectionThroughput(const struct Connection *conn);
 
 #endif /* TCP_H */
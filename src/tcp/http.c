@@ -153,7 +153,7 @@ BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
       while(tc->connection->error == CONNECTERR_NO_ERROR &&
             (len = tc->receiveFunc(tc->connection, tc->requestResponse, sizeof(tc->requestResponse))) > 0)
       {
-        PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, len, tr(MSG_HTTP_RECEIVING_DATA));
+        PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, len, tr(MSG_HTTP_RECEIVING_DATA), tc->connection->minRTT, GetConnectionThroughput(tc->connection));
 
         if(out != NULL && fwrite(tc->requestResponse, len, 1, out) != 1)
         {
@@ -170,7 +170,7 @@ BOOL ReceiveHTTPBody(struct TransferContext *tc, const char *filename)
 
       D(DBF_NET, "received %ld/%ld bytes", received, tc->contentLength);
 
-      PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_HTTP_RECEIVING_DATA));
+      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_HTTP_RECEIVING_DATA), tc->connection->minRTT, GetConnectionThroughput(tc->connection));
 
       // check if we retrieved anything
       if(tc->connection->error == CONNECTERR_NO_ERROR && received >= 0)
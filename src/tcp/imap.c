@@ -0,0 +1,1390 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <mui/NList_mcc.h>
+#include <mui/NListtree_mcc.h>
+
+#include <clib/alib_protos.h>
+#include <libraries/iffparse.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <proto/utility.h>
+
+#include "extrasrc.h"
+
+#include "YAM.h"
+#include "YAM_error.h"
+#include "YAM_find.h"
+#include "YAM_mainFolder.h"
+#include "YAM_stringsizes.h"
+#include "YAM_utilities.h"
+
+#include "mui/ClassesExtra.h"
+#include "mui/StringRequestWindow.h"
+#include "mui/TransferControlGroup.h"
+#include "mui/YAMApplication.h"
+#include "tcp/Connection.h"
+#include "tcp/imap.h"
+#include "tcp/pop3.h"
+#include "tcp/ssl.h"
+
+#include "Busy.h"
+#include "FileInfo.h"
+#include "FolderList.h"
+#include "Locale.h"
+#include "Logfile.h"
+#include "MailList.h"
+#include "MailServers.h"
+#include "MethodStack.h"
+#include "MUIObjects.h"
+#include "Requesters.h"
+#include "Threads.h"
+
+#include "Debug.h"
+
+/**************************************************************************/
+// local macros & defines
+
+// the maximum number of mails requested by a single UID FETCH command, the
+// server streams all of them without waiting for further commands
+#define IMAP_FETCH_CHUNK     50
+
+// the version of the file holding the state of the last mail check
+#define IMAP_STATE_VER       MAKE_ID('Y','I','S','1')
+
+// the state of the INBOX at the end of a mail check, as long as UIDVALIDITY
+// doesn't change all mails with an UID below UIDNEXT are known. Only new mails
+// are fetched, flag changes and expunged mails on the server are not tracked.
+struct IMAPSyncState
+{
+  ULONG uidValidity;                     // the UIDVALIDITY of the mailbox
+  ULONG uidNext;                         // the first UID which has not been downloaded yet
+};
+
+struct IMAPStateFile
+{
+  ULONG ID;                              // IMAP_STATE_VER
+  struct IMAPSyncState state;
+};
+
+// a new mail on the server
+struct IMAPMail
+{
+  ULONG uid;
+  ULONG size;
+  BOOL downloaded;
+};
+
+struct IMAPContext
+{
+  struct Connection *connection;
+  struct MailServerNode *msn;
+  Object *transferGroup;
+  struct BusyNode *busy;
+  struct Folder *incomingFolder;         // the folder to place the downloaded mails into
+  ULONG flags;
+  ULONG tagCounter;                      // the number of commands sent so far
+  char tag[SIZE_SMALL];                  // the tag of the pending command
+  size_t tagLength;
+  char lineBuffer[SIZE_LINE];
+  char commandBuffer[SIZE_LINE];
+  char password[SIZE_PASSWORD];
+  char windowTitle[SIZE_DEFAULT];        // the password window's title
+  char transferGroupTitle[SIZE_DEFAULT]; // the TransferControlGroup's title
+  BOOL useTLS;
+  BOOL preAuth;                          // the server authenticated us already (PREAUTH)
+  BOOL loginDisabled;                    // LOGINDISABLED capability
+  BOOL listing;                          // FETCH responses list the new mails
+  BOOL downloading;                      // FETCH responses carry mails to be stored
+  struct IMAPSyncState oldState;         // the state of the last mail check
+  struct IMAPSyncState newState;         // the state reported by SELECT
+  ULONG exists;                          // number of mails in the mailbox
+  ULONG firstUID;                        // the lowest UID to be regarded as new
+  struct IMAPMail *mails;                // the new mails, sorted by UID
+  ULONG numMails;
+  ULONG maxMails;
+  ULONG mailIndex;                       // the number of the mail being downloaded
+  long totalSize;
+  struct DownloadResult downloadResult;
+  struct FilterResult filterResult;
+  struct TimeVal lastUpdateTime;
+};
+
+/**************************************************************************/
+// static function prototypes
+static void ParseUntaggedResponse(struct IMAPContext *ic);
+
+/**************************************************************************/
+// local functions
+
+/// BuildStateFilename
+// set up a name for the file with the mail check state of an account
+static void BuildStateFilename(const struct MailServerNode *msn, char *statePath, const size_t statePathSize)
+{
+  char *stateName;
+
+  ENTER();
+
+  // create a file name using the mail server's unique ID
+  if(asprintf(&stateName, ".imap_%08lx", msn->id) != -1)
+  {
+    CreateFilename(stateName, statePath, statePathSize);
+
+    free(stateName);
+  }
+  else
+    statePath[0] = '\0';
+
+  LEAVE();
+}
+
+///
+/// LoadSyncState
+// read the state of the last mail check of the account
+static void LoadSyncState(struct IMAPContext *ic)
+{
+  char statePath[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  memset(&ic->oldState, 0, sizeof(ic->oldState));
+
+  BuildStateFilename(ic->msn, statePath, sizeof(statePath));
+  if(statePath[0] != '\0' && (fh = fopen(statePath, "r")) != NULL)
+  {
+    struct IMAPStateFile stateFile;
+
+    if(fread(&stateFile, sizeof(stateFile), 1, fh) == 1 && stateFile.ID == IMAP_STATE_VER)
+    {
+      memcpy(&ic->oldState, &stateFile.state, sizeof(ic->oldState));
+
+      D(DBF_NET, "loaded IMAP state of account '%s', UIDVALIDITY %ld, UIDNEXT %ld", ic->msn->description, ic->oldState.uidValidity, ic->oldState.uidNext);
+    }
+    else
+      W(DBF_NET, "ignoring invalid IMAP state file '%s'", statePath);
+
+    fclose(fh);
+  }
+
+  LEAVE();
+}
+
+///
+/// SaveSyncState
+// remember the state of the current mail check
+static void SaveSyncState(const struct IMAPContext *ic, const struct IMAPSyncState *state)
+{
+  char statePath[SIZE_PATHFILE];
+  FILE *fh;
+
+  ENTER();
+
+  BuildStateFilename(ic->msn, statePath, sizeof(statePath));
+  if(statePath[0] != '\0' && (fh = fopen(statePath, "w")) != NULL)
+  {
+    struct IMAPStateFile stateFile;
+
+    memset(&stateFile, 0, sizeof(stateFile));
+    stateFile.ID = IMAP_STATE_VER;
+    memcpy(&stateFile.state, state, sizeof(stateFile.state));
+
+    if(fwrite(&stateFile, sizeof(stateFile), 1, fh) != 1)
+      E(DBF_NET, "failed to write IMAP state file '%s'", statePath);
+
+    fclose(fh);
+
+    D(DBF_NET, "saved IMAP state of account '%s', UIDVALIDITY %ld, UIDNEXT %ld", ic->msn->description, state->uidValidity, state->uidNext);
+  }
+  else
+    E(DBF_NET, "failed to create IMAP state file '%s'", statePath);
+
+  LEAVE();
+}
+
+///
+/// HasCapability
+// check whether a list of capabilities contains a certain capability
+static BOOL HasCapability(const char *list, const char *capability)
+{
+  BOOL found = FALSE;
+  size_t len = strlen(capability);
+  const char *p = list;
+
+  ENTER();
+
+  while(found == FALSE && (p = strcasestr(p, capability)) != NULL)
+  {
+    // only whole words count
+    if((p == list || p[-1] == ' ') &&
+       (p[len] == '\0' || p[len] == ' ' || p[len] == ']' || p[len] == '\r' || p[len] == '\n'))
+    {
+      found = TRUE;
+    }
+    else
+      p += len;
+  }
+
+  RETURN(found);
+  return found;
+}
+
+///
+/// ParseCapabilities
+// evaluate the capabilities we are interested in (RFC 3501)
+static void ParseCapabilities(struct IMAPContext *ic, const char *list)
+{
+  ENTER();
+
+  ic->loginDisabled = HasCapability(list, "LOGINDISABLED");
+
+  D(DBF_NET, "IMAP server '%s' capabilities: LOGINDISABLED %ld", ic->msn->hostname, ic->loginDisabled);
+
+  LEAVE();
+}
+
+///
+/// ParseResponseCode
+// evaluate the response code of an OK response, like "[UIDNEXT 4392] Predicted next UID"
+static void ParseResponseCode(struct IMAPContext *ic, const char *text)
+{
+  ENTER();
+
+  if(text[0] == '[')
+  {
+    const char *code = &text[1];
+
+    if(strnicmp(code, "UIDVALIDITY ", 12) == 0)
+      ic->newState.uidValidity = strtoul(&code[12], NULL, 10);
+    else if(strnicmp(code, "UIDNEXT ", 8) == 0)
+      ic->newState.uidNext = strtoul(&code[8], NULL, 10);
+    else if(strnicmp(code, "CAPABILITY ", 11) == 0)
+      ParseCapabilities(ic, &code[11]);
+  }
+
+  LEAVE();
+}
+
+///
+/// GetLiteralLength
+// check whether a line announces a literal like "{1234}\r\n" at its end
+static BOOL GetLiteralLength(const char *line, size_t *length)
+{
+  BOOL result = FALSE;
+  const char *p;
+
+  ENTER();
+
+  if((p = strrchr(line, '{')) != NULL && isdigit(p[1]))
+  {
+    char *end;
+    size_t len = strtoul(&p[1], &end, 10);
+
+    if(strcmp(end, "}\r\n") == 0)
+    {
+      *length = len;
+      result = TRUE;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReceiveIMAPLine
+// receive a single line of a response, the part of a line exceeding the
+// line buffer is dropped, we are not interested in such lines anyway
+static int ReceiveIMAPLine(struct IMAPContext *ic)
+{
+  int received;
+
+  ENTER();
+
+  if((received = ReceiveLineFromHost(ic->connection, ic->lineBuffer, sizeof(ic->lineBuffer))) > 0 &&
+     ic->lineBuffer[received-1] != '\n')
+  {
+    char rest[SIZE_DEFAULT];
+    int len;
+
+    W(DBF_NET, "dropping the rest of an overlong IMAP response line");
+
+    while((len = ReceiveLineFromHost(ic->connection, rest, sizeof(rest))) > 0 && rest[len-1] != '\n')
+      ;
+
+    // keep the line ending to let the line look complete
+    if(len > 0)
+      strlcpy(&ic->lineBuffer[sizeof(ic->lineBuffer)-3], "\r\n", 3);
+    else
+      received = len;
+  }
+
+  RETURN(received);
+  return received;
+}
+
+///
+/// StoreLiteralData
+// write the data of a literal to a file, the file is "closed" on errors
+static void StoreLiteralData(FILE **fh, const char *data, const size_t len)
+{
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+  if(*fh != NULL && len > 0 && fwrite(data, 1, len, *fh) != len)
+    *fh = NULL;
+}
+
+///
+/// ReceiveLiteral
+// receive a literal of the given length and write it to a file or drop it if
+// no file is given. The data is processed right within the connection's
+// receive buffer and "\r\n" line endings become "\n". Returns FALSE if the
+// literal could not be received or written completely.
+static BOOL ReceiveLiteral(struct IMAPContext *ic, FILE *fh, size_t length)
+{
+  BOOL success;
+  BOOL pendingCR = FALSE;
+  FILE *out = fh;
+
+  ENTER();
+
+  // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
+  // mark through which mail account this mail was received.
+  if(out != NULL)
+    fprintf(out, "X-YAM-MailAccount: %s@%s\n", ic->msn->username, ic->msn->hostname);
+
+  while(length > 0 && ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR)
+  {
+    char *data;
+    char *ptr;
+    char *end;
+    int read;
+
+    if((read = PeekFromHost(ic->connection, &data)) <= 0)
+    {
+      if(ic->connection->error == CONNECTERR_NO_ERROR)
+        ic->connection->error = CONNECTERR_UNKNOWN_ERROR;
+
+      break;
+    }
+
+    // anything beyond the literal belongs to the rest of the response
+    if((size_t)read > length)
+      read = length;
+
+    ptr = data;
+    end = data + read;
+
+    // the previous block ended with a "\r"
+    if(pendingCR == TRUE)
+    {
+      if(*ptr == '\n')
+      {
+        StoreLiteralData(&out, "\n", 1);
+        ptr++;
+      }
+      else
+        StoreLiteralData(&out, "\r", 1);
+
+      pendingCR = FALSE;
+    }
+
+    while(ptr < end)
+    {
+      char *eol;
+
+      if((eol = memchr(ptr, '\n', end - ptr)) != NULL)
+      {
+        // convert a "\r\n" line ending to "\n" in place, we are allowed
+        // to modify the data we are going to consume
+        if(eol > ptr && eol[-1] == '\r')
+        {
+          eol[-1] = '\n';
+          StoreLiteralData(&out, ptr, eol - ptr);
+        }
+        else
+          StoreLiteralData(&out, ptr, eol + 1 - ptr);
+
+        ptr = eol + 1;
+      }
+      else
+      {
+        // a trailing "\r" might be the first half of the line ending
+        if(end[-1] == '\r')
+        {
+          StoreLiteralData(&out, ptr, end - 1 - ptr);
+          pendingCR = TRUE;
+        }
+        else
+          StoreLiteralData(&out, ptr, end - ptr);
+
+        ptr = end;
+      }
+    }
+
+    ConsumeFromHost(ic->connection, read);
+    length -= read;
+
+    // update the transfer status while downloading mails
+    if(ic->downloading == TRUE)
+      PushMethodOnStack(ic->transferGroup, 5, MUIM_TransferControlGroup_Update, read, tr(MSG_TR_Downloading), ic->connection->minRTT, GetConnectionThroughput(ic->connection));
+  }
+
+  if(pendingCR == TRUE)
+    StoreLiteralData(&out, "\r", 1);
+
+  success = (length == 0 && out == fh);
+
+  RETURN(success);
+  return success;
+}
+
+///
+/// FindIMAPMail
+// find a new mail by its UID
+static struct IMAPMail *FindIMAPMail(const struct IMAPContext *ic, const ULONG uid)
+{
+  struct IMAPMail *result = NULL;
+  ULONG low = 0;
+  ULONG high = ic->numMails;
+
+  ENTER();
+
+  // the mails are sorted by their UIDs
+  while(low < high)
+  {
+    ULONG mid = (low + high) / 2;
+
+    if(ic->mails[mid].uid < uid)
+      low = mid + 1;
+    else if(ic->mails[mid].uid > uid)
+      high = mid;
+    else
+    {
+      result = &ic->mails[mid];
+      break;
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// AddIMAPMail
+// add a new mail to the list of mails to be downloaded
+static void AddIMAPMail(struct IMAPContext *ic, const ULONG uid, const ULONG size)
+{
+  ENTER();
+
+  // the FETCH responses arrive in the order of the message sequence numbers
+  // and hence in ascending UID order, anything else is dropped
+  if(ic->numMails == 0 || uid > ic->mails[ic->numMails-1].uid)
+  {
+    if(ic->numMails == ic->maxMails)
+    {
+      ULONG newMax = (ic->maxMails == 0) ? 64 : ic->maxMails * 2;
+      struct IMAPMail *newMails;
+
+      if((newMails = realloc(ic->mails, newMax * sizeof(*newMails))) != NULL)
+      {
+        ic->mails = newMails;
+        ic->maxMails = newMax;
+      }
+    }
+
+    if(ic->numMails < ic->maxMails)
+    {
+      struct IMAPMail *mail = &ic->mails[ic->numMails++];
+
+      mail->uid = uid;
+      mail->size = size;
+      mail->downloaded = FALSE;
+
+      ic->totalSize += size;
+    }
+    else
+      E(DBF_NET, "failed to enlarge the list of new IMAP mails");
+  }
+  else
+    W(DBF_NET, "dropping out of order UID %ld", uid);
+
+  LEAVE();
+}
+
+///
+/// ReceiveMessage
+// receive a mail announced by a FETCH response as literal and add it to the
+// incoming folder
+static void ReceiveMessage(struct IMAPContext *ic, ULONG uid, const size_t length)
+{
+  char msgfile[SIZE_PATHFILE];
+  FILE *fh;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  ic->mailIndex++;
+  PushMethodOnStack(ic->transferGroup, 5, MUIM_TransferControlGroup_Next, ic->mailIndex, ic->mailIndex-1, length, tr(MSG_TR_Downloading));
+
+  // the mails of several accounts may be stored in the same folder at the
+  // same time, hence the new mail file must be created before any other
+  // thread is able to pick the same name
+  ObtainSemaphore(G->globalSemaphore);
+  MA_NewMailFile(ic->incomingFolder, msgfile, sizeof(msgfile));
+  fh = fopen(msgfile, "w");
+  ReleaseSemaphore(G->globalSemaphore);
+
+  if(fh != NULL)
+  {
+    setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
+
+    done = ReceiveLiteral(ic, fh, length);
+    fclose(fh);
+  }
+  else
+  {
+    // the literal must be received nevertheless to stay in sync with the server
+    ReceiveLiteral(ic, NULL, length);
+  }
+
+  if(fh == NULL || (done == FALSE && ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR))
+    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), msgfile);
+
+  // the rest of the FETCH response follows the literal, it might contain the
+  // UID if the server didn't send it in front of the mail
+  if(ReceiveIMAPLine(ic) > 0 && uid == 0)
+  {
+    char *p;
+
+    if((p = strcasestr(ic->lineBuffer, "UID ")) != NULL)
+      uid = strtoul(&p[4], NULL, 10);
+  }
+
+  if(fh != NULL)
+  {
+    BOOL stored = FALSE;
+
+    if(ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR && done == TRUE)
+      stored = AddDownloadedMail(ic->msn, ic->incomingFolder, msgfile);
+
+    if(stored == TRUE)
+    {
+      struct IMAPMail *mail;
+
+      ic->connection->transferredMails++;
+      ic->downloadResult.downloaded++;
+
+      if((mail = FindIMAPMail(ic, uid)) != NULL)
+        mail->downloaded = TRUE;
+      else
+        W(DBF_NET, "downloaded mail with unknown UID %ld", uid);
+
+      if(TimeHasElapsed(&ic->lastUpdateTime, 250000) == TRUE)
+      {
+        // redraw the folderentry in the listtree 4 times per second at most
+        PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, ic->incomingFolder->Treenode, MUIF_NONE);
+      }
+
+      // put the transferStat for this mail to 100%
+      PushMethodOnStack(ic->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading), ic->connection->minRTT, GetConnectionThroughput(ic->connection));
+    }
+    else
+    {
+      DeleteFile(msgfile);
+
+      // we need to set the folder flags to modified so that the .index will be saved later.
+      setFlag(ic->incomingFolder->Flags, FOFL_MODIFY);
+    }
+  }
+
+  LEAVE();
+}
+
+///
+/// ParseFetchResponse
+// evaluate a FETCH response, it either lists a new mail or carries the mail itself
+static void ParseFetchResponse(struct IMAPContext *ic, const char *items)
+{
+  ULONG uid = 0;
+  ULONG size = 0;
+  size_t length;
+  char *p;
+
+  ENTER();
+
+  if((p = strcasestr(items, "UID ")) != NULL)
+    uid = strtoul(&p[4], NULL, 10);
+  if((p = strcasestr(items, "RFC822.SIZE ")) != NULL)
+    size = strtoul(&p[12], NULL, 10);
+
+  if(ic->downloading == TRUE)
+  {
+    if(strcasestr(items, "BODY[] ") != NULL && GetLiteralLength(ic->lineBuffer, &length) == TRUE)
+      ReceiveMessage(ic, uid, length);
+  }
+  else if(ic->listing == TRUE && uid != 0 && uid >= ic->firstUID)
+  {
+    // "UID FETCH n:*" returns the last mail even if its UID is less than n
+    AddIMAPMail(ic, uid, size);
+  }
+
+  LEAVE();
+}
+
+///
+/// ParseUntaggedResponse
+// evaluate an untagged response line like "* 23 EXISTS"
+static void ParseUntaggedResponse(struct IMAPContext *ic)
+{
+  char *line = &ic->lineBuffer[2];
+  size_t length;
+
+  ENTER();
+
+  if(strnicmp(line, "OK ", 3) == 0)
+    ParseResponseCode(ic, &line[3]);
+  else if(strnicmp(line, "CAPABILITY ", 11) == 0)
+    ParseCapabilities(ic, &line[11]);
+  else if(strnicmp(line, "BYE ", 4) == 0)
+    D(DBF_NET, "IMAP server '%s' closes the connection: %s", ic->msn->hostname, &line[4]);
+  else if(isdigit(line[0]))
+  {
+    char *p;
+    ULONG number = strtoul(line, &p, 10);
+
+    if(strnicmp(p, " EXISTS", 7) == 0)
+      ic->exists = number;
+    else if(strnicmp(p, " FETCH (", 8) == 0)
+      ParseFetchResponse(ic, &p[8]);
+  }
+
+  // drop the literals of all responses we are not interested in
+  while(ic->connection->error == CONNECTERR_NO_ERROR && GetLiteralLength(ic->lineBuffer, &length) == TRUE)
+  {
+    if(ReceiveLiteral(ic, NULL, length) == FALSE || ReceiveIMAPLine(ic) <= 0)
+      break;
+  }
+
+  LEAVE();
+}
+
+///
+/// ReceiveIMAPResponse
+// receive all responses up to the tagged completion result of the pending
+// command, the untagged responses are evaluated on the way
+static char *ReceiveIMAPResponse(struct IMAPContext *ic, const char *command, const char *errorMsg)
+{
+  char *result = NULL;
+  BOOL done = FALSE;
+
+  ENTER();
+
+  while(done == FALSE && ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR)
+  {
+    if(ReceiveIMAPLine(ic) <= 0)
+    {
+      if(ic->connection->error == CONNECTERR_NO_ERROR)
+        ic->connection->error = CONNECTERR_UNKNOWN_ERROR;
+
+      break;
+    }
+
+    if(strncmp(ic->lineBuffer, "* ", 2) == 0)
+      ParseUntaggedResponse(ic);
+    else if(strncmp(ic->lineBuffer, ic->tag, ic->tagLength) == 0 && ic->lineBuffer[ic->tagLength] == ' ')
+    {
+      char *status = &ic->lineBuffer[ic->tagLength+1];
+
+      D(DBF_NET, "received IMAP answer '%s'", ic->lineBuffer);
+
+      if(strnicmp(status, "OK", 2) == 0)
+      {
+        if(status[2] == ' ')
+          ParseResponseCode(ic, &status[3]);
+
+        result = status;
+      }
+      else if(errorMsg != NULL)
+        ER_NewError(errorMsg, ic->msn->hostname, ic->msn->description, (char *)command, status);
+
+      done = TRUE;
+    }
+    else
+    {
+      // we never send literals, so there should be no continuation requests
+      W(DBF_NET, "unexpected IMAP response '%s'", ic->lineBuffer);
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// SendIMAPCommand
+// send a tagged command to the IMAP server and wait for its completion
+static char *SendIMAPCommand(struct IMAPContext *ic, const char *command, const char *args, const char *errorMsg)
+{
+  char *result = NULL;
+
+  ENTER();
+
+  ic->tagLength = snprintf(ic->tag, sizeof(ic->tag), "Y%04ld", ++ic->tagCounter);
+
+  if(IsStrEmpty(args))
+    snprintf(ic->commandBuffer, sizeof(ic->commandBuffer), "%s %s\r\n", ic->tag, command);
+  else
+    snprintf(ic->commandBuffer, sizeof(ic->commandBuffer), "%s %s %s\r\n", ic->tag, command, args);
+
+  D(DBF_NET, "send IMAP cmd '%s' with param '%s'", command, (strcmp(command, "LOGIN") == 0) ? "XXX" : SafeStr(args));
+
+  if(SendLineToHost(ic->connection, ic->commandBuffer) > 0)
+    result = ReceiveIMAPResponse(ic, command, errorMsg);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReceiveGreeting
+// receive the server's greeting, either "* OK", "* PREAUTH" or "* BYE"
+static BOOL ReceiveGreeting(struct IMAPContext *ic)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(ReceiveIMAPLine(ic) > 0)
+  {
+    D(DBF_NET, "received IMAP greeting '%s'", ic->lineBuffer);
+
+    if(strnicmp(ic->lineBuffer, "* OK ", 5) == 0)
+    {
+      ParseResponseCode(ic, &ic->lineBuffer[5]);
+      result = TRUE;
+    }
+    else if(strnicmp(ic->lineBuffer, "* PREAUTH ", 10) == 0)
+    {
+      ParseResponseCode(ic, &ic->lineBuffer[10]);
+      ic->preAuth = TRUE;
+      result = TRUE;
+    }
+  }
+
+  if(result == FALSE)
+    ER_NewError(tr(MSG_ER_IMAPWELCOME), ic->msn->hostname, ic->msn->description, ic->lineBuffer);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// QuoteString
+// append a string as quoted string (RFC 3501) to a buffer
+static void QuoteString(char *buffer, const size_t bufferSize, const char *string)
+{
+  size_t len = strlen(buffer);
+
+  ENTER();
+
+  if(len + 1 < bufferSize)
+    buffer[len++] = '"';
+
+  while(*string != '\0' && len + 2 < bufferSize)
+  {
+    if(*string == '"' || *string == '\\')
+      buffer[len++] = '\\';
+
+    buffer[len++] = *string++;
+  }
+
+  if(len + 1 < bufferSize)
+    buffer[len++] = '"';
+
+  buffer[len] = '\0';
+
+  LEAVE();
+}
+
+///
+/// AskForPassword
+// ask the user for the password if none is stored in the configuration
+static BOOL AskForPassword(struct IMAPContext *ic)
+{
+  BOOL result;
+
+  ENTER();
+
+  if(IsStrEmpty(ic->password))
+  {
+    Object *passwordWin;
+
+    snprintf(ic->windowTitle, sizeof(ic->windowTitle), tr(MSG_TR_ENTER_IMAP_PASSWORD), ic->msn->description);
+
+    if((passwordWin = (Object *)PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_CreatePasswordWindow, CurrentThread(), ic->transferGroupTitle, ic->windowTitle, sizeof(ic->password))) != NULL)
+    {
+      PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_WAIT_FOR_PASSWORD));
+
+      if(SleepThread() == TRUE)
+      {
+        ULONG result = 0;
+
+        PushMethodOnStackWait(passwordWin, 3, OM_GET, MUIA_StringRequestWindow_Result, &result);
+        if(result != 0)
+          PushMethodOnStackWait(passwordWin, 3, OM_GET, MUIA_StringRequestWindow_StringContents, ic->password);
+      }
+      else
+      {
+        // force "no password" if we were aborted
+        ic->password[0] = '\0';
+      }
+
+      PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DisposeWindow, passwordWin);
+    }
+  }
+
+  // bail out if we still got no password
+  result = (IsStrEmpty(ic->password) == FALSE);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ConnectToIMAP
+// connect to the IMAP server and log in
+static BOOL ConnectToIMAP(struct IMAPContext *ic)
+{
+  BOOL result = FALSE;
+  enum ConnectError err;
+
+  ENTER();
+
+  D(DBF_NET, "connect to IMAP server '%s'", ic->msn->hostname);
+
+  PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_Connecting));
+
+  // show some busy text in the main window
+  ic->busy = BusyBegin(BUSY_TEXT);
+  BusyText(ic->busy, tr(MSG_TR_MAILCHECKFROM), ic->msn->description);
+
+  if((err = ConnectToHost(ic->connection, ic->msn)) != CONNECTERR_SUCCESS)
+  {
+    if(isFlagSet(ic->flags, RECEIVEF_USER) && err != CONNECTERR_ABORTED && err != CONNECTERR_NO_ERROR)
+    {
+      if(err == CONNECTERR_UNKNOWN_HOST)
+        ER_NewError(tr(MSG_ER_UNKNOWN_HOST_POP3), ic->msn->hostname, ic->msn->description);
+      else
+        ER_NewError(tr(MSG_ER_CANNOT_CONNECT_IMAP), ic->msn->hostname, ic->msn->description);
+    }
+
+    goto out;
+  }
+
+  // a SSL connection must be established before the greeting arrives
+  if(hasServerSSL(ic->msn))
+  {
+    PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_INITTLS));
+
+    if(MakeSecureConnection(ic->connection) == FALSE)
+    {
+      ER_NewError(tr(MSG_ER_INITTLS_POP3), ic->msn->hostname, ic->msn->description);
+      goto out;
+    }
+
+    ic->useTLS = TRUE;
+  }
+
+  PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_WaitWelcome));
+  if(ReceiveGreeting(ic) == FALSE)
+    goto out;
+
+  // start the TLS negotiation (RFC 3501, section 6.2.1)
+  if(hasServerTLS(ic->msn) && ic->preAuth == FALSE)
+  {
+    if(SendIMAPCommand(ic, "STARTTLS", NULL, tr(MSG_ER_BADRESPONSE_IMAP)) == NULL)
+      goto out;
+
+    PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_INITTLS));
+
+    if(MakeSecureConnection(ic->connection) == FALSE)
+    {
+      ER_NewError(tr(MSG_ER_INITTLS_POP3), ic->msn->hostname, ic->msn->description);
+      goto out;
+    }
+
+    ic->useTLS = TRUE;
+  }
+
+  // the capabilities must be requested again after the TLS negotiation
+  if(SendIMAPCommand(ic, "CAPABILITY", NULL, tr(MSG_ER_BADRESPONSE_IMAP)) == NULL)
+    goto out;
+
+  if(ic->preAuth == FALSE)
+  {
+    if(ic->loginDisabled == TRUE)
+    {
+      ER_NewError(tr(MSG_ER_IMAP_LOGINDISABLED), ic->msn->hostname, ic->msn->description);
+      goto out;
+    }
+
+    if(AskForPassword(ic) == FALSE)
+      goto out;
+
+    ic->lineBuffer[0] = '\0';
+    QuoteString(ic->lineBuffer, sizeof(ic->lineBuffer), ic->msn->username);
+    strlcat(ic->lineBuffer, " ", sizeof(ic->lineBuffer));
+    QuoteString(ic->lineBuffer, sizeof(ic->lineBuffer), ic->password);
+
+    PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_SendPassword));
+    if(SendIMAPCommand(ic, "LOGIN", ic->lineBuffer, tr(MSG_ER_BADRESPONSE_IMAP)) == NULL)
+      goto out;
+
+    // the capabilities may change after the login
+    if(SendIMAPCommand(ic, "CAPABILITY", NULL, tr(MSG_ER_BADRESPONSE_IMAP)) == NULL)
+      goto out;
+  }
+
+  result = TRUE;
+
+out:
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// DisconnectFromIMAP
+static void DisconnectFromIMAP(struct IMAPContext *ic)
+{
+  ENTER();
+
+  D(DBF_NET, "disconnecting from IMAP server '%s'", ic->msn->hostname);
+  PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_Disconnecting));
+  if(ic->connection->error == CONNECTERR_NO_ERROR)
+    SendIMAPCommand(ic, "LOGOUT", NULL, NULL);
+
+  DisconnectFromHost(ic->connection);
+
+  BusyEnd(ic->busy);
+  ic->busy = NULL;
+
+  LEAVE();
+}
+
+///
+/// SelectInbox
+// select the INBOX to learn its UIDVALIDITY and UIDNEXT
+static BOOL SelectInbox(struct IMAPContext *ic)
+{
+  BOOL result;
+
+  ENTER();
+
+  memset(&ic->newState, 0, sizeof(ic->newState));
+  ic->exists = 0;
+
+  PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_GetStats));
+
+  // the mailbox is opened read-only unless mails are to be deleted
+  result = (SendIMAPCommand(ic, hasServerPurge(ic->msn) ? "SELECT" : "EXAMINE", "INBOX", tr(MSG_ER_BADRESPONSE_IMAP)) != NULL);
+
+  D(DBF_NET, "INBOX has %ld mails, UIDVALIDITY %ld, UIDNEXT %ld", ic->exists, ic->newState.uidValidity, ic->newState.uidNext);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// GetNewMails
+// find the mails which arrived since the last mail check
+static BOOL GetNewMails(struct IMAPContext *ic)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  ic->numMails = 0;
+  ic->totalSize = 0;
+
+  if(ic->oldState.uidValidity != 0 && ic->oldState.uidValidity != ic->newState.uidValidity)
+  {
+    // the UIDs of the last mail check are meaningless now
+    W(DBF_NET, "UIDVALIDITY of IMAP account '%s' changed from %ld to %ld", ic->msn->description, ic->oldState.uidValidity, ic->newState.uidValidity);
+    AppendToLogfile(LF_ALL, 33, tr(MSG_LOG_IMAP_UIDVALIDITY), ic->msn->description);
+
+    ic->firstUID = 1;
+  }
+  else
+    ic->firstUID = MAX(ic->oldState.uidNext, 1);
+
+  if(ic->exists == 0)
+    D(DBF_NET, "INBOX is empty");
+  else if(ic->newState.uidNext != 0 && ic->newState.uidNext <= ic->firstUID)
+    D(DBF_NET, "no new mails since UID %ld", ic->firstUID);
+  else
+  {
+    char args[SIZE_DEFAULT];
+
+    snprintf(args, sizeof(args), "%lu:* (UID RFC822.SIZE)", ic->firstUID);
+
+    ic->listing = TRUE;
+    result = (SendIMAPCommand(ic, "UID FETCH", args, tr(MSG_ER_BADRESPONSE_IMAP)) != NULL);
+    ic->listing = FALSE;
+  }
+
+  D(DBF_NET, "found %ld new mails with %ld bytes", ic->numMails, ic->totalSize);
+
+  if(ic->numMails != 0)
+    AppendToLogfile(LF_VERBOSE, 31, tr(MSG_LOG_CONNECT_IMAP), ic->msn->description, ic->numMails);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// BuildUIDSet
+// build a compact UID set like "1:4,7,9:12" of at most maxMails mails starting
+// at index first, optionally of the downloaded mails only. Returns the index
+// of the first mail not included.
+static ULONG BuildUIDSet(const struct IMAPContext *ic, ULONG first, const ULONG maxMails, const BOOL downloadedOnly, char *set, const size_t setSize)
+{
+  ULONG count = 0;
+  size_t len = 0;
+
+  ENTER();
+
+  set[0] = '\0';
+
+  while(first < ic->numMails && count < maxMails)
+  {
+    if(downloadedOnly == FALSE || ic->mails[first].downloaded == TRUE)
+    {
+      ULONG last = first;
+      char range[SIZE_DEFAULT];
+      int rangeLen;
+
+      // extend the range as long as the UIDs are consecutive
+      while(last + 1 < ic->numMails && count + last + 1 - first < maxMails &&
+            ic->mails[last+1].uid == ic->mails[last].uid + 1 &&
+            (downloadedOnly == FALSE || ic->mails[last+1].downloaded == TRUE))
+      {
+        last++;
+      }
+
+      if(last == first)
+        rangeLen = snprintf(range, sizeof(range), "%s%lu", len != 0 ? "," : "", ic->mails[first].uid);
+      else
+        rangeLen = snprintf(range, sizeof(range), "%s%lu:%lu", len != 0 ? "," : "", ic->mails[first].uid, ic->mails[last].uid);
+
+      // leave the rest for the next set
+      if(len + rangeLen >= setSize)
+        break;
+
+      strlcpy(&set[len], range, setSize - len);
+      len += rangeLen;
+      count += last + 1 - first;
+      first = last + 1;
+    }
+    else
+      first++;
+  }
+
+  RETURN(first);
+  return first;
+}
+
+///
+/// DownloadMails
+// download all new mails
+static void DownloadMails(struct IMAPContext *ic)
+{
+  ULONG next = 0;
+
+  ENTER();
+
+  PushMethodOnStack(ic->transferGroup, 3, MUIM_TransferControlGroup_Start, ic->numMails, ic->totalSize);
+
+  ic->downloading = TRUE;
+  ic->mailIndex = 0;
+
+  while(next < ic->numMails && ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR)
+  {
+    char set[SIZE_LINE-SIZE_DEFAULT];
+
+    // BODY.PEEK[] doesn't set the \Seen flag of the mails
+    next = BuildUIDSet(ic, next, IMAP_FETCH_CHUNK, FALSE, set, sizeof(set));
+    snprintf(ic->lineBuffer, sizeof(ic->lineBuffer), "%s (UID BODY.PEEK[])", set);
+
+    if(SendIMAPCommand(ic, "UID FETCH", ic->lineBuffer, tr(MSG_ER_BADRESPONSE_IMAP)) == NULL)
+      break;
+  }
+
+  ic->downloading = FALSE;
+
+  PushMethodOnStack(ic->transferGroup, 1, MUIM_TransferControlGroup_Finish);
+
+  // update the stats
+  PushMethodOnStack(G->App, 3, MUIM_YAMApplication_DisplayStatistics, ic->incomingFolder, TRUE);
+
+  // update the menu items and toolbars
+  PushMethodOnStack(G->App, 3, MUIM_YAMApplication_ChangeSelected, ic->incomingFolder, TRUE);
+
+  LEAVE();
+}
+
+///
+/// DeleteMails
+// delete the downloaded mails on the server
+static void DeleteMails(struct IMAPContext *ic)
+{
+  ULONG next = 0;
+  BOOL success = TRUE;
+
+  ENTER();
+
+  PushMethodOnStack(ic->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_DeletingServerMail));
+
+  while(success == TRUE && next < ic->numMails)
+  {
+    char set[SIZE_LINE-SIZE_DEFAULT];
+
+    next = BuildUIDSet(ic, next, ic->numMails, TRUE, set, sizeof(set));
+    if(set[0] != '\0')
+    {
+      snprintf(ic->lineBuffer, sizeof(ic->lineBuffer), "%s +FLAGS.SILENT (\\Deleted)", set);
+      success = (SendIMAPCommand(ic, "UID STORE", ic->lineBuffer, tr(MSG_ER_BADRESPONSE_IMAP)) != NULL);
+    }
+  }
+
+  // CLOSE expunges the deleted mails without any further response
+  if(success == TRUE && SendIMAPCommand(ic, "CLOSE", NULL, tr(MSG_ER_BADRESPONSE_IMAP)) != NULL)
+    ic->downloadResult.deleted = ic->downloadResult.downloaded;
+
+  LEAVE();
+}
+
+///
+/// UpdateSyncState
+// remember up to which UID the mails have been downloaded
+static void UpdateSyncState(struct IMAPContext *ic)
+{
+  struct IMAPSyncState state;
+  ULONG i;
+
+  ENTER();
+
+  memcpy(&state, &ic->newState, sizeof(state));
+
+  // without UIDNEXT the UID following the highest known one is used
+  if(state.uidNext == 0)
+    state.uidNext = (ic->numMails != 0) ? ic->mails[ic->numMails-1].uid + 1 : ic->firstUID;
+
+  // a mail which failed to download is tried again next time
+  for(i = 0; i < ic->numMails; i++)
+  {
+    if(ic->mails[i].downloaded == FALSE)
+    {
+      state.uidNext = ic->mails[i].uid;
+      break;
+    }
+  }
+
+  if(memcmp(&state, &ic->oldState, sizeof(state)) != 0)
+    SaveSyncState(ic, &state);
+
+  LEAVE();
+}
+
+///
+
+/**************************************************************************/
+// public functions
+
+/// DeleteIMAPStateFile
+// delete the mail check state in case it is no longer needed, i.e. the account is deleted
+void DeleteIMAPStateFile(const struct MailServerNode *msn)
+{
+  char statePath[SIZE_PATHFILE];
+
+  ENTER();
+
+  BuildStateFilename(msn, statePath, sizeof(statePath));
+
+  if(statePath[0] != '\0' && FileExists(statePath) == TRUE && DeleteFile(statePath) == 0)
+    AddZombieFile(statePath);
+
+  LEAVE();
+}
+
+///
+/// ReceiveMailsIMAP
+// download the new mails of the INBOX of an IMAP4rev1 account (RFC 3501).
+// This is a new-mail fetcher based on UIDNEXT, not a synchronization of the
+// mailbox. Mails below the UIDNEXT of the last check are never looked at
+// again, so their flags and deletions on the server are not reflected locally.
+BOOL ReceiveMailsIMAP(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *dlResult)
+{
+  BOOL success = FALSE;
+  struct IMAPContext *ic;
+
+  ENTER();
+
+  // make sure the mail server node does not vanish
+  ObtainSemaphoreShared(G->configSemaphore);
+
+  if((ic = calloc(1, sizeof(*ic))) != NULL)
+  {
+    ic->msn = msn;
+    ic->flags = flags;
+    // assume an error at first
+    ic->downloadResult.error = TRUE;
+
+    // depending on the incoming folder settings in the
+    // account configuration we store mail either in the
+    // folder configured there or in the default incoming folder
+    if(ic->msn->mailStoreFolderID == 0 ||
+       (ic->incomingFolder = FindFolderByID(G->folders, ic->msn->mailStoreFolderID)) == NULL)
+    {
+      ic->incomingFolder = FO_GetFolderByType(FT_INCOMING, NULL);
+    }
+
+    if(ic->incomingFolder != NULL)
+    {
+      // try to open the TCP/IP stack
+      if((ic->connection = CreateConnection(TRUE)) != NULL && ConnectionIsOnline(ic->connection) == TRUE)
+      {
+        ULONG twFlags;
+
+        // copy a link to the mailservernode for which we created
+        // the connection
+        ic->connection->server = ic->msn;
+
+        strlcpy(ic->password, msn->password, sizeof(ic->password));
+        snprintf(ic->transferGroupTitle, sizeof(ic->transferGroupTitle), tr(MSG_TR_MAILCHECKFROM), msn->description);
+
+        twFlags = TWF_ACTIVATE;
+        if(isFlagSet(ic->flags, RECEIVEF_USER))
+          setFlag(twFlags, TWF_OPEN);
+
+        if((ic->transferGroup = (Object *)PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_CreateTransferGroup, CurrentThread(), ic->transferGroupTitle, ic->connection, twFlags)) != NULL)
+        {
+          // wait until the connection limits permit another session
+          if(ObtainConnectionSlot(ic->msn) == TRUE)
+          {
+            if(ConnectToIMAP(ic) == TRUE)
+            {
+              // connection succeeded
+              success = TRUE;
+
+              if(isFlagClear(flags, RECEIVEF_TEST_CONNECTION))
+              {
+                LoadSyncState(ic);
+
+                if(SelectInbox(ic) == TRUE && GetNewMails(ic) == TRUE)
+                {
+                  ic->downloadResult.onServer = ic->exists;
+
+                  if(ic->numMails != 0 && ThreadWasAborted() == FALSE)
+                  {
+                    DownloadMails(ic);
+
+                    if(hasServerPurge(ic->msn) && ic->downloadResult.downloaded > 0)
+                      DeleteMails(ic);
+                  }
+
+                  UpdateSyncState(ic);
+
+                  if(ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR)
+                    ic->downloadResult.error = FALSE;
+                }
+              }
+              else if(ic->connection->abort == FALSE && ic->connection->error == CONNECTERR_NO_ERROR)
+                ic->downloadResult.error = FALSE;
+            }
+
+            // disconnect no matter if the connect operation succeeded or not
+            DisconnectFromIMAP(ic);
+
+            ReleaseConnectionSlot(ic->msn);
+          }
+
+          PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DeleteTransferGroup, ic->transferGroup);
+        }
+
+        // perform the finalizing actions only if we haven't been aborted externally
+        if(ThreadWasAborted() == FALSE)
+        {
+          AppendToLogfile(LF_ALL, 30, tr(MSG_LOG_RETRIEVED_IMAP), ic->downloadResult.downloaded, msn->description);
+
+          FinishMailCheck(ic->msn, ic->flags, &ic->downloadResult, &ic->filterResult);
+        }
+        else
+        {
+          // signal failure
+          success = FALSE;
+        }
+      }
+
+      DeleteConnection(ic->connection);
+    }
+    else
+    {
+      E(DBF_FOLDER, "could not resolve incoming folder of IMAP server '%s'", ic->msn->description);
+    }
+
+    // finally copy the download stats of this operation if someone is interested in them
+    if(dlResult != NULL)
+      memcpy(dlResult, &ic->downloadResult, sizeof(*dlResult));
+
+    free(ic->mails);
+    free(ic);
+  }
+
+  // mark the server as being no longer "in use"
+  LockMailServer(msn);
+  msn->useCount--;
+  UnlockMailServer(msn);
+
+  // now we are done
+  ReleaseSemaphore(G->configSemaphore);
+
+  // wake up the calling thread if this is requested
+  if(isFlagSet(flags, RECEIVEF_SIGNAL))
+    WakeupThread(NULL);
+
+  RETURN(success);
+  return success;
+}
+
+///
@@ -25,6 +25,7 @@
 
 ***************************************************************************/
 
+#include <ctype.h>
 #include <string.h>
 
 #include <mui/NList_mcc.h>
@@ -84,7 +85,7 @@ enum POPCommand
   POPCMD_UIDL,
 
   // POP3 extended commands
-  POPCMD_STLS
+  POPCMD_STLS, POPCMD_CAPA
 };
 
 static const char *const POPcmd[] =
@@ -95,7 +96,7 @@ static const char *const POPcmd[] =
   "UIDL",
 
   // POP3 extended commands
-  "STLS"
+  "STLS", "CAPA"
 };
 
 // POP responses
@@ -105,6 +106,36 @@ static const char *const POPcmd[] =
 /**************************************************************************/
 // local macros & defines
 
+// the maximum number of commands sent ahead without waiting for their
+// responses, if the server supports pipelining (RFC 2449)
+#define POP3_PIPELINE_DEPTH 16
+
+// a command sent to the server whose response is still pending
+struct POP3Request
+{
+  enum POPCommand command;
+  struct MailTransferNode *tnode;        // the mail the command refers to
+};
+
+// the pending commands, their responses will arrive in the same order
+struct POP3Pipeline
+{
+  struct POP3Request requests[POP3_PIPELINE_DEPTH];
+  ULONG first;                           // the oldest pending request
+  ULONG count;                           // the number of pending requests
+  ULONG depth;                           // the maximum number of pending requests
+};
+
+// the states of ReceiveToFile() at the end of a received block
+enum ReceiveState
+{
+  RS_LINESTART=0,                        // at the start of a line
+  RS_DOT,                                // after a dot at the start of a line
+  RS_DOTCR,                              // after ".\r" at the start of a line
+  RS_CR,                                 // after a "\r" within a line
+  RS_TEXT                                // within a line
+};
+
 struct TransferContext
 {
   struct Connection *connection;
@@ -126,6 +157,10 @@ struct TransferContext
   struct MailTransferNode *firstPreselect;
   struct Folder *incomingFolder;         // the folder to place the downloaded mails into
   BOOL useTLS;
+  struct POP3Pipeline pipeline;          // commands sent ahead to the server
+  char *detailsBuffer;                   // the received TOP response
+  size_t detailsLength;                  // the length of the received TOP response
+  size_t detailsSize;                    // the allocated size of the details buffer
   struct DownloadResult downloadResult;
   struct FilterResult filterResult;
   int numberOfMailsTotal;
@@ -140,10 +175,36 @@ struct TransferContext
 static void ApplyRemoteFilters(struct TransferContext *tc, struct MailTransferNode *tnode)
 {
   struct FilterNode *filter;
+  struct TempFile *tf = NULL;
 
   ENTER();
 
   D(DBF_NET, "apply remote filters, from='%s', to='%s', subject='%s'", tnode->mail->From.Address, tnode->mail->To.Address, tnode->mail->Subject);
+
+  // the message details are kept in memory only, but some filters need
+  // to read the mail file. In this case we write the received TOP
+  // response to a temporary file.
+  if(FilterListNeedsMailFile(tc->remoteFilters, tnode->mail) == TRUE)
+  {
+    if((tf = OpenTempFile("w")) != NULL)
+    {
+      BOOL written = FALSE;
+
+      if(fwrite(tc->detailsBuffer, 1, tc->detailsLength, tf->FP) == tc->detailsLength)
+        written = TRUE;
+
+      fclose(tf->FP);
+      tf->FP = NULL;
+
+      if(written == TRUE)
+        strlcpy(tnode->mail->MailFile, FilePart(tf->Filename), sizeof(tnode->mail->MailFile));
+      else
+        ER_NewError(tr(MSG_ER_ErrorWriteMailfile), tf->Filename);
+    }
+    else
+      ER_NewError(tr(MSG_ER_CantCreateTempfile));
+  }
+
   IterateList(tc->remoteFilters, struct FilterNode *, filter)
   {
     if(DoFilterSearch(filter, tnode->mail) == TRUE)
@@ -172,12 +233,79 @@ static void ApplyRemoteFilters(struct TransferContext *tc, struct MailTransferNo
   // remember that the remote filters have been applied for this mail already
   setFlag(tnode->tflags, TRF_REMOTE_FILTER_APPLIED);
 
+  if(tf != NULL)
+  {
+    tnode->mail->MailFile[0] = '\0';
+    CloseTempFile(tf);
+  }
+
   LEAVE();
 }
 
+///
+/// GetPOP3Response
+//  Receives the status line of the POP3 server's response to a command
+static char *GetPOP3Response(struct TransferContext *tc, const enum POPCommand command, const char *errorMsg)
+{
+  char *result = NULL;
+  int received;
+
+  ENTER();
+
+  // let us read the next line from the server and check if
+  // some status message can be retrieved.
+  if((received = ReceiveLineFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) > 0)
+  {
+    D(DBF_NET, "received POP3 answer '%s'", tc->pop3Buffer);
+
+    if(strncmp(tc->pop3Buffer, POP_RESP_OKAY, strlen(POP_RESP_OKAY)) == 0)
+    {
+      // everything worked out fine so lets set
+      // the result to our allocated buffer
+      result = tc->pop3Buffer;
+    }
+  }
+
+  if(result == NULL)
+  {
+    BOOL showError;
+
+    // don't show an error message for a failed QUIT command with no answer at all
+    if(command == POPCMD_QUIT && received == -1)
+      showError = FALSE;
+    else
+      showError = TRUE;
+
+    // only report an error if explicitly wanted
+    if(showError == TRUE && errorMsg != NULL)
+    {
+      // if we just issued a PASS command and that failed, then overwrite the visible
+      // password with X chars now, so that nobody else can read your password
+      if(command == POPCMD_PASS)
+      {
+        char *p;
+
+        // find the beginning of the password
+        if((p = strstr(tc->pop3Buffer, POPcmd[POPCMD_PASS])) != NULL &&
+           (p = strchr(p, ' ')) != NULL)
+        {
+          // now cross it out
+          while(*p != '\0' && *p != ' ' && *p != '\n' && *p != '\r')
+            *p++ = 'X';
+        }
+      }
+
+      ER_NewError(errorMsg, tc->msn->hostname, tc->msn->description, (char *)POPcmd[command], tc->pop3Buffer);
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// SendPOP3Command
-//  Sends a command to the POP3 server
+//  Sends a command to the POP3 server and waits for the response
 static char *SendPOP3Command(struct TransferContext *tc, const enum POPCommand command, const char *parmtext, const char *errorMsg)
 {
   char *result = NULL;
@@ -196,244 +324,305 @@ static char *SendPOP3Command(struct TransferContext *tc, const enum POPCommand c
   // and for a connect we don't send something or the server will get
   // confused.
   if(command == POPCMD_CONNECT || SendLineToHost(tc->connection, tc->pop3Buffer) > 0)
+    result = GetPOP3Response(tc, command, errorMsg);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// SendPOP3Request
+//  Sends a command concerning a single mail to the POP3 server without waiting
+//  for the response. The command is only buffered, the caller must flush the
+//  connection before waiting for the response. Returns FALSE if the pipeline
+//  is full already or if the command could not be sent.
+static BOOL SendPOP3Request(struct TransferContext *tc, const enum POPCommand command, struct MailTransferNode *tnode, const char *parmtext)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(tc->pipeline.count < tc->pipeline.depth)
   {
-    int received;
+    snprintf(tc->pop3Buffer, sizeof(tc->pop3Buffer), "%s %s\r\n", POPcmd[command], parmtext);
+
+    D(DBF_NET, "send POP3 cmd '%s' with param '%s', %ld commands pending", POPcmd[command], parmtext, tc->pipeline.count);
 
-    // let us read the next line from the server and check if
-    // some status message can be retrieved.
-    if((received = ReceiveLineFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) > 0)
+    if(SendToHost(tc->connection, tc->pop3Buffer, strlen(tc->pop3Buffer), TCPF_NONE) > 0)
     {
-      D(DBF_NET, "received POP3 answer '%s'", tc->pop3Buffer);
+      struct POP3Request *request = &tc->pipeline.requests[(tc->pipeline.first + tc->pipeline.count) % POP3_PIPELINE_DEPTH];
 
-      if(strncmp(tc->pop3Buffer, POP_RESP_OKAY, strlen(POP_RESP_OKAY)) == 0)
-      {
-        // everything worked out fine so lets set
-        // the result to our allocated buffer
-        result = tc->pop3Buffer;
-      }
+      // remember the command, its response will be received after the
+      // responses of all previously sent commands
+      request->command = command;
+      request->tnode = tnode;
+      tc->pipeline.count++;
+
+      result = TRUE;
     }
+  }
 
-    if(result == NULL)
-    {
-      BOOL showError;
+  RETURN(result);
+  return result;
+}
 
-      // don't show an error message for a failed QUIT command with no answer at all
-      if(command == POPCMD_QUIT && received == -1)
-        showError = FALSE;
-      else
-        showError = TRUE;
+///
+/// NextPOP3Request
+//  Returns the oldest pending command, the next response to be received belongs
+//  to this one
+static struct POP3Request *NextPOP3Request(struct TransferContext *tc)
+{
+  struct POP3Request *request = NULL;
 
-      // only report an error if explicitly wanted
-      if(showError == TRUE && errorMsg != NULL)
-      {
-        // if we just issued a PASS command and that failed, then overwrite the visible
-        // password with X chars now, so that nobody else can read your password
-        if(command == POPCMD_PASS)
-        {
-          char *p;
+  ENTER();
 
-          // find the beginning of the password
-          if((p = strstr(tc->pop3Buffer, POPcmd[POPCMD_PASS])) != NULL &&
-             (p = strchr(p, ' ')) != NULL)
-          {
-            // now cross it out
-            while(*p != '\0' && *p != ' ' && *p != '\n' && *p != '\r')
-              *p++ = 'X';
-          }
-        }
+  if(tc->pipeline.count != 0)
+    request = &tc->pipeline.requests[tc->pipeline.first];
 
-        ER_NewError(errorMsg, tc->msn->hostname, tc->msn->description, (char *)POPcmd[command], tc->pop3Buffer);
-      }
-    }
+  RETURN(request);
+  return request;
+}
+
+///
+/// ReceivePOP3Response
+//  Receives the status line of the response to the oldest pending command
+static char *ReceivePOP3Response(struct TransferContext *tc, const char *errorMsg)
+{
+  char *result = NULL;
+
+  ENTER();
+
+  if(tc->pipeline.count != 0)
+  {
+    enum POPCommand command = tc->pipeline.requests[tc->pipeline.first].command;
+
+    // this command is no longer pending
+    tc->pipeline.first = (tc->pipeline.first + 1) % POP3_PIPELINE_DEPTH;
+    tc->pipeline.count--;
+
+    result = GetPOP3Response(tc, command, errorMsg);
   }
+  else
+    E(DBF_NET, "no pending POP3 command");
 
   RETURN(result);
   return result;
 }
 
+///
+/// StoreReceivedData
+// write received data to a file or, if no file is given, append it to the
+// memory buffer for the message details
+static BOOL StoreReceivedData(struct TransferContext *tc, FILE *fh, const char *data, const size_t len)
+{
+  BOOL success = FALSE;
+
+  ENTER();
+
+  if(fh != NULL)
+  {
+    if(fwrite(data, 1, len, fh) == len)
+      success = TRUE;
+  }
+  else
+  {
+    if(tc->detailsLength + len > tc->detailsSize)
+    {
+      size_t newSize = (tc->detailsSize == 0) ? SIZE_LARGE : tc->detailsSize * 2;
+      char *newBuffer;
+
+      while(newSize < tc->detailsLength + len)
+        newSize *= 2;
+
+      if((newBuffer = realloc(tc->detailsBuffer, newSize)) != NULL)
+      {
+        tc->detailsBuffer = newBuffer;
+        tc->detailsSize = newSize;
+      }
+    }
+
+    if(tc->detailsLength + len <= tc->detailsSize)
+    {
+      memcpy(&tc->detailsBuffer[tc->detailsLength], data, len);
+      tc->detailsLength += len;
+      success = TRUE;
+    }
+    else
+      E(DBF_NET, "failed to enlarge the details buffer to %ld bytes", tc->detailsLength + len);
+  }
+
+  RETURN(success);
+  return success;
+}
+
 ///
 /// ReceiveToFile
+// receive a multi line response and write it to a file, or to the memory
+// buffer for the message details if no file is given. The data is processed
+// in blocks right within the connection's receive buffer: whole lines are
+// located by memchr() and written at once, "\r\n" line endings become "\n",
+// dot-stuffed lines are unstuffed and "\r\n.\r\n" terminates the response.
 static int ReceiveToFile(struct TransferContext *tc, FILE *fh, const char *filename, const BOOL isTemp)
 {
-  int count;
-  int l=0, read, state=0;
+  int count = 0;
+  enum ReceiveState state = RS_LINESTART;
   BOOL error = FALSE;
   BOOL done = FALSE;
-  char *lineptr = tc->lineBuffer;
 
   ENTER();
 
-  // get the first data the pop server returns after the TOP command
-  if((read = count = ReceiveFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) <= 0)
-    tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
-  else
-  {
-    // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
-    // mark through which mail account this mail was received.
+  // the first line we write out to our mail file is a X-YAM-MailAccount: header in which we
+  // mark through which mail account this mail was received.
+  if(fh != NULL)
     fprintf(fh, "X-YAM-MailAccount: %s@%s\n", tc->msn->username, tc->msn->hostname);
-  }
 
-  while(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+  while(done == FALSE && error == FALSE && tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
   {
-    char *bufptr;
+    char *data;
+    char *ptr;
+    char *end;
+    int read;
 
-    // now we iterate through the received string
-    // and strip out the '\r' character.
-    // we iterate through it because the strings we receive
-    // from the socket can be splitted somehow.
-    for(bufptr = tc->pop3Buffer; read > 0; bufptr++, read--)
+    // get the next block of data the pop server returns
+    if((read = PeekFromHost(tc->connection, &data)) <= 0)
     {
-      // first we check if our buffer is full and if so we
-      // write it to the file.
-      if(l == sizeof(tc->lineBuffer) || done == TRUE)
-      {
-        // update the transfer status during the final download
-        if(isTemp == FALSE)
-          PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, l, tr(MSG_TR_Downloading));
+      if(tc->connection->error == CONNECTERR_NO_ERROR)
+        tc->connection->error = CONNECTERR_UNKNOWN_ERROR;
 
-        // write the line to the file now
-        if(fwrite(tc->lineBuffer, 1, l, fh) != (size_t)l)
-        {
-          error = TRUE;
-          ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
-          break;
-        }
-
-        // if we end up here and done is true we have to break that iteration
-        if(done == TRUE)
-          break;
+      break;
+    }
 
-        // set l to zero so that the next char gets written to the beginning
-        l = 0;
-        lineptr = tc->lineBuffer;
-      }
+    ptr = data;
+    end = data + read;
 
-      // we have to analyze different states because we iterate through our
-      // received buffer char by char.
+    while(ptr < end && done == FALSE && error == FALSE)
+    {
       switch(state)
       {
-        // stat==1 is only reached if a "\r" was found previously
-        case 1:
+        // a new line starts, check for a leading dot
+        case RS_LINESTART:
         {
-          // if we previously found a \r and the actual char is not a \n, then
-          // we write the \r in the buffer and iterate to the next char.
-          if(*bufptr != '\n')
+          if(*ptr == '.')
           {
-            *lineptr++ = '\r';
-            l++;
-            read++;
-            bufptr--;
-            state = 0;
-
-            continue;
+            ptr++;
+            state = RS_DOT;
           }
-
-          // write the actual char "\n" in the line buffer
-          *lineptr++ = *bufptr;
-          l++;
-
-          state = 2; // we found a "\r\n" so we move to stat 2 on the next iteration.
-          continue;
+          else
+            state = RS_TEXT;
         }
         break;
 
-        // stat==2 is only reached if we previously found a "\r\n"
-        // stat==5 if we found a lonely "\n"
-        case 2:
-        case 5:
+        // a line started with a dot
+        case RS_DOT:
         {
-          if(*bufptr == '.')
+          if(*ptr == '\r')
           {
-            state++; // now it's 3 or 6
-            continue;
+            // this may be the termination line
+            ptr++;
+            state = RS_DOTCR;
           }
+          else
+          {
+            // (RFC 1939) - the server sends ".." for a line starting with "."
+            // and we drop the first dot. Otherwise the dot is kept.
+            if(*ptr != '.')
+              error = (StoreReceivedData(tc, fh, ".", 1) == FALSE);
 
-          state = 0;
+            state = RS_TEXT;
+          }
         }
         break;
 
-        // stat==3 is only reached if we previously found a "\r\n."
-        // stat==6 if we found a lonely "\n."
-        case 3:
-        case 6:
+        // a line started with ".\r"
+        case RS_DOTCR:
         {
-          if(state == 3 && *bufptr == '\r')
+          if(*ptr == '\n')
           {
-            state = 4; // we found a \r directly after a "\r\n.", so it can be the start of a TERM
+            // so if we end up here we finally found our termination line "\r\n.\r\n".
+            // Anything following it already belongs to the response of the next
+            // pipelined command and stays in the receive buffer.
+            ptr++;
+            done = TRUE;
           }
-          else if(*bufptr == '.')
+          else
           {
-            // (RFC 1939) - the server handles "." as "..", so we only write "."
-            *lineptr++ = '.';
-            l++;
-            state = 0;
+            error = (StoreReceivedData(tc, fh, ".", 1) == FALSE);
+            state = RS_CR;
+          }
+        }
+        break;
+
+        // the previous block ended with a "\r"
+        case RS_CR:
+        {
+          if(*ptr == '\n')
+          {
+            error = (StoreReceivedData(tc, fh, "\n", 1) == FALSE);
+            ptr++;
+            state = RS_LINESTART;
           }
           else
           {
-            // write the actual char in the line buffer
-            *lineptr++ = '.';
-            l++;
-            read++;
-            bufptr--;
-            state = 0;
+            // a lonely "\r" is kept
+            error = (StoreReceivedData(tc, fh, "\r", 1) == FALSE);
+            state = RS_TEXT;
           }
-
-          continue;
         }
         break;
 
-        // stat==4 is only reached if we previsouly found a "\r\n.\r"
-        case 4:
+        // the text of a line, write everything up to the end of the line at once
+        case RS_TEXT:
         {
-          if(*bufptr != '\n')
+          char *eol;
+
+          if((eol = memchr(ptr, '\n', end - ptr)) != NULL)
           {
-            *lineptr++ = '.';
-            l++;
-            read += 2;
-            bufptr -= 2;
-            state = 0;
+            // convert a "\r\n" line ending to "\n" in place, we are allowed
+            // to modify the data we are going to consume
+            if(eol > ptr && eol[-1] == '\r')
+            {
+              eol[-1] = '\n';
+              error = (StoreReceivedData(tc, fh, ptr, eol - ptr) == FALSE);
+            }
+            else
+              error = (StoreReceivedData(tc, fh, ptr, eol + 1 - ptr) == FALSE);
 
-            continue;
+            ptr = eol + 1;
+            state = RS_LINESTART;
           }
+          else
+          {
+            // the line continues in the next block, a trailing "\r" might
+            // be the first half of the line ending
+            if(end[-1] == '\r')
+            {
+              if(end - 1 > ptr)
+                error = (StoreReceivedData(tc, fh, ptr, end - 1 - ptr) == FALSE);
 
-          // so if we end up here we finally found our termination line "\r\n.\r\n"
-          // and make sure the buffer is written before we break out here.
-          read = 2;
-          done = TRUE;
+              state = RS_CR;
+            }
+            else
+              error = (StoreReceivedData(tc, fh, ptr, end - ptr) == FALSE);
 
-          continue;
+            ptr = end;
+          }
         }
         break;
       }
-
-      // if we find a \r we set the stat to 1 and check on the next iteration if
-      // the following char is a \n and if so we have to strip it out.
-      if(*bufptr == '\r')
-      {
-        state = 1;
-        continue;
-      }
-      else if(*bufptr == '\n')
-      {
-        state=5;
-      }
-
-      // write the actual char in the line buffer
-      *lineptr++ = *bufptr;
-      l++;
     }
 
-    // if we received the term octet we can exit the while loop now
-    if(done == TRUE || error == TRUE || tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
-      break;
-
-    // if not, we get another bunch of data and start over again.
-    if((read = ReceiveFromHost(tc->connection, tc->pop3Buffer, sizeof(tc->pop3Buffer))) <= 0)
-      break;
+    // tell the connection how much of the block has been processed
+    ConsumeFromHost(tc->connection, ptr - data);
+    count += ptr - data;
 
-    count += read;
+    // update the transfer status during the final download
+    if(isTemp == FALSE)
+      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, ptr - data, tr(MSG_TR_Downloading), tc->connection->minRTT, GetConnectionThroughput(tc->connection));
   }
 
+  if(error == TRUE && fh != NULL)
+    ER_NewError(tr(MSG_ER_ErrorWriteMailfile), filename);
+
   if(done == FALSE || error == TRUE)
     count = 0;
 
@@ -598,80 +787,89 @@ static BOOL GetMessageList(struct TransferContext *tc)
   return success;
 }
 
+///
+/// RequestMessageDetails
+//  Sends the TOP command to obtain the header of a message without waiting for
+//  the response. Returns TRUE if the command was sent.
+static BOOL RequestMessageDetails(struct TransferContext *tc, struct MailTransferNode *tnode)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(isFlagClear(tnode->tflags, TRF_GOT_DETAILS) && IsStrEmpty(tnode->mail->From.Address) &&
+     tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+  {
+    char cmdbuf[SIZE_SMALL];
+
+    // we issue a TOP command with a one line message body.
+    snprintf(cmdbuf, sizeof(cmdbuf), "%d 1", tnode->index);
+    result = SendPOP3Request(tc, POPCMD_TOP, tnode, cmdbuf);
+  }
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// GetSingleMessageDetails
 //  Gets header from a message stored on the POP3 server
 static void GetSingleMessageDetails(struct TransferContext *tc, struct MailTransferNode *tnode, int lline)
 {
   struct Mail *mail = tnode->mail;
+  struct POP3Request *request;
 
   ENTER();
 
   D(DBF_NET, "get details for mail %ld", lline);
 
-  if(IsStrEmpty(mail->From.Address) &&
-     tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+  // request the details now, unless the TOP command has been sent ahead already
+  if((request = NextPOP3Request(tc)) == NULL && RequestMessageDetails(tc, tnode) == TRUE)
   {
-    char cmdbuf[SIZE_SMALL];
+    FlushConnection(tc->connection);
+    request = NextPOP3Request(tc);
+  }
 
-    // we issue a TOP command with a one line message body.
-    //
-    // This command is optional within the RFC 1939 specification
+  if(request != NULL && request->tnode == tnode)
+  {
+    // The TOP command is optional within the RFC 1939 specification
     // and therefore we don't throw any error
-    snprintf(cmdbuf, sizeof(cmdbuf), "%d 1", tnode->index);
-    if(SendPOP3Command(tc, POPCMD_TOP, cmdbuf, NULL) != NULL)
+    if(ReceivePOP3Response(tc, NULL) != NULL)
     {
-      struct TempFile *tf;
+      struct ExtendedMail *email;
 
-      // we generate a temporary file to buffer the TOP list into
-      if((tf = OpenTempFile("w")) != NULL)
+      // now we call a subfunction to receive data from the POP3 server into
+      // memory as long as there is no termination \r\n.\r\n. The header lines
+      // are parsed right from there without bothering the file system.
+      // If we end up here because of an error, abort or the upper loop wasn't
+      // finished we exit immediatly.
+      tc->detailsLength = 0;
+      if(ReceiveToFile(tc, NULL, NULL, TRUE) <= 0 || tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
       {
-        struct ExtendedMail *email;
-        BOOL done = FALSE;
-
-        // now we call a subfunction to receive data from the POP3 server
-        // and write it in the filehandle as long as there is no termination \r\n.\r\n
-        if(ReceiveToFile(tc, tf->FP, tf->Filename, TRUE) > 0)
-          done = TRUE;
-
-        // close the filehandle now
-        fclose(tf->FP);
-        tf->FP = NULL;
-
-        // If we end up here because of an error, abort or the upper loop wasn't finished
-        // we exit immediatly with deleting the temp file also.
-        if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR || done == FALSE)
-        {
-          lline = -1;
-        }
-        else if((email = MA_ExamineMail(NULL, FilePart(tf->Filename), TRUE)) != NULL)
-        {
-          memcpy(&mail->From, &email->Mail.From, sizeof(mail->From));
-          memcpy(&mail->To, &email->Mail.To, sizeof(mail->To));
-          memcpy(&mail->ReplyTo, &email->Mail.ReplyTo, sizeof(mail->ReplyTo));
-          strlcpy(mail->Subject, email->Mail.Subject, sizeof(mail->Subject));
-          strlcpy(mail->MailFile, email->Mail.MailFile, sizeof(mail->MailFile));
-          memcpy(&mail->Date, &email->Mail.Date, sizeof(mail->Date));
-
-          // if this function was called with -1, then the POP3 server
-          // doesn't have the UIDL command and we have to generate our
-          // own one by using the MsgID.
-          if(lline == -1)
-            tnode->uidl = strdup(email->messageID);
-
-          // apply possible remote filters
-          if(isFlagClear(tnode->tflags, TRF_REMOTE_FILTER_APPLIED) && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
-            ApplyRemoteFilters(tc, tnode);
-
-          MA_FreeEMailStruct(email);
-        }
-        else
-          E(DBF_NET, "couldn't examine mail file '%s'", tf->Filename);
+        lline = -1;
+      }
+      else if((email = MA_ExamineMailBuffer(tc->msn->hostname, tc->detailsBuffer, tc->detailsLength, TRUE)) != NULL)
+      {
+        SetMailPerson(&mail->From, email->Mail.From.Address, email->Mail.From.RealName);
+        SetMailPerson(&mail->To, email->Mail.To.Address, email->Mail.To.RealName);
+        SetMailPerson(&mail->ReplyTo, email->Mail.ReplyTo.Address, email->Mail.ReplyTo.RealName);
+        SetMailSubject(mail, email->Mail.Subject);
+        memcpy(&mail->Date, &email->Mail.Date, sizeof(mail->Date));
+
+        // if this function was called with -1, then the POP3 server
+        // doesn't have the UIDL command and we have to generate our
+        // own one by using the MsgID.
+        if(lline == -1)
+          tnode->uidl = strdup(email->messageID);
+
+        // apply possible remote filters
+        if(isFlagClear(tnode->tflags, TRF_REMOTE_FILTER_APPLIED) && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
+          ApplyRemoteFilters(tc, tnode);
 
-        CloseTempFile(tf);
+        MA_FreeEMailStruct(email);
       }
       else
-        ER_NewError(tr(MSG_ER_CantCreateTempfile));
+        E(DBF_NET, "couldn't examine details of mail %ld", tnode->index);
     }
   }
 
@@ -764,13 +962,32 @@ static int GetAllMessageDetails(struct TransferContext *tc, BOOL remoteFilters)
 
     if(tnode != NULL)
     {
+      struct MailTransferNode *sendNode = tnode;
+
       D(DBF_NET, "pass %ld start at mail %ld", pass, tnode->index-1);
 
       // get all message details until the end of the list
       do
       {
+        BOOL sent = FALSE;
+
+        // keep the pipeline filled with TOP commands for the following mails,
+        // but don't request anything new if we are going to bail out
+        while(success == 1 && sendNode != NULL && tc->pipeline.count < tc->pipeline.depth)
+        {
+          if(RequestMessageDetails(tc, sendNode) == TRUE)
+            sent = TRUE;
+
+          sendNode = NextMailTransferNode(sendNode);
+        }
+
+        if(sent == TRUE)
+          FlushConnection(tc->connection);
+
         // get the message details only if this has not been done before already
-        if(isFlagClear(tnode->tflags, TRF_GOT_DETAILS))
+        // and only those which have been requested already if we are going to
+        // bail out
+        if(isFlagClear(tnode->tflags, TRF_GOT_DETAILS) && (success == 1 || NextPOP3Request(tc) != NULL))
         {
           GetSingleMessageDetails(tc, tnode, tnode->index-1);
 
@@ -780,12 +997,15 @@ static int GetAllMessageDetails(struct TransferContext *tc, BOOL remoteFilters)
             PushMethodOnStack(tc->preselectWindow, 3, MUIM_Set, MUIA_PreselectionWindow_Progress, handledMails);
         }
 
-        if((success = CheckAbort(tc)) != 1)
-        {
-          // bail out completely
-          tnode = NULL;
+        // bail out completely, but not before all pending responses have been
+        // received, otherwise they would be mistaken as responses to later commands
+        if(success == 1 && (success = CheckAbort(tc)) != 1)
           pass = 3;
-        }
+
+        if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
+          tnode = NULL;
+        else if(success != 1 && NextPOP3Request(tc) == NULL)
+          tnode = NULL;
         else
         {
           // continue with the next mail
@@ -972,6 +1192,36 @@ static BOOL FilterDuplicates(struct TransferContext *tc)
   return result;
 }
 
+///
+/// GetCapabilities
+// ask the server for its capabilities (RFC 2449), currently we are only
+// interested in whether it accepts pipelined commands
+static void GetCapabilities(struct TransferContext *tc)
+{
+  ENTER();
+
+  // without pipelining we must wait for each response before sending the next command
+  tc->pipeline.first = 0;
+  tc->pipeline.count = 0;
+  tc->pipeline.depth = 1;
+
+  // CAPA is optional, so we don't throw any error if the server doesn't know it
+  if(SendPOP3Command(tc, POPCMD_CAPA, NULL, NULL) != NULL)
+  {
+    // the capabilities are listed one per line until the termination octet
+    while(ReceiveLineFromHost(tc->connection, tc->lineBuffer, sizeof(tc->lineBuffer)) > 0 &&
+          strncmp(tc->lineBuffer, ".\r\n", 3) != 0)
+    {
+      if(strnicmp(tc->lineBuffer, "PIPELINING", 10) == 0 && isspace(tc->lineBuffer[10]) != 0)
+        tc->pipeline.depth = POP3_PIPELINE_DEPTH;
+    }
+  }
+
+  D(DBF_NET, "POP3 server '%s' accepts %ld pipelined commands", tc->msn->hostname, tc->pipeline.depth);
+
+  LEAVE();
+}
+
 ///
 /// ConnectToPOP3
 //  Connects to a POP3 mail server
@@ -1171,6 +1421,9 @@ static int ConnectToPOP3(struct TransferContext *tc)
       goto out;
   }
 
+  // find out whether we may pipeline our commands
+  GetCapabilities(tc);
+
   PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_GetStats));
   if((resp = SendPOP3Command(tc, POPCMD_STAT, NULL, tr(MSG_ER_BADRESPONSE_POP3))) == NULL)
     goto out;
@@ -1213,9 +1466,89 @@ static void DisconnectFromPOP3(struct TransferContext *tc)
   LEAVE();
 }
 
+///
+/// AddDownloadedMail
+// add a freshly downloaded mail file to the incoming folder and remember it
+// for the final filtering and notification, this is shared with the IMAP code
+BOOL AddDownloadedMail(struct MailServerNode *msn, struct Folder *inFolder, const char *msgfile)
+{
+  BOOL result = FALSE;
+  struct ExtendedMail *email;
+
+  ENTER();
+
+  if((email = MA_ExamineMail(inFolder, FilePart(msgfile), FALSE)) != NULL)
+  {
+    struct Mail *mail;
+
+    if((mail = CloneMail(&email->Mail)) != NULL)
+    {
+      AddMailToFolder(mail, inFolder);
+
+      // we have to get the actual Time and place it in the transDate, so that we know at
+      // which time this mail arrived
+      GetSysTimeUTC(&mail->transDate);
+
+      mail->sflags = SFLAG_NEW;
+      MA_UpdateMailFile(mail);
+
+      D(DBF_NET, "adding mail to downloaded list");
+      // add the mail to the list of downloaded mails
+      LockMailList(msn->downloadedMails);
+      AddNewMailNode(msn->downloadedMails, mail);
+      UnlockMailList(msn->downloadedMails);
+
+      // if the current folder is the inbox we can go and add the mail instantly to the maillist
+      if(inFolder == GetCurrentFolder())
+        PushMethodOnStack(G->MA->GUI.PG_MAILLIST, 3, MUIM_NList_InsertSingle, mail, MUIV_NList_Insert_Sorted);
+
+      AppendToLogfile(LF_VERBOSE, 32, tr(MSG_LOG_RetrievingVerbose), AddrName(mail->From), mail->Subject, mail->Size);
+
+      PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_NEWMSG, msgfile);
+
+      result = TRUE;
+    }
+
+    MA_FreeEMailStruct(email);
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// FinishMailCheck
+// perform the final actions after mails have been downloaded: start the
+// POSTGET macro, filter the new mails and notify the user about them
+void FinishMailCheck(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *downloadResult, struct FilterResult *filterResult)
+{
+  char downloadedStr[SIZE_SMALL];
+
+  ENTER();
+
+  snprintf(downloadedStr, sizeof(downloadedStr), "%d", (int)downloadResult->downloaded);
+  PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_POSTGET, downloadedStr);
+
+  // we only apply the filters if we downloaded something, or it's wasted
+  D(DBF_NET, "filter %ld downloaded mails", downloadResult->downloaded);
+  if(downloadResult->downloaded > 0)
+  {
+    PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterNewMails, msn->downloadedMails, filterResult);
+    PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_NewMailAlert, msn, downloadResult, filterResult, flags);
+  }
+
+  // forget about the downloaded mails again
+  LockMailList(msn->downloadedMails);
+  ClearMailList(msn->downloadedMails);
+  UnlockMailList(msn->downloadedMails);
+
+  LEAVE();
+}
+
 ///
 /// LoadMessage
-static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder, const int number)
+// receive a mail whose RETR command is the oldest pending one
+static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder)
 {
   BOOL result = FALSE;
   char msgfile[SIZE_PATHFILE];
@@ -1223,19 +1556,24 @@ static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder, con
 
   ENTER();
 
+  // the mails of several accounts may be stored in the same folder at the
+  // same time, hence the new mail file must be created before any other
+  // thread is able to pick the same name
+  ObtainSemaphore(G->globalSemaphore);
   MA_NewMailFile(inFolder, msgfile, sizeof(msgfile));
 
   // open the new mailfile for writing out the retrieved
   // data
-  if((fh = fopen(msgfile, "w")) != NULL)
+  fh = fopen(msgfile, "w");
+  ReleaseSemaphore(G->globalSemaphore);
+
+  if(fh != NULL)
   {
-    char msgnum[SIZE_SMALL];
     BOOL done = FALSE;
 
     setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
-    snprintf(msgnum, sizeof(msgnum), "%d", number);
-    if(SendPOP3Command(tc, POPCMD_RETR, msgnum, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+    if(ReceivePOP3Response(tc, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
     {
       // now we call a subfunction to receive data from the POP3 server
       // and write it in the filehandle as long as there is no termination \r\n.\r\n
@@ -1245,44 +1583,7 @@ static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder, con
     fclose(fh);
 
     if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR && done == TRUE)
-    {
-      struct ExtendedMail *email;
-
-      if((email = MA_ExamineMail(inFolder, FilePart(msgfile), FALSE)) != NULL)
-      {
-        struct Mail *mail;
-
-        if((mail = CloneMail(&email->Mail)) != NULL)
-        {
-          AddMailToFolder(mail, inFolder);
-
-          // we have to get the actual Time and place it in the transDate, so that we know at
-          // which time this mail arrived
-          GetSysTimeUTC(&mail->transDate);
-
-          mail->sflags = SFLAG_NEW;
-          MA_UpdateMailFile(mail);
-
-          D(DBF_NET, "adding mail to downloaded list");
-          // add the mail to the list of downloaded mails
-          LockMailList(tc->msn->downloadedMails);
-          AddNewMailNode(tc->msn->downloadedMails, mail);
-          UnlockMailList(tc->msn->downloadedMails);
-
-          // if the current folder is the inbox we can go and add the mail instantly to the maillist
-          if(inFolder == GetCurrentFolder())
-            PushMethodOnStack(G->MA->GUI.PG_MAILLIST, 3, MUIM_NList_InsertSingle, mail, MUIV_NList_Insert_Sorted);
-
-          AppendToLogfile(LF_VERBOSE, 32, tr(MSG_LOG_RetrievingVerbose), AddrName(mail->From), mail->Subject, mail->Size);
-
-          PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_NEWMSG, msgfile);
-
-          result = TRUE;
-        }
-
-        MA_FreeEMailStruct(email);
-      }
-    }
+      result = AddDownloadedMail(tc->msn, inFolder, msgfile);
 
     if(result == FALSE)
     {
@@ -1293,26 +1594,36 @@ static BOOL LoadMessage(struct TransferContext *tc, struct Folder *inFolder, con
     }
   }
   else
+  {
     ER_NewError(tr(MSG_ER_ErrorWriteMailfile), msgfile);
 
+    // the RETR command has been sent already, so we must skip the mail
+    // to be able to receive the responses of the following commands
+    if(ReceivePOP3Response(tc, NULL) != NULL)
+    {
+      while(ReceiveLineFromHost(tc->connection, tc->lineBuffer, sizeof(tc->lineBuffer)) > 0 &&
+            strncmp(tc->lineBuffer, ".\r\n", 3) != 0)
+        ;
+    }
+  }
+
   RETURN(result);
   return result;
 }
 
 ///
 /// DeleteMessage
-static BOOL DeleteMessage(struct TransferContext *tc, const int number)
+// receive the response to the oldest pending DELE command
+static BOOL DeleteMessage(struct TransferContext *tc)
 {
   BOOL result = FALSE;
-  char msgnum[SIZE_SMALL];
 
   ENTER();
 
   // update the transfer status
-  PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_DeletingServerMail));
+  PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_DeletingServerMail), tc->connection->minRTT, GetConnectionThroughput(tc->connection));
 
-  snprintf(msgnum, sizeof(msgnum), "%d", number);
-  if(SendPOP3Command(tc, POPCMD_DELE, msgnum, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
+  if(ReceivePOP3Response(tc, tr(MSG_ER_BADRESPONSE_POP3)) != NULL)
   {
     tc->downloadResult.deleted++;
     result = TRUE;
@@ -1322,11 +1633,30 @@ static BOOL DeleteMessage(struct TransferContext *tc, const int number)
   return result;
 }
 
+///
+/// RequestMessage
+// send a RETR or DELE command for a mail without waiting for the response
+static BOOL RequestMessage(struct TransferContext *tc, struct MailTransferNode *tnode, const enum POPCommand command)
+{
+  BOOL result;
+  char msgnum[SIZE_SMALL];
+
+  ENTER();
+
+  snprintf(msgnum, sizeof(msgnum), "%d", tnode->index);
+  result = SendPOP3Request(tc, command, tnode, msgnum);
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// DownloadMails
 static void DownloadMails(struct TransferContext *tc)
 {
-  struct MailTransferNode *tnode;
+  struct MailTransferNode *sendNode;
+  struct POP3Request *request;
+  BOOL sent = FALSE;
 
   ENTER();
 
@@ -1335,82 +1665,126 @@ static void DownloadMails(struct TransferContext *tc)
 
   GetSysTime(TIMEVAL(&tc->lastUpdateTime));
 
-  ForEachMailTransferNode(tc->transferList, tnode)
+  sendNode = FirstMailTransferNode(tc->transferList);
+
+  do
   {
-    struct Mail *mail = tnode->mail;
+    // keep the pipeline filled with the commands for the following mails
+    while(sendNode != NULL && tc->pipeline.count < tc->pipeline.depth &&
+          tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+    {
+      struct Mail *mail = sendNode->mail;
 
-    D(DBF_NET, "download flags %08lx=%s%s%s for mail with subject '%s' and size %ld", tnode->tflags, isFlagSet(tnode->tflags, TRF_TRANSFER) ? "TR_TRANSFER " : "" , isFlagSet(tnode->tflags, TRF_DELETE) ? "TR_DELETE " : "", isFlagSet(tnode->tflags, TRF_PRESELECT) ? "TR_PRESELECT " : "", mail->Subject, mail->Size);
-    if(isFlagSet(tnode->tflags, TRF_TRANSFER))
+      D(DBF_NET, "download flags %08lx=%s%s%s for mail with subject '%s' and size %ld", sendNode->tflags, isFlagSet(sendNode->tflags, TRF_TRANSFER) ? "TR_TRANSFER " : "" , isFlagSet(sendNode->tflags, TRF_DELETE) ? "TR_DELETE " : "", isFlagSet(sendNode->tflags, TRF_PRESELECT) ? "TR_PRESELECT " : "", mail->Subject, mail->Size);
+      if(isFlagSet(sendNode->tflags, TRF_TRANSFER))
+      {
+        if(RequestMessage(tc, sendNode, POPCMD_RETR) == TRUE)
+          sent = TRUE;
+      }
+      else if(isFlagSet(sendNode->tflags, TRF_DELETE))
+      {
+        if(RequestMessage(tc, sendNode, POPCMD_DELE) == TRUE)
+          sent = TRUE;
+      }
+      else
+      {
+        D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
+        // Do not modify the UIDL hash here!
+        // The mail was marked as "don't download", but here we don't know if that
+        // is due to the duplicates checking or if the user did that himself.
+      }
+
+      sendNode = NextMailTransferNode(sendNode);
+    }
+
+    // make sure the server gets all commands before we wait for a response
+    if(sent == TRUE)
     {
-      D(DBF_NET, "downloading mail with subject '%s' and size %ld", mail->Subject, mail->Size);
+      FlushConnection(tc->connection);
+      sent = FALSE;
+    }
 
-      // update the transfer status
-      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, mail->Size, tr(MSG_TR_Downloading));
+    // the responses arrive in the same order as the commands were sent
+    if((request = NextPOP3Request(tc)) != NULL)
+    {
+      struct MailTransferNode *tnode = request->tnode;
+      struct Mail *mail = tnode->mail;
 
-      if(LoadMessage(tc, tc->incomingFolder, tnode->index) == TRUE)
+      if(request->command == POPCMD_RETR)
       {
-        if(TimeHasElapsed(&tc->lastUpdateTime, 250000) == TRUE)
+        D(DBF_NET, "downloading mail with subject '%s' and size %ld", mail->Subject, mail->Size);
+
+        // update the transfer status
+        PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, mail->Size, tr(MSG_TR_Downloading));
+
+        if(LoadMessage(tc, tc->incomingFolder) == TRUE)
         {
-          // redraw the folderentry in the listtree 4 times per second at most
-          PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, tc->incomingFolder->Treenode, MUIF_NONE);
-        }
+          tc->connection->transferredMails++;
 
-        // put the transferStat for this mail to 100%
-        PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading));
+          if(TimeHasElapsed(&tc->lastUpdateTime, 250000) == TRUE)
+          {
+            // redraw the folderentry in the listtree 4 times per second at most
+            PushMethodOnStack(G->MA->GUI.LT_FOLDERS, 3, MUIM_NListtree_Redraw, tc->incomingFolder->Treenode, MUIF_NONE);
+          }
 
-        tc->downloadResult.downloaded++;
+          // put the transferStat for this mail to 100%
+          PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Downloading), tc->connection->minRTT, GetConnectionThroughput(tc->connection));
 
-        // Remember the UIDL of this mail, no matter if it is going
-        // to be deleted or not. Some servers don't delete a mail
-        // right after the DELETE command, but only after a successful
-        // QUIT command. Personal experience shows that pop.gmx.de is
-        // one of these servers.
-        if(hasServerAvoidDuplicates(tc->msn) == TRUE)
-        {
-          D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
-          // add the UIDL to the hash table or update an existing entry
-          AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
-        }
+          tc->downloadResult.downloaded++;
 
-        if(isFlagSet(tnode->tflags, TRF_DELETE))
-        {
-          D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
+          // Remember the UIDL of this mail, no matter if it is going
+          // to be deleted or not. Some servers don't delete a mail
+          // right after the DELETE command, but only after a successful
+          // QUIT command. Personal experience shows that pop.gmx.de is
+          // one of these servers.
+          if(hasServerAvoidDuplicates(tc->msn) == TRUE)
+          {
+            D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
+            // add the UIDL to the hash table or update an existing entry
+            AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
+          }
 
-          DeleteMessage(tc, tnode->index);
+          if(isFlagSet(tnode->tflags, TRF_DELETE))
+          {
+            D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
+
+            // the DELE command is queued behind the commands which have been sent ahead
+            if(RequestMessage(tc, tnode, POPCMD_DELE) == TRUE)
+              sent = TRUE;
+          }
+          else
+            D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
         }
-        else
-          D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
       }
-    }
-    else if(isFlagSet(tnode->tflags, TRF_DELETE))
-    {
-      D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
+      else
+      {
+        // a DELE for a downloaded mail has been issued above already, so
+        // the transfer status and the UIDL must be updated for all other mails
+        if(isFlagClear(tnode->tflags, TRF_TRANSFER))
+        {
+          D(DBF_NET, "deleting mail with subject '%s' on server", mail->Subject);
 
-      // update the transfer status, use a zero mail size
-      PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, 0, tr(MSG_TR_DeletingServerMail));
+          // update the transfer status, use a zero mail size
+          PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Next, tnode->index - tc->numberOfMailsSkipped, tnode->position, 0, tr(MSG_TR_DeletingServerMail));
 
-      // now we "know" that this mail had existed, don't forget this in case
-      // the delete operation fails
-      if(hasServerAvoidDuplicates(tc->msn) == TRUE)
-      {
-        D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
-        // add the UIDL to the hash table or update an existing entry
-        AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
-      }
+          // now we "know" that this mail had existed, don't forget this in case
+          // the delete operation fails
+          if(hasServerAvoidDuplicates(tc->msn) == TRUE)
+          {
+            D(DBF_NET, "adding mail with subject '%s' to UIDL hash", mail->Subject);
+            // add the UIDL to the hash table or update an existing entry
+            AddUIDLtoHash(tc->UIDLhashTable, tnode->uidl, UIDLF_NEW);
+          }
+        }
 
-      DeleteMessage(tc, tnode->index);
-    }
-    else
-    {
-      D(DBF_NET, "leaving mail with subject '%s' and size %ld on server to be downloaded again", mail->Subject, mail->Size);
-      // Do not modify the UIDL hash here!
-      // The mail was marked as "don't download", but here we don't know if that
-      // is due to the duplicates checking or if the user did that himself.
+        DeleteMessage(tc);
+      }
     }
 
     if(tc->connection->abort == TRUE || tc->connection->error != CONNECTERR_NO_ERROR)
       break;
   }
+  while(request != NULL);
 
   PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
 
@@ -1592,117 +1966,124 @@ BOOL ReceiveMails(struct MailServerNode *msn, const ULONG flags, struct Download
                 {
                   int msgs;
 
-                  if((msgs = ConnectToPOP3(tc)) != -1)
+                  // wait until the connection limits permit another session, this
+                  // keeps the checks of many accounts from flooding the network
+                  if(ObtainConnectionSlot(tc->msn) == TRUE)
                   {
-                    // connection succeeded
-                    success = TRUE;
-
-                    // but we continue only if there is something to be downloaded at all
-                    if(isFlagClear(flags, RECEIVEF_TEST_CONNECTION) && msgs > 0)
+                    if((msgs = ConnectToPOP3(tc)) != -1)
                     {
-                      // there are messages on the server
-                      if(GetMessageList(tc) == TRUE)
-                      {
-                        BOOL goOn = TRUE;
-                        BOOL doPreselect;
-                        BOOL doDownload;
+                      // connection succeeded
+                      success = TRUE;
 
-                        // if the user wants to avoid to receive the same message from the
-                        // POP3 server again we have to analyze the UIDL of it
-                        if(goOn == TRUE && hasServerAvoidDuplicates(tc->msn) == TRUE)
-                          goOn = FilterDuplicates(tc);
-
-                        // receive all message details to be able to apply the remote filters
-                        if(goOn == TRUE && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
+                      // but we continue only if there is something to be downloaded at all
+                      if(isFlagClear(flags, RECEIVEF_TEST_CONNECTION) && msgs > 0)
+                      {
+                        // there are messages on the server
+                        if(GetMessageList(tc) == TRUE)
                         {
-                          PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_ApplyFilters));
-                          goOn = GetAllMessageDetails(tc, TRUE);
-                        }
+                          BOOL goOn = TRUE;
+                          BOOL doPreselect;
+                          BOOL doDownload;
 
-                        // check the list of mails if some kind of preselection is required
-                        if(goOn == TRUE && isFlagSet(tc->flags, RECEIVEF_USER) && ScanMailTransferList(tc->transferList, TRF_PRESELECT, TRF_PRESELECT, TRUE) != NULL)
-                          doPreselect = TRUE;
-                        else
-                          doPreselect = FALSE;
+                          // if the user wants to avoid to receive the same message from the
+                          // POP3 server again we have to analyze the UIDL of it
+                          if(goOn == TRUE && hasServerAvoidDuplicates(tc->msn) == TRUE)
+                            goOn = FilterDuplicates(tc);
 
-                        if(doPreselect == TRUE)
-                        {
-                          // show the preselection window in case user interaction is requested
-                          D(DBF_NET, "preselection is required");
-                          doDownload = FALSE;
+                          // receive all message details to be able to apply the remote filters
+                          if(goOn == TRUE && hasServerApplyRemoteFilters(tc->msn) == TRUE && IsMinListEmpty(tc->remoteFilters) == FALSE)
+                          {
+                            PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_ApplyFilters));
+                            goOn = GetAllMessageDetails(tc, TRUE);
+                          }
 
-                          snprintf(tc->windowTitle, sizeof(tc->windowTitle), tr(MSG_TR_MAILCHECKFROM), tc->msn->description);
+                          // check the list of mails if some kind of preselection is required
+                          if(goOn == TRUE && isFlagSet(tc->flags, RECEIVEF_USER) && ScanMailTransferList(tc->transferList, TRF_PRESELECT, TRF_PRESELECT, TRUE) != NULL)
+                            doPreselect = TRUE;
+                          else
+                            doPreselect = FALSE;
 
-                          if((tc->preselectWindow = (Object *)PushMethodOnStackWait(G->App, 6, MUIM_YAMApplication_CreatePreselectionWindow, CurrentThread(), tc->windowTitle, tc->msn->largeMailSizeLimit, PRESELWINMODE_DOWNLOAD, tc->transferList)) != NULL)
+                          if(doPreselect == TRUE)
                           {
-                            int mustWait;
+                            // show the preselection window in case user interaction is requested
+                            D(DBF_NET, "preselection is required");
+                            doDownload = FALSE;
 
-                            PushMethodOnStack(tc->preselectWindow, 3, MUIM_Set, MUIA_PreselectionWindow_ActiveMail, tc->firstPreselect);
-                            PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_WAIT_FOR_PRESELECTION));
+                            snprintf(tc->windowTitle, sizeof(tc->windowTitle), tr(MSG_TR_MAILCHECKFROM), tc->msn->description);
 
-                            if(ThreadWasAborted() == FALSE)
+                            if((tc->preselectWindow = (Object *)PushMethodOnStackWait(G->App, 6, MUIM_YAMApplication_CreatePreselectionWindow, CurrentThread(), tc->windowTitle, tc->msn->largeMailSizeLimit, PRESELWINMODE_DOWNLOAD, tc->transferList)) != NULL)
                             {
-                              if((mustWait = GetAllMessageDetails(tc, FALSE)) != 0)
+                              int mustWait;
+
+                              PushMethodOnStack(tc->preselectWindow, 3, MUIM_Set, MUIA_PreselectionWindow_ActiveMail, tc->firstPreselect);
+                              PushMethodOnStack(tc->transferGroup, 2, MUIM_TransferControlGroup_ShowStatus, tr(MSG_TR_WAIT_FOR_PRESELECTION));
+
+                              if(ThreadWasAborted() == FALSE)
                               {
-                                if(mustWait == 1)
+                                if((mustWait = GetAllMessageDetails(tc, FALSE)) != 0)
                                 {
-                                  // we got all details, now wait for the user to finish the preselection
-                                  doDownload = WaitForPreselection(tc);
+                                  if(mustWait == 1)
+                                  {
+                                    // we got all details, now wait for the user to finish the preselection
+                                    doDownload = WaitForPreselection(tc);
+                                  }
+                                  else
+                                  {
+                                    // getting the details has been aborted early by pressing the "Start" button
+                                    doDownload = TRUE;
+                                  }
                                 }
                                 else
-                                {
-                                  // getting the details has been aborted early by pressing the "Start" button
-                                  doDownload = TRUE;
-                                }
-                              }
-                              else
-                                D(DBF_NET, "getting message details failed/was aborted, no preselection");
+                                  D(DBF_NET, "getting message details failed/was aborted, no preselection");
 
-                              PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DisposeWindow, tc->preselectWindow);
+                                PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DisposeWindow, tc->preselectWindow);
+                              }
                             }
                           }
-                        }
-                        else
-                        {
-                          D(DBF_NET, "no preselection required");
-                          doDownload = goOn;
-                        }
+                          else
+                          {
+                            D(DBF_NET, "no preselection required");
+                            doDownload = goOn;
+                          }
 
-                        // is there anything left to transfer or delete?
-                        if(ThreadWasAborted() == FALSE && doDownload == TRUE && ScanMailTransferList(tc->transferList, TRF_TRANSFER|TRF_DELETE, TRF_NONE, FALSE) != NULL)
-                        {
-                          SumUpMails(tc);
-                          PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Start, tc->numberOfMailsTotal - tc->numberOfMailsSkipped, tc->totalSize);
+                          // is there anything left to transfer or delete?
+                          if(ThreadWasAborted() == FALSE && doDownload == TRUE && ScanMailTransferList(tc->transferList, TRF_TRANSFER|TRF_DELETE, TRF_NONE, FALSE) != NULL)
+                          {
+                            SumUpMails(tc);
+                            PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Start, tc->numberOfMailsTotal - tc->numberOfMailsSkipped, tc->totalSize);
 
-                          DownloadMails(tc);
+                            DownloadMails(tc);
 
-                          PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
+                            PushMethodOnStack(tc->transferGroup, 1, MUIM_TransferControlGroup_Finish);
 
-                          if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
-                            tc->downloadResult.error = FALSE;
-                        }
-                        else
-                        {
-                          W(DBF_NET, "no mails to be transferred");
+                            if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+                              tc->downloadResult.error = FALSE;
+                          }
+                          else
+                          {
+                            W(DBF_NET, "no mails to be transferred");
 
-                          if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
-                            tc->downloadResult.error = FALSE;
+                            if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+                              tc->downloadResult.error = FALSE;
+                          }
                         }
+                        else
+                          E(DBF_NET, "couldn't retrieve MessageList");
                       }
                       else
-                        E(DBF_NET, "couldn't retrieve MessageList");
-                    }
-                    else
-                    {
-                      W(DBF_NET, "no messages found on server '%s'", tc->msn->hostname);
+                      {
+                        W(DBF_NET, "no messages found on server '%s'", tc->msn->hostname);
 
-                      if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
-                        tc->downloadResult.error = FALSE;
+                        if(tc->connection->abort == FALSE && tc->connection->error == CONNECTERR_NO_ERROR)
+                          tc->downloadResult.error = FALSE;
+                      }
                     }
-                  }
 
-                  // disconnect no matter if the connect operation succeeded or not
-                  DisconnectFromPOP3(tc);
+                    // disconnect no matter if the connect operation succeeded or not
+                    DisconnectFromPOP3(tc);
+
+                    ReleaseConnectionSlot(tc->msn);
+                  }
 
                   PushMethodOnStack(G->App, 2, MUIM_YAMApplication_DeleteTransferGroup, tc->transferGroup);
                 }
@@ -1722,25 +2103,9 @@ BOOL ReceiveMails(struct MailServerNode *msn, const ULONG flags, struct Download
           // perform the finalizing actions only if we haven't been aborted externally
           if(ThreadWasAborted() == FALSE)
           {
-            char downloadedStr[SIZE_SMALL];
-
-            snprintf(downloadedStr, sizeof(downloadedStr), "%d", (int)tc->downloadResult.downloaded);
-            PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_StartMacro, MACRO_POSTGET, downloadedStr);
-
             AppendToLogfile(LF_ALL, 30, tr(MSG_LOG_RETRIEVED_POP3), tc->downloadResult.downloaded, msn->description);
 
-            // we only apply the filters if we downloaded something, or it's wasted
-            D(DBF_NET, "filter %ld downloaded mails", tc->downloadResult.downloaded);
-            if(tc->downloadResult.downloaded > 0)
-            {
-              PushMethodOnStackWait(G->App, 3, MUIM_YAMApplication_FilterNewMails, tc->msn->downloadedMails, &tc->filterResult);
-              PushMethodOnStackWait(G->App, 5, MUIM_YAMApplication_NewMailAlert, tc->msn, &tc->downloadResult, &tc->filterResult, tc->flags);
-            }
-
-            // forget about the downloaded mails again
-            LockMailList(tc->msn->downloadedMails);
-            ClearMailList(tc->msn->downloadedMails);
-            UnlockMailList(tc->msn->downloadedMails);
+            FinishMailCheck(tc->msn, tc->flags, &tc->downloadResult, &tc->filterResult);
           }
           else
           {
@@ -1764,6 +2129,7 @@ BOOL ReceiveMails(struct MailServerNode *msn, const ULONG flags, struct Download
     if(dlResult != NULL)
       memcpy(dlResult, &tc->downloadResult, sizeof(*dlResult));
 
+    free(tc->detailsBuffer);
     free(tc);
   }
 
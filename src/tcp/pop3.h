@@ -29,6 +29,7 @@
 ***************************************************************************/
 
 // forward declarations
+struct FilterResult;
 struct Folder;
 struct MailTransferNode;
 struct MailServerNode;
@@ -51,5 +52,7 @@ struct DownloadResult
 
 // prototypes
 BOOL ReceiveMails(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *dlResult);
+BOOL AddDownloadedMail(struct MailServerNode *msn, struct Folder *inFolder, const char *msgfile);
+void FinishMailCheck(struct MailServerNode *msn, const ULONG flags, struct DownloadResult *downloadResult, struct FilterResult *filterResult);
 
 #endif /* POP3_H */
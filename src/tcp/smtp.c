@@ -73,7 +73,7 @@ enum SMTPCommand
 
   // ESMTP commands
   ESMTP_EHLO, ESMTP_STARTTLS, ESMTP_AUTH_CRAM_MD5, ESMTP_AUTH_DIGEST_MD5, ESMTP_AUTH_LOGIN,
-  ESMTP_AUTH_PLAIN
+  ESMTP_AUTH_PLAIN, ESMTP_BDAT
 };
 
 static const char *const SMTPcmd[] =
@@ -84,7 +84,7 @@ static const char *const SMTPcmd[] =
 
   // ESMTP commands
   "EHLO", "STARTTLS", "AUTH CRAM-MD5", "AUTH DIGEST-MD5", "AUTH LOGIN",
-  "AUTH PLAIN"
+  "AUTH PLAIN", "BDAT"
 };
 
 // SMTP Status Messages
@@ -106,6 +106,7 @@ static const char *const SMTPcmd[] =
 #define SMTP_FLG_ENHANCEDSTATUSCODES (1<<11)
 #define SMTP_FLG_DELIVERBY           (1<<12)
 #define SMTP_FLG_HELP                (1<<13)
+#define SMTP_FLG_CHUNKING            (1<<14)
 #define hasESMTP(v)                  (isFlagSet((v), SMTP_FLG_ESMTP))
 #define hasCRAM_MD5_Auth(v)          (isFlagSet((v), SMTP_FLG_AUTH_CRAM_MD5))
 #define hasDIGEST_MD5_Auth(v)        (isFlagSet((v), SMTP_FLG_AUTH_DIGEST_MD5))
@@ -120,10 +121,16 @@ static const char *const SMTPcmd[] =
 #define hasENHANCEDSTATUSCODES(v)    (isFlagSet((v), SMTP_FLG_ENHANCEDSTATUSCODES))
 #define hasDELIVERBY(v)              (isFlagSet((v), SMTP_FLG_DELIVERBY))
 #define hasHELP(v)                   (isFlagSet((v), SMTP_FLG_HELP))
+#define hasCHUNKING(v)               (isFlagSet((v), SMTP_FLG_CHUNKING))
 
 // help macros for SMTP routines
 #define getResponseCode(str)          ((int)strtol((str), NULL, 10))
 
+// the size of the chunks of a mail sent by BDAT commands (RFC 3030)
+#define SMTP_CHUNK_SIZE               (64*1024)
+// the maximum number of pipelined BDAT commands waiting for their responses
+#define SMTP_MAX_PENDING_CHUNKS       8
+
 struct TransferContext
 {
   struct Connection *conn;
@@ -137,155 +144,144 @@ struct TransferContext
   char tempBuffer[SIZE_LINE];
   char transferGroupTitle[SIZE_DEFAULT]; // the TransferControlGroup's title
   BOOL useTLS;
+  int pendingRecipients;                 // number of pipelined RCPT commands
+  char *chunkBuffer;                     // the data of the next BDAT command
+  size_t chunkLength;                    // the number of bytes in chunkBuffer
+  int pendingChunks;                     // number of BDAT commands waiting for a response
 };
 
-/// SendSMTPCommand
-//  Sends a command to the SMTP server and returns the response message
-//  described in (RFC 2821)
-static char *SendSMTPCommand(struct TransferContext *tc, const enum SMTPCommand command, const char *parmtext, const char *errorMsg)
+/// ReceiveSMTPResponse
+//  Receives the response of the SMTP server to a previously sent command
+//  as described in (RFC 2821)
+static char *ReceiveSMTPResponse(struct TransferContext *tc, const enum SMTPCommand command, const char *errorMsg)
 {
   BOOL success = FALSE;
   char *result = tc->smtpBuffer;
+  int len;
 
   ENTER();
 
-  // first we check if the socket is ready
-  // now we prepare the SMTP command
-  if(IsStrEmpty(parmtext))
-    snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s\r\n", SMTPcmd[command]);
-  else
-    snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s %s\r\n", SMTPcmd[command], parmtext);
-
-  D(DBF_NET, "TCP: send SMTP cmd '%s' with param '%s'", SMTPcmd[command], SafeStr(parmtext));
-
-  // lets send the command via TR_WriteLine, but not if we are in connection
-  // state
-  if(command == SMTP_CONNECT || SendLineToHost(tc->conn, tc->smtpBuffer) > 0)
+  // after issuing the SMTP command we read out the server response to it
+  if((len = ReceiveLineFromHost(tc->conn, tc->smtpBuffer, sizeof(tc->smtpBuffer))) > 0)
   {
-    int len = 0;
+    // get the response code
+    int rc = strtol(tc->smtpBuffer, NULL, 10);
 
-    // after issuing the SMTP command we read out the server response to it
-    // but only if this wasn't the SMTP_QUIT command.
-    if((len = ReceiveLineFromHost(tc->conn, tc->smtpBuffer, sizeof(tc->smtpBuffer))) > 0)
-    {
-      // get the response code
-      int rc = strtol(tc->smtpBuffer, NULL, 10);
+    D(DBF_NET, "received SMTP answer '%s'", tc->smtpBuffer);
 
-      D(DBF_NET, "received SMTP answer '%s'", tc->smtpBuffer);
+    // if the response is a multiline response we have to get out more
+    // from the socket
+    if(tc->smtpBuffer[3] == '-') // (RFC 2821) - section 4.2.1
+    {
+      char tbuf[SIZE_LINE];
 
-      // if the response is a multiline response we have to get out more
-      // from the socket
-      if(tc->smtpBuffer[3] == '-') // (RFC 2821) - section 4.2.1
+      // now we concatenate the multiline reply to
+      // out main buffer
+      do
       {
-        char tbuf[SIZE_LINE];
-
-        // now we concatenate the multiline reply to
-        // out main buffer
-        do
+        // lets get out the next line from the socket
+        if((len = ReceiveLineFromHost(tc->conn, tbuf, sizeof(tbuf))) > 0)
         {
-          // lets get out the next line from the socket
-          if((len = ReceiveLineFromHost(tc->conn, tbuf, sizeof(tbuf))) > 0)
-          {
-            // get the response code
-            int rc2 = strtol(tbuf, NULL, 10);
+          // get the response code
+          int rc2 = strtol(tbuf, NULL, 10);
 
-            // check if the response code matches the one
-            // of the first line
-            if(rc == rc2)
-            {
-              // lets concatenate both strings while stripping the
-              // command code and make sure we didn't reach the end
-              // of the buffer
-              if(strlcat(tc->smtpBuffer, tbuf, sizeof(tc->smtpBuffer)) >= sizeof(tc->smtpBuffer))
-                W(DBF_NET, "buffer overrun on trying to concatenate a multiline reply!");
-            }
-            else
-            {
-              E(DBF_NET, "response codes of multiline reply doesn't match!");
-
-              errorMsg = NULL;
-              len = 0;
-              break;
-            }
+          // check if the response code matches the one
+          // of the first line
+          if(rc == rc2)
+          {
+            // lets concatenate both strings while stripping the
+            // command code and make sure we didn't reach the end
+            // of the buffer
+            if(strlcat(tc->smtpBuffer, tbuf, sizeof(tc->smtpBuffer)) >= sizeof(tc->smtpBuffer))
+              W(DBF_NET, "buffer overrun on trying to concatenate a multiline reply!");
           }
           else
           {
-            errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+            E(DBF_NET, "response codes of multiline reply doesn't match!");
+
+            errorMsg = NULL;
+            len = 0;
             break;
           }
         }
-        while(tbuf[3] == '-');
-      }
-
-      // check that the concatentation worked
-      // out fine and that the rc is valid
-      if(len > 0 && rc >= 100)
-      {
-        // Now we check if we got the correct response code for the command
-        // we issued
-        switch(command)
+        else
         {
-          //  Reponse    Description (RFC 2821 - section 4.2.1)
-          //  1xx        Positive Preliminary reply
-          //  2xx        Positive Completion reply
-          //  3xx        Positive Intermediate reply
-          //  4xx        Transient Negative Completion reply
-          //  5xx        Permanent Negative Completion reply
-
-          case SMTP_HELP:    { success = (rc == 211 || rc == 214); } break;
-          case SMTP_VRFY:    { success = (rc == 250 || rc == 251); } break;
-          case SMTP_CONNECT: { success = (rc == 220); } break;
-          case SMTP_QUIT:    { success = (rc == 221); } break;
-          case SMTP_DATA:    { success = (rc == 354); } break;
-
-          // all codes that accept 250 response code
-          case SMTP_HELO:
-          case SMTP_MAIL:
-          case SMTP_RCPT:
-          case SMTP_FINISH:
-          case SMTP_RSET:
-          case SMTP_SEND:
-          case SMTP_SOML:
-          case SMTP_SAML:
-          case SMTP_EXPN:
-          case SMTP_NOOP:
-          case SMTP_TURN:    { success = (rc == 250); } break;
-
-          // ESMTP commands & response codes
-          case ESMTP_EHLO:            { success = (rc == 250); } break;
-          case ESMTP_STARTTLS:        { success = (rc == 220); } break;
-
-          // ESMTP_AUTH command responses
-          case ESMTP_AUTH_CRAM_MD5:
-          case ESMTP_AUTH_DIGEST_MD5:
-          case ESMTP_AUTH_LOGIN:
-          case ESMTP_AUTH_PLAIN:      { success = (rc == 334); } break;
+          errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+          break;
         }
       }
+      while(tbuf[3] == '-');
     }
-    else
+
+    // check that the concatentation worked
+    // out fine and that the rc is valid
+    if(len > 0 && rc >= 100)
     {
-      // Unfortunately, there are broken SMTP server implementations out there
-      // like the one used by "smtp.googlemail.com" or "smtp.gmail.com".
-      //
-      // It seems these broken SMTP servers do automatically drop the
-      // data connection right after the 'QUIT' command was send and don't
-      // reply with a status message like it is clearly defined in RFC 2821
-      // (section 4.1.1.10). Unfortunately we can't do anything about
-      // it really and have to consider this a bad and ugly workaround. :(
-      if(command == SMTP_QUIT)
+      // Now we check if we got the correct response code for the command
+      // we issued
+      switch(command)
       {
-        W(DBF_NET, "broken SMTP server implementation found on QUIT, keeping quiet...");
-
-        success = TRUE;
-        tc->smtpBuffer[0] = '\0';
+        //  Reponse    Description (RFC 2821 - section 4.2.1)
+        //  1xx        Positive Preliminary reply
+        //  2xx        Positive Completion reply
+        //  3xx        Positive Intermediate reply
+        //  4xx        Transient Negative Completion reply
+        //  5xx        Permanent Negative Completion reply
+
+        case SMTP_HELP:    { success = (rc == 211 || rc == 214); } break;
+        case SMTP_VRFY:    { success = (rc == 250 || rc == 251); } break;
+        case SMTP_CONNECT: { success = (rc == 220); } break;
+        case SMTP_QUIT:    { success = (rc == 221); } break;
+        case SMTP_DATA:    { success = (rc == 354); } break;
+
+        // all codes that accept 250 response code
+        case SMTP_HELO:
+        case SMTP_MAIL:
+        case SMTP_RCPT:
+        case SMTP_FINISH:
+        case SMTP_RSET:
+        case SMTP_SEND:
+        case SMTP_SOML:
+        case SMTP_SAML:
+        case SMTP_EXPN:
+        case SMTP_NOOP:
+        case SMTP_TURN:    { success = (rc == 250); } break;
+
+        // ESMTP commands & response codes
+        case ESMTP_EHLO:            { success = (rc == 250); } break;
+        case ESMTP_STARTTLS:        { success = (rc == 220); } break;
+
+        // ESMTP_AUTH command responses
+        case ESMTP_AUTH_CRAM_MD5:
+        case ESMTP_AUTH_DIGEST_MD5:
+        case ESMTP_AUTH_LOGIN:
+        case ESMTP_AUTH_PLAIN:      { success = (rc == 334); } break;
+
+        // CHUNKING command responses
+        case ESMTP_BDAT:            { success = (rc == 250); } break;
       }
-      else
-        errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
     }
   }
   else
-    errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+  {
+    // Unfortunately, there are broken SMTP server implementations out there
+    // like the one used by "smtp.googlemail.com" or "smtp.gmail.com".
+    //
+    // It seems these broken SMTP servers do automatically drop the
+    // data connection right after the 'QUIT' command was send and don't
+    // reply with a status message like it is clearly defined in RFC 2821
+    // (section 4.1.1.10). Unfortunately we can't do anything about
+    // it really and have to consider this a bad and ugly workaround. :(
+    if(command == SMTP_QUIT)
+    {
+      W(DBF_NET, "broken SMTP server implementation found on QUIT, keeping quiet...");
+
+      success = TRUE;
+      tc->smtpBuffer[0] = '\0';
+    }
+    else
+      errorMsg = tr(MSG_ER_CONNECTIONBROKEN);
+  }
 
   // the rest of the responses throws an error
   if(success == FALSE)
@@ -300,6 +296,36 @@ static char *SendSMTPCommand(struct TransferContext *tc, const enum SMTPCommand
   return result;
 }
 
+///
+/// SendSMTPCommand
+//  Sends a command to the SMTP server and returns the response message
+//  described in (RFC 2821)
+static char *SendSMTPCommand(struct TransferContext *tc, const enum SMTPCommand command, const char *parmtext, const char *errorMsg)
+{
+  char *result = NULL;
+
+  ENTER();
+
+  // first we check if the socket is ready
+  // now we prepare the SMTP command
+  if(IsStrEmpty(parmtext))
+    snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s\r\n", SMTPcmd[command]);
+  else
+    snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s %s\r\n", SMTPcmd[command], parmtext);
+
+  D(DBF_NET, "TCP: send SMTP cmd '%s' with param '%s'", SMTPcmd[command], SafeStr(parmtext));
+
+  // lets send the command via TR_WriteLine, but not if we are in connection
+  // state
+  if(command == SMTP_CONNECT || SendLineToHost(tc->conn, tc->smtpBuffer) > 0)
+    result = ReceiveSMTPResponse(tc, command, errorMsg);
+  else
+    ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[command], tc->smtpBuffer);
+
+  RETURN(result);
+  return result;
+}
+
 ///
 /// ConnectToSMTP
 //  Connects to a SMTP mail server - here we always try to do an ESMTP connection
@@ -419,6 +445,8 @@ static BOOL ConnectToSMTP(struct TransferContext *tc)
             setFlag(flags, SMTP_FLG_DELIVERBY);
           else if(strnicmp(resp+4, "HELP", 4) == 0)         // HELP Extension (RFC 821)
             setFlag(flags, SMTP_FLG_HELP);
+          else if(strnicmp(resp+4, "CHUNKING", 8) == 0)     // CHUNKING Extension (RFC 3030)
+            setFlag(flags, SMTP_FLG_CHUNKING);
         }
       }
 
@@ -438,6 +466,7 @@ static BOOL ConnectToSMTP(struct TransferContext *tc)
       D(DBF_NET, "  ENHANCEDSTATUSCODES: %s", Bool2Txt(hasENHANCEDSTATUSCODES(flags)));
       D(DBF_NET, "  DELIVERBY..........: %s", Bool2Txt(hasDELIVERBY(flags)));
       D(DBF_NET, "  HELP...............: %s", Bool2Txt(hasHELP(flags)));
+      D(DBF_NET, "  CHUNKING...........: %s", Bool2Txt(hasCHUNKING(flags)));
       #endif
 
       // now we check the 8BITMIME extension against
@@ -1101,6 +1130,158 @@ static BOOL InitSMTPAUTH(struct TransferContext *tc)
   return (BOOL)(rc == SMTP_ACTION_OK);
 }
 
+///
+/// SendEnvelopeCommand
+// send a MAIL or RCPT command. If the server supports pipelining (RFC 2920)
+// the command is just buffered and its response is checked later by
+// ReceiveEnvelopeResponses(), otherwise the response is checked immediately.
+static BOOL SendEnvelopeCommand(struct TransferContext *tc, const enum SMTPCommand command, const char *parmtext)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  if(hasPIPELINING(tc->msn->smtpFlags))
+  {
+    snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s %s\r\n", SMTPcmd[command], parmtext);
+
+    D(DBF_NET, "TCP: pipeline SMTP cmd '%s' with param '%s'", SMTPcmd[command], parmtext);
+
+    if(SendToHost(tc->conn, tc->smtpBuffer, strlen(tc->smtpBuffer), TCPF_NONE) > 0)
+    {
+      if(command == SMTP_RCPT)
+        tc->pendingRecipients++;
+
+      result = TRUE;
+    }
+    else
+      ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[command]);
+  }
+  else
+    result = (SendSMTPCommand(tc, command, parmtext, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ReceiveEnvelopeResponses
+// receive the responses to the pipelined MAIL and RCPT commands. Each rejected
+// recipient is reported separately. Returns TRUE if the sender and all
+// recipients have been accepted.
+static BOOL ReceiveEnvelopeResponses(struct TransferContext *tc)
+{
+  BOOL result = TRUE;
+
+  ENTER();
+
+  if(hasPIPELINING(tc->msn->smtpFlags))
+  {
+    int numRecipients = tc->pendingRecipients;
+    int rejected = 0;
+
+    // now send all commands at once
+    FlushConnection(tc->conn);
+
+    // the response to the MAIL command arrives first
+    if(ReceiveSMTPResponse(tc, SMTP_MAIL, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+      result = FALSE;
+
+    // the responses to the RCPT commands must be received even if the MAIL
+    // command failed, but then there is no need to complain about them
+    while(tc->pendingRecipients > 0 && tc->conn->abort == FALSE && tc->conn->error == CONNECTERR_NO_ERROR)
+    {
+      tc->pendingRecipients--;
+
+      if(ReceiveSMTPResponse(tc, SMTP_RCPT, (result == TRUE) ? tr(MSG_ER_BADRESPONSE_SMTP) : NULL) == NULL)
+        rejected++;
+    }
+
+    D(DBF_NET, "%ld of %ld recipients rejected", rejected, numRecipients);
+
+    if(rejected != 0 || tc->pendingRecipients != 0)
+      result = FALSE;
+
+    tc->pendingRecipients = 0;
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// SendChunk
+// send the collected mail data with a BDAT command (RFC 3030). If the server
+// supports pipelining the responses are received only when too many of them
+// are pending or after the last chunk, otherwise each chunk is confirmed
+// immediately.
+static BOOL SendChunk(struct TransferContext *tc, const BOOL last)
+{
+  BOOL result = FALSE;
+
+  ENTER();
+
+  snprintf(tc->smtpBuffer, sizeof(tc->smtpBuffer), "%s %ld%s\r\n", SMTPcmd[ESMTP_BDAT], (long)tc->chunkLength, (last == TRUE) ? " LAST" : "");
+
+  D(DBF_NET, "TCP: send SMTP cmd '%s' with %ld bytes, last %ld", SMTPcmd[ESMTP_BDAT], tc->chunkLength, last);
+
+  if(SendToHost(tc->conn, tc->smtpBuffer, strlen(tc->smtpBuffer), TCPF_NONE) > 0 &&
+     (tc->chunkLength == 0 || SendToHost(tc->conn, tc->chunkBuffer, tc->chunkLength, TCPF_NONE) > 0))
+  {
+    tc->chunkLength = 0;
+    tc->pendingChunks++;
+
+    result = TRUE;
+
+    if(last == TRUE || hasPIPELINING(tc->msn->smtpFlags) == FALSE || tc->pendingChunks >= SMTP_MAX_PENDING_CHUNKS)
+    {
+      FlushConnection(tc->conn);
+
+      // receive all pending responses, but complain about the first failure only
+      while(tc->pendingChunks > 0 && tc->conn->abort == FALSE && tc->conn->error == CONNECTERR_NO_ERROR)
+      {
+        tc->pendingChunks--;
+
+        if(ReceiveSMTPResponse(tc, ESMTP_BDAT, (result == TRUE) ? tr(MSG_ER_BADRESPONSE_SMTP) : NULL) == NULL)
+          result = FALSE;
+      }
+
+      if(tc->pendingChunks != 0)
+        result = FALSE;
+    }
+  }
+  else
+    ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[ESMTP_BDAT]);
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// AddToChunk
+// add data to the current BDAT chunk and send the chunk as soon as it is full
+static BOOL AddToChunk(struct TransferContext *tc, const char *data, size_t length)
+{
+  BOOL result = TRUE;
+
+  // no ENTER/RETURN macro calls on purpose as this would blow up the trace log too much
+
+  while(length > 0 && result == TRUE)
+  {
+    size_t fill = MIN(length, SMTP_CHUNK_SIZE - tc->chunkLength);
+
+    memcpy(&tc->chunkBuffer[tc->chunkLength], data, fill);
+    tc->chunkLength += fill;
+    data += fill;
+    length -= fill;
+
+    if(tc->chunkLength == SMTP_CHUNK_SIZE)
+      result = SendChunk(tc, FALSE);
+  }
+
+  return result;
+}
+
 ///
 /// SendMessage
 // Sends a single message (-1 signals an error in DATA phase, 0 signals
@@ -1119,10 +1300,16 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
 
   D(DBF_NET, "about to send mail '%s' via SMTP server '%s'", mailfile, tc->msn->hostname);
 
+  tc->pendingRecipients = 0;
+  tc->chunkLength = 0;
+  tc->pendingChunks = 0;
+
   // open the mail file for reading
   if((buf = malloc(buflen)) != NULL &&
      (fh = fopen(mailfile, "r")) != NULL)
   {
+    struct ExtendedMail *email;
+
     setvbuf(fh, NULL, _IOFBF, SIZE_FILEBUF);
 
     // now we put together our parameters for our MAIL command
@@ -1140,12 +1327,12 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
     if(has8BITMIME(tc->msn->smtpFlags))
       snprintf(buf, buflen, "%s BODY=%s", buf, hasServer8bit(tc->msn) ? "8BITMIME" : "7BIT");
 
-    // send the MAIL command with the FROM: message
-    if(SendSMTPCommand(tc, SMTP_MAIL, buf, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
+    // we need the recipients before the MAIL command is sent, because with
+    // pipelining all envelope commands are sent at once
+    if((email = MA_ExamineMail(tc->outFolder, mail->MailFile, TRUE)) != NULL)
     {
-      struct ExtendedMail *email = MA_ExamineMail(tc->outFolder, mail->MailFile, TRUE);
-
-      if(email != NULL)
+      // send the MAIL command with the FROM: message
+      if(SendEnvelopeCommand(tc, SMTP_MAIL, buf) == TRUE)
       {
         BOOL rcptok = TRUE;
         int j;
@@ -1158,7 +1345,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentTo; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentTo[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1166,14 +1353,14 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
         {
           // specify the main 'To:' recipient
           snprintf(buf, buflen, "TO:<%s>", mail->To.Address);
-          if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+          if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
             rcptok = FALSE;
 
           // now add the additional 'To:' recipients of the mail
           for(j=0; j < email->NumSTo && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->STo[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1184,7 +1371,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentCC; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1194,7 +1381,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumCC && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->CC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1205,7 +1392,7 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumResentBCC; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->ResentBCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
@@ -1215,20 +1402,33 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
           for(j=0; j < email->NumBCC && rcptok; j++)
           {
             snprintf(buf, buflen, "TO:<%s>", email->BCC[j].Address);
-            if(SendSMTPCommand(tc, SMTP_RCPT, buf, tr(MSG_ER_BADRESPONSE_SMTP)) == NULL)
+            if(SendEnvelopeCommand(tc, SMTP_RCPT, buf) == FALSE)
               rcptok = FALSE;
           }
         }
 
+        // in case of pipelining the responses to all the commands above arrive now
+        if(ReceiveEnvelopeResponses(tc) == FALSE)
+          rcptok = FALSE;
+
         if(rcptok == TRUE)
         {
+          BOOL chunking = FALSE;
+
           D(DBF_NET, "RCPTs accepted, sending mail data");
 
+          // if the server supports BDAT we send the mail in large chunks without
+          // the need to escape lines starting with a period, otherwise the mail
+          // must be sent line by line after a DATA command
+          if(hasCHUNKING(tc->msn->smtpFlags) && (tc->chunkBuffer = malloc(SMTP_CHUNK_SIZE)) != NULL)
+            chunking = TRUE;
+
           // now we send the actual main data of the mail
-          if(SendSMTPCommand(tc, SMTP_DATA, NULL, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
+          if(chunking == TRUE || SendSMTPCommand(tc, SMTP_DATA, NULL, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
           {
             BOOL lineskip = FALSE;
             BOOL inbody = FALSE;
+            BOOL dataok = TRUE;
             ssize_t curlen;
             ssize_t proclen = 0;
             size_t sentbytes = 0;
@@ -1277,8 +1477,8 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
               if(lineskip == FALSE)
               {
                 // RFC 821 says a starting period needs a second one
-                // so we send out a period in advance
-                if(buf[0] == '.')
+                // so we send out a period in advance, but not for BDAT
+                if(buf[0] == '.' && chunking == FALSE)
                 {
                   if(SendToHost(tc->conn, ".", 1, TCPF_NONE) <= 0)
                   {
@@ -1296,40 +1496,119 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
                 if(buf[curlen-1] == '\n')
                   curlen--;
 
-                // now lets send the data buffered to the socket.
-                // we will flush it later then.
-                if(curlen > 0 && SendToHost(tc->conn, buf, curlen, TCPF_NONE) <= 0)
+                if(chunking == TRUE)
                 {
-                  E(DBF_NET, "couldn't send buffer data to SMTP server (%ld)", curlen);
-
-                  ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[SMTP_DATA]);
-                  break;
+                  // collect the line and the final CRLF (RFC 2822) for the next chunk
+                  if(AddToChunk(tc, buf, curlen) == FALSE || AddToChunk(tc, "\r\n", 2) == FALSE)
+                  {
+                    dataok = FALSE;
+                    break;
+                  }
+                  else
+                    sentbytes += curlen+2;
                 }
                 else
-                  sentbytes += curlen;
+                {
+                  // now lets send the data buffered to the socket.
+                  // we will flush it later then.
+                  if(curlen > 0 && SendToHost(tc->conn, buf, curlen, TCPF_NONE) <= 0)
+                  {
+                    E(DBF_NET, "couldn't send buffer data to SMTP server (%ld)", curlen);
+
+                    ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[SMTP_DATA]);
+                    break;
+                  }
+                  else
+                    sentbytes += curlen;
+
+                  // now we send the final CRLF (RFC 2822)
+                  if(SendToHost(tc->conn, "\r\n", 2, TCPF_NONE) <= 0)
+                  {
+                    E(DBF_NET, "couldn't send CRLF to SMTP server");
+
+                    ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[SMTP_DATA]);
+                    break;
+                  }
+                  else
+                    sentbytes += 2;
+                }
+              }
+
+              PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, proclen, tr(MSG_TR_Sending), tc->conn->minRTT, GetConnectionThroughput(tc->conn));
+
+              // without the need to escape periods the body doesn't have to be
+              // handled line by line
+              if(chunking == TRUE && inbody == TRUE)
+                break;
+            }
+
+            // now send the body in large blocks, only the LF line endings must
+            // be converted to CRLF
+            if(chunking == TRUE && inbody == TRUE && dataok == TRUE)
+            {
+              size_t blocklen;
+              char lastChar = '\n';
+
+              // enlarge the buffer for reading larger blocks
+              if(buflen < SIZE_FILEBUF)
+              {
+                char *newbuf;
+
+                if((newbuf = realloc(buf, SIZE_FILEBUF)) != NULL)
+                {
+                  buf = newbuf;
+                  buflen = SIZE_FILEBUF;
+                }
+              }
 
-                // now we send the final CRLF (RFC 2822)
-                if(SendToHost(tc->conn, "\r\n", 2, TCPF_NONE) <= 0)
+              while(dataok == TRUE && tc->conn->abort == FALSE && tc->conn->error == CONNECTERR_NO_ERROR &&
+                    (blocklen = fread(buf, 1, buflen, fh)) > 0)
+              {
+                char *p = buf;
+                char *end = &buf[blocklen];
+                char *lf;
+
+                while(dataok == TRUE && (lf = memchr(p, '\n', end-p)) != NULL)
                 {
-                  E(DBF_NET, "couldn't send CRLF to SMTP server");
+                  if(AddToChunk(tc, p, lf-p) == FALSE || AddToChunk(tc, "\r\n", 2) == FALSE)
+                    dataok = FALSE;
 
-                  ER_NewError(tr(MSG_ER_CONNECTIONBROKEN), tc->msn->hostname, (char *)SMTPcmd[SMTP_DATA]);
-                  break;
+                  sentbytes += lf-p+2;
+                  p = lf+1;
                 }
+
+                if(dataok == TRUE && p < end && AddToChunk(tc, p, end-p) == FALSE)
+                  dataok = FALSE;
+
+                sentbytes += end-p;
+                lastChar = end[-1];
+
+                PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, blocklen, tr(MSG_TR_Sending), tc->conn->minRTT, GetConnectionThroughput(tc->conn));
+              }
+
+              // terminate the final line if necessary
+              if(dataok == TRUE && lastChar != '\n')
+              {
+                if(AddToChunk(tc, "\r\n", 2) == FALSE)
+                  dataok = FALSE;
                 else
                   sentbytes += 2;
               }
-
-              PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, proclen, tr(MSG_TR_Sending));
             }
 
             D(DBF_NET, "transfered %ld bytes (raw: %ld bytes) error: %ld/%ld", sentbytes, mail->Size, tc->conn->abort, tc->conn->error);
 
             if(tc->conn->abort == FALSE && tc->conn->error == CONNECTERR_NO_ERROR)
             {
+              if(dataok == FALSE)
+              {
+                // the server rejected a chunk, but all responses have been
+                // received and the transaction can be reset
+                W(DBF_NET, "BDAT command failed");
+              }
               // check if any of the above getline() operations caused a ferror or
               // if we didn't walk until the end of the mail file
-              if(ferror(fh) != 0 || feof(fh) == 0)
+              else if(ferror(fh) != 0 || feof(fh) == 0)
               {
                 E(DBF_NET, "input mail file returned error state: ferror(fh)=%ld feof(fh)=%ld", ferror(fh), feof(fh));
 
@@ -1338,22 +1617,36 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
               }
               else
               {
-                // we have to flush the write buffer if this wasn't a error or
-                // abort situation
-                SendToHost(tc->conn, NULL, 0, TCPF_FLUSHONLY);
-
-                // send a CRLF+octet "\r\n." to signal that the data is finished.
-                // we do it here because if there was an error and we send it, the message
-                // will be send incomplete.
-                if(SendSMTPCommand(tc, SMTP_FINISH, NULL, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL)
+                BOOL finished;
+
+                if(chunking == TRUE)
+                {
+                  // send the remaining data as the last chunk and wait for
+                  // all outstanding responses
+                  finished = SendChunk(tc, TRUE);
+                }
+                else
+                {
+                  // we have to flush the write buffer if this wasn't a error or
+                  // abort situation
+                  SendToHost(tc->conn, NULL, 0, TCPF_FLUSHONLY);
+
+                  // send a CRLF+octet "\r\n." to signal that the data is finished.
+                  // we do it here because if there was an error and we send it, the message
+                  // will be send incomplete.
+                  finished = (SendSMTPCommand(tc, SMTP_FINISH, NULL, tr(MSG_ER_BADRESPONSE_SMTP)) != NULL);
+                }
+
+                if(finished == TRUE)
                 {
                   // put the transferStat to 100%
-                  PushMethodOnStack(tc->transferGroup, 3, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Sending));
+                  PushMethodOnStack(tc->transferGroup, 5, MUIM_TransferControlGroup_Update, TCG_SETMAX, tr(MSG_TR_Sending), tc->conn->minRTT, GetConnectionThroughput(tc->conn));
 
                   // now that we are at 100% we have to set the transfer Date of the message
                   GetSysTimeUTC(&mail->transDate);
 
                   result = email->DelSent ? 2 : 1;
+                  tc->conn->transferredMails++;
                   AppendToLogfile(LF_VERBOSE, 42, tr(MSG_LOG_SendingVerbose), AddrName(mail->To), mail->Subject, mail->Size);
                 }
               }
@@ -1362,13 +1655,16 @@ static int SendMessage(struct TransferContext *tc, struct Mail *mail)
             if(tc->conn->abort == TRUE || tc->conn->error != CONNECTERR_NO_ERROR)
               result = -1; // signal the caller that we aborted within the DATA part
           }
-        }
 
-        MA_FreeEMailStruct(email);
+          free(tc->chunkBuffer);
+          tc->chunkBuffer = NULL;
+        }
       }
-      else
-        ER_NewError(tr(MSG_ER_CantOpenFile), mailfile);
+
+      MA_FreeEMailStruct(email);
     }
+    else
+      ER_NewError(tr(MSG_ER_CantOpenFile), mailfile);
 
     fclose(fh);
   }
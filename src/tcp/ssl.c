@@ -80,6 +80,17 @@
 #define DEFAULT_CAPATH "PROGDIR:Resources/certificates"
 #define DEFAULT_CAFILE "PROGDIR:Resources/certificates/ca-bundle.crt"
 
+// per server cache of the last resumable TLS session and of the
+// fingerprint of the last certificate which passed all checks
+struct SSLSessionNode
+{
+  struct MinNode node;
+  char hostname[SIZE_HOST];        // the server's hostname
+  int port;                        // the server's port
+  SSL_SESSION *session;            // the session to be resumed or NULL
+  char fingerprint[SSL_DIGESTLEN]; // fingerprint of the verified server certificate
+};
+
 /// verify_callback
 // callback function that is called by AmiSSL/OpenSSL for every certification
 // verification step
@@ -455,7 +466,7 @@ static int CheckCertificateIdentity(const char *hostname, X509 *cert, char **ide
 ///
 /// GetCertFingerprint
 // extracts the fingerprint of a SSL certificate
-static int GetCertFingerprint(const struct Certificate *cert, char *digest)
+static int GetCertFingerprint(X509 *x509, char *digest)
 {
   unsigned char sha1[EVP_MAX_MD_SIZE];
   unsigned int len;
@@ -468,7 +479,7 @@ static int GetCertFingerprint(const struct Certificate *cert, char *digest)
    #error SHA digest length is not 20 bytes
   #endif
 
-  if(X509_digest(cert->subject, EVP_sha1(), sha1, &len) == 0 || len != SHA_DIGEST_LENGTH)
+  if(X509_digest(x509, EVP_sha1(), sha1, &len) == 0 || len != SHA_DIGEST_LENGTH)
   {
     ERR_clear_error();
     result = -1;
@@ -596,7 +607,7 @@ static struct Certificate *MakeCertificateChain(STACK_OF(X509) *chain)
     // Retrieve the cert identity; pass a dummy hostname to match.
     cert->identity = NULL;
     CheckCertificateIdentity(NULL, x5, &cert->identity);
-    GetCertFingerprint(cert, cert->fingerprint);
+    GetCertFingerprint(x5, cert->fingerprint);
     cert->issuerStr = ExtractReadableDN(cert->issuer_dn);
     if(ASN1Time2TimeVal(X509_get_notBefore(cert->subject), &tv))
       TimeVal2String(cert->notBefore, sizeof(cert->notBefore), &tv, DSS_DATETIME, TZC_NONE);
@@ -644,6 +655,128 @@ static void FreeCertificateChain(struct Certificate *top_cert)
   LEAVE();
 }
 
+///
+/// FindSSLSessionNode
+// find the session cache entry of a server and create a new one if requested,
+// the caller must hold G->connectionSemaphore
+static struct SSLSessionNode *FindSSLSessionNode(const struct MailServerNode *msn, const BOOL create)
+{
+  struct SSLSessionNode *result = NULL;
+  struct SSLSessionNode *sn;
+
+  ENTER();
+
+  IterateList(&G->sslSessionList, struct SSLSessionNode *, sn)
+  {
+    if(sn->port == msn->port && stricmp(sn->hostname, msn->hostname) == 0)
+    {
+      result = sn;
+      break;
+    }
+  }
+
+  if(result == NULL && create == TRUE)
+  {
+    if((result = calloc(1, sizeof(*result))) != NULL)
+    {
+      strlcpy(result->hostname, msn->hostname, sizeof(result->hostname));
+      result->port = msn->port;
+      AddTail((struct List *)&G->sslSessionList, (struct Node *)result);
+    }
+  }
+
+  RETURN(result);
+  return result;
+}
+
+///
+/// ForgetSSLSession
+// drop the cached session of a server, i.e. because resuming it failed
+static void ForgetSSLSession(const struct MailServerNode *msn)
+{
+  struct SSLSessionNode *sn;
+
+  ENTER();
+
+  ObtainSemaphore(G->connectionSemaphore);
+
+  if((sn = FindSSLSessionNode(msn, FALSE)) != NULL && sn->session != NULL)
+  {
+    D(DBF_NET, "forgetting SSL session of server '%s'", msn->hostname);
+    SSL_SESSION_free(sn->session);
+    sn->session = NULL;
+  }
+
+  ReleaseSemaphore(G->connectionSemaphore);
+
+  LEAVE();
+}
+
+///
+/// RememberSSLCertificate
+// remember the fingerprint of a server certificate which passed all checks
+static void RememberSSLCertificate(const struct MailServerNode *msn, const char *fingerprint)
+{
+  struct SSLSessionNode *sn;
+
+  ENTER();
+
+  ObtainSemaphore(G->connectionSemaphore);
+
+  if((sn = FindSSLSessionNode(msn, TRUE)) != NULL)
+    strlcpy(sn->fingerprint, fingerprint, sizeof(sn->fingerprint));
+
+  ReleaseSemaphore(G->connectionSemaphore);
+
+  LEAVE();
+}
+
+///
+/// StoreSSLSession
+// keep the session of a connection which is about to be closed so that
+// the next connection to the same server can resume it instead of doing
+// a full handshake
+void StoreSSLSession(struct Connection *conn)
+{
+  ENTER();
+
+  // only sessions which did not need any user interaction to accept
+  // the certificate may be resumed silently later
+  if(conn != NULL && conn->ssl != NULL && conn->server != NULL &&
+     conn->sslCertFailures == SSL_CERT_ERR_NONE)
+  {
+    SSL_SESSION *session;
+
+    if((session = SSL_get1_session(conn->ssl)) != NULL)
+    {
+      struct SSLSessionNode *sn;
+
+      if(SSL_SESSION_is_resumable(session) == 1)
+      {
+        ObtainSemaphore(G->connectionSemaphore);
+
+        if((sn = FindSSLSessionNode(conn->server, TRUE)) != NULL)
+        {
+          D(DBF_NET, "storing SSL session of server '%s'", conn->server->hostname);
+
+          if(sn->session != NULL)
+            SSL_SESSION_free(sn->session);
+
+          sn->session = session;
+          session = NULL;
+        }
+
+        ReleaseSemaphore(G->connectionSemaphore);
+      }
+
+      if(session != NULL)
+        SSL_SESSION_free(session);
+    }
+  }
+
+  LEAVE();
+}
+
 ///
 /// CheckCertificate
 // Verifies an SSL server certificate
@@ -793,6 +926,22 @@ BOOL MakeSecureConnection(struct Connection *conn)
           {
             BOOL errorState = FALSE;
             int res;
+            struct SSLSessionNode *sn;
+            char verifiedFingerprint[SSL_DIGESTLEN] = "";
+
+            // try to resume the last session with this server to avoid
+            // a full handshake and remember the last verified certificate
+            ObtainSemaphore(G->connectionSemaphore);
+
+            if((sn = FindSSLSessionNode(conn->server, FALSE)) != NULL)
+            {
+              if(sn->session != NULL && SSL_set_session(conn->ssl, sn->session) == 1)
+                D(DBF_NET, "trying to resume SSL session with server '%s'", conn->server->hostname);
+
+              strlcpy(verifiedFingerprint, sn->fingerprint, sizeof(verifiedFingerprint));
+            }
+
+            ReleaseSemaphore(G->connectionSemaphore);
 
             // 5) establish the ssl connection and take care of non-blocking IO
             D(DBF_NET, "connect SSL context %08lx", conn->ssl);
@@ -924,7 +1073,19 @@ BOOL MakeSecureConnection(struct Connection *conn)
               }
             }
 
-            if(errorState == FALSE)
+            if(errorState == TRUE)
+            {
+              // don't try the same session again next time
+              if(sn != NULL)
+                ForgetSSLSession(conn->server);
+            }
+            else if(SSL_session_reused(conn->ssl) == 1)
+            {
+              // the certificate was checked already when the session was established
+              D(DBF_NET, "resumed SSL session with server '%s'", conn->server->hostname);
+              secure = TRUE;
+            }
+            else
             {
               STACK_OF(X509) *chain;
 
@@ -935,69 +1096,87 @@ BOOL MakeSecureConnection(struct Connection *conn)
                 E(DBF_NET, "SSL server did not present certificate, chain=%08lx", chain);
               else
               {
-                struct Certificate *cert;
-
-                // 7) make a local copy of the certificate chain so that
-                //     we can bug the user with information on accepting/rejecting the certificate
-                cert = MakeCertificateChain(chain);
+                char fingerprint[SSL_DIGESTLEN];
 
-                // 8) now check the certificate chain for any errors and ask the user
-                //     how to proceed in case there were an certificate error found
-                if(CheckCertificate(conn, cert) != 0)
-                  E(DBF_NET, "SSL certificate checks failed");
-                else
+                // if the server presents the same certificate which already passed
+                // all checks before we can skip building and checking the chain again
+                if(conn->sslCertFailures == SSL_CERT_ERR_NONE && verifiedFingerprint[0] != '\0' &&
+                   GetCertFingerprint(sk_X509_value(chain, 0), fingerprint) == 0 &&
+                   strcmp(fingerprint, verifiedFingerprint) == 0)
                 {
-                  // everything was successfully so lets set the result
-                  // value of that function to true
+                  D(DBF_NET, "certificate of server '%s' is unchanged since last verification", conn->server->hostname);
                   secure = TRUE;
+                }
+                else
+                {
+                  struct Certificate *cert;
 
-                  // Debug information on the certificate
-                  #if defined(DEBUG)
+                  // 7) make a local copy of the certificate chain so that
+                  //     we can bug the user with information on accepting/rejecting the certificate
+                  cert = MakeCertificateChain(chain);
+
+                  // 8) now check the certificate chain for any errors and ask the user
+                  //     how to proceed in case there were an certificate error found
+                  if(CheckCertificate(conn, cert) != 0)
+                    E(DBF_NET, "SSL certificate checks failed");
+                  else
                   {
-                    char *x509buf;
-                    const SSL_CIPHER *cipher;
-                    X509 *server_cert;
-                    char peer_CN[256] = "";
+                    // everything was successfully so lets set the result
+                    // value of that function to true
+                    secure = TRUE;
+
+                    // remember certificates which passed without user interaction
+                    if(conn->sslCertFailures == SSL_CERT_ERR_NONE)
+                      RememberSSLCertificate(conn->server, cert->fingerprint);
 
-                    cipher = SSL_get_current_cipher(conn->ssl);
-                    if(cipher != NULL)
-                      D(DBF_NET, "%s connection using %s", SSL_CIPHER_get_version(cipher), SSL_get_cipher(conn->ssl));
+                    // Debug information on the certificate
+                    #if defined(DEBUG)
+                    {
+                      char *x509buf;
+                      const SSL_CIPHER *cipher;
+                      X509 *server_cert;
+                      char peer_CN[256] = "";
 
-                    D(DBF_NET, "Certificate verify result: %ld", SSL_get_verify_result(conn->ssl));
+                      cipher = SSL_get_current_cipher(conn->ssl);
+                      if(cipher != NULL)
+                        D(DBF_NET, "%s connection using %s", SSL_CIPHER_get_version(cipher), SSL_get_cipher(conn->ssl));
 
-                    if((server_cert = SSL_get_peer_certificate(conn->ssl)) == NULL)
-                      E(DBF_NET, "SSL_get_peer_certificate() error!");
+                      D(DBF_NET, "Certificate verify result: %ld", SSL_get_verify_result(conn->ssl));
 
-                    D(DBF_NET, "Server public key is %ld bits", EVP_PKEY_bits(X509_get_pubkey(server_cert)));
+                      if((server_cert = SSL_get_peer_certificate(conn->ssl)) == NULL)
+                        E(DBF_NET, "SSL_get_peer_certificate() error!");
 
-                    X509_NAME_get_text_by_NID(X509_get_subject_name(server_cert), NID_commonName, peer_CN, sizeof(peer_CN));
-                    D(DBF_NET, "peer_commonName: '%s'", peer_CN);
+                      D(DBF_NET, "Server public key is %ld bits", EVP_PKEY_bits(X509_get_pubkey(server_cert)));
 
-                    #define X509BUFSIZE 4096
-                    if((x509buf = calloc(1, X509BUFSIZE)) != NULL)
-                    {
-                      D(DBF_NET, "Server certificate:");
+                      X509_NAME_get_text_by_NID(X509_get_subject_name(server_cert), NID_commonName, peer_CN, sizeof(peer_CN));
+                      D(DBF_NET, "peer_commonName: '%s'", peer_CN);
 
-                      if(!(X509_NAME_oneline(X509_get_subject_name(server_cert), x509buf, X509BUFSIZE)))
-                        E(DBF_NET, "X509_NAME_oneline...[subject] error!");
+                      #define X509BUFSIZE 4096
+                      if((x509buf = calloc(1, X509BUFSIZE)) != NULL)
+                      {
+                        D(DBF_NET, "Server certificate:");
 
-                      D(DBF_NET, "subject: %s", x509buf);
+                        if(!(X509_NAME_oneline(X509_get_subject_name(server_cert), x509buf, X509BUFSIZE)))
+                          E(DBF_NET, "X509_NAME_oneline...[subject] error!");
 
-                      if(!(X509_NAME_oneline(X509_get_issuer_name(server_cert), x509buf, X509BUFSIZE)))
-                        E(DBF_NET, "X509_NAME_oneline...[issuer] error!");
+                        D(DBF_NET, "subject: %s", x509buf);
 
-                      D(DBF_NET, "issuer:  %s", x509buf);
+                        if(!(X509_NAME_oneline(X509_get_issuer_name(server_cert), x509buf, X509BUFSIZE)))
+                          E(DBF_NET, "X509_NAME_oneline...[issuer] error!");
 
-                      free(x509buf);
-                    }
+                        D(DBF_NET, "issuer:  %s", x509buf);
 
-                    if(server_cert != NULL)
-                      X509_free(server_cert);
+                        free(x509buf);
+                      }
+
+                      if(server_cert != NULL)
+                        X509_free(server_cert);
+                    }
+                    #endif
                   }
-                  #endif
-                }
 
-                FreeCertificateChain(cert);
+                  FreeCertificateChain(cert);
+                }
               }
             }
           }
@@ -1031,6 +1210,8 @@ BOOL InitSSLConnections(void)
   BOOL result = FALSE;
   ENTER();
 
+  NewMinList(&G->sslSessionList);
+
   // try to open amisslmaster.library first
   if((AmiSSLMasterBase = OpenLibrary("amisslmaster.library", AMISSLMASTER_VERSION)) != NULL &&
      LIB_VERSION_IS_AT_LEAST(AmiSSLMasterBase, AMISSLMASTER_VERSION, AMISSLMASTER_REVISION) &&
@@ -1112,7 +1293,10 @@ BOOL InitSSLConnections(void)
             //    function wheter the connection should continue or if it should be terminated right away.
             SSL_CTX_set_verify(G->sslCtx, SSL_VERIFY_PEER, ENTRY(verify_callback));
 
-            // 7) set the ciphers we want to use and exclude unwanted ones
+            // 7) sessions are cached per server by ourself, see StoreSSLSession()
+            SSL_CTX_set_session_cache_mode(G->sslCtx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+            // 8) set the ciphers we want to use and exclude unwanted ones
             if(rc != 0 && (rc = SSL_CTX_set_cipher_list(G->sslCtx, C->DefaultSSLCiphers)) == 0)
                E(DBF_NET, "AmiSSL: SSL_CTX_set_cipher_list() error!");
             else
@@ -1154,6 +1338,19 @@ void CleanupSSLConnections(void)
   // cleanup the SSL connection context
   if(G->sslCtx != NULL)
   {
+    struct SSLSessionNode *sn;
+    struct SSLSessionNode *next;
+
+    // free all cached sessions before the context they belong to
+    SafeIterateList(&G->sslSessionList, struct SSLSessionNode *, sn, next)
+    {
+      if(sn->session != NULL)
+        SSL_SESSION_free(sn->session);
+
+      free(sn);
+    }
+    NewMinList(&G->sslSessionList);
+
     SSL_CTX_free(G->sslCtx);
     G->sslCtx = NULL;
   }
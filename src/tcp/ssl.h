@@ -73,5 +73,6 @@ struct Certificate
 BOOL InitSSLConnections(void);
 void CleanupSSLConnections(void);
 BOOL MakeSecureConnection(struct Connection *conn);
+void StoreSSLSession(struct Connection *conn);
 
 #endif /* SSL_H */
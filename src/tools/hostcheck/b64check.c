@@ -0,0 +1,559 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ Host side check of mime/base64.c and the base64 stage of mime/decodechain.c
+
+ Random data is encoded and decoded by the current functions and by the
+ previous implementation (see reference/base64.c), and the results must be
+ byte-identical:
+
+ - base64encode() and base64decode() on memory buffers
+ - base64encode_file() without LF conversion
+ - the decoding of base64 files, which is now done by decodechain_file()
+   instead of base64decode_file()
+
+ Two deliberate changes are checked against the expected result instead of
+ the previous implementation, which had chunk boundary bugs here:
+
+ - base64encode_file() with LF->CRLF conversion must produce the same as
+   encoding the already converted data
+ - decoding with CRLF->LF normalisation must produce the decoded data with
+   every CRLF replaced by LF
+
+ The number of cases in which the previous implementation differs is
+ reported for information. Finally truncated input must be decoded as far
+ as possible and flagged as problem.
+
+ With -b both implementations are timed on 20 MB of data.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mime/base64.h"
+#include "mime/decodechain.h"
+
+#include "common.h"
+
+// the previous implementation, see reference/
+int old_base64encode(char **out, const char *in, size_t inlen);
+int old_base64decode(char **out, const char *in, size_t inlen);
+long old_base64encode_file(FILE *in, FILE *out, BOOL convLF);
+long old_base64decode_file(FILE *in, FILE *out, struct codeset *srcCodeset, BOOL isText, BOOL convCRLF);
+
+#define MAX_DATA   (200*1024)
+#define BENCH_DATA (20*1024*1024)
+
+// a growing memory buffer, also used as sink of the decoding chain
+struct Buffer
+{
+  char *data;
+  size_t length;
+  size_t size;
+};
+
+// the cases in which the previous implementation differed
+static ULONG oldEncodeDiffs;
+static ULONG oldDecodeDiffs;
+static ULONG oldTruncatedFails;
+
+/// Append
+// append data to a buffer
+static BOOL Append(const char *data, size_t len, void *userData)
+{
+  struct Buffer *buf = userData;
+  BOOL result = TRUE;
+
+  if(buf->length + len > buf->size)
+  {
+    size_t size = (buf->length + len) * 2;
+    char *data = realloc(buf->data, size);
+
+    if(data != NULL)
+    {
+      buf->data = data;
+      buf->size = size;
+    }
+    else
+      result = FALSE;
+  }
+
+  if(result == TRUE)
+  {
+    memcpy(&buf->data[buf->length], data, len);
+    buf->length += len;
+  }
+
+  return result;
+}
+
+///
+/// TempFile
+// create a temporary file containing the given data
+static FILE *TempFile(const char *data, size_t len)
+{
+  FILE *fh;
+
+  if((fh = tmpfile()) != NULL)
+  {
+    fwrite(data, 1, len, fh);
+    rewind(fh);
+  }
+
+  return fh;
+}
+
+///
+/// ReadFile
+// read the complete contents of a file into a buffer
+static void ReadFile(FILE *fh, struct Buffer *buf)
+{
+  char block[4096];
+  size_t read;
+
+  buf->length = 0;
+  rewind(fh);
+
+  while((read = fread(block, 1, sizeof(block), fh)) > 0)
+    Append(block, read, buf);
+}
+
+///
+/// SameData
+//
+static BOOL SameData(const struct Buffer *buf, const char *data, size_t len)
+{
+  return buf->length == len && (len == 0 || memcmp(buf->data, data, len) == 0);
+}
+
+///
+/// RandomData
+// random binary data, text with line breaks or data full of line breaks
+static size_t RandomData(char *data)
+{
+  size_t len;
+  size_t i;
+
+  // many short ones and some long ones to cross the block boundaries
+  // of both implementations
+  if(Random() % 2 == 0)
+    len = Random() % 300;
+  else
+    len = Random() % MAX_DATA;
+
+  switch(Random() % 3)
+  {
+    case 0:
+    {
+      for(i = 0; i < len; i++)
+        data[i] = Random();
+    }
+    break;
+
+    case 1:
+    {
+      for(i = 0; i < len; i++)
+      {
+        ULONG r = Random() % 40;
+
+        data[i] = (r == 0) ? '\n' : (r == 1) ? '\r' : 'a' + r % 26;
+      }
+    }
+    break;
+
+    default:
+    {
+      static const char chars[] = "\r\n\r\nxy";
+
+      for(i = 0; i < len; i++)
+        data[i] = chars[Random() % (sizeof(chars) - 1)];
+    }
+    break;
+  }
+
+  return len;
+}
+
+///
+/// ConvertLF
+// convert each LF to CRLF like the encoder does
+static size_t ConvertLF(const char *in, size_t len, char *out)
+{
+  size_t i;
+  size_t o = 0;
+
+  for(i = 0; i < len; i++)
+  {
+    if(in[i] == '\n')
+      out[o++] = '\r';
+    out[o++] = in[i];
+  }
+
+  return o;
+}
+
+///
+/// NormaliseCRLF
+// replace each CRLF by LF like the decoding chain does
+static size_t NormaliseCRLF(const char *in, size_t len, char *out)
+{
+  size_t i;
+  size_t o = 0;
+
+  for(i = 0; i < len; i++)
+  {
+    if(in[i] != '\r' || i + 1 == len || in[i+1] != '\n')
+      out[o++] = in[i];
+  }
+
+  return o;
+}
+
+///
+/// DecodeChain
+// decode a file through the decoding chain like RE_DecodeStream() does
+static long DecodeChain(FILE *in, BOOL convCRLF, struct Buffer *out, BOOL *problem)
+{
+  struct DecodeChain dc;
+  long result = -1;
+
+  out->length = 0;
+
+  if(decodechain_init(&dc, DCT_BASE64, convCRLF == TRUE ? DCF_CRLF : 0, NULL, Append, out) == TRUE)
+  {
+    if(decodechain_file(&dc, in, -1) == TRUE)
+      result = dc.decoded;
+
+    *problem = dc.dec.b64.problem;
+    decodechain_cleanup(&dc);
+  }
+
+  return result;
+}
+
+///
+/// CheckStrings
+// compare base64encode() and base64decode() with the previous implementation
+static void CheckStrings(const char *data, size_t len)
+{
+  char *enc = NULL;
+  char *oldEnc = NULL;
+  int encLen = base64encode(&enc, data, len);
+  int oldEncLen = old_base64encode(&oldEnc, data, len);
+
+  if(encLen != oldEncLen || (encLen > 0 && memcmp(enc, oldEnc, encLen) != 0))
+    Fail("base64encode() of %lu bytes differs from the previous implementation", (unsigned long)len);
+  else if(encLen > 0)
+  {
+    char *dec = NULL;
+    char *oldDec = NULL;
+    int decLen = base64decode(&dec, enc, encLen);
+    int oldDecLen = old_base64decode(&oldDec, enc, encLen);
+
+    if(decLen != oldDecLen || (decLen > 0 && memcmp(dec, oldDec, decLen) != 0))
+      Fail("base64decode() of %d characters differs from the previous implementation", encLen);
+    else if(decLen != (int)len || memcmp(dec, data, len) != 0)
+      Fail("base64decode() doesn't return the data encoded by base64encode()");
+
+    free(dec);
+    free(oldDec);
+  }
+
+  free(enc);
+  free(oldEnc);
+}
+
+///
+/// CheckFiles
+// compare the file encoding and decoding with the previous implementation
+static void CheckFiles(const char *data, size_t len, char *conv)
+{
+  struct Buffer enc = { NULL, 0, 0 };
+  struct Buffer expected = { NULL, 0, 0 };
+  struct Buffer dec = { NULL, 0, 0 };
+  FILE *in = TempFile(data, len);
+  FILE *out = tmpfile();
+  FILE *oldOut = tmpfile();
+  long result;
+  long oldResult;
+  BOOL problem = FALSE;
+  size_t convLen;
+
+  // plain encoding
+  result = base64encode_file(in, out, FALSE);
+  rewind(in);
+  oldResult = old_base64encode_file(in, oldOut, FALSE);
+  ReadFile(out, &enc);
+  ReadFile(oldOut, &expected);
+
+  if(result != oldResult || SameData(&enc, expected.data, expected.length) == FALSE)
+    Fail("base64encode_file() of %lu bytes differs from the previous implementation", (unsigned long)len);
+
+  // decoding, both implementations must reproduce the data
+  rewind(out);
+  result = DecodeChain(out, FALSE, &dec, &problem);
+
+  if(result != (long)len || problem == TRUE || SameData(&dec, data, len) == FALSE)
+    Fail("decoding %lu encoded bytes failed", (unsigned long)len);
+
+  fclose(oldOut);
+  oldOut = tmpfile();
+  rewind(out);
+  oldResult = old_base64decode_file(out, oldOut, NULL, FALSE, FALSE);
+  ReadFile(oldOut, &expected);
+
+  if(oldResult != result || SameData(&dec, expected.data, expected.length) == FALSE)
+    Fail("decoding %lu encoded bytes differs from the previous implementation", (unsigned long)len);
+
+  // encoding with LF->CRLF conversion must equal the encoding of the
+  // converted data
+  convLen = ConvertLF(data, len, conv);
+  fclose(in);
+  in = TempFile(conv, convLen);
+  fclose(oldOut);
+  oldOut = tmpfile();
+  old_base64encode_file(in, oldOut, FALSE);
+  ReadFile(oldOut, &expected);
+
+  fclose(in);
+  in = TempFile(data, len);
+  fclose(out);
+  out = tmpfile();
+  base64encode_file(in, out, TRUE);
+  ReadFile(out, &enc);
+
+  if(SameData(&enc, expected.data, expected.length) == FALSE)
+    Fail("base64encode_file() of %lu bytes with LF conversion is wrong", (unsigned long)len);
+
+  rewind(in);
+  fclose(oldOut);
+  oldOut = tmpfile();
+  old_base64encode_file(in, oldOut, TRUE);
+  ReadFile(oldOut, &dec);
+
+  if(SameData(&dec, expected.data, expected.length) == FALSE)
+    oldEncodeDiffs++;
+
+  // decoding with CRLF->LF normalisation
+  convLen = NormaliseCRLF(conv, convLen, conv);
+  rewind(out);
+  DecodeChain(out, TRUE, &dec, &problem);
+
+  if(SameData(&dec, conv, convLen) == FALSE)
+    Fail("decoding %lu encoded bytes with CRLF normalisation is wrong", (unsigned long)len);
+
+  rewind(out);
+  fclose(oldOut);
+  oldOut = tmpfile();
+  old_base64decode_file(out, oldOut, NULL, FALSE, TRUE);
+  ReadFile(oldOut, &dec);
+
+  if(SameData(&dec, conv, convLen) == FALSE)
+    oldDecodeDiffs++;
+
+  fclose(in);
+  fclose(out);
+  fclose(oldOut);
+  free(enc.data);
+  free(expected.data);
+  free(dec.data);
+}
+
+///
+/// CheckTruncated
+// truncated data must be decoded as far as possible and flagged
+static void CheckTruncated(const char *data, size_t len)
+{
+  char *enc = NULL;
+  int encLen;
+
+  // data whose encoding doesn't end with padding characters
+  len -= len % 3;
+
+  if(len > 0 && (encLen = base64encode(&enc, data, len)) > 0)
+  {
+    struct Buffer dec = { NULL, 0, 0 };
+    size_t cut = 1 + Random() % 3;
+    FILE *in = TempFile(enc, encLen - cut);
+    FILE *out;
+    BOOL problem = FALSE;
+    long result = DecodeChain(in, FALSE, &dec, &problem);
+
+    // the 4 - cut characters left of the last quantum yield 3 - cut bytes
+    if(result < 0 || problem == FALSE)
+      Fail("truncated data of %lu bytes not flagged", (unsigned long)len);
+    else if(dec.length != len - cut)
+      Fail("truncated data of %lu bytes decoded to %lu bytes", (unsigned long)len, (unsigned long)dec.length);
+    else if(memcmp(dec.data, data, dec.length) != 0)
+      Fail("truncated data of %lu bytes decoded wrongly", (unsigned long)len);
+
+    // the previous implementation gave up on such data
+    rewind(in);
+    if((out = tmpfile()) != NULL)
+    {
+      if(old_base64decode_file(in, out, NULL, FALSE, FALSE) == -1)
+        oldTruncatedFails++;
+
+      fclose(out);
+    }
+
+    fclose(in);
+    free(dec.data);
+  }
+
+  free(enc);
+}
+
+///
+/// Benchmark
+// time both implementations on a large attachment
+static void Benchmark(void)
+{
+  char *data;
+
+  if((data = malloc(BENCH_DATA)) != NULL)
+  {
+    struct Buffer dec = { NULL, 0, 0 };
+    FILE *in;
+    FILE *enc = tmpfile();
+    FILE *out = tmpfile();
+    char *str = NULL;
+    char *oldStr = NULL;
+    char *decoded = NULL;
+    char *oldDecoded = NULL;
+    double start;
+    BOOL problem;
+    size_t i;
+
+    for(i = 0; i < BENCH_DATA; i++)
+      data[i] = Random();
+
+    in = TempFile(data, BENCH_DATA);
+
+    printf("%d MB of binary data\n", BENCH_DATA / (1024*1024));
+
+    start = Now();
+    base64encode_file(in, enc, FALSE);
+    ReportMBs("base64encode_file()", Now() - start, BENCH_DATA);
+
+    rewind(in);
+    start = Now();
+    old_base64encode_file(in, out, FALSE);
+    ReportMBs("base64encode_file(), previous", Now() - start, BENCH_DATA);
+
+    rewind(enc);
+    start = Now();
+    DecodeChain(enc, FALSE, &dec, &problem);
+    ReportMBs("decodechain_file()", Now() - start, BENCH_DATA);
+
+    rewind(enc);
+    rewind(out);
+    start = Now();
+    old_base64decode_file(enc, out, NULL, FALSE, FALSE);
+    ReportMBs("base64decode_file(), previous", Now() - start, BENCH_DATA);
+
+    start = Now();
+    base64encode(&str, data, BENCH_DATA);
+    ReportMBs("base64encode()", Now() - start, BENCH_DATA);
+
+    start = Now();
+    old_base64encode(&oldStr, data, BENCH_DATA);
+    ReportMBs("base64encode(), previous", Now() - start, BENCH_DATA);
+
+    start = Now();
+    base64decode(&decoded, str, strlen(str));
+    ReportMBs("base64decode()", Now() - start, BENCH_DATA);
+
+    start = Now();
+    old_base64decode(&oldDecoded, str, strlen(str));
+    ReportMBs("base64decode(), previous", Now() - start, BENCH_DATA);
+
+    free(oldDecoded);
+    free(decoded);
+    free(oldStr);
+    free(str);
+    free(dec.data);
+    fclose(out);
+    fclose(enc);
+    fclose(in);
+    free(data);
+  }
+  else
+    Fail("out of memory");
+}
+
+///
+/// main
+//
+int main(int argc, char **argv)
+{
+  struct CheckOptions opts;
+  const char *name = (strrchr(argv[0], '/') != NULL) ? strrchr(argv[0], '/') + 1 : argv[0];
+  char *data = malloc(MAX_DATA);
+  char *conv = malloc(MAX_DATA*2);
+  int result = 1;
+
+  if(data != NULL && conv != NULL && ParseOptions(argc, argv, &opts, 1000) == TRUE)
+  {
+    ULONG n;
+
+    printf("%s: %lu random encodings and decodings\n", name, (unsigned long)opts.iterations);
+
+    for(n = 0; n < opts.iterations; n++)
+    {
+      size_t len = RandomData(data);
+
+      CheckStrings(data, len);
+      CheckFiles(data, len, conv);
+      CheckTruncated(data, len);
+    }
+
+    // for information only, these are the fixed bugs of the previous implementation
+    printf("%s: previous implementation: %lu LF conversions and %lu CRLF normalisations wrong, %lu truncated inputs rejected\n",
+           name, (unsigned long)oldEncodeDiffs, (unsigned long)oldDecodeDiffs, (unsigned long)oldTruncatedFails);
+
+    if(opts.benchmark == TRUE)
+      Benchmark();
+
+    if(Failures() == 0)
+    {
+      printf("%s: OK\n", name);
+      result = 0;
+    }
+    else
+      printf("%s: %lu FAILURES\n", name, (unsigned long)Failures());
+  }
+
+  free(conv);
+  free(data);
+
+  return result;
+}
+
+///
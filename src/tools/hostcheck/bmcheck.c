@@ -0,0 +1,301 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ Host side check of BoyerMooreSearch.c
+
+ The search is compared against a naive search on random strings. Each
+ string ends right in front of an inaccessible page, so a search reading
+ beyond the terminating NUL byte crashes the check. Built with SSE2 or NEON
+ enabled this covers the SIMD candidate scan, built as bmcheck-scalar it
+ covers the plain Boyer/Moore loop used on m68k and PPC.
+
+ With -b the search is timed against the previous implementation, a naive
+ search and strstr() on a large text.
+*/
+
+#include <ctype.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BoyerMooreSearch.h"
+
+#include "common.h"
+
+// the previous implementation, see reference/
+struct OldBoyerMooreContext;
+struct OldBoyerMooreContext *OldBoyerMooreInit(const char *pattern, const BOOL caseSensitive);
+void OldBoyerMooreCleanup(struct OldBoyerMooreContext *bmc);
+const char *OldBoyerMooreSearch(const struct OldBoyerMooreContext *bmc, const char *string);
+
+#define MAX_STRING  300
+#define MAX_PATTERN 40
+#define TEXT_SIZE   (8*1024*1024)
+
+/// NaiveSearch
+// the leftmost match of pattern in string, checked position by position
+static const char *NaiveSearch(const char *pattern, const char *string, BOOL caseSensitive)
+{
+  const char *result = NULL;
+  size_t plen = strlen(pattern);
+  size_t slen = strlen(string);
+  size_t i;
+
+  for(i = 0; result == NULL && i + plen <= slen; i++)
+  {
+    size_t j;
+
+    for(j = 0; j < plen; j++)
+    {
+      unsigned char s = string[i+j];
+      unsigned char p = pattern[j];
+
+      if(caseSensitive == TRUE ? s != p : tolower(s) != tolower(p))
+        break;
+    }
+
+    if(j == plen)
+      result = &string[i];
+  }
+
+  return result;
+}
+
+///
+/// RandomString
+// fill a string from a small alphabet to get lots of partial matches
+static void RandomString(char *string, size_t len)
+{
+  // upper and lower case letters as well as Latin-1 characters which
+  // only have a case in some locales
+  static const char alphabet[] = "aAbBzZ \xe4\xc4\xf6\xd6\xff";
+  size_t i;
+
+  for(i = 0; i < len; i++)
+    string[i] = alphabet[Random() % (sizeof(alphabet) - 1)];
+
+  string[len] = '\0';
+}
+
+///
+/// CheckRandom
+// compare the search with the naive search on random strings
+static void CheckRandom(ULONG iterations)
+{
+  char *guarded;
+  char pattern[MAX_PATTERN+1];
+  ULONG n;
+
+  guarded = GuardedAlloc(MAX_STRING+1);
+
+  for(n = 0; n < iterations; n++)
+  {
+    size_t slen = Random() % (MAX_STRING + 1);
+    size_t plen = Random() % (MAX_PATTERN + 1);
+    BOOL caseSensitive = (Random() & 1) ? TRUE : FALSE;
+    // place the string right in front of the guard page
+    char *string = guarded + MAX_STRING - slen;
+    struct BoyerMooreContext *bmc;
+
+    RandomString(string, slen);
+
+    // take every second pattern from the string, so that it is found
+    if((Random() & 1) && plen <= slen)
+    {
+      size_t start = Random() % (slen - plen + 1);
+
+      memcpy(pattern, &string[start], plen);
+      pattern[plen] = '\0';
+
+      // change the case of one character
+      if(plen > 0 && caseSensitive == FALSE)
+      {
+        size_t i = Random() % plen;
+
+        pattern[i] = islower((unsigned char)pattern[i]) ? toupper((unsigned char)pattern[i]) : tolower((unsigned char)pattern[i]);
+      }
+    }
+    else
+      RandomString(pattern, plen);
+
+    if((bmc = BoyerMooreInit(pattern, caseSensitive)) != NULL)
+    {
+      const char *expected = NaiveSearch(pattern, string, caseSensitive);
+      const char *found = BoyerMooreSearch(bmc, string);
+
+      if(found != expected)
+      {
+        Fail("pattern '%s' in '%s' (%s): found at %ld, expected at %ld", pattern, string,
+             caseSensitive == TRUE ? "case sensitive" : "case insensitive",
+             found != NULL ? (long)(found - string) : -1L, expected != NULL ? (long)(expected - string) : -1L);
+      }
+
+      BoyerMooreCleanup(bmc);
+    }
+    else
+      Fail("BoyerMooreInit('%s') failed", pattern);
+  }
+
+  GuardedFree(guarded, MAX_STRING+1);
+}
+
+///
+/// Benchmark
+// time the searches for patterns which are not contained in a large text
+static void Benchmark(void)
+{
+  char *text;
+
+  if((text = malloc(TEXT_SIZE+1)) != NULL)
+  {
+    size_t pos = 0;
+    int plen;
+
+    // words of lower case letters, without any digits
+    while(pos < TEXT_SIZE)
+    {
+      size_t wlen = 1 + Random() % 10;
+
+      while(wlen-- > 0 && pos < TEXT_SIZE)
+        text[pos++] = 'a' + Random() % 26;
+
+      if(pos < TEXT_SIZE)
+        text[pos++] = (Random() % 12 == 0) ? '\n' : ' ';
+    }
+    text[TEXT_SIZE] = '\0';
+
+    for(plen = 3; plen <= 24; plen *= 2)
+    {
+      char pattern[MAX_PATTERN+1];
+      int cs;
+
+      // take the pattern from the text, but replace its middle character by a
+      // digit, so the first and last characters still produce candidates
+      memcpy(pattern, &text[TEXT_SIZE / 2], plen);
+      pattern[plen] = '\0';
+      pattern[plen / 2] = '7';
+
+      printf("pattern length %d\n", plen);
+
+      for(cs = 1; cs >= 0; cs--)
+      {
+        BOOL caseSensitive = (cs == 1) ? TRUE : FALSE;
+        const char *mode = caseSensitive == TRUE ? "case sensitive" : "case insensitive";
+        struct BoyerMooreContext *bmc = BoyerMooreInit(pattern, caseSensitive);
+        struct OldBoyerMooreContext *old = OldBoyerMooreInit(pattern, caseSensitive);
+        char name[64];
+        double start;
+        int rounds;
+        int i;
+
+        // a few rounds to get measurable times
+        rounds = 16;
+
+        start = Now();
+        for(i = 0; i < rounds; i++)
+        {
+          if(BoyerMooreSearch(bmc, text) != NULL)
+            Fail("pattern '%s' found in text", pattern);
+        }
+        snprintf(name, sizeof(name), "BoyerMooreSearch, %s", mode);
+        ReportMBs(name, Now() - start, (double)rounds * TEXT_SIZE);
+
+        start = Now();
+        for(i = 0; i < rounds; i++)
+        {
+          if(OldBoyerMooreSearch(old, text) != NULL)
+            Fail("pattern '%s' found in text by the old search", pattern);
+        }
+        snprintf(name, sizeof(name), "previous implementation, %s", mode);
+        ReportMBs(name, Now() - start, (double)rounds * TEXT_SIZE);
+
+        start = Now();
+        for(i = 0; i < rounds; i++)
+        {
+          if(NaiveSearch(pattern, text, caseSensitive) != NULL)
+            Fail("pattern '%s' found in text by the naive search", pattern);
+        }
+        snprintf(name, sizeof(name), "naive search, %s", mode);
+        ReportMBs(name, Now() - start, (double)rounds * TEXT_SIZE);
+
+        if(caseSensitive == TRUE)
+        {
+          start = Now();
+          for(i = 0; i < rounds; i++)
+          {
+            if(strstr(text, pattern) != NULL)
+              Fail("pattern '%s' found in text by strstr()", pattern);
+          }
+          ReportMBs("strstr()", Now() - start, (double)rounds * TEXT_SIZE);
+        }
+
+        OldBoyerMooreCleanup(old);
+        BoyerMooreCleanup(bmc);
+      }
+    }
+
+    free(text);
+  }
+  else
+    Fail("out of memory");
+}
+
+///
+/// main
+//
+int main(int argc, char **argv)
+{
+  struct CheckOptions opts;
+  const char *name = (strrchr(argv[0], '/') != NULL) ? strrchr(argv[0], '/') + 1 : argv[0];
+  int result = 1;
+
+  if(ParseOptions(argc, argv, &opts, 200000) == TRUE)
+  {
+    if(opts.locale != NULL && setlocale(LC_CTYPE, opts.locale) == NULL)
+      printf("locale '%s' is not available, using the C locale\n", opts.locale);
+
+    printf("%s: %lu random searches\n", name, (unsigned long)opts.iterations);
+    CheckRandom(opts.iterations);
+
+    if(opts.benchmark == TRUE)
+      Benchmark();
+
+    if(Failures() == 0)
+    {
+      printf("%s: OK\n", name);
+      result = 0;
+    }
+    else
+      printf("%s: %lu FAILURES\n", name, (unsigned long)Failures());
+  }
+
+  return result;
+}
+
+///
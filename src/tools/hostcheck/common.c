@@ -0,0 +1,230 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <proto/codesets.h>
+
+#include "common.h"
+
+static struct Config config;
+struct Config *C = &config;
+
+static ULONG randomState = 1;
+static ULONG failures = 0;
+
+/// SeedRandom
+//
+void SeedRandom(ULONG seed)
+{
+  randomState = (seed != 0) ? seed : 1;
+}
+
+///
+/// Random
+//
+ULONG Random(void)
+{
+  ULONG x = randomState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randomState = x;
+
+  return x;
+}
+
+///
+/// Now
+//
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+///
+/// GuardedAlloc
+//
+char *GuardedAlloc(size_t size)
+{
+  char *result = NULL;
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t mapSize = (size + pageSize - 1) / pageSize * pageSize + pageSize;
+  char *map;
+
+  if((map = mmap(NULL, mapSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) != MAP_FAILED)
+  {
+    // the last page catches any access behind the buffer
+    if(mprotect(map + mapSize - pageSize, pageSize, PROT_NONE) == 0)
+      result = map + mapSize - pageSize - size;
+    else
+      munmap(map, mapSize);
+  }
+
+  return result;
+}
+
+///
+/// GuardedFree
+//
+void GuardedFree(char *buffer, size_t size)
+{
+  if(buffer != NULL)
+  {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t mapSize = (size + pageSize - 1) / pageSize * pageSize + pageSize;
+
+    munmap(buffer + size + pageSize - mapSize, mapSize);
+  }
+}
+
+///
+/// Fail
+//
+void Fail(const char *format, ...)
+{
+  failures++;
+
+  // don't flood the output if something is seriously broken
+  if(failures <= 10)
+  {
+    va_list args;
+
+    fputs("FAIL: ", stdout);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fputc('\n', stdout);
+  }
+}
+
+///
+/// Failures
+//
+ULONG Failures(void)
+{
+  return failures;
+}
+
+///
+/// ReportMBs
+//
+void ReportMBs(const char *name, double seconds, double bytes)
+{
+  printf("  %-40s %10.1f MB/s\n", name, seconds > 0 ? bytes / seconds / (1024*1024) : 0);
+}
+
+///
+/// ReportOps
+//
+void ReportOps(const char *name, double seconds, double ops)
+{
+  printf("  %-40s %10.2f Mops/s %8.1f ns/op\n", name, seconds > 0 ? ops / seconds / 1e6 : 0, ops > 0 ? seconds * 1e9 / ops : 0);
+}
+
+///
+/// ParseOptions
+//
+BOOL ParseOptions(int argc, char **argv, struct CheckOptions *opts, ULONG defaultIterations)
+{
+  BOOL result = TRUE;
+  int i;
+
+  opts->benchmark = FALSE;
+  opts->iterations = defaultIterations;
+  opts->seed = 1;
+  opts->locale = NULL;
+
+  for(i = 1; i < argc && result == TRUE; i++)
+  {
+    if(strcmp(argv[i], "-b") == 0)
+      opts->benchmark = TRUE;
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      opts->iterations = strtoul(argv[++i], NULL, 0);
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      opts->seed = strtoul(argv[++i], NULL, 0);
+    else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+      opts->locale = argv[++i];
+    else
+    {
+      fprintf(stderr, "usage: %s [-b] [-n iterations] [-s seed] [-l locale]\n", argv[0]);
+      result = FALSE;
+    }
+  }
+
+  SeedRandom(opts->seed);
+
+  return result;
+}
+
+///
+/// ToLowerCase
+// the function of YAM_UT.c used by the reference implementations
+void ToLowerCase(char *str)
+{
+  char c;
+
+  while((c = *str) != '\0')
+    *str++ = tolower(c);
+}
+
+///
+/// CodesetsFindBest
+// codesets.library is not available on the host
+struct codeset *CodesetsFindBest(UNUSED ULONG tag, ...)
+{
+  return NULL;
+}
+
+///
+/// CodesetsUTF8Create
+// codesets.library is not available on the host
+UTF8 *CodesetsUTF8Create(UNUSED ULONG tag, ...)
+{
+  return NULL;
+}
+
+///
+/// CodesetsFreeA
+// codesets.library is not available on the host
+void CodesetsFreeA(UNUSED APTR obj, UNUSED void *attrs)
+{
+}
+
+///
@@ -0,0 +1,68 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+#include <exec/types.h>
+
+// helper functions shared by all host side checks
+
+// a small xorshift generator, so that the checks produce the same data on
+// every host for a given seed
+void SeedRandom(ULONG seed);
+ULONG Random(void);
+
+// wall clock time in seconds
+double Now(void);
+
+// allocate a buffer of size bytes which is immediately followed by an
+// inaccessible page, so reading beyond its end crashes the check
+char *GuardedAlloc(size_t size);
+void GuardedFree(char *buffer, size_t size);
+
+// count a failed check and print a message for the first failures
+void Fail(const char *format, ...);
+ULONG Failures(void);
+
+// print a benchmark result as throughput in MB/s or operations per second
+void ReportMBs(const char *name, double seconds, double bytes);
+void ReportOps(const char *name, double seconds, double ops);
+
+// the command line options understood by all checks
+struct CheckOptions
+{
+  BOOL benchmark;     // -b: run the benchmarks as well
+  ULONG iterations;   // -n: number of random checks
+  ULONG seed;         // -s: seed of the random generator
+  const char *locale; // -l: locale for case insensitive comparisons
+};
+
+// parse the common command line options, returns FALSE on unknown options
+BOOL ParseOptions(int argc, char **argv, struct CheckOptions *opts, ULONG defaultIterations);
+
+#endif /* COMMON_H */
@@ -0,0 +1,452 @@
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ Host side check of HashTable.c
+
+ Random sequences of additions, removals and lookups, single and batched,
+ are applied to a table and to a plain array which records which keys
+ must be present. After every operation the result of the table must
+ agree with the array, and from time to time the entry count and an
+ enumeration of the whole table are verified as well. This is done for a
+ table using the default string operators, which the table handles inline,
+ and for a table using pointer keys, which goes through the callbacks.
+ Built as htcheck-scalar the same checks cover the plain C group matching
+ used on m68k and PPC instead of the SSE2/NEON one.
+
+ With -b the insertion and lookup of strings is timed against the previous
+ implementation, the batch lookup against single lookups.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HashTable.h"
+
+#include "common.h"
+
+// the previous implementation, see reference/. Its entries have the same
+// layout as the current ones
+struct OldHashTable;
+struct OldHashTableOps;
+struct OldHashTable *OldHashTableNew(const struct OldHashTableOps *ops, void *data, ULONG entrySize, ULONG capacity);
+void OldHashTableDestroy(struct OldHashTable *table);
+struct HashEntryHeader *OldHashTableOperate(struct OldHashTable *table, const void *key, enum HashTableOperator op);
+const struct OldHashTableOps *OldHashTableGetDefaultStringOps(void);
+
+#define NUM_KEYS      20000  // number of different keys used by the random checks
+#define BATCH_SIZE    64     // maximum number of keys in a random batch operation
+#define BENCH_KEYS    200000 // number of tokens in the benchmark tables
+#define BENCH_LOOKUPS 4000000
+#define BENCH_BATCH   256
+
+static char *keys[NUM_KEYS];
+static BOOL present[NUM_KEYS];
+static ULONG presentCount;
+
+/// KeyOf
+// the key of an entry, depending on the type of the table
+static const void *KeyOf(BOOL stringKeys, ULONG i)
+{
+  return stringKeys == TRUE ? (const void *)keys[i] : (const void *)&keys[i];
+}
+
+///
+/// CheckEntry
+// check an entry returned for key number i
+static void CheckEntry(struct HashEntryHeader *entry, BOOL stringKeys, ULONG i, const char *op)
+{
+  if(present[i] == TRUE)
+  {
+    if(entry == NULL || !HASH_ENTRY_IS_LIVE(entry))
+      Fail("%s: key '%s' not found", op, keys[i]);
+    else if(stringKeys == TRUE ? strcmp(((struct HashEntry *)entry)->key, keys[i]) != 0 : ((struct HashEntry *)entry)->key != &keys[i])
+      Fail("%s: wrong entry for key '%s'", op, keys[i]);
+  }
+  else if(entry != NULL && HASH_ENTRY_IS_LIVE(entry))
+    Fail("%s: removed key '%s' found", op, keys[i]);
+}
+
+///
+/// AddKey
+// handle the entry returned by an addition of key number i
+static void AddKey(struct HashEntryHeader *entry, BOOL stringKeys, ULONG i, const char *op)
+{
+  if(entry == NULL)
+    Fail("%s: adding key '%s' failed", op, keys[i]);
+  else if(present[i] == FALSE)
+  {
+    // a new entry must not have a key yet
+    if(((struct HashEntry *)entry)->key != NULL)
+      Fail("%s: new entry for key '%s' is not empty", op, keys[i]);
+
+    ((struct HashEntry *)entry)->key = stringKeys == TRUE ? strdup(keys[i]) : (void *)&keys[i];
+    present[i] = TRUE;
+    presentCount++;
+  }
+  else
+    CheckEntry(entry, stringKeys, i, op);
+}
+
+///
+/// CountEntry
+// enumerator checking that every entry is expected to be present
+static enum HashTableOperator CountEntry(UNUSED struct HashTable *table, struct HashEntryHeader *entry, UNUSED ULONG number, void *arg)
+{
+  BOOL stringKeys = *(BOOL *)arg;
+  const char *key = ((struct HashEntry *)entry)->key;
+  ULONG i;
+
+  if(stringKeys == TRUE)
+    i = strtoul(key + 1, NULL, 10);
+  else
+    i = (char **)key - keys;
+
+  if(i >= NUM_KEYS || present[i] == FALSE)
+    Fail("enumerate: unexpected entry");
+
+  return htoNext;
+}
+
+///
+/// CheckTable
+// run the random checks on one table
+static void CheckTable(struct HashTable *table, BOOL stringKeys, ULONG iterations)
+{
+  ULONG n;
+
+  memset(present, 0, sizeof(present));
+  presentCount = 0;
+
+  for(n = 0; n < iterations; n++)
+  {
+    // work on a small set of keys from time to time, so that the table
+    // shrinks again and removed entries are reused
+    ULONG range = (n / 100000) % 2 == 0 ? NUM_KEYS : 300;
+    ULONG i = Random() % range;
+
+    switch(Random() % 8)
+    {
+      case 0:
+      case 1:
+      {
+        AddKey(HashTableOperate(table, KeyOf(stringKeys, i), htoAdd), stringKeys, i, "add");
+      }
+      break;
+
+      case 2:
+      case 3:
+      {
+        struct HashEntryHeader *entry = HashTableOperate(table, KeyOf(stringKeys, i), htoRemove);
+
+        // a removal never returns a live entry
+        if(entry != NULL && HASH_ENTRY_IS_LIVE(entry))
+          Fail("remove: live entry returned for key '%s'", keys[i]);
+
+        if(present[i] == TRUE)
+        {
+          present[i] = FALSE;
+          presentCount--;
+        }
+      }
+      break;
+
+      case 4:
+      {
+        struct HashEntryHeader *entry = HashTableOperate(table, KeyOf(stringKeys, i), htoLookup);
+
+        CheckEntry(entry, stringKeys, i, "raw remove");
+        if(HASH_ENTRY_IS_LIVE(entry))
+        {
+          HashTableRawRemove(table, entry);
+          present[i] = FALSE;
+          presentCount--;
+        }
+      }
+      break;
+
+      case 5:
+      {
+        const void *batchKeys[BATCH_SIZE];
+        struct HashEntryHeader *entries[BATCH_SIZE];
+        ULONG count = Random() % BATCH_SIZE;
+        ULONG j;
+
+        // keys may occur more than once in a lookup batch
+        for(j = 0; j < count; j++)
+          batchKeys[j] = KeyOf(stringKeys, (i + Random() % 128) % range);
+
+        HashTableOperateBatch(table, batchKeys, count, htoLookup, entries);
+
+        for(j = 0; j < count; j++)
+        {
+          ULONG k = stringKeys == TRUE ? (ULONG)strtoul((const char *)batchKeys[j] + 1, NULL, 10) : (ULONG)((char **)batchKeys[j] - keys);
+
+          CheckEntry(entries[j], stringKeys, k, "batch lookup");
+        }
+      }
+      break;
+
+      case 6:
+      {
+        const void *batchKeys[BATCH_SIZE];
+        struct HashEntryHeader *entries[BATCH_SIZE];
+        ULONG count = Random() % BATCH_SIZE;
+        ULONG j;
+
+        // the keys of a batch addition must be distinct
+        count = count < range - i ? count : range - i;
+        for(j = 0; j < count; j++)
+          batchKeys[j] = KeyOf(stringKeys, i + j);
+
+        HashTableOperateBatch(table, batchKeys, count, htoAdd, entries);
+
+        for(j = 0; j < count; j++)
+          AddKey(entries[j], stringKeys, i + j, "batch add");
+      }
+      break;
+
+      default:
+      {
+        CheckEntry(HashTableOperate(table, KeyOf(stringKeys, i), htoLookup), stringKeys, i, "lookup");
+      }
+      break;
+    }
+
+    if(n % 10000 == 0 || n == iterations - 1)
+    {
+      if(table->entryCount != presentCount)
+        Fail("entry count %lu, expected %lu", (unsigned long)table->entryCount, (unsigned long)presentCount);
+
+      if(HashTableEnumerate(table, CountEntry, &stringKeys) != presentCount)
+        Fail("enumerated entry count differs from %lu", (unsigned long)presentCount);
+    }
+  }
+}
+
+///
+/// CheckRandom
+//
+static void CheckRandom(ULONG iterations)
+{
+  static const struct HashTableOps pointerOps =
+  {
+    DefaultHashAllocTable,
+    DefaultHashFreeTable,
+    DefaultHashGetKey,
+    DefaultHashHashKey,
+    DefaultHashMatchEntry,
+    DefaultHashMoveEntry,
+    DefaultHashClearEntry,
+    DefaultHashFinalize,
+    NULL,
+    NULL
+  };
+  struct HashTable *table;
+  ULONG i;
+
+  for(i = 0; i < NUM_KEYS; i++)
+  {
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "k%lu", (unsigned long)i);
+    keys[i] = strdup(buf);
+  }
+
+  if((table = HashTableNew(HashTableGetDefaultStringOps(), NULL, sizeof(struct HashEntry), 0)) != NULL)
+  {
+    CheckTable(table, TRUE, iterations);
+    HashTableDestroy(table);
+  }
+  else
+    Fail("HashTableNew() failed");
+
+  if((table = HashTableNew(&pointerOps, NULL, sizeof(struct HashEntry), 0)) != NULL)
+  {
+    CheckTable(table, FALSE, iterations);
+    HashTableDestroy(table);
+  }
+  else
+    Fail("HashTableNew() failed");
+
+  for(i = 0; i < NUM_KEYS; i++)
+    free(keys[i]);
+}
+
+///
+/// Benchmark
+// time tables of tokens like the ones of the spam filter
+static void Benchmark(void)
+{
+  char **tokens;
+  const void **lookups;
+  struct HashEntryHeader **entries;
+
+  tokens = calloc(BENCH_KEYS, sizeof(*tokens));
+  lookups = calloc(BENCH_LOOKUPS, sizeof(*lookups));
+  entries = calloc(BENCH_BATCH, sizeof(*entries));
+
+  if(tokens != NULL && lookups != NULL && entries != NULL)
+  {
+    struct HashTable *table;
+    struct OldHashTable *old;
+    double start;
+    ULONG i;
+
+    // random words of 3 to 12 lower case letters, duplicates don't matter
+    for(i = 0; i < BENCH_KEYS; i++)
+    {
+      char buf[16];
+      ULONG len = 3 + Random() % 10;
+      ULONG j;
+
+      for(j = 0; j < len; j++)
+        buf[j] = 'a' + Random() % 26;
+      buf[len] = '\0';
+
+      tokens[i] = strdup(buf);
+    }
+
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+      lookups[i] = tokens[Random() % BENCH_KEYS];
+
+    printf("%d tokens, %d lookups\n", BENCH_KEYS, BENCH_LOOKUPS);
+
+    table = HashTableNew(HashTableGetDefaultStringOps(), NULL, sizeof(struct HashEntry), 0);
+    old = OldHashTableNew(OldHashTableGetDefaultStringOps(), NULL, sizeof(struct HashEntry), 0);
+
+    start = Now();
+    for(i = 0; i < BENCH_KEYS; i++)
+    {
+      struct HashEntry *entry = (struct HashEntry *)HashTableOperate(table, tokens[i], htoAdd);
+
+      if(entry->key == NULL)
+        entry->key = strdup(tokens[i]);
+    }
+    ReportOps("insert", Now() - start, BENCH_KEYS);
+
+    start = Now();
+    for(i = 0; i < BENCH_KEYS; i++)
+    {
+      struct HashEntry *entry = (struct HashEntry *)OldHashTableOperate(old, tokens[i], htoAdd);
+
+      if(entry->key == NULL)
+        entry->key = strdup(tokens[i]);
+    }
+    ReportOps("insert, previous implementation", Now() - start, BENCH_KEYS);
+
+    start = Now();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      if(!HASH_ENTRY_IS_LIVE(HashTableOperate(table, lookups[i], htoLookup)))
+        Fail("token '%s' not found", (const char *)lookups[i]);
+    }
+    ReportOps("lookup", Now() - start, BENCH_LOOKUPS);
+
+    start = Now();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      if(!HASH_ENTRY_IS_LIVE(OldHashTableOperate(old, lookups[i], htoLookup)))
+        Fail("token '%s' not found", (const char *)lookups[i]);
+    }
+    ReportOps("lookup, previous implementation", Now() - start, BENCH_LOOKUPS);
+
+    start = Now();
+    for(i = 0; i < BENCH_LOOKUPS; i += BENCH_BATCH)
+    {
+      ULONG count = BENCH_LOOKUPS - i < BENCH_BATCH ? BENCH_LOOKUPS - i : BENCH_BATCH;
+
+      if(HashTableOperateBatch(table, &lookups[i], count, htoLookup, entries) != count)
+        Fail("batch lookup incomplete");
+    }
+    ReportOps("batch lookup", Now() - start, BENCH_LOOKUPS);
+
+    // the same number of lookups for tokens which are not in the table
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+      lookups[i] = "unknown-token" + Random() % 8;
+
+    start = Now();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      if(HASH_ENTRY_IS_LIVE(HashTableOperate(table, lookups[i], htoLookup)))
+        Fail("token '%s' found", (const char *)lookups[i]);
+    }
+    ReportOps("failing lookup", Now() - start, BENCH_LOOKUPS);
+
+    start = Now();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      if(HASH_ENTRY_IS_LIVE(OldHashTableOperate(old, lookups[i], htoLookup)))
+        Fail("token '%s' found", (const char *)lookups[i]);
+    }
+    ReportOps("failing lookup, previous implementation", Now() - start, BENCH_LOOKUPS);
+
+    OldHashTableDestroy(old);
+    HashTableDestroy(table);
+
+    for(i = 0; i < BENCH_KEYS; i++)
+      free(tokens[i]);
+  }
+  else
+    Fail("out of memory");
+
+  free(entries);
+  free(lookups);
+  free(tokens);
+}
+
+///
+/// main
+//
+int main(int argc, char **argv)
+{
+  struct CheckOptions opts;
+  const char *name = (strrchr(argv[0], '/') != NULL) ? strrchr(argv[0], '/') + 1 : argv[0];
+  int result = 1;
+
+  if(ParseOptions(argc, argv, &opts, 1000000) == TRUE)
+  {
+    printf("%s: %lu random operations per table\n", name, (unsigned long)opts.iterations);
+    CheckRandom(opts.iterations);
+
+    if(opts.benchmark == TRUE)
+      Benchmark();
+
+    if(Failures() == 0)
+    {
+      printf("%s: OK\n", name);
+      result = 0;
+    }
+    else
+      printf("%s: %lu FAILURES\n", name, (unsigned long)Failures());
+  }
+
+  return result;
+}
+
+///
@@ -0,0 +1,52 @@
+#ifndef EXEC_TYPES_H
+#define EXEC_TYPES_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+// the few AmigaOS types used by the modules checked on the host
+
+#include <stdint.h>
+
+typedef uint32_t ULONG;
+typedef int32_t  LONG;
+typedef uint16_t UWORD;
+typedef int16_t  WORD;
+typedef uint8_t  UBYTE;
+typedef int8_t   BYTE;
+typedef int16_t  BOOL;
+typedef char *   STRPTR;
+typedef void *   APTR;
+
+#ifndef TRUE
+#define TRUE  1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#endif /* EXEC_TYPES_H */
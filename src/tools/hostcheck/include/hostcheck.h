@@ -0,0 +1,92 @@
+#ifndef HOSTCHECK_H
+#define HOSTCHECK_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ This file is included in front of every YAM module compiled on the host.
+ It takes the place of the AmigaOS specific headers those modules include
+ by defining their include guards in advance and supplies the few macros
+ the modules actually use from them.
+*/
+
+#define MAIN_YAM_H
+#define YAM_UTILITIES_H
+#define CONFIG_H
+#define DEBUG_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <exec/types.h>
+
+#include "SDI_compiler.h"
+
+#define ENTER()               ((void)0)
+#define LEAVE()               ((void)0)
+#define RETURN(r)             ((void)0)
+#define SHOWVALUE(f, v)       ((void)0)
+#define SHOWPOINTER(f, p)     ((void)0)
+#define SHOWSTRING(f, s)      ((void)0)
+#define SHOWMSG(f, m)         ((void)0)
+#define D(f, ...)             ((void)0)
+#define E(f, ...)             ((void)0)
+#define W(f, ...)             ((void)0)
+#define ASSERT(expression)    ((void)0)
+
+#define stricmp(s1, s2)       strcasecmp(s1, s2)
+#define strnicmp(s1, s2, n)   strncasecmp(s1, s2, n)
+
+#define ARRAY_SIZE(x)         (sizeof(x[0]) ? sizeof(x)/sizeof(x[0]) : 0)
+#define isFlagSet(v, f)       (((v) & (f)) == (f))
+#define isAnyFlagSet(v, f)    (((v) & (f)) != 0)
+#define isFlagClear(v, f)     (((v) & (f)) == 0)
+
+// the part of the configuration of Config.h used by the modules, the
+// settings are defined in common.c
+struct Config
+{
+  BOOL DetectCyrillic;
+};
+
+extern struct Config *C;
+
+// functions of YAM_UT.c, implemented in common.c
+void ToLowerCase(char *str);
+
+#ifndef MIN
+#define MIN(a, b)             ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)             ((a) > (b) ? (a) : (b))
+#endif
+
+#endif /* HOSTCHECK_H */
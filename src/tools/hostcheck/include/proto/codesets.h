@@ -0,0 +1,64 @@
+#ifndef PROTO_CODESETS_H
+#define PROTO_CODESETS_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ The host side checks only pass binary data through the decoding chain,
+ hence codesets.library is never actually called. These declarations just
+ let the modules compile, the functions in common.c fail every call.
+*/
+
+#include <exec/types.h>
+
+typedef unsigned char UTF8;
+
+struct codeset
+{
+  char *name;
+};
+
+#define TAG_DONE                    0UL
+
+#define CSA_Source                  1UL
+#define CSA_SourceLen               2UL
+#define CSA_SourceCodeset           3UL
+#define CSA_Dest                    4UL
+#define CSA_DestLen                 5UL
+#define CSA_DestLenPtr              6UL
+#define CSA_CodesetFamily           7UL
+#define CSA_FallbackToDefault       8UL
+
+#define CSV_CodesetFamily_Latin     0UL
+#define CSV_CodesetFamily_Cyrillic  1UL
+
+struct codeset *CodesetsFindBest(ULONG tag, ...);
+UTF8 *CodesetsUTF8Create(ULONG tag, ...);
+void CodesetsFreeA(APTR obj, void *attrs);
+
+#endif /* PROTO_CODESETS_H */
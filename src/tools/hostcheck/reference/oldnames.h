@@ -0,0 +1,78 @@
+#ifndef OLDNAMES_H
+#define OLDNAMES_H
+
+/***************************************************************************
+
+ YAM - Yet Another Mailer
+ Copyright (C) 1995-2000 Marcel Beck
+ Copyright (C) 2000-2019 YAM Open Source Team
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ YAM Official Support Site :  http://www.yam.ch
+ YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+
+ $Id$
+
+***************************************************************************/
+
+/*
+ The files in this directory are the implementations YAM used before the
+ modules in question were optimized. They are compiled with their public
+ names prefixed by "Old" or "old_", so that the checks can link them together with
+ the current implementations and compare both.
+*/
+
+// BoyerMooreSearch.c
+#define BoyerMooreContext             OldBoyerMooreContext
+#define BoyerMooreInit                OldBoyerMooreInit
+#define BoyerMooreCleanup             OldBoyerMooreCleanup
+#define BoyerMooreSearch              OldBoyerMooreSearch
+
+// HashTable.c
+#define HashTable                     OldHashTable
+#define HashTableOps                  OldHashTableOps
+#define HashEntryHeader               OldHashEntryHeader
+#define HashEntry                     OldHashEntry
+#define HashTableNew                  OldHashTableNew
+#define HashTableDestroy              OldHashTableDestroy
+#define HashTableInit                 OldHashTableInit
+#define HashTableSetAlphaBounds       OldHashTableSetAlphaBounds
+#define HashTableCleanup              OldHashTableCleanup
+#define HashTableOperate              OldHashTableOperate
+#define HashTableRawRemove            OldHashTableRawRemove
+#define HashTableGetDefaultOps        OldHashTableGetDefaultOps
+#define HashTableGetDefaultStringOps  OldHashTableGetDefaultStringOps
+#define HashTableEnumerate            OldHashTableEnumerate
+#define DefaultHashAllocTable         OldDefaultHashAllocTable
+#define DefaultHashFreeTable          OldDefaultHashFreeTable
+#define DefaultHashGetKey             OldDefaultHashGetKey
+#define DefaultHashHashKey            OldDefaultHashHashKey
+#define DefaultHashMatchEntry         OldDefaultHashMatchEntry
+#define DefaultHashMoveEntry          OldDefaultHashMoveEntry
+#define DefaultHashClearEntry         OldDefaultHashClearEntry
+#define DefaultHashFinalize           OldDefaultHashFinalize
+#define StringHashHashKey             OldStringHashHashKey
+#define StringHashMatchEntry          OldStringHashMatchEntry
+#define StringHashClearEntry          OldStringHashClearEntry
+#define StringHashDestroyEntry        OldStringHashDestroyEntry
+
+// mime/base64.c
+#define base64encode                  old_base64encode
+#define base64decode                  old_base64decode
+#define base64encode_file             old_base64encode_file
+#define base64decode_file             old_base64decode_file
+
+#endif /* OLDNAMES_H */
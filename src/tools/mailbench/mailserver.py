@@ -0,0 +1,717 @@
+#!/usr/bin/env python3
+############################################################################
+#
+# YAM - Yet Another Mailer
+# Copyright (C) 1995-2000 Marcel Beck
+# Copyright (C) 2000-2019 YAM Open Source Team
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# YAM Official Support Site :  http://www.yam.ch
+# YAM OpenSource project    :  http://sourceforge.net/projects/yamos/
+#
+# $Id$
+#
+############################################################################
+
+# Scripted POP3/SMTP server for benchmarking the mail transfers of YAM.
+#
+# The server hands out a generated mailbox via POP3 and swallows everything
+# delivered via SMTP. The mailbox size, the message size, the round trip
+# latency and the advertised capabilities are configurable, either one by one
+# or through a named scenario. For every session it reports the number of
+# mails, the bytes in both directions, the round trips and the resulting
+# mails/s and bytes/s, counted the same way as the STATS lines YAM prints
+# with the NETLOG argument.
+#
+# A round trip is counted whenever the client sends data after the server
+# has answered. The server collects all commands the client has sent so far
+# before it answers, so pipelined commands cost a single round trip, just
+# like on a real server. The latency is added once per round trip.
+#
+#   ./mailserver.py --scenario pipelined
+#   ./mailserver.py --messages 500 --size 4096 --latency 40 --pop3-caps UIDL,TOP
+#   ./mailserver.py --list-scenarios
+#   ./mailserver.py --selftest
+
+import argparse
+import base64
+import hashlib
+import json
+import os
+import random
+import select
+import socket
+import sys
+import tempfile
+import threading
+import time
+
+# the scenarios cover the cases the pipelining changes of the POP3 and SMTP
+# code have to be measured against, all values can be overridden on the
+# command line
+SCENARIOS = {
+  'pipelined': dict(messages=200, size=4096, latency=0,
+                    pop3_caps='UIDL,TOP,USER,PIPELINING',
+                    smtp_caps='PIPELINING,8BITMIME,SIZE,ENHANCEDSTATUSCODES',
+                    help='many small mails, server supports pipelining'),
+  'lockstep':  dict(messages=200, size=4096, latency=0,
+                    pop3_caps='UIDL,TOP,USER',
+                    smtp_caps='8BITMIME,SIZE,ENHANCEDSTATUSCODES',
+                    help='many small mails, server without pipelining'),
+  'wan':       dict(messages=200, size=4096, latency=50,
+                    pop3_caps='UIDL,TOP,USER,PIPELINING',
+                    smtp_caps='PIPELINING,8BITMIME,SIZE,ENHANCEDSTATUSCODES',
+                    help='many small mails behind a 50 ms round trip'),
+  'wan-lockstep': dict(messages=200, size=4096, latency=50,
+                    pop3_caps='UIDL,TOP,USER',
+                    smtp_caps='8BITMIME,SIZE,ENHANCEDSTATUSCODES',
+                    help='the same without pipelining'),
+  'large':     dict(messages=20, size=2*1024*1024, latency=0,
+                    pop3_caps='UIDL,TOP,USER,PIPELINING',
+                    smtp_caps='PIPELINING,8BITMIME,SIZE,ENHANCEDSTATUSCODES',
+                    help='few large mails, throughput bound'),
+  'chunking':  dict(messages=50, size=256*1024, latency=20,
+                    pop3_caps='UIDL,TOP,USER,PIPELINING',
+                    smtp_caps='PIPELINING,8BITMIME,SIZE,ENHANCEDSTATUSCODES,CHUNKING',
+                    help='SMTP delivery with BDAT (RFC 3030)'),
+  'no-uidl':   dict(messages=200, size=4096, latency=0,
+                    pop3_caps='TOP,USER',
+                    smtp_caps='PIPELINING,8BITMIME,SIZE',
+                    help='POP3 server without UIDL, no duplicate check by UIDL'),
+}
+
+WORDS = ('amiga workbench intuition exec dos graphics layers mail folder '
+         'message header body server client pipelining chunk literal '
+         'transfer socket buffer window gadget request answer').split()
+
+
+def log(text):
+  sys.stdout.write(text + '\n')
+  sys.stdout.flush()
+
+
+class Mailbox:
+  """A reproducible set of mails. Each session gets a fresh copy with its
+  own UIDLs, so YAM downloads the whole mailbox on every run instead of
+  skipping the mails it knows from the previous run."""
+
+  def __init__(self, count, size, seed):
+    self.count = count
+    self.size = size
+    self.seed = seed
+
+  def generate(self, session):
+    rng = random.Random('%d-%d' % (self.seed, session))
+    mails = []
+    for i in range(self.count):
+      header = ('From: Mail Bench <bench@localhost>\r\n'
+                'To: YAM User <user@localhost>\r\n'
+                'Subject: benchmark mail %d of session %d\r\n'
+                'Date: Mon, 01 Jan 2018 12:%02d:%02d +0000\r\n'
+                'Message-ID: <%d.%d.%d@mailbench.localhost>\r\n'
+                'MIME-Version: 1.0\r\n'
+                'Content-Type: text/plain; charset=us-ascii\r\n'
+                '\r\n' % (i+1, session, (i // 60) % 60, i % 60, self.seed, session, i))
+      body = []
+      length = len(header)
+      while length < self.size:
+        line = ' '.join(rng.choice(WORDS) for _ in range(rng.randint(4, 12)))
+        # a leading dot exercises the dot-stuffing of both sides
+        if rng.random() < 0.05:
+          line = '.' + line
+        line = line[:max(self.size - length - 2, 0)] + '\r\n'
+        body.append(line)
+        length += len(line)
+      mails.append((header + ''.join(body)).encode('ascii'))
+    uidls = ['mb%d-%d-%d' % (self.seed, session, i) for i in range(self.count)]
+    return mails, uidls
+
+
+def dot_stuff(data):
+  """Dot-stuff a message and append the terminating line (RFC 1939/5321)."""
+  lines = data.split(b'\r\n')
+  if lines and lines[-1] == b'':
+    lines.pop()
+  out = [(b'.' + l) if l.startswith(b'.') else l for l in lines]
+  return b'\r\n'.join(out) + b'\r\n.\r\n'
+
+
+class Statistics:
+  def __init__(self, protocol, number):
+    self.protocol = protocol
+    self.number = number
+    self.start = time.monotonic()
+    self.bytes_sent = 0
+    self.bytes_received = 0
+    self.round_trips = 0
+    self.commands = 0
+    self.mails = 0
+    self.mail_bytes = 0
+
+  def report(self, options):
+    elapsed = max(time.monotonic() - self.start, 1e-6)
+    total = self.bytes_sent + self.bytes_received
+    log('STATS[%s #%d]: %d mails (%d bytes), %d commands, %d round trips, %d bytes sent, %d bytes received, %.3f s'
+        % (self.protocol, self.number, self.mails, self.mail_bytes, self.commands,
+           self.round_trips, self.bytes_sent, self.bytes_received, elapsed))
+    log('STATS[%s #%d]: %.2f mails/s, %d bytes/s, %.2f round trips/mail'
+        % (self.protocol, self.number, self.mails / elapsed, total / elapsed,
+           self.round_trips / self.mails if self.mails else 0.0))
+    if options.report is not None:
+      with open(options.report, 'a') as fh:
+        fh.write(json.dumps(dict(protocol=self.protocol, session=self.number,
+                                 scenario=options.scenario, messages=options.messages,
+                                 size=options.size, latency=options.latency,
+                                 mails=self.mails, mail_bytes=self.mail_bytes,
+                                 commands=self.commands, round_trips=self.round_trips,
+                                 bytes_sent=self.bytes_sent, bytes_received=self.bytes_received,
+                                 seconds=round(elapsed, 6))) + '\n')
+
+
+class Session:
+  """The common part of both protocols: buffered line input, batched output
+  and the round trip accounting."""
+
+  def __init__(self, sock, stats, options):
+    self.sock = sock
+    self.stats = stats
+    self.options = options
+    self.inbuf = b''
+    self.outbuf = []
+    self.answered = True
+
+  def send(self, data):
+    if isinstance(data, str):
+      data = data.encode('ascii')
+    self.outbuf.append(data)
+
+  def flush(self):
+    if self.outbuf:
+      data = b''.join(self.outbuf)
+      self.outbuf = []
+      # the latency delays every answer of the server once
+      if self.options.latency > 0:
+        time.sleep(self.options.latency / 1000.0)
+      self.sock.sendall(data)
+      self.stats.bytes_sent += len(data)
+      self.answered = True
+
+  def fill(self):
+    # answer everything collected so far before waiting for the client, but
+    # keep collecting while the client is still sending pipelined commands
+    if not select.select([self.sock], [], [], 0)[0]:
+      self.flush()
+    data = self.sock.recv(65536)
+    if not data:
+      raise EOFError()
+    self.stats.bytes_received += len(data)
+    if self.answered:
+      self.stats.round_trips += 1
+      self.answered = False
+    self.inbuf += data
+
+  def readline(self):
+    while b'\r\n' not in self.inbuf:
+      if len(self.inbuf) > 65536:
+        raise EOFError()
+      self.fill()
+    line, self.inbuf = self.inbuf.split(b'\r\n', 1)
+    return line.decode('latin-1')
+
+  def readbytes(self, count):
+    while len(self.inbuf) < count:
+      self.fill()
+    data, self.inbuf = self.inbuf[:count], self.inbuf[count:]
+    return data
+
+  def run(self):
+    try:
+      self.greet()
+      while True:
+        line = self.readline()
+        self.stats.commands += 1
+        if self.options.verbose:
+          log('%s #%d < %s' % (self.stats.protocol, self.stats.number, line))
+        if self.command(line) is False:
+          break
+    except (EOFError, ConnectionError):
+      pass
+    finally:
+      try:
+        self.flush()
+      except (OSError, ConnectionError):
+        pass
+      self.sock.close()
+      self.stats.report(self.options)
+
+
+class POP3Session(Session):
+  def __init__(self, sock, stats, options, mailbox):
+    Session.__init__(self, sock, stats, options)
+    self.caps = set(c for c in options.pop3_caps.upper().split(',') if c)
+    self.mails, self.uidls = mailbox.generate(stats.number)
+    self.deleted = set()
+    self.user = None
+    self.authorized = False
+    self.timestamp = '<%d.%d@mailbench.localhost>' % (os.getpid(), stats.number)
+
+  def greet(self):
+    if 'APOP' in self.caps:
+      self.send('+OK mailbench POP3 server ready %s\r\n' % self.timestamp)
+    else:
+      self.send('+OK mailbench POP3 server ready\r\n')
+
+  def message(self, arg):
+    try:
+      number = int(arg)
+    except ValueError:
+      return None
+    if number < 1 or number > len(self.mails) or number - 1 in self.deleted:
+      return None
+    return number - 1
+
+  def command(self, line):
+    parts = line.split(' ', 2)
+    cmd = parts[0].upper()
+    args = parts[1:]
+
+    if cmd == 'QUIT':
+      # the mails marked as deleted count as gone, the next session gets a
+      # fresh mailbox anyway
+      self.send('+OK %d mails deleted, bye\r\n' % len(self.deleted))
+      return False
+    elif cmd == 'CAPA':
+      self.send('+OK capability list follows\r\n')
+      for cap in sorted(self.caps):
+        if cap not in ('APOP',):
+          self.send(cap + '\r\n')
+      self.send('.\r\n')
+    elif cmd == 'NOOP':
+      self.send('+OK\r\n')
+    elif not self.authorized:
+      if cmd == 'USER' and args:
+        self.user = args[0]
+        self.send('+OK send the password\r\n')
+      elif cmd == 'PASS' and self.user is not None:
+        self.authorize(self.user, ' '.join(args), None)
+      elif cmd == 'APOP' and len(args) == 2 and 'APOP' in self.caps:
+        self.authorize(args[0], None, args[1])
+      else:
+        self.send('-ERR not authorized\r\n')
+    elif cmd == 'STAT':
+      live = [i for i in range(len(self.mails)) if i not in self.deleted]
+      self.send('+OK %d %d\r\n' % (len(live), sum(len(self.mails[i]) for i in live)))
+    elif cmd in ('LIST', 'UIDL'):
+      if cmd == 'UIDL' and 'UIDL' not in self.caps:
+        self.send('-ERR command not supported\r\n')
+        return True
+      def value(i):
+        return self.uidls[i] if cmd == 'UIDL' else str(len(self.mails[i]))
+      if args:
+        i = self.message(args[0])
+        if i is None:
+          self.send('-ERR no such message\r\n')
+        else:
+          self.send('+OK %d %s\r\n' % (i+1, value(i)))
+      else:
+        self.send('+OK listing follows\r\n')
+        self.send(''.join('%d %s\r\n' % (i+1, value(i)) for i in range(len(self.mails)) if i not in self.deleted))
+        self.send('.\r\n')
+    elif cmd in ('RETR', 'TOP'):
+      i = self.message(args[0]) if args else None
+      if cmd == 'TOP' and 'TOP' not in self.caps:
+        self.send('-ERR command not supported\r\n')
+      elif i is None:
+        self.send('-ERR no such message\r\n')
+      elif cmd == 'RETR':
+        self.send('+OK %d octets\r\n' % len(self.mails[i]))
+        self.send(dot_stuff(self.mails[i]))
+        self.stats.mails += 1
+        self.stats.mail_bytes += len(self.mails[i])
+      else:
+        try:
+          lines = int(args[1].split()[0]) if len(args) > 1 else 0
+        except ValueError:
+          lines = 0
+        header, _, body = self.mails[i].partition(b'\r\n\r\n')
+        top = header + b'\r\n\r\n' + b''.join(l + b'\r\n' for l in body.split(b'\r\n')[:lines] if l)
+        self.send('+OK top of message follows\r\n')
+        self.send(dot_stuff(top))
+    elif cmd == 'DELE':
+      i = self.message(args[0]) if args else None
+      if i is None:
+        self.send('-ERR no such message\r\n')
+      else:
+        self.deleted.add(i)
+        self.send('+OK message %d deleted\r\n' % (i+1))
+    elif cmd == 'RSET':
+      self.deleted.clear()
+      self.send('+OK\r\n')
+    else:
+      self.send('-ERR unknown command\r\n')
+    return True
+
+  def authorize(self, user, password, digest):
+    ok = self.options.user is None or user == self.options.user
+    if ok and self.options.password is not None:
+      if digest is not None:
+        expected = hashlib.md5((self.timestamp + self.options.password).encode('latin-1')).hexdigest()
+        ok = digest.lower() == expected
+      else:
+        ok = password == self.options.password
+    if ok:
+      self.authorized = True
+      self.send('+OK %d messages\r\n' % len(self.mails))
+    else:
+      self.send('-ERR authentication failed\r\n')
+
+
+class SMTPSession(Session):
+  def __init__(self, sock, stats, options):
+    Session.__init__(self, sock, stats, options)
+    self.caps = set(c for c in options.smtp_caps.upper().split(',') if c)
+    self.reset()
+
+  def reset(self):
+    self.sender = None
+    self.recipients = 0
+    self.chunked = b''
+    self.chunking = False
+
+  def greet(self):
+    self.send('220 mailbench ESMTP server ready\r\n')
+
+  def command(self, line):
+    cmd = line.split(' ', 1)[0].upper()
+    arg = line[len(cmd)+1:]
+
+    if cmd == 'QUIT':
+      self.send('221 2.0.0 bye\r\n')
+      return False
+    elif cmd == 'EHLO':
+      self.reset()
+      caps = sorted(self.caps)
+      if 'SIZE' in self.caps:
+        caps[caps.index('SIZE')] = 'SIZE %d' % (64*1024*1024)
+      lines = ['mailbench greets %s' % arg] + caps
+      for n, text in enumerate(lines):
+        self.send('250%s%s\r\n' % (' ' if n == len(lines)-1 else '-', text))
+    elif cmd == 'HELO':
+      self.reset()
+      self.send('250 mailbench\r\n')
+    elif cmd == 'AUTH':
+      self.authenticate(arg)
+    elif cmd == 'MAIL':
+      if self.sender is not None:
+        self.send('503 5.5.1 sender already given\r\n')
+      else:
+        self.sender = arg
+        self.send('250 2.1.0 sender ok\r\n')
+    elif cmd == 'RCPT':
+      if self.sender is None:
+        self.send('503 5.5.1 need MAIL first\r\n')
+      else:
+        self.recipients += 1
+        self.send('250 2.1.5 recipient ok\r\n')
+    elif cmd == 'DATA':
+      if self.recipients == 0:
+        self.send('554 5.5.1 no valid recipients\r\n')
+      else:
+        self.send('354 end data with <CR><LF>.<CR><LF>\r\n')
+        size = 0
+        while True:
+          data = self.readline()
+          if data == '.':
+            break
+          size += len(data) + 2 - (1 if data.startswith('.') else 0)
+        self.accept(size)
+    elif cmd == 'BDAT' and 'CHUNKING' in self.caps:
+      words = arg.split()
+      try:
+        length = int(words[0])
+      except (IndexError, ValueError):
+        self.send('501 5.5.4 syntax error\r\n')
+        return True
+      self.chunked += self.readbytes(length)
+      if self.recipients == 0:
+        self.send('554 5.5.1 no valid recipients\r\n')
+      elif len(words) > 1 and words[1].upper() == 'LAST':
+        self.accept(len(self.chunked))
+      else:
+        self.send('250 2.0.0 %d octets received\r\n' % length)
+    elif cmd == 'RSET':
+      self.reset()
+      self.send('250 2.0.0 ok\r\n')
+    elif cmd == 'NOOP':
+      self.send('250 2.0.0 ok\r\n')
+    else:
+      self.send('502 5.5.2 command not implemented\r\n')
+    return True
+
+  def accept(self, size):
+    self.stats.mails += 1
+    self.stats.mail_bytes += size
+    self.send('250 2.0.0 message %d accepted\r\n' % self.stats.mails)
+    self.reset()
+
+  def authenticate(self, arg):
+    # any credentials are accepted, the mechanisms are only implemented as
+    # far as YAM needs them to finish the exchange
+    words = arg.split()
+    mech = words[0].upper() if words else ''
+    if mech == 'PLAIN':
+      if len(words) < 2:
+        self.send('334 \r\n')
+        self.readline()
+      self.send('235 2.7.0 authenticated\r\n')
+    elif mech == 'LOGIN':
+      self.send('334 %s\r\n' % base64.b64encode(b'Username:').decode('ascii'))
+      self.readline()
+      self.send('334 %s\r\n' % base64.b64encode(b'Password:').decode('ascii'))
+      self.readline()
+      self.send('235 2.7.0 authenticated\r\n')
+    else:
+      self.send('504 5.5.4 mechanism not supported\r\n')
+
+
+class Server:
+  def __init__(self, options):
+    self.options = options
+    self.mailbox = Mailbox(options.messages, options.size, options.seed)
+    self.sessions = 0
+    self.lock = threading.Lock()
+    self.sockets = []
+
+  def listen(self, port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((self.options.bind, port))
+    sock.listen(8)
+    self.sockets.append(sock)
+    return sock
+
+  def serve(self, sock, protocol):
+    while True:
+      try:
+        client, _ = sock.accept()
+      except OSError:
+        break
+      client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+      with self.lock:
+        self.sessions += 1
+        number = self.sessions
+      stats = Statistics(protocol, number)
+      if protocol == 'POP3':
+        session = POP3Session(client, stats, self.options, self.mailbox)
+      else:
+        session = SMTPSession(client, stats, self.options)
+      threading.Thread(target=session.run, daemon=True).start()
+
+  def start(self):
+    pop3 = self.listen(self.options.pop3_port)
+    smtp = self.listen(self.options.smtp_port)
+    for sock, protocol in ((pop3, 'POP3'), (smtp, 'SMTP')):
+      threading.Thread(target=self.serve, args=(sock, protocol), daemon=True).start()
+    return pop3.getsockname()[1], smtp.getsockname()[1]
+
+  def stop(self):
+    for sock in self.sockets:
+      sock.close()
+
+
+class Client:
+  """A minimal client for the self test. It talks to the server either in
+  lock-step or pipelined, like YAM does depending on the capabilities."""
+
+  def __init__(self, port):
+    self.sock = socket.create_connection(('127.0.0.1', port))
+    self.buf = b''
+
+  def readline(self):
+    while b'\r\n' not in self.buf:
+      data = self.sock.recv(65536)
+      if not data:
+        raise EOFError()
+      self.buf += data
+    line, self.buf = self.buf.split(b'\r\n', 1)
+    return line
+
+  def multiline(self):
+    lines = []
+    while True:
+      line = self.readline()
+      if line == b'.':
+        return lines
+      lines.append(line[1:] if line.startswith(b'.') else line)
+
+  def send(self, text):
+    self.sock.sendall(text if isinstance(text, bytes) else text.encode('ascii'))
+
+
+def selftest_pop3(port, count, pipelined):
+  c = Client(port)
+  c.readline()
+  c.send('USER bench\r\n'); c.readline()
+  c.send('PASS bench\r\n'); c.readline()
+  c.send('UIDL\r\n'); c.readline(); uidls = c.multiline()
+  mails = []
+  if pipelined:
+    c.send(''.join('RETR %d\r\nDELE %d\r\n' % (i, i) for i in range(1, count+1)))
+    for _ in range(count):
+      c.readline(); mails.append(b'\r\n'.join(c.multiline()) + b'\r\n'); c.readline()
+  else:
+    for i in range(1, count+1):
+      c.send('RETR %d\r\n' % i); c.readline(); mails.append(b'\r\n'.join(c.multiline()) + b'\r\n')
+      c.send('DELE %d\r\n' % i); c.readline()
+  c.send('QUIT\r\n'); c.readline()
+  return uidls, mails
+
+
+def selftest_smtp(port, mails, pipelined, chunking):
+  c = Client(port)
+  c.readline()
+  c.send('EHLO selftest\r\n')
+  while not c.readline().startswith(b'250 '):
+    pass
+  for mail in mails:
+    envelope = 'MAIL FROM:<bench@localhost>\r\nRCPT TO:<a@localhost>\r\nRCPT TO:<b@localhost>\r\n'
+    if pipelined:
+      c.send(envelope); [c.readline() for _ in range(3)]
+    else:
+      for cmd in envelope.split('\r\n')[:-1]:
+        c.send(cmd + '\r\n'); c.readline()
+    if chunking:
+      half = len(mail) // 2
+      c.send(b'BDAT %d\r\n' % half + mail[:half] + b'BDAT %d LAST\r\n' % (len(mail) - half) + mail[half:])
+      c.readline(); c.readline()
+    else:
+      c.send('DATA\r\n'); c.readline()
+      c.send(dot_stuff(mail)); c.readline()
+  c.send('QUIT\r\n'); c.readline()
+
+
+def selftest(options):
+  """Check the protocol handling and the round trip accounting of the
+  server with the lock-step and the pipelined client above."""
+  failures = 0
+  count = 20
+  report = os.path.join(tempfile.gettempdir(), 'mailbench-selftest-%d.json' % os.getpid())
+
+  options.bind = '127.0.0.1'
+  options.pop3_port = options.smtp_port = 0
+  options.messages, options.size, options.latency = count, 3000, 0
+  options.pop3_caps, options.smtp_caps = 'UIDL,TOP,USER,PIPELINING', 'PIPELINING,8BITMIME,SIZE,CHUNKING'
+  options.report, options.scenario = report, 'selftest'
+
+  server = Server(options)
+  pop3, smtp = server.start()
+  expected, uidls = Mailbox(count, 3000, options.seed).generate(1)
+
+  try:
+    got_uidls, mails = selftest_pop3(pop3, count, False)
+    failures += (mails != expected) + (got_uidls[0].split()[1].decode() != uidls[0])
+    _, mails2 = selftest_pop3(pop3, count, True)
+    failures += (len(mails2) != count)
+    selftest_smtp(smtp, expected, False, False)
+    selftest_smtp(smtp, expected, True, False)
+    selftest_smtp(smtp, expected, True, True)
+    time.sleep(0.2)
+  finally:
+    server.stop()
+
+  with open(report) as fh:
+    sessions = [json.loads(l) for l in fh]
+  os.remove(report)
+  pop = [s for s in sessions if s['protocol'] == 'POP3']
+  smt = sorted((s for s in sessions if s['protocol'] == 'SMTP'), key=lambda s: s['session'])
+
+  def check(cond, text):
+    nonlocal failures
+    if not cond:
+      failures += 1
+      log('mailserver: FAILED: ' + text)
+
+  check(len(pop) == 2 and len(smt) == 3, 'number of sessions')
+  if len(pop) == 2 and len(smt) == 3:
+    pop.sort(key=lambda s: s['session'])
+    check(all(s['mails'] == count for s in pop + smt), 'number of transferred mails')
+    check(all(s['mail_bytes'] == sum(len(m) for m in expected) for s in pop + smt), 'number of mail bytes')
+    # banner + USER + PASS + UIDL + 2 per mail + QUIT
+    check(pop[0]['round_trips'] == 4 + 2*count, 'lock-step POP3 round trips %d' % pop[0]['round_trips'])
+    check(pop[1]['round_trips'] <= 6, 'pipelined POP3 round trips %d' % pop[1]['round_trips'])
+    check(smt[0]['round_trips'] == 2 + 5*count, 'lock-step SMTP round trips %d' % smt[0]['round_trips'])
+    check(smt[1]['round_trips'] <= 2 + 3*count, 'pipelined SMTP round trips %d' % smt[1]['round_trips'])
+    check(smt[2]['round_trips'] <= 2 + 2*count, 'BDAT round trips %d' % smt[2]['round_trips'])
+    log('mailserver: POP3 round trips %d lock-step, %d pipelined; SMTP %d lock-step, %d pipelined, %d BDAT'
+        % (pop[0]['round_trips'], pop[1]['round_trips'], smt[0]['round_trips'], smt[1]['round_trips'], smt[2]['round_trips']))
+
+  if failures == 0:
+    log('mailserver: OK')
+  else:
+    log('mailserver: %d FAILURES' % failures)
+  return 0 if failures == 0 else 1
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Scripted POP3/SMTP server for benchmarking YAM.')
+  parser.add_argument('--scenario', choices=sorted(SCENARIOS), help='preset of the values below')
+  parser.add_argument('--list-scenarios', action='store_true', help='list the scenarios and exit')
+  parser.add_argument('--bind', default='0.0.0.0', help='address to listen on (default: %(default)s)')
+  parser.add_argument('--pop3-port', type=int, default=11110, help='POP3 port (default: %(default)s)')
+  parser.add_argument('--smtp-port', type=int, default=11025, help='SMTP port (default: %(default)s)')
+  parser.add_argument('--messages', type=int, help='number of mails in the mailbox (default: 200)')
+  parser.add_argument('--size', type=int, help='size of each mail in bytes (default: 4096)')
+  parser.add_argument('--latency', type=int, help='delay per round trip in ms (default: 0)')
+  parser.add_argument('--pop3-caps', help='comma separated POP3 capabilities, APOP enables the APOP banner')
+  parser.add_argument('--smtp-caps', help='comma separated ESMTP extensions, AUTH is given as "AUTH PLAIN LOGIN"')
+  parser.add_argument('--user', help='accept this user only (default: any)')
+  parser.add_argument('--password', help='accept this password only (default: any)')
+  parser.add_argument('--seed', type=int, default=1, help='seed for the mail contents (default: %(default)s)')
+  parser.add_argument('--report', help='append a JSON line per session to this file')
+  parser.add_argument('--verbose', action='store_true', help='log every command')
+  parser.add_argument('--selftest', action='store_true', help='check the server against a built-in client and exit')
+  options = parser.parse_args()
+
+  if options.list_scenarios:
+    for name in sorted(SCENARIOS):
+      s = SCENARIOS[name]
+      log('%-13s %s\n%-13s %d mails of %d bytes, %d ms latency, POP3 %s, SMTP %s'
+          % (name, s['help'], '', s['messages'], s['size'], s['latency'], s['pop3_caps'], s['smtp_caps']))
+    return 0
+
+  if options.selftest:
+    return selftest(options)
+
+  preset = SCENARIOS.get(options.scenario, SCENARIOS['pipelined'])
+  for key in ('messages', 'size', 'latency', 'pop3_caps', 'smtp_caps'):
+    if getattr(options, key) is None:
+      setattr(options, key, preset[key])
+
+  server = Server(options)
+  pop3, smtp = server.start()
+  log('mailbench: POP3 on port %d, SMTP on port %d, %d mails of %d bytes, %d ms latency'
+      % (pop3, smtp, options.messages, options.size, options.latency))
+  log('mailbench: POP3 capabilities %s, SMTP extensions %s' % (options.pop3_caps, options.smtp_caps))
+  try:
+    while True:
+      time.sleep(3600)
+  except KeyboardInterrupt:
+    server.stop()
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())